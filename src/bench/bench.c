@@ -0,0 +1,357 @@
+/*
+ * bench.c - Benchmarks for libkutil.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <fcntl.h>              // open, O_WRONLY
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint64_t
+#include <stdio.h>              // FILE, fdopen, fprintf, fflush, snprintf, stderr, stdout
+#include <stdlib.h>             // free, malloc, qsort, strtoull
+#include <string.h>             // strcmp, strerror, strstr
+#include <unistd.h>             // close, dup, dup2, getopt, optind
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // ADDR
+#include "libkern.h"            // kernel_find, kernel_read, kernel_write
+#include "sim.h"                // sim_*
+#include "timer.h"              // timer_ns
+
+#include "bench.h"
+
+#define DEFAULT_ITERATIONS  50
+#define DEFAULT_LATENCY     20000   /* ns, roughly one mach_msg round trip */
+#define DEFAULT_MAX_XFER    0xFFF   /* what MIG lets through */
+#define DEFAULT_PAGE_SIZE   0x4000  /* for out-of-line transfers */
+#define DEFAULT_PAGE_NS     1000    /* ns per page mapped out-of-line */
+#define DEFAULT_SEED        0x6b7574696c
+#define HEAP_REGIONS        4096
+
+typedef struct
+{
+    kbackend_t *be;
+    sim_image_t img;
+    FILE *out;
+    const char *filter;
+    size_t iterations;
+    uint64_t *samples;
+    bool first;
+    int null_fd;
+    int saved_stdout;
+    int saved_stderr;
+} bench_t;
+
+typedef int (*bench_fn_t)(bench_t *b, void *arg);
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-f filter] [-l latency] [-m max_xfer] [-n iterations] [-o file] [-p page_size]\n"
+                    "Runs libkutil benchmarks against a simulated kernel and writes JSON results.\n"
+                    "\n"
+                    "Options:\n"
+                    "    -f  Only run benchmarks whose name contains filter\n"
+                    "    -h  Print this help\n"
+                    "    -l  Simulated latency per backend call in ns (default %u)\n"
+                    "    -m  Simulated transfer limit per call (default 0x%x, 0 = none)\n"
+                    "    -n  Iterations per benchmark (default %u)\n"
+                    "    -o  Write results to file instead of stdout\n"
+                    "    -p  Page size of simulated out-of-line transfers (default 0x%x, 0 = none)\n"
+                    , self, DEFAULT_LATENCY, DEFAULT_MAX_XFER, DEFAULT_ITERATIONS, DEFAULT_PAGE_SIZE);
+}
+
+static int u64_cmp(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t*)a,
+             y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+// Nearest-rank percentile of sorted samples
+static uint64_t percentile(const uint64_t *s, size_t n, unsigned int p)
+{
+    size_t rank = (n * p + 99) / 100;
+    return s[rank > 0 ? rank - 1 : 0];
+}
+
+// Tools print plenty, and we're not here to measure the terminal
+static void quiet(bench_t *b, bool on)
+{
+    fflush(stdout);
+    fflush(stderr);
+    if(on)
+    {
+        dup2(b->null_fd, STDOUT_FILENO);
+        dup2(b->null_fd, STDERR_FILENO);
+    }
+    else
+    {
+        dup2(b->saved_stdout, STDOUT_FILENO);
+        dup2(b->saved_stderr, STDERR_FILENO);
+    }
+}
+
+static void run(bench_t *b, const char *name, uint64_t bytes, bool noisy, bench_fn_t fn, void *arg)
+{
+    if(b->filter != NULL && strstr(name, b->filter) == NULL)
+    {
+        return;
+    }
+    if(noisy)
+    {
+        quiet(b, true);
+    }
+    // One warmup round, which also tells us how many backend calls an iteration takes
+    uint64_t calls = sim_calls(b->be);
+    int ret = fn(b, arg);
+    calls = sim_calls(b->be) - calls;
+    for(size_t i = 0; ret == 0 && i < b->iterations; ++i)
+    {
+        uint64_t start = timer_ns();
+        ret = fn(b, arg);
+        b->samples[i] = timer_ns() - start;
+    }
+    if(noisy)
+    {
+        quiet(b, false);
+    }
+    if(ret != 0)
+    {
+        fprintf(stderr, "[!] Benchmark %s failed\n", name);
+        return;
+    }
+
+    size_t n = b->iterations;
+    qsort(b->samples, n, sizeof(*b->samples), &u64_cmp);
+    uint64_t sum = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        sum += b->samples[i];
+    }
+    uint64_t p50 = percentile(b->samples, n, 50);
+    fprintf(b->out, "%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"bytes\": %llu, \"calls\": %llu"
+                    ", \"min_ns\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu"
+                    ", \"mb_per_s\": %.2f}"
+                    , b->first ? "" : ","
+                    , name, n, (unsigned long long)bytes, (unsigned long long)calls
+                    , (unsigned long long)b->samples[0], (unsigned long long)(sum / n), (unsigned long long)p50
+                    , (unsigned long long)percentile(b->samples, n, 90), (unsigned long long)percentile(b->samples, n, 99)
+                    , (unsigned long long)b->samples[n - 1]
+                    , p50 != 0 ? (double)bytes * 1000.0 / (double)p50 : 0.0);
+    fflush(b->out);
+    b->first = false;
+}
+
+/* ----- Microbenchmarks ----- */
+
+typedef struct
+{
+    vm_address_t addr;
+    vm_size_t size;
+    void *buf;
+} io_arg_t;
+
+static int bench_read(bench_t *b, void *arg)
+{
+    io_arg_t *io = arg;
+    return kernel_read(io->addr, io->size, io->buf) == io->size ? 0 : -1;
+}
+
+static int bench_write(bench_t *b, void *arg)
+{
+    io_arg_t *io = arg;
+    return kernel_write(io->addr, io->size, io->buf) == io->size ? 0 : -1;
+}
+
+static int bench_find(bench_t *b, void *arg)
+{
+    io_arg_t *io = arg;
+    return kernel_find(io->addr, io->size, io->buf, 16) == b->img.needle ? 0 : -1;
+}
+
+/* ----- Macrobenchmarks ----- */
+
+static int bench_kdump(bench_t *b, void *arg)
+{
+    const char *argv[] = { "kdump", "/dev/null", NULL };
+    return kdump_main(2, argv);
+}
+
+static int bench_kmem(bench_t *b, void *arg)
+{
+    char addr[32],
+         size[32];
+    snprintf(addr, sizeof(addr), "0x" ADDR, b->img.base);
+    snprintf(size, sizeof(size), "0x%lx", (unsigned long)*(vm_size_t*)arg);
+    char *argv[] = { "kmem", addr, size, NULL };
+    optind = 1;
+#ifdef __APPLE__
+    optreset = 1;
+#endif
+    return kmem_main(3, argv);
+}
+
+static int bench_kmap(bench_t *b, void *arg)
+{
+    const char *argv[] = { "kmap", arg, NULL };
+    return kmap_main(arg != NULL ? 2 : 1, argv);
+}
+
+static int bench_nvpatch(bench_t *b, void *arg)
+{
+    const char *argv[] = { "nvpatch", NULL };
+    return nvpatch_main(1, argv);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t latency = DEFAULT_LATENCY;
+    vm_size_t max_xfer = DEFAULT_MAX_XFER,
+              page_size = DEFAULT_PAGE_SIZE;
+    const char *outfile = NULL;
+    bench_t b =
+    {
+        .filter = NULL,
+        .iterations = DEFAULT_ITERATIONS,
+        .first = true,
+    };
+    char *end;
+    int c;
+
+    while((c = getopt(argc, argv, "f:hl:m:n:o:p:")) != -1)
+    {
+        switch(c)
+        {
+            case 'f':
+                b.filter = optarg;
+                break;
+            case 'l':
+                latency = strtoull(optarg, &end, 0);
+                break;
+            case 'm':
+                max_xfer = strtoull(optarg, &end, 0);
+                break;
+            case 'n':
+                b.iterations = strtoull(optarg, &end, 0);
+                break;
+            case 'o':
+                outfile = optarg;
+                break;
+            case 'p':
+                page_size = strtoull(optarg, &end, 0);
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+    if(page_size & (page_size - 1))
+    {
+        fprintf(stderr, "[!] Page size must be a power of two\n");
+        return -1;
+    }
+    if(b.iterations == 0)
+    {
+        fprintf(stderr, "[!] Need at least one iteration\n");
+        return -1;
+    }
+
+    b.saved_stdout = dup(STDOUT_FILENO);
+    b.saved_stderr = dup(STDERR_FILENO);
+    b.null_fd = open("/dev/null", O_WRONLY);
+    b.out = outfile != NULL ? fopen(outfile, "w") : fdopen(dup(STDOUT_FILENO), "w");
+    b.samples = malloc(b.iterations * sizeof(*b.samples));
+    b.be = sim_create(SIM_IMAGE_BASE, latency, max_xfer);
+    if(b.saved_stdout < 0 || b.saved_stderr < 0 || b.null_fd < 0 || b.out == NULL || b.samples == NULL || b.be == NULL)
+    {
+        fprintf(stderr, "[!] Setup failed: %s\n", strerror(errno));
+        return -1;
+    }
+    sim_set_ool(b.be, page_size, DEFAULT_PAGE_NS);
+    if(sim_image_build(b.be, &b.img, 0, DEFAULT_SEED, HEAP_REGIONS) != 0)
+    {
+        fprintf(stderr, "[!] Failed to build simulated kernel\n");
+        return -1;
+    }
+    kernel_set_backend(b.be);
+
+    fprintf(b.out, "{\n  \"config\": {\"latency_ns\": %llu, \"max_xfer\": %lu, \"page_size\": %lu, \"iterations\": %zu, \"seed\": %llu, \"heap_regions\": %u},\n  \"results\": ["
+            , (unsigned long long)latency, (unsigned long)max_xfer, (unsigned long)page_size, b.iterations, (unsigned long long)DEFAULT_SEED, HEAP_REGIONS);
+
+    char name[128];
+    void *buf = malloc(b.img.text_size);
+    if(buf == NULL)
+    {
+        fprintf(stderr, "[!] Failed to allocate buffer: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // kernel_read: request size vs. alignment, around the transfer limit in particular
+    static const vm_size_t sizes[] = { 0x10, 0x200, 0xfff, 0x1000, 0x1001, 0x1ffe, 0x4000, 0x10000, 0x100000 };
+    static const vm_size_t aligns[] = { 0, 0x8, 0x7ff };
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(*sizes); ++i)
+    {
+        for(size_t j = 0; j < sizeof(aligns) / sizeof(*aligns); ++j)
+        {
+            io_arg_t io = { .addr = b.img.base + 0x10000 + aligns[j], .size = sizes[i], .buf = buf };
+            snprintf(name, sizeof(name), "kernel_read/size=0x%lx/align=0x%lx", (unsigned long)sizes[i], (unsigned long)aligns[j]);
+            run(&b, name, sizes[i], false, &bench_read, &io);
+        }
+    }
+
+    // kernel_write into __DATA, rewriting what is already there
+    static const vm_size_t wsizes[] = { 0x8, 0x1000, 0x10000 };
+    for(size_t i = 0; i < sizeof(wsizes) / sizeof(*wsizes); ++i)
+    {
+        io_arg_t io = { .addr = b.img.base + b.img.text_size + 0x10000, .size = wsizes[i], .buf = buf };
+        if(kernel_read(io.addr, io.size, buf) != io.size)
+        {
+            fprintf(stderr, "[!] Failed to read write target\n");
+            return -1;
+        }
+        snprintf(name, sizeof(name), "kernel_write/size=0x%lx", (unsigned long)wsizes[i]);
+        run(&b, name, wsizes[i], false, &bench_write, &io);
+    }
+
+    // kernel_find with the needle at the very end of the range
+    static const vm_size_t franges[] = { 0x10000, 0x100000, 0x1000000 };
+    unsigned char needle[16];
+    if(kernel_read(b.img.needle, sizeof(needle), needle) != sizeof(needle))
+    {
+        fprintf(stderr, "[!] Failed to read needle\n");
+        return -1;
+    }
+    for(size_t i = 0; i < sizeof(franges) / sizeof(*franges); ++i)
+    {
+        io_arg_t io = { .addr = b.img.needle + 16 - franges[i], .size = franges[i], .buf = needle };
+        snprintf(name, sizeof(name), "kernel_find/range=0x%lx", (unsigned long)franges[i]);
+        run(&b, name, franges[i], false, &bench_find, &io);
+    }
+
+    // Whole tools
+    run(&b, "kdump", b.img.text_size + b.img.data_size, true, &bench_kdump, NULL);
+    static const vm_size_t ksizes[] = { 0x1000, 0x100000 };
+    for(size_t i = 0; i < sizeof(ksizes) / sizeof(*ksizes); ++i)
+    {
+        vm_size_t ksize = ksizes[i];
+        snprintf(name, sizeof(name), "kmem/hexdump/size=0x%lx", (unsigned long)ksize);
+        run(&b, name, ksize, true, &bench_kmem, &ksize);
+    }
+    run(&b, "kmap", 0, true, &bench_kmap, NULL);
+    run(&b, "kmap/extended", 0, true, &bench_kmap, "-e");
+    run(&b, "nvpatch/list", b.img.data_size, true, &bench_nvpatch, NULL);
+
+    fprintf(b.out, "\n  ]\n}\n");
+    fclose(b.out);
+
+    kernel_set_backend(NULL);
+    sim_destroy(b.be);
+    free(buf);
+    free(b.samples);
+    return 0;
+}
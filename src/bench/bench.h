@@ -0,0 +1,18 @@
+/*
+ * bench.h - Benchmarks for libkutil.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * The tools are linked in with their main renamed (see Makefile).
+ */
+int kdump_main(int argc, const char **argv);
+int kmap_main(int argc, const char **argv);
+int kmem_main(int argc, char **argv);
+int nvpatch_main(int argc, const char **argv);
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * CommonDigest.h - SHA-256 with the CommonCrypto interface (see compat.c).
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef COMPAT_COMMONDIGEST_H
+#define COMPAT_COMMONDIGEST_H
+
+#include <stdint.h>             // uint32_t, uint64_t, uint8_t
+
+#define CC_SHA256_DIGEST_LENGTH 32
+#define CC_SHA256_BLOCK_BYTES   64
+
+typedef uint32_t CC_LONG;
+
+typedef struct
+{
+    uint32_t state[8];
+    uint64_t count;             // Bytes hashed so far
+    uint8_t buf[CC_SHA256_BLOCK_BYTES];
+} CC_SHA256_CTX;
+
+int CC_SHA256_Init(CC_SHA256_CTX *ctx);
+int CC_SHA256_Update(CC_SHA256_CTX *ctx, const void *data, CC_LONG len);
+int CC_SHA256_Final(unsigned char *md, CC_SHA256_CTX *ctx);
+
+#endif
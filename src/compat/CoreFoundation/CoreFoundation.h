@@ -0,0 +1,12 @@
+/*
+ * CoreFoundation.h - The one symbol arch.h needs.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef COMPAT_COREFOUNDATION_H
+#define COMPAT_COREFOUNDATION_H
+
+extern double kCFCoreFoundationVersionNumber;
+
+#endif
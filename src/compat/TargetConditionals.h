@@ -0,0 +1,13 @@
+/*
+ * TargetConditionals.h - Build everything as if for iOS.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef COMPAT_TARGETCONDITIONALS_H
+#define COMPAT_TARGETCONDITIONALS_H
+
+// The simulated kernels are arm64, so lay out structures the way iOS does.
+#define TARGET_OS_IPHONE 1
+
+#endif
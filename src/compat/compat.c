@@ -0,0 +1,229 @@
+/*
+ * compat.c - Mach stand-ins and SHA-256 for hosts without them.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdint.h>             // uint32_t, uint64_t, uint8_t
+#include <string.h>             // memcpy, memset
+
+#include <CommonCrypto/CommonDigest.h> // CC_SHA256_*
+#include <mach/mach.h>          // Everything else
+
+// Same as arm64 iOS, so that the simulated kernels look familiar.
+vm_size_t vm_page_size = 0x4000;
+vm_size_t vm_kernel_page_size = 0x4000;
+vm_size_t vm_kernel_page_mask = 0x3fff;
+
+// Recent enough for HAVE_TAGGED_REGIONS to be false.
+double kCFCoreFoundationVersionNumber = 1400;
+
+/********** ********** ********** ********** ********** Mach ********** ********** ********** ********** **********/
+
+// There is no kernel to talk to, so everything fails with what iOS
+// returns to processes that lack the entitlements. The port names of our
+// own task and host are still valid, since the backends that stand in
+// for the kernel hand out the former as their kernel task.
+
+mach_port_t mach_task_self(void)
+{
+    return 0x103;
+}
+
+mach_port_t mach_host_self(void)
+{
+    return 0x203;
+}
+
+kern_return_t task_for_pid(mach_port_t target, int pid, task_t *task)
+{
+    *task = MACH_PORT_NULL;
+    return KERN_FAILURE;
+}
+
+kern_return_t pid_for_task(mach_port_t task, int *pid)
+{
+    return KERN_FAILURE;
+}
+
+kern_return_t host_get_special_port(host_t host, int node, int which, mach_port_t *port)
+{
+    *port = MACH_PORT_NULL;
+    return KERN_FAILURE;
+}
+
+kern_return_t task_info(task_t task, int flavor, task_info_t info, mach_msg_type_number_t *count)
+{
+    return KERN_FAILURE;
+}
+
+kern_return_t mach_port_deallocate(task_t task, mach_port_t name)
+{
+    return KERN_SUCCESS;
+}
+
+const char* mach_error_string(kern_return_t err)
+{
+    switch(err)
+    {
+        case KERN_SUCCESS:              return "(os/kern) successful";
+        case KERN_INVALID_ADDRESS:      return "(os/kern) invalid address";
+        case KERN_PROTECTION_FAILURE:   return "(os/kern) protection failure";
+        case KERN_NO_SPACE:             return "(os/kern) no space available";
+        case KERN_INVALID_ARGUMENT:     return "(os/kern) invalid argument";
+        case KERN_FAILURE:              return "(os/kern) failure";
+        case KERN_RESOURCE_SHORTAGE:    return "(os/kern) resource shortage";
+        case KERN_NOT_SUPPORTED:        return "(os/kern) not supported";
+    }
+    return "unknown error code";
+}
+
+kern_return_t vm_read(vm_map_t map, vm_address_t addr, vm_size_t size, vm_offset_t *data, mach_msg_type_number_t *count)
+{
+    return KERN_INVALID_ARGUMENT;
+}
+
+kern_return_t vm_read_list(vm_map_t map, vm_read_entry_t list, natural_t count)
+{
+    return KERN_INVALID_ARGUMENT;
+}
+
+kern_return_t vm_read_overwrite(vm_map_t map, vm_address_t addr, vm_size_t size, vm_address_t data, vm_size_t *outsize)
+{
+    return KERN_INVALID_ARGUMENT;
+}
+
+kern_return_t vm_write(vm_map_t map, vm_address_t addr, vm_offset_t data, mach_msg_type_number_t count)
+{
+    return KERN_INVALID_ARGUMENT;
+}
+
+kern_return_t vm_deallocate(vm_map_t map, vm_address_t addr, vm_size_t size)
+{
+    return KERN_SUCCESS;
+}
+
+kern_return_t vm_region_recurse_64(vm_map_t map, vm_address_t *addr, vm_size_t *size, natural_t *depth, vm_region_info_t info, mach_msg_type_number_t *count)
+{
+    return KERN_INVALID_ARGUMENT;
+}
+
+// Declared by libkern.c itself, like on iOS
+kern_return_t mach_vm_region(vm_map_t map, mach_vm_address_t *addr, mach_vm_size_t *size, vm_region_flavor_t flavor, vm_region_info_t info, mach_msg_type_number_t *count, mach_port_t *object)
+{
+    return KERN_INVALID_ARGUMENT;
+}
+
+/********** ********** ********** ********** ********** SHA-256 ********** ********** ********** ********** **********/
+
+// Plain FIPS 180-4, for merkle.c. It only ever hashes what the benchmark
+// and the tests feed it, so this is kept short rather than fast.
+
+static const uint32_t K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void sha256_block(uint32_t state[8], const uint8_t *p)
+{
+    uint32_t w[64];
+    for(size_t i = 0; i < 16; ++i)
+    {
+        w[i] = ((uint32_t)p[4*i] << 24) | ((uint32_t)p[4*i+1] << 16) | ((uint32_t)p[4*i+2] << 8) | (uint32_t)p[4*i+3];
+    }
+    for(size_t i = 16; i < 64; ++i)
+    {
+        uint32_t s0 = ROR(w[i-15],  7) ^ ROR(w[i-15], 18) ^ (w[i-15] >>  3),
+                 s1 = ROR(w[i- 2], 17) ^ ROR(w[i- 2], 19) ^ (w[i- 2] >> 10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+             e = state[4], f = state[5], g = state[6], h = state[7];
+    for(size_t i = 0; i < 64; ++i)
+    {
+        uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i],
+                 t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+int CC_SHA256_Init(CC_SHA256_CTX *ctx)
+{
+    static const uint32_t init[8] =
+    {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, init, sizeof(init));
+    ctx->count = 0;
+    return 1;
+}
+
+int CC_SHA256_Update(CC_SHA256_CTX *ctx, const void *data, CC_LONG len)
+{
+    const uint8_t *p = data;
+    size_t have = ctx->count % CC_SHA256_BLOCK_BYTES;
+    ctx->count += len;
+    if(have > 0)
+    {
+        size_t n = CC_SHA256_BLOCK_BYTES - have;
+        if(n > len)
+        {
+            n = len;
+        }
+        memcpy(&ctx->buf[have], p, n);
+        p   += n;
+        len -= n;
+        if(have + n < CC_SHA256_BLOCK_BYTES)
+        {
+            return 1;
+        }
+        sha256_block(ctx->state, ctx->buf);
+    }
+    for(; len >= CC_SHA256_BLOCK_BYTES; p += CC_SHA256_BLOCK_BYTES, len -= CC_SHA256_BLOCK_BYTES)
+    {
+        sha256_block(ctx->state, p);
+    }
+    memcpy(ctx->buf, p, len);
+    return 1;
+}
+
+int CC_SHA256_Final(unsigned char *md, CC_SHA256_CTX *ctx)
+{
+    uint64_t bits = ctx->count * 8;
+    size_t have = ctx->count % CC_SHA256_BLOCK_BYTES;
+    ctx->buf[have++] = 0x80;
+    if(have > CC_SHA256_BLOCK_BYTES - 8)
+    {
+        memset(&ctx->buf[have], 0, CC_SHA256_BLOCK_BYTES - have);
+        sha256_block(ctx->state, ctx->buf);
+        have = 0;
+    }
+    memset(&ctx->buf[have], 0, CC_SHA256_BLOCK_BYTES - 8 - have);
+    for(size_t i = 0; i < 8; ++i)
+    {
+        ctx->buf[CC_SHA256_BLOCK_BYTES - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    sha256_block(ctx->state, ctx->buf);
+    for(size_t i = 0; i < 8; ++i)
+    {
+        md[4*i]   = (uint8_t)(ctx->state[i] >> 24);
+        md[4*i+1] = (uint8_t)(ctx->state[i] >> 16);
+        md[4*i+2] = (uint8_t)(ctx->state[i] >>  8);
+        md[4*i+3] = (uint8_t)(ctx->state[i]);
+    }
+    memset(ctx, 0, sizeof(*ctx));
+    return 1;
+}
@@ -0,0 +1,235 @@
+/*
+ * compat.h - Just enough of the Mach headers to build on other hosts.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef COMPAT_H
+#define COMPAT_H
+
+/*
+ * Only used when the benchmark and the host tools are built on a system
+ * without Mach (see the UNIX defaults in the Makefile). Such builds can only
+ * ever talk to the simulated, snapshot or replay backends, so the kernel
+ * calls below exist to make things link and fail like a device without
+ * tfp0 would. Layouts follow the XNU headers for 64-bit hosts.
+ */
+
+#include <stdint.h>             // uint*_t, uintptr_t
+
+// Types
+
+typedef int kern_return_t;
+typedef int boolean_t;
+typedef int integer_t;
+typedef uint32_t natural_t;
+typedef unsigned int mach_port_t;
+typedef mach_port_t task_t;
+typedef mach_port_t host_t;
+typedef mach_port_t vm_map_t;
+typedef mach_port_t mach_port_name_t;
+typedef unsigned int mach_msg_type_number_t;
+typedef uintptr_t vm_address_t;
+typedef uintptr_t vm_offset_t;
+typedef uintptr_t vm_size_t;
+typedef uint64_t mach_vm_address_t;
+typedef uint64_t mach_vm_size_t;
+typedef unsigned long long memory_object_offset_t;
+typedef int vm_prot_t;
+typedef unsigned int vm_inherit_t;
+typedef int vm_behavior_t;
+typedef int vm_region_flavor_t;
+typedef int *vm_region_info_t;
+typedef int *task_info_t;
+typedef int cpu_type_t;
+typedef int cpu_subtype_t;
+
+// kern_return.h
+
+#define KERN_SUCCESS                0
+#define KERN_INVALID_ADDRESS        1
+#define KERN_PROTECTION_FAILURE     2
+#define KERN_NO_SPACE               3
+#define KERN_INVALID_ARGUMENT       4
+#define KERN_FAILURE                5
+#define KERN_RESOURCE_SHORTAGE      6
+#define KERN_NOT_SUPPORTED          46
+
+// port.h
+
+#define MACH_PORT_NULL              0
+#define MACH_PORT_DEAD              ((mach_port_t)~0)
+#define MACH_PORT_VALID(name)       (((name) != MACH_PORT_NULL) && ((name) != MACH_PORT_DEAD))
+
+// vm_prot.h, vm_inherit.h
+
+#define VM_PROT_NONE                0x0
+#define VM_PROT_READ                0x1
+#define VM_PROT_WRITE               0x2
+#define VM_PROT_EXECUTE             0x4
+#define VM_PROT_DEFAULT             (VM_PROT_READ | VM_PROT_WRITE)
+#define VM_PROT_ALL                 (VM_PROT_READ | VM_PROT_WRITE | VM_PROT_EXECUTE)
+
+#define VM_INHERIT_SHARE            0
+#define VM_INHERIT_COPY             1
+#define VM_INHERIT_NONE             2
+#define VM_INHERIT_DONATE_COPY      3
+
+// vm_region.h
+
+#define SM_COW                      1
+#define SM_PRIVATE                  2
+#define SM_EMPTY                    3
+#define SM_SHARED                   4
+#define SM_TRUESHARED               5
+#define SM_PRIVATE_ALIASED          6
+#define SM_SHARED_ALIASED           7
+#define SM_LARGE_PAGE               8
+
+typedef struct vm_region_submap_info_64
+{
+    vm_prot_t protection;
+    vm_prot_t max_protection;
+    vm_inherit_t inheritance;
+    memory_object_offset_t offset;
+    unsigned int user_tag;
+    unsigned int pages_resident;
+    unsigned int pages_shared_now_private;
+    unsigned int pages_swapped_out;
+    unsigned int pages_dirtied;
+    unsigned int ref_count;
+    unsigned short shadow_depth;
+    unsigned char external_pager;
+    unsigned char share_mode;
+    boolean_t is_submap;
+    vm_behavior_t behavior;
+    uint32_t object_id;
+    unsigned short user_wired_count;
+    unsigned int pages_reusable;
+} vm_region_submap_info_data_64_t, *vm_region_submap_info_64_t;
+
+#define VM_REGION_SUBMAP_INFO_COUNT_64 ((mach_msg_type_number_t)(sizeof(vm_region_submap_info_data_64_t) / sizeof(int)))
+
+typedef struct
+{
+    vm_prot_t protection;
+    unsigned int user_tag;
+    unsigned int pages_resident;
+    unsigned int pages_shared_now_private;
+    unsigned int pages_swapped_out;
+    unsigned int pages_dirtied;
+    unsigned int ref_count;
+    unsigned short shadow_depth;
+    unsigned char external_pager;
+    unsigned char share_mode;
+    unsigned int pages_reusable;
+} vm_region_extended_info_data_t;
+
+#define VM_REGION_EXTENDED_INFO     13
+#define VM_REGION_EXTENDED_INFO_COUNT ((mach_msg_type_number_t)(sizeof(vm_region_extended_info_data_t) / sizeof(int)))
+
+// vm_map.h
+
+#define VM_MAP_ENTRY_MAX            256
+
+struct vm_read_entry
+{
+    vm_address_t address;
+    vm_size_t size;
+};
+typedef struct vm_read_entry vm_read_entry_t[VM_MAP_ENTRY_MAX];
+
+// task_info.h, host_special_ports.h
+
+typedef struct
+{
+    mach_vm_address_t all_image_info_addr;
+    mach_vm_size_t all_image_info_size;
+    integer_t all_image_info_format;
+} task_dyld_info_data_t;
+
+#define TASK_DYLD_INFO              17
+#define TASK_DYLD_INFO_COUNT        ((mach_msg_type_number_t)(sizeof(task_dyld_info_data_t) / sizeof(natural_t)))
+
+#define HOST_LOCAL_NODE             -1
+
+// thread_status.h (arm only, since TargetConditionals.h claims iOS)
+
+#define ARM_THREAD_STATE            1
+#define ARM_THREAD_STATE64          6
+
+typedef struct
+{
+    uint32_t flavor;
+    uint32_t count;
+} arm_state_hdr_t;
+
+typedef struct
+{
+    uint32_t __r[13];
+    uint32_t __sp;
+    uint32_t __lr;
+    uint32_t __pc;
+    uint32_t __cpsr;
+} arm_thread_state32_t;
+
+typedef struct
+{
+    unsigned long long __x[29];
+    unsigned long long __fp;
+    unsigned long long __lr;
+    unsigned long long __sp;
+    unsigned long long __pc;
+    uint32_t __cpsr;
+    uint32_t __pad;
+} arm_thread_state64_t;
+
+typedef struct
+{
+    arm_state_hdr_t ash;
+    union
+    {
+        arm_thread_state32_t ts_32;
+        arm_thread_state64_t ts_64;
+    } uts;
+} arm_unified_thread_state_t;
+
+#define ts_32 uts.ts_32
+#define ts_64 uts.ts_64
+
+// machine.h
+
+#define CPU_ARCH_ABI64              0x01000000
+#define CPU_TYPE_X86                7
+#define CPU_TYPE_X86_64             (CPU_TYPE_X86 | CPU_ARCH_ABI64)
+#define CPU_TYPE_ARM                12
+#define CPU_TYPE_ARM64              (CPU_TYPE_ARM | CPU_ARCH_ABI64)
+
+// vm_page_size.h
+
+extern vm_size_t vm_page_size;
+extern vm_size_t vm_kernel_page_size;
+extern vm_size_t vm_kernel_page_mask;
+
+#define trunc_page_kernel(x)        ((x) & ~vm_kernel_page_mask)
+#define round_page_kernel(x)        trunc_page_kernel((x) + vm_kernel_page_mask)
+
+// Calls, all of which fail (see compat.c)
+
+mach_port_t mach_task_self(void);
+mach_port_t mach_host_self(void);
+kern_return_t task_for_pid(mach_port_t target, int pid, task_t *task);
+kern_return_t pid_for_task(mach_port_t task, int *pid);
+kern_return_t host_get_special_port(host_t host, int node, int which, mach_port_t *port);
+kern_return_t task_info(task_t task, int flavor, task_info_t info, mach_msg_type_number_t *count);
+kern_return_t mach_port_deallocate(task_t task, mach_port_t name);
+const char* mach_error_string(kern_return_t err);
+
+kern_return_t vm_read(vm_map_t map, vm_address_t addr, vm_size_t size, vm_offset_t *data, mach_msg_type_number_t *count);
+kern_return_t vm_read_list(vm_map_t map, vm_read_entry_t list, natural_t count);
+kern_return_t vm_read_overwrite(vm_map_t map, vm_address_t addr, vm_size_t size, vm_address_t data, vm_size_t *outsize);
+kern_return_t vm_write(vm_map_t map, vm_address_t addr, vm_offset_t data, mach_msg_type_number_t count);
+kern_return_t vm_deallocate(vm_map_t map, vm_address_t addr, vm_size_t size);
+kern_return_t vm_region_recurse_64(vm_map_t map, vm_address_t *addr, vm_size_t *size, natural_t *depth, vm_region_info_t info, mach_msg_type_number_t *count);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * loader.h - Mach-O structures, for hosts that don't ship them.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef COMPAT_LOADER_H
+#define COMPAT_LOADER_H
+
+#include <stdint.h>             // uint32_t, uint64_t, uint8_t
+
+#include "../compat.h"          // cpu_type_t, cpu_subtype_t, vm_prot_t
+
+struct mach_header
+{
+    uint32_t magic;
+    cpu_type_t cputype;
+    cpu_subtype_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+};
+
+struct mach_header_64
+{
+    uint32_t magic;
+    cpu_type_t cputype;
+    cpu_subtype_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+#define MH_MAGIC                0xfeedface
+#define MH_MAGIC_64             0xfeedfacf
+
+#define MH_EXECUTE              0x2
+#define MH_KEXT_BUNDLE          0xb
+#define MH_FILESET              0xc
+
+struct load_command
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+};
+
+union lc_str
+{
+    uint32_t offset;
+};
+
+#define LC_REQ_DYLD             0x80000000
+#define LC_SEGMENT              0x1
+#define LC_SYMTAB               0x2
+#define LC_UNIXTHREAD           0x5
+#define LC_DYSYMTAB             0xb
+#define LC_SEGMENT_64           0x19
+#define LC_UUID                 0x1b
+#define LC_VERSION_MIN_MACOSX   0x24
+#define LC_VERSION_MIN_IPHONEOS 0x25
+#define LC_FUNCTION_STARTS      0x26
+#define LC_SOURCE_VERSION       0x2a
+#define LC_VERSION_MIN_TVOS     0x2f
+#define LC_VERSION_MIN_WATCHOS  0x30
+
+struct segment_command
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char segname[16];
+    uint32_t vmaddr;
+    uint32_t vmsize;
+    uint32_t fileoff;
+    uint32_t filesize;
+    vm_prot_t maxprot;
+    vm_prot_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+};
+
+struct segment_command_64
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char segname[16];
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff;
+    uint64_t filesize;
+    vm_prot_t maxprot;
+    vm_prot_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+};
+
+struct section
+{
+    char sectname[16];
+    char segname[16];
+    uint32_t addr;
+    uint32_t size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+};
+
+struct section_64
+{
+    char sectname[16];
+    char segname[16];
+    uint64_t addr;
+    uint64_t size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+    uint32_t reserved3;
+};
+
+#define SECTION_TYPE            0x000000ff
+#define S_ZEROFILL              0x1
+#define S_CSTRING_LITERALS      0x2
+
+struct symtab_command
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t symoff;
+    uint32_t nsyms;
+    uint32_t stroff;
+    uint32_t strsize;
+};
+
+struct dysymtab_command
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t ilocalsym;
+    uint32_t nlocalsym;
+    uint32_t iextdefsym;
+    uint32_t nextdefsym;
+    uint32_t iundefsym;
+    uint32_t nundefsym;
+    uint32_t tocoff;
+    uint32_t ntoc;
+    uint32_t modtaboff;
+    uint32_t nmodtab;
+    uint32_t extrefsymoff;
+    uint32_t nextrefsyms;
+    uint32_t indirectsymoff;
+    uint32_t nindirectsyms;
+    uint32_t extreloff;
+    uint32_t nextrel;
+    uint32_t locreloff;
+    uint32_t nlocrel;
+};
+
+struct uuid_command
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint8_t uuid[16];
+};
+
+struct version_min_command
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t version;
+    uint32_t sdk;
+};
+
+struct source_version_command
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint64_t version;
+};
+
+struct linkedit_data_command
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t dataoff;
+    uint32_t datasize;
+};
+
+#endif
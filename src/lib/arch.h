@@ -10,6 +10,7 @@
 
 #include <TargetConditionals.h> // TARGET_OS_IPHONE
 #include <mach-o/loader.h>      // mach_header, mach_header_64, segment_command, segment_command_64
+#include <mach-o/nlist.h>       // nlist, nlist_64
 
 #include <CoreFoundation/CoreFoundation.h> // kCFCoreFoundationVersionNumber
 
@@ -31,6 +32,8 @@
 #   else
 #       define IMAGE_OFFSET 0x2000
 #       define MACH_TYPE CPU_TYPE_ARM64
+        // https://opensource.apple.com/source/xnu/xnu-3789.51.2/osfmk/mach/vm_statistics.h.auto.html
+#       define VM_KERNEL_LINK_ADDRESS 0xFFFFFFF007004000ULL
 #   endif
 #   define ADDR "%016lx"
 #   define SIZE "%lu"
@@ -41,6 +44,7 @@
     typedef struct mach_header_64 mach_hdr_t;
     typedef struct segment_command_64 mach_seg_t;
     typedef struct section_64 mach_sec_t;
+    typedef struct nlist_64 mach_nlist_t;
 #else
 #   ifdef TARGET_MACOS
 #       error "Unsupported architecture"
@@ -57,6 +61,7 @@
     typedef struct mach_header mach_hdr_t;
     typedef struct segment_command mach_seg_t;
     typedef struct section mach_sec_t;
+    typedef struct nlist mach_nlist_t;
 #endif
 typedef struct load_command mach_lc_t;
 
@@ -0,0 +1,102 @@
+/*
+ * backend.h - Pluggable implementations of kernel memory access.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include <stdbool.h>            // bool
+#include <stdint.h>             // uint64_t
+
+#include <mach/kern_return.h>   // kern_return_t
+#include <mach/mach_types.h>    // task_t
+#include <mach/vm_region.h>     // vm_region_submap_info_data_64_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "libkern.h"            // kernel_iov_t
+
+/*
+ * Everything in libkern.h ultimately goes through the active backend.
+ * By default that is the native one (tfp0 or Corellium's unicopy),
+ * but tools can be pointed at e.g. a simulated kernel instead.
+ */
+typedef struct kbackend kbackend_t;
+struct kbackend
+{
+    const char *name;
+
+    // Obtain a task port, or something that passes for one
+    kern_return_t (*task)(kbackend_t *be, task_t *task);
+
+    // Kernel base address, 0 on failure
+    vm_address_t (*base)(kbackend_t *be);
+
+    // A single transfer of at most max_xfer bytes; returns bytes transferred, 0 on failure
+    vm_size_t (*read)(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf);
+    vm_size_t (*write)(kbackend_t *be, vm_address_t addr, vm_size_t size, const void *buf);
+
+    // Same semantics as vm_region_recurse_64 on the kernel task
+    kern_return_t (*region)(kbackend_t *be, vm_address_t *addr, vm_size_t *size, unsigned int *depth, vm_region_submap_info_data_64_t *info);
+
+    // Largest transfer read/write accept, 0 if unlimited
+    vm_size_t max_xfer;
+
+    // Optional out-of-line transfers of whole, page-aligned ranges of any size;
+    // same return value as read/write. NULL if not supported.
+    vm_size_t (*read_large)(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf);
+    vm_size_t (*write_large)(kbackend_t *be, vm_address_t addr, vm_size_t size, const void *buf);
+
+    // Page size read_large/write_large align to, 0 for vm_kernel_page_size
+    vm_size_t page_size;
+
+    // Preferred size of large transfers, 0 to have libkern tune it on first use
+    vm_size_t large_xfer;
+
+    // Optional batch of reads in a single call, setting the result of each
+    // entry, all or nothing. NULL if not supported.
+    void (*read_list)(kbackend_t *be, kernel_iov_t *iov, size_t count);
+
+    // Most entries read_list takes at once
+    size_t max_list;
+
+    // Whether read may be called ahead of time and on addresses that might
+    // not be mapped. Together with concurrent, enables read-ahead (readahead.c).
+    bool speculative;
+
+    // Whether read and write may be called from several threads at once.
+    // Otherwise kio.c keeps to a single worker.
+    bool concurrent;
+
+    // Optional transfers by physical address, of any size; same return value
+    // as read/write. NULL if not supported.
+    vm_size_t (*read_phys)(kbackend_t *be, uint64_t paddr, vm_size_t size, void *buf);
+    vm_size_t (*write_phys)(kbackend_t *be, uint64_t paddr, vm_size_t size, const void *buf);
+
+    // Optional copy from one physical range to another in a single call;
+    // returns bytes copied. NULL if not supported.
+    vm_size_t (*copy_phys)(kbackend_t *be, uint64_t dst, uint64_t src, vm_size_t size);
+
+    void *priv;
+};
+
+/*
+ * Return the active backend.
+ */
+kbackend_t* kernel_backend(void);
+
+/*
+ * Replace the active backend. NULL restores the native one.
+ */
+void kernel_set_backend(kbackend_t *be);
+
+/*
+ * The transfers kernel_read splits a read into, without counting the call
+ * as a read or tracing it. Adds the number of transfers to *chunks.
+ *
+ * Returns the number of bytes read.
+ */
+vm_size_t backend_read(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf, uint64_t *chunks);
+
+#endif
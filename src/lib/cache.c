@@ -0,0 +1,101 @@
+/*
+ * cache.c - On-disk cache for data derived from a kernel image.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno, EEXIST
+#include <limits.h>             // PATH_MAX
+#include <stdint.h>             // uint8_t
+#include <stdio.h>              // FILE, fopen, fread, fwrite, fclose, snprintf, rename
+#include <stdlib.h>             // free, malloc, getenv
+#include <string.h>             // strerror
+#include <unistd.h>             // getpid, unlink
+
+#include <sys/stat.h>           // mkdir, fstat, struct stat
+
+#include "debug.h"              // DEBUG
+
+#include "cache.h"
+
+static int cache_path(const uint8_t uuid[16], const char *kind, char *buf, size_t len)
+{
+    const char *dir = getenv("KUTIL_CACHE_DIR");
+    if(dir == NULL || dir[0] == '\0')
+    {
+        dir = CACHE_DEFAULT_DIR;
+    }
+    if(mkdir(dir, 0755) != 0 && errno != EEXIST)
+    {
+        DEBUG("Failed to create cache dir %s: %s", dir, strerror(errno));
+        return -1;
+    }
+    int r = snprintf(buf, len, "%s/%02X%02X%02X%02X-%02X%02X-%02X%02X-%02X%02X-%02X%02X%02X%02X%02X%02X.%s", dir
+                     , uuid[ 0], uuid[ 1], uuid[ 2], uuid[ 3], uuid[ 4], uuid[ 5], uuid[ 6], uuid[ 7]
+                     , uuid[ 8], uuid[ 9], uuid[10], uuid[11], uuid[12], uuid[13], uuid[14], uuid[15]
+                     , kind);
+    return (r < 0 || (size_t)r >= len) ? -1 : 0;
+}
+
+void* cache_load(const uint8_t uuid[16], const char *kind, size_t *size)
+{
+    char path[PATH_MAX];
+    if(cache_path(uuid, kind, path, sizeof(path)) != 0)
+    {
+        return NULL;
+    }
+    FILE *f = fopen(path, "rb");
+    if(f == NULL)
+    {
+        return NULL;
+    }
+    void *data = NULL;
+    struct stat s;
+    if(fstat(fileno(f), &s) == 0 && s.st_size > 0)
+    {
+        data = malloc(s.st_size);
+        if(data != NULL && fread(data, s.st_size, 1, f) != 1)
+        {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+    if(data != NULL)
+    {
+        DEBUG("Loaded cache entry %s", path);
+        *size = s.st_size;
+    }
+    return data;
+}
+
+int cache_store(const uint8_t uuid[16], const char *kind, const void *data, size_t size)
+{
+    char path[PATH_MAX],
+         tmp[PATH_MAX];
+    if(cache_path(uuid, kind, path, sizeof(path)) != 0 || snprintf(tmp, sizeof(tmp), "%s.%u", path, getpid()) >= sizeof(tmp))
+    {
+        return -1;
+    }
+    FILE *f = fopen(tmp, "wb");
+    if(f == NULL)
+    {
+        DEBUG("Failed to open %s for writing: %s", tmp, strerror(errno));
+        return -1;
+    }
+    int ret = fwrite(data, size, 1, f) == 1 ? 0 : -1;
+    if(fclose(f) != 0)
+    {
+        ret = -1;
+    }
+    if(ret == 0 && rename(tmp, path) != 0)
+    {
+        ret = -1;
+    }
+    if(ret != 0)
+    {
+        DEBUG("Failed to write cache entry %s: %s", path, strerror(errno));
+        unlink(tmp);
+    }
+    return ret;
+}
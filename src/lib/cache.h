@@ -0,0 +1,36 @@
+/*
+ * cache.h - On-disk cache for data derived from a kernel image.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint8_t
+
+/*
+ * Cache entries are keyed by kernel UUID and a short kind tag (e.g. "kext"),
+ * and live in $KUTIL_CACHE_DIR, or CACHE_DEFAULT_DIR if that is not set.
+ *
+ * Cached data must never contain slid addresses, since the slide changes
+ * with every boot while the UUID doesn't.
+ */
+#define CACHE_DEFAULT_DIR "/var/tmp/kutil"
+
+/*
+ * Load a cache entry.
+ *
+ * Returns a malloc'ed buffer and sets *size, or returns NULL if there is no entry.
+ */
+void* cache_load(const uint8_t uuid[16], const char *kind, size_t *size);
+
+/*
+ * Atomically create or replace a cache entry.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int cache_store(const uint8_t uuid[16], const char *kind, const void *data, size_t size);
+
+#endif
@@ -4,9 +4,537 @@
  * Copyright (c) 2016 Siguza
  */
 
-#include <stdbool.h>            // bool, false
+#include <errno.h>              // errno, EINTR
+#include <fcntl.h>              // open, O_*
+#include <pthread.h>            // pthread_*
+#include <sched.h>              // sched_yield
+#include <stdarg.h>             // va_list, va_start, va_arg, va_end
+#include <stdbool.h>            // bool, true, false
+#include <stddef.h>             // ptrdiff_t, size_t
+#include <stdint.h>             // intmax_t, uint32_t, uint64_t
+#include <stdio.h>              // fflush, fprintf, snprintf, stderr, stdout
+#include <stdlib.h>             // atexit, getenv
+#include <string.h>             // memcpy, strchr, strcmp, strerror, strlen, strnlen
+#include <sys/time.h>           // gettimeofday
+#include <time.h>               // struct timespec
+#include <unistd.h>             // fsync, ssize_t, write, STDERR_FILENO
+
+#include "timer.h"              // timer_ns
 
 #include "debug.h"
 
 bool verbose = false;
 bool slow = false;
+
+typedef struct
+{
+    uint64_t seq;           // pos + 1 once written at pos, pos + DEBUG_RING_SIZE once drained
+    const char *fmt;
+    uint64_t time;
+    uint32_t nargs;
+    uint32_t strsize;
+    uint64_t args[DEBUG_MAX_ARGS];
+    char str[DEBUG_STR_SIZE];
+} record_t;
+
+// String arguments are stored as offset and length into str
+#define STR_ARG(off, len)   ((uint64_t)(off) << 32 | (len))
+#define STR_NULL            UINT64_MAX
+
+static record_t ring[DEBUG_RING_SIZE];
+
+static struct
+{
+    pthread_once_t once;
+    pthread_mutex_t drain;  // Held by whoever drains, thread or debug_flush
+    pthread_mutex_t lock;   // Only for sleeping on wake
+    pthread_cond_t wake;
+    bool sleeping;
+    bool thread;
+    int fd;
+    bool sync;              // fd is a file
+    uint64_t t0;
+    uint64_t head;          // Next record to claim
+    uint64_t tail;          // Next record to drain
+    size_t buflen;
+    char buf[0x10000];
+} logger =
+{
+    .once = PTHREAD_ONCE_INIT,
+    .drain = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .fd = STDERR_FILENO,
+};
+
+/********** Formats **********/
+
+typedef enum
+{
+    ARG_NONE,               // %%
+    ARG_INT,
+    ARG_UINT,
+    ARG_DOUBLE,
+    ARG_STR,
+    ARG_PTR,
+    ARG_BAD,
+} argtype_t;
+
+typedef struct
+{
+    const char *start;      // The '%'
+    const char *end;        // Past the conversion character
+    bool width_arg;         // '*'
+    bool prec_arg;
+    int prec;               // -1 if none or '*'
+    char len[3];            // Length modifier
+    char conv;
+    argtype_t type;
+} spec_t;
+
+// Parse the conversion at p, which points at a '%'
+static void parse_spec(const char *p, spec_t *s)
+{
+    s->start = p++;
+    s->width_arg = s->prec_arg = false;
+    s->prec = -1;
+    s->len[0] = '\0';
+    while(*p != '\0' && strchr("-+ #0'", *p) != NULL)
+    {
+        ++p;
+    }
+    if(*p == '*')
+    {
+        s->width_arg = true;
+        ++p;
+    }
+    while(*p >= '0' && *p <= '9')
+    {
+        ++p;
+    }
+    if(*p == '.')
+    {
+        ++p;
+        if(*p == '*')
+        {
+            s->prec_arg = true;
+            ++p;
+        }
+        else
+        {
+            s->prec = 0;
+            while(*p >= '0' && *p <= '9')
+            {
+                s->prec = s->prec * 10 + (*p++ - '0');
+            }
+        }
+    }
+    size_t n = 0;
+    while(*p != '\0' && strchr("hljztLq", *p) != NULL)
+    {
+        if(n < sizeof(s->len) - 1)
+        {
+            s->len[n++] = *p;
+        }
+        ++p;
+    }
+    s->len[n] = '\0';
+    s->conv = *p;
+    s->end = *p != '\0' ? p + 1 : p;
+    switch(s->conv)
+    {
+        case '%':
+            s->type = ARG_NONE;
+            break;
+        case 'd': case 'i':
+            s->type = ARG_INT;
+            break;
+        case 'u': case 'o': case 'x': case 'X': case 'c':
+            s->type = ARG_UINT;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            s->type = ARG_DOUBLE;
+            break;
+        case 's':
+            s->type = ARG_STR;
+            break;
+        case 'p':
+            s->type = ARG_PTR;
+            break;
+        default:
+            s->type = ARG_BAD;
+            break;
+    }
+}
+
+static uint64_t get_int(va_list *ap, const char *len, bool sign)
+{
+    if(strcmp(len, "hh") == 0) return sign ? (uint64_t)(int64_t)(signed char)va_arg(*ap, int) : (unsigned char)va_arg(*ap, unsigned int);
+    if(strcmp(len, "h") == 0)  return sign ? (uint64_t)(int64_t)(short)va_arg(*ap, int) : (unsigned short)va_arg(*ap, unsigned int);
+    if(strcmp(len, "l") == 0)  return sign ? (uint64_t)(int64_t)va_arg(*ap, long) : va_arg(*ap, unsigned long);
+    if(strcmp(len, "ll") == 0 || strcmp(len, "q") == 0) return sign ? (uint64_t)va_arg(*ap, long long) : va_arg(*ap, unsigned long long);
+    if(strcmp(len, "j") == 0)  return sign ? (uint64_t)va_arg(*ap, intmax_t) : va_arg(*ap, uintmax_t);
+    if(strcmp(len, "z") == 0)  return sign ? (uint64_t)(int64_t)va_arg(*ap, ssize_t) : va_arg(*ap, size_t);
+    if(strcmp(len, "t") == 0)  return (uint64_t)(int64_t)va_arg(*ap, ptrdiff_t);
+    return sign ? (uint64_t)(int64_t)va_arg(*ap, int) : va_arg(*ap, unsigned int);
+}
+
+// Pull the arguments fmt asks for out of ap
+static void capture(record_t *r, const char *fmt, va_list *ap)
+{
+    r->nargs = 0;
+    r->strsize = 0;
+    for(const char *p = strchr(fmt, '%'); p != NULL; p = strchr(p, '%'))
+    {
+        spec_t s;
+        parse_spec(p, &s);
+        p = s.end;
+        if(s.type == ARG_NONE)
+        {
+            continue;
+        }
+        size_t need = 1 + s.width_arg + s.prec_arg;
+        if(s.type == ARG_BAD || r->nargs + need > DEBUG_MAX_ARGS)
+        {
+            // The rest gets printed as is
+            break;
+        }
+        if(s.width_arg)
+        {
+            r->args[r->nargs++] = (uint64_t)(int64_t)va_arg(*ap, int);
+        }
+        if(s.prec_arg)
+        {
+            int prec = va_arg(*ap, int);
+            s.prec = prec >= 0 ? prec : -1;
+            r->args[r->nargs++] = (uint64_t)(int64_t)prec;
+        }
+        uint64_t v = 0;
+        switch(s.type)
+        {
+            case ARG_INT:
+            case ARG_UINT:
+                v = get_int(ap, s.len, s.type == ARG_INT);
+                break;
+            case ARG_DOUBLE:
+                {
+                    double d = strchr(s.len, 'L') != NULL ? (double)va_arg(*ap, long double) : va_arg(*ap, double);
+                    memcpy(&v, &d, sizeof(v));
+                }
+                break;
+            case ARG_PTR:
+                v = (uintptr_t)va_arg(*ap, void*);
+                break;
+            case ARG_STR:
+                {
+                    const char *str = va_arg(*ap, const char*);
+                    if(str == NULL)
+                    {
+                        v = STR_NULL;
+                        break;
+                    }
+                    // Strings may not be terminated if there is a precision
+                    size_t room = DEBUG_STR_SIZE - r->strsize,
+                           max = s.prec >= 0 && (size_t)s.prec < room ? (size_t)s.prec : room,
+                           len = strnlen(str, max);
+                    memcpy(&r->str[r->strsize], str, len);
+                    v = STR_ARG(r->strsize, len);
+                    r->strsize += len;
+                }
+                break;
+            default:
+                break;
+        }
+        r->args[r->nargs++] = v;
+    }
+}
+
+static void out(const char *data, size_t len);
+
+// Print a record, in the same way printf would have
+static void render(const record_t *r)
+{
+    char tmp[0x400];
+    if(logger.sync)
+    {
+        uint64_t us = (r->time - logger.t0) / 1000;
+        int n = snprintf(tmp, sizeof(tmp), "%llu.%06llu ", (unsigned long long)(us / 1000000), (unsigned long long)(us % 1000000));
+        out(tmp, n);
+    }
+    const char *p = r->fmt;
+    size_t arg = 0;
+    while(*p != '\0')
+    {
+        const char *pct = strchr(p, '%');
+        if(pct == NULL)
+        {
+            out(p, strlen(p));
+            break;
+        }
+        out(p, pct - p);
+        spec_t s;
+        parse_spec(pct, &s);
+        p = s.end;
+        if(s.type == ARG_NONE)
+        {
+            out("%", 1);
+            continue;
+        }
+        if(s.type == ARG_BAD || arg + 1 + s.width_arg + s.prec_arg > r->nargs)
+        {
+            out(pct, strlen(pct));
+            break;
+        }
+        // Rebuild the conversion with '*' filled in and a length modifier that fits the stored value
+        char spec[64];
+        size_t n = 0;
+        for(const char *q = s.start; q < s.end - 1 - strlen(s.len) && n < sizeof(spec) - 24; ++q)
+        {
+            if(*q == '*')
+            {
+                n += snprintf(&spec[n], sizeof(spec) - n, "%d", (int)(int64_t)r->args[arg++]);
+            }
+            else
+            {
+                spec[n++] = *q;
+            }
+        }
+        uint64_t v = r->args[arg++];
+        int len = 0;
+        switch(s.type)
+        {
+            case ARG_INT:
+            case ARG_UINT:
+                if(s.conv == 'c')
+                {
+                    snprintf(&spec[n], sizeof(spec) - n, "c");
+                    len = snprintf(tmp, sizeof(tmp), spec, (int)v);
+                }
+                else
+                {
+                    snprintf(&spec[n], sizeof(spec) - n, "ll%c", s.conv);
+                    len = s.type == ARG_INT ? snprintf(tmp, sizeof(tmp), spec, (long long)v) : snprintf(tmp, sizeof(tmp), spec, (unsigned long long)v);
+                }
+                break;
+            case ARG_DOUBLE:
+                {
+                    double d;
+                    memcpy(&d, &v, sizeof(d));
+                    snprintf(&spec[n], sizeof(spec) - n, "%c", s.conv);
+                    len = snprintf(tmp, sizeof(tmp), spec, d);
+                }
+                break;
+            case ARG_PTR:
+                snprintf(&spec[n], sizeof(spec) - n, "p");
+                len = snprintf(tmp, sizeof(tmp), spec, (void*)(uintptr_t)v);
+                break;
+            case ARG_STR:
+                snprintf(&spec[n], sizeof(spec) - n, "s");
+                if(v == STR_NULL)
+                {
+                    len = snprintf(tmp, sizeof(tmp), spec, "(null)");
+                }
+                else
+                {
+                    char str[DEBUG_STR_SIZE + 1];
+                    size_t off = v >> 32,
+                           slen = v & 0xffffffff;
+                    memcpy(str, &r->str[off], slen);
+                    str[slen] = '\0';
+                    len = snprintf(tmp, sizeof(tmp), spec, str);
+                }
+                break;
+            default:
+                break;
+        }
+        if(len > 0)
+        {
+            out(tmp, (size_t)len < sizeof(tmp) ? (size_t)len : sizeof(tmp) - 1);
+        }
+    }
+}
+
+/********** Output **********/
+
+static void out_flush(void)
+{
+    const char *p = logger.buf;
+    size_t len = logger.buflen;
+    while(len > 0)
+    {
+        ssize_t n = write(logger.fd, p, len);
+        if(n < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            // Nowhere to complain to
+            break;
+        }
+        p += n;
+        len -= n;
+    }
+    logger.buflen = 0;
+}
+
+static void out(const char *data, size_t len)
+{
+    while(len > 0)
+    {
+        if(logger.buflen == sizeof(logger.buf))
+        {
+            out_flush();
+        }
+        size_t n = sizeof(logger.buf) - logger.buflen;
+        if(n > len)
+        {
+            n = len;
+        }
+        memcpy(&logger.buf[logger.buflen], data, n);
+        logger.buflen += n;
+        data += n;
+        len -= n;
+    }
+}
+
+// Write out records up to until, waiting for the ones still being filled in.
+// Must hold logger.drain.
+static void drain(uint64_t until)
+{
+    bool any = false;
+    for(; logger.tail < until; ++logger.tail)
+    {
+        record_t *r = &ring[logger.tail & (DEBUG_RING_SIZE - 1)];
+        while(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != logger.tail + 1)
+        {
+            sched_yield();
+        }
+        render(r);
+        __atomic_store_n(&r->seq, logger.tail + DEBUG_RING_SIZE, __ATOMIC_RELEASE);
+        any = true;
+    }
+    if(any)
+    {
+        out_flush();
+        if(logger.sync)
+        {
+            fsync(logger.fd);
+        }
+    }
+}
+
+static void* drainer(void *arg)
+{
+    while(1)
+    {
+        pthread_mutex_lock(&logger.drain);
+        drain(__atomic_load_n(&logger.head, __ATOMIC_ACQUIRE));
+        pthread_mutex_unlock(&logger.drain);
+
+        pthread_mutex_lock(&logger.lock);
+        __atomic_store_n(&logger.sleeping, true, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(&logger.head, __ATOMIC_SEQ_CST) == logger.tail)
+        {
+            // Producers don't take the lock, so a wakeup can be missed; don't sleep long
+            struct timeval now;
+            gettimeofday(&now, NULL);
+            uint64_t ns = (uint64_t)now.tv_usec * 1000 + 10000000;
+            struct timespec until =
+            {
+                .tv_sec = now.tv_sec + ns / 1000000000,
+                .tv_nsec = ns % 1000000000,
+            };
+            pthread_cond_timedwait(&logger.wake, &logger.lock, &until);
+        }
+        __atomic_store_n(&logger.sleeping, false, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&logger.lock);
+    }
+    return NULL;
+}
+
+static void debug_exit(void)
+{
+    debug_flush();
+}
+
+static void logger_init(void)
+{
+    for(size_t i = 0; i < DEBUG_RING_SIZE; ++i)
+    {
+        ring[i].seq = i;
+    }
+    logger.t0 = timer_ns();
+    const char *path = getenv(DEBUG_ENV);
+    if(path != NULL && path[0] != '\0')
+    {
+        int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if(fd < 0)
+        {
+            fprintf(stderr, "[!] Failed to open log %s: %s\n", path, strerror(errno));
+        }
+        else
+        {
+            logger.fd = fd;
+            logger.sync = true;
+        }
+    }
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, &drainer, NULL) == 0)
+    {
+        pthread_detach(thread);
+        logger.thread = true;
+    }
+    atexit(&debug_exit);
+}
+
+void debug_log(const char *fmt, ...)
+{
+    pthread_once(&logger.once, &logger_init);
+    uint64_t pos = __atomic_fetch_add(&logger.head, 1, __ATOMIC_ACQ_REL);
+    record_t *r = &ring[pos & (DEBUG_RING_SIZE - 1)];
+    // Full, wait for the drainer to get to this one
+    while(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != pos)
+    {
+        if(logger.thread)
+        {
+            pthread_cond_signal(&logger.wake);
+            sched_yield();
+        }
+        else if(pthread_mutex_trylock(&logger.drain) == 0)
+        {
+            drain(pos - DEBUG_RING_SIZE + 1);
+            pthread_mutex_unlock(&logger.drain);
+        }
+    }
+    r->fmt = fmt;
+    r->time = timer_ns();
+    va_list ap;
+    va_start(ap, fmt);
+    capture(r, fmt, &ap);
+    va_end(ap);
+    __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+    if(__atomic_load_n(&logger.sleeping, __ATOMIC_SEQ_CST))
+    {
+        pthread_cond_signal(&logger.wake);
+    }
+}
+
+void debug_flush(void)
+{
+    pthread_once(&logger.once, &logger_init);
+    fflush(stdout);
+    fflush(stderr);
+    pthread_mutex_lock(&logger.drain);
+    drain(__atomic_load_n(&logger.head, __ATOMIC_ACQUIRE));
+    pthread_mutex_unlock(&logger.drain);
+}
+
+__attribute__((constructor)) static void debug_init(void)
+{
+    const char *path = getenv(DEBUG_ENV);
+    if(path != NULL && path[0] != '\0')
+    {
+        verbose = true;
+    }
+}
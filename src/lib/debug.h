@@ -8,25 +8,61 @@
 #define DEBUG_H
 
 #include <stdbool.h>            // bool
-#include <stdio.h>              // fprintf, stderr
-#include <unistd.h>             // usleep
 
 #define BUGTRACKER_URL "https://github.com/Siguza/ios-kern-utils/issues/new"
 
-#define DEBUG(str, args...) \
+/*
+ * DEBUG doesn't format anything on the spot. It stores the format string
+ * pointer, the raw arguments (copies of strings) and a timestamp in a
+ * fixed-size record of a ring buffer, which a background thread drains
+ * to stderr, or to the file in KUTIL_LOG if that is set. Producers claim
+ * records with an atomic increment and never take a lock.
+ *
+ * In slow mode (-d), every DEBUG waits for the log to be written and synced
+ * to disk, so that it survives a kernel panic right after.
+ *
+ * Formats may use the usual integer, string, pointer and floating point
+ * conversions, with at most DEBUG_MAX_ARGS arguments.
+ */
+
+#define DEBUG_ENV           "KUTIL_LOG"
+#define DEBUG_RING_SIZE     1024    /* Records, power of two */
+#define DEBUG_MAX_ARGS      16
+#define DEBUG_STR_SIZE      160     /* Bytes of string arguments per record */
+
+#define DEBUG(str, args...) DEBUG_IF(verbose, str, ##args)
+
+/*
+ * For when more than the global switch decides, like a context's own
+ * verbose flag (see kutil.h).
+ */
+#define DEBUG_IF(cond, str, args...) \
 do \
 { \
-    if(verbose) \
+    if(cond) \
     { \
-        fprintf(stderr, "[DEBUG] " str " [" __FILE__ ":%u]\n", ##args, __LINE__); \
+        debug_log("[DEBUG] " str " [" __FILE__ ":%u]\n", ##args, __LINE__); \
     } \
     if(slow) \
     { \
-        usleep(100); \
+        debug_flush(); \
     } \
 } while(0)
 
 extern bool verbose;
 extern bool slow;
 
+/*
+ * Queue a message. fmt must be a string literal, or otherwise live forever.
+ */
+void debug_log(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/*
+ * Wait until everything logged so far has been written out, and synced if
+ * it goes to a file, and flush stdout and stderr.
+ *
+ * To be called right before anything that might bring the kernel down.
+ */
+void debug_flush(void);
+
 #endif
@@ -0,0 +1,357 @@
+/*
+ * emit.c - Structured output as JSON lines or binary records.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno, EINTR
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+#include <string.h>             // memcpy, strcmp, strlen
+#include <unistd.h>             // write
+
+#include "emit.h"
+
+// Two digits per lookup, so numbers take half as many divisions or shifts
+static const char dec_pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char hex_pairs[] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+bool emit_parse_fmt(const char *str, emit_fmt_t *fmt)
+{
+    if(strcmp(str, "text") == 0)
+    {
+        *fmt = EMIT_TEXT;
+    }
+    else if(strcmp(str, "json") == 0)
+    {
+        *fmt = EMIT_JSON;
+    }
+    else if(strcmp(str, "bin") == 0)
+    {
+        *fmt = EMIT_BIN;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+static void out_write(emit_t *e, const char *data, size_t size)
+{
+    while(size > 0 && e->err == 0)
+    {
+        ssize_t r = write(e->fd, data, size);
+        if(r < 0)
+        {
+            if(errno != EINTR)
+            {
+                e->err = errno;
+            }
+            continue;
+        }
+        data += r;
+        size -= r;
+    }
+}
+
+int emit_flush(emit_t *e)
+{
+    out_write(e, e->buf, e->len);
+    e->len = 0;
+    if(e->err != 0)
+    {
+        errno = e->err;
+        return -1;
+    }
+    return 0;
+}
+
+// Room for n bytes, n being small
+static char* reserve(emit_t *e, size_t n)
+{
+    if(e->len + n > sizeof(e->buf))
+    {
+        emit_flush(e);
+    }
+    return &e->buf[e->len];
+}
+
+static void put(emit_t *e, const void *data, size_t size)
+{
+    if(e->len + size > sizeof(e->buf))
+    {
+        emit_flush(e);
+        if(size > sizeof(e->buf))
+        {
+            out_write(e, data, size);
+            return;
+        }
+    }
+    memcpy(&e->buf[e->len], data, size);
+    e->len += size;
+}
+
+static void put_byte(emit_t *e, uint8_t b)
+{
+    *reserve(e, 1) = b;
+    ++e->len;
+}
+
+static void put_le(emit_t *e, uint64_t val, size_t size)
+{
+    char *p = reserve(e, size);
+    for(size_t i = 0; i < size; ++i)
+    {
+        p[i] = (val >> (8 * i)) & 0xff;
+    }
+    e->len += size;
+}
+
+static void put_dec(emit_t *e, uint64_t val)
+{
+    char tmp[20],
+         *p = &tmp[sizeof(tmp)];
+    while(val >= 100)
+    {
+        p -= 2;
+        memcpy(p, &dec_pairs[2 * (val % 100)], 2);
+        val /= 100;
+    }
+    if(val >= 10)
+    {
+        p -= 2;
+        memcpy(p, &dec_pairs[2 * val], 2);
+    }
+    else
+    {
+        *--p = '0' + val;
+    }
+    put(e, p, &tmp[sizeof(tmp)] - p);
+}
+
+static void put_hex(emit_t *e, uint64_t val)
+{
+    char tmp[16],
+         *p = &tmp[sizeof(tmp)];
+    do
+    {
+        p -= 2;
+        memcpy(p, &hex_pairs[2 * (val & 0xff)], 2);
+        val >>= 8;
+    } while(val != 0);
+    if(*p == '0' && p + 1 < &tmp[sizeof(tmp)])
+    {
+        ++p;
+    }
+    put(e, p, &tmp[sizeof(tmp)] - p);
+}
+
+// Everything but printable ASCII without quotes and backslashes is escaped.
+// Bytes above 0x7e come out as the Latin-1 code point of the same value,
+// which keeps the output valid UTF-8 no matter what the kernel had.
+static void put_json_str(emit_t *e, const char *str, size_t len)
+{
+    put_byte(e, '"');
+    size_t run = 0;
+    for(size_t i = 0; i < len; ++i)
+    {
+        uint8_t c = str[i];
+        if(c >= 0x20 && c < 0x7f && c != '"' && c != '\\')
+        {
+            continue;
+        }
+        put(e, &str[run], i - run);
+        run = i + 1;
+        char *p = reserve(e, 6);
+        switch(c)
+        {
+            case '"':   memcpy(p, "\\\"", 2); e->len += 2; break;
+            case '\\':  memcpy(p, "\\\\", 2); e->len += 2; break;
+            case '\n':  memcpy(p, "\\n", 2);  e->len += 2; break;
+            case '\r':  memcpy(p, "\\r", 2);  e->len += 2; break;
+            case '\t':  memcpy(p, "\\t", 2);  e->len += 2; break;
+            default:
+                memcpy(p, "\\u00", 4);
+                memcpy(p + 4, &hex_pairs[2 * c], 2);
+                e->len += 6;
+                break;
+        }
+    }
+    put(e, &str[run], len - run);
+    put_byte(e, '"');
+}
+
+static void put_key(emit_t *e, uint8_t tag, const char *key)
+{
+    size_t len = strlen(key);
+    if(e->fmt == EMIT_JSON)
+    {
+        put(e, ",\"", 2);
+        put(e, key, len);
+        put(e, "\":", 2);
+    }
+    else
+    {
+        put_byte(e, tag);
+        put_byte(e, len);
+        put(e, key, len & 0xff);
+    }
+}
+
+void emit_init(emit_t *e, int fd, emit_fmt_t fmt)
+{
+    e->fmt = fmt;
+    e->fd = fd;
+    e->err = 0;
+    e->len = 0;
+    if(fmt == EMIT_BIN)
+    {
+        put(e, "KUTB", 4);
+        put_le(e, EMIT_BIN_VERSION, sizeof(uint32_t));
+    }
+}
+
+void emit_begin(emit_t *e, const char *type)
+{
+    size_t len = strlen(type);
+    if(e->fmt == EMIT_JSON)
+    {
+        put(e, "{\"type\":\"", 9);
+        put(e, type, len);
+        put_byte(e, '"');
+    }
+    else
+    {
+        put_byte(e, len);
+        put(e, type, len & 0xff);
+    }
+}
+
+void emit_end(emit_t *e)
+{
+    if(e->fmt == EMIT_JSON)
+    {
+        put(e, "}\n", 2);
+    }
+    else
+    {
+        put_byte(e, EMIT_T_END);
+    }
+}
+
+void emit_u64(emit_t *e, const char *key, uint64_t val)
+{
+    put_key(e, EMIT_T_U64, key);
+    if(e->fmt == EMIT_JSON)
+    {
+        put_dec(e, val);
+    }
+    else
+    {
+        put_le(e, val, sizeof(val));
+    }
+}
+
+void emit_hex(emit_t *e, const char *key, uint64_t val)
+{
+    put_key(e, EMIT_T_HEX, key);
+    if(e->fmt == EMIT_JSON)
+    {
+        put(e, "\"0x", 3);
+        put_hex(e, val);
+        put_byte(e, '"');
+    }
+    else
+    {
+        put_le(e, val, sizeof(val));
+    }
+}
+
+void emit_bool(emit_t *e, const char *key, bool val)
+{
+    put_key(e, EMIT_T_BOOL, key);
+    if(e->fmt == EMIT_JSON)
+    {
+        if(val)
+        {
+            put(e, "true", 4);
+        }
+        else
+        {
+            put(e, "false", 5);
+        }
+    }
+    else
+    {
+        put_byte(e, val);
+    }
+}
+
+void emit_strn(emit_t *e, const char *key, const char *str, size_t len)
+{
+    put_key(e, EMIT_T_STR, key);
+    if(e->fmt == EMIT_JSON)
+    {
+        put_json_str(e, str, len);
+    }
+    else
+    {
+        put_le(e, len, sizeof(uint32_t));
+        put(e, str, len);
+    }
+}
+
+void emit_str(emit_t *e, const char *key, const char *str)
+{
+    emit_strn(e, key, str, strlen(str));
+}
+
+void emit_bytes(emit_t *e, const char *key, const void *data, size_t size)
+{
+    put_key(e, EMIT_T_BYTES, key);
+    if(e->fmt == EMIT_JSON)
+    {
+        const uint8_t *bytes = data;
+        put_byte(e, '"');
+        while(size > 0)
+        {
+            // Whatever fits, at least one byte
+            size_t n = (sizeof(e->buf) - e->len) / 2;
+            if(n == 0)
+            {
+                emit_flush(e);
+                continue;
+            }
+            n = n < size ? n : size;
+            char *p = &e->buf[e->len];
+            for(size_t i = 0; i < n; ++i)
+            {
+                memcpy(&p[2 * i], &hex_pairs[2 * bytes[i]], 2);
+            }
+            e->len += 2 * n;
+            bytes += n;
+            size -= n;
+        }
+        put_byte(e, '"');
+    }
+    else
+    {
+        put_le(e, size, sizeof(uint32_t));
+        put(e, data, size);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * emit.h - Structured output as JSON lines or binary records.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stdbool.h>            // bool
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint64_t
+
+/*
+ * Tools that take -o json|bin hand their records to an emitter instead of
+ * printf. Output is formatted straight into a buffer that lives in the
+ * emitter itself and is written out with write(2) whenever it fills up,
+ * so nothing is allocated after emit_init.
+ *
+ * JSON output is one object per line, with a "type" key naming the record.
+ * Addresses and hex values are strings ("0x..."), as JSON numbers can't
+ * hold 64 bits.
+ *
+ * Binary output starts with the 4 bytes "KUTB" and a little-endian uint32
+ * version (EMIT_BIN_VERSION), followed by records. A record is its type as
+ * a length byte and that many characters, then fields, then a 0 byte.
+ * A field is one of the EMIT_T_* tags, the key (length byte and characters)
+ * and the value: 8 bytes little-endian for EMIT_T_U64 and EMIT_T_HEX,
+ * 1 byte for EMIT_T_BOOL, and a little-endian uint32 length followed by
+ * the data for EMIT_T_STR and EMIT_T_BYTES.
+ */
+
+#define EMIT_BUF_SIZE       0x40000
+#define EMIT_BIN_VERSION    1
+
+typedef enum
+{
+    EMIT_TEXT,      // Whatever the tool prints by itself
+    EMIT_JSON,
+    EMIT_BIN,
+} emit_fmt_t;
+
+enum
+{
+    EMIT_T_END = 0,
+    EMIT_T_U64,
+    EMIT_T_HEX,
+    EMIT_T_BOOL,
+    EMIT_T_STR,
+    EMIT_T_BYTES,
+};
+
+typedef struct
+{
+    emit_fmt_t fmt;
+    int fd;
+    int err;                // errno of the first failed write, 0 if none
+    size_t len;
+    char buf[EMIT_BUF_SIZE];
+} emit_t;
+
+/*
+ * Parse "text", "json" or "bin".
+ */
+bool emit_parse_fmt(const char *str, emit_fmt_t *fmt);
+
+void emit_init(emit_t *e, int fd, emit_fmt_t fmt);
+
+void emit_begin(emit_t *e, const char *type);
+void emit_end(emit_t *e);
+
+void emit_u64(emit_t *e, const char *key, uint64_t val);
+void emit_hex(emit_t *e, const char *key, uint64_t val);
+void emit_bool(emit_t *e, const char *key, bool val);
+void emit_str(emit_t *e, const char *key, const char *str);
+void emit_strn(emit_t *e, const char *key, const char *str, size_t len);
+void emit_bytes(emit_t *e, const char *key, const void *data, size_t size);
+
+/*
+ * Write out everything buffered.
+ *
+ * Returns 0 on success, or -1 if any write failed (with errno set).
+ */
+int emit_flush(emit_t *e);
+
+#endif
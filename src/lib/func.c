@@ -0,0 +1,661 @@
+/*
+ * func.c - Function table from LC_FUNCTION_STARTS.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+#include <stdlib.h>             // free, malloc, qsort, realloc
+#include <string.h>             // memcpy, memset
+
+#include <mach/vm_prot.h>       // VM_PROT_EXECUTE
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <mach-o/loader.h>      // LC_FUNCTION_STARTS, LC_SYMTAB, MH_FILESET, struct *_command
+#include <mach-o/nlist.h>       // N_SECT, N_STAB, N_TYPE
+#include <sys/types.h>          // ssize_t
+
+#include "arch.h"               // ADDR, MACH_LC_SEGMENT, mach_*
+#include "cache.h"              // cache_load, cache_store
+#include "debug.h"              // DEBUG
+#include "libkern.h"            // kernel_header, kernel_read
+#include "mach-o.h"             // CMD_ITERATE, LC_FILESET_ENTRY, macho_*
+
+#include "func.h"
+
+#define FUNC_CACHE_KIND     "func"
+#define FUNC_CACHE_MAGIC    0x434e5546 /* FUNC */
+#define FUNC_CACHE_VERSION  1
+
+#define INSN_PACIBSP        0xd503237f
+
+/* Cache layout: header, then start and end of each function relative to the kernel base. */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+} func_cache_hdr_t;
+
+typedef struct
+{
+    vm_address_t start;
+    vm_address_t end;
+    const uint8_t *data;    // Contents, if building from a file
+} range_t;
+
+typedef struct
+{
+    const uint8_t *file;    // NULL when reading from the kernel
+    size_t filesize;
+    size_t count;
+    size_t cap;
+    vm_address_t *starts;
+    size_t nsyms;
+    size_t capsyms;
+    vm_address_t *syms;     // From symbol tables, kept apart until the prologue scan
+    size_t nranges;
+    size_t capranges;
+    range_t *ranges;        // Executable segments
+} builder_t;
+
+/* ----- Decoding ----- */
+
+// A whole ULEB128 of up to 8 bytes from an 8-byte load, without a loop.
+// Returns its length, or 0 if it is longer than that.
+static size_t uleb_fast(const uint8_t *p, uint64_t *val)
+{
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    // The first byte without the continuation bit ends it
+    uint64_t stop = ~w & 0x8080808080808080ULL;
+    if(stop == 0)
+    {
+        return 0;
+    }
+    size_t len = (__builtin_ctzll(stop) >> 3) + 1;
+    w &= len == 8 ? ~0ULL : (1ULL << (len * 8)) - 1;
+    // Squeeze the 7-bit groups together
+    *val = (w & 0x7fULL)
+         | ((w >>  1) & (0x7fULL <<  7))
+         | ((w >>  2) & (0x7fULL << 14))
+         | ((w >>  3) & (0x7fULL << 21))
+         | ((w >>  4) & (0x7fULL << 28))
+         | ((w >>  5) & (0x7fULL << 35))
+         | ((w >>  6) & (0x7fULL << 42))
+         | ((w >>  7) & (0x7fULL << 49));
+    return len;
+}
+
+// Same for the last few bytes, or longer values. Returns 0 if truncated.
+static size_t uleb_slow(const uint8_t *p, size_t size, uint64_t *val)
+{
+    uint64_t v = 0;
+    for(size_t i = 0; i < size && i < 10; ++i)
+    {
+        v |= (uint64_t)(p[i] & 0x7f) << (7 * i);
+        if(!(p[i] & 0x80))
+        {
+            *val = v;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+size_t func_starts_decode(const uint8_t *data, size_t size, vm_address_t base, vm_address_t *out)
+{
+    size_t off = 0,
+           count = 0;
+    vm_address_t addr = base;
+    while(off < size)
+    {
+        uint64_t delta;
+        size_t len = size - off >= 8 ? uleb_fast(&data[off], &delta) : 0;
+        if(len == 0)
+        {
+            len = uleb_slow(&data[off], size - off, &delta);
+            if(len == 0)
+            {
+                DEBUG("Function starts truncated at offset 0x%zx", off);
+                break;
+            }
+        }
+        if(delta == 0)
+        {
+            break;
+        }
+        off += len;
+        addr += delta;
+        out[count++] = addr;
+    }
+    return count;
+}
+
+/* ----- Building ----- */
+
+static bool builder_grow(void **ptr, size_t *cap, size_t need, size_t elem)
+{
+    if(need <= *cap)
+    {
+        return true;
+    }
+    size_t cap2 = *cap == 0 ? 0x100 : *cap;
+    while(cap2 < need)
+    {
+        cap2 *= 2;
+    }
+    void *p = realloc(*ptr, cap2 * elem);
+    if(p == NULL)
+    {
+        return false;
+    }
+    *ptr = p;
+    *cap = cap2;
+    return true;
+}
+
+// Function starts from an LC_FUNCTION_STARTS, data being where it's mapped
+static int builder_starts(builder_t *b, const struct linkedit_data_command *fs, vm_address_t data, vm_address_t addr)
+{
+    if(!builder_grow((void**)&b->starts, &b->cap, b->count + fs->datasize, sizeof(*b->starts)))
+    {
+        return -1;
+    }
+    if(b->file != NULL)
+    {
+        if(fs->dataoff > b->filesize || fs->datasize > b->filesize - fs->dataoff)
+        {
+            DEBUG("Function starts of image at " ADDR " exceed the file", addr);
+            return 0;
+        }
+        b->count += func_starts_decode(b->file + fs->dataoff, fs->datasize, addr, &b->starts[b->count]);
+        return 0;
+    }
+    if(data == 0)
+    {
+        DEBUG("Function starts of image at " ADDR " aren't mapped", addr);
+        return 0;
+    }
+    uint8_t *buf = malloc(fs->datasize);
+    if(buf == NULL)
+    {
+        return -1;
+    }
+    DEBUG("Reading function starts of image at " ADDR " from " ADDR, addr, data);
+    if(kernel_read(data, fs->datasize, buf) != fs->datasize)
+    {
+        DEBUG("Failed to read function starts at " ADDR, data);
+        free(buf);
+        return 0;
+    }
+    b->count += func_starts_decode(buf, fs->datasize, addr, &b->starts[b->count]);
+    free(buf);
+    return 0;
+}
+
+// Defined symbols that are in one of the executable ranges from first on
+static int builder_symbols(builder_t *b, const struct symtab_command *st, vm_address_t slide, size_t first)
+{
+    if(st->symoff > b->filesize || st->nsyms > (b->filesize - st->symoff) / sizeof(mach_nlist_t))
+    {
+        DEBUG("Symbol table at 0x%x exceeds the file", st->symoff);
+        return 0;
+    }
+    if(!builder_grow((void**)&b->syms, &b->capsyms, b->nsyms + st->nsyms, sizeof(*b->syms)))
+    {
+        return -1;
+    }
+    const mach_nlist_t *sym = (const mach_nlist_t*)(b->file + st->symoff);
+    for(size_t i = 0; i < st->nsyms; ++i)
+    {
+        if((sym[i].n_type & N_STAB) || (sym[i].n_type & N_TYPE) != N_SECT)
+        {
+            continue;
+        }
+        vm_address_t a = sym[i].n_value + slide;
+        for(size_t r = first; r < b->nranges; ++r)
+        {
+            if(a >= b->ranges[r].start && a < b->ranges[r].end)
+            {
+                b->syms[b->nsyms++] = a;
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+// Functions of one image whose header is at addr
+static int builder_image(builder_t *b, const mach_hdr_t *hdr, vm_address_t addr, vm_address_t slide)
+{
+    struct linkedit_data_command *fs = NULL;
+    struct symtab_command *st = NULL;
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == LC_FUNCTION_STARTS && ((struct linkedit_data_command*)cmd)->datasize > 0)
+        {
+            fs = (struct linkedit_data_command*)cmd;
+        }
+        else if(cmd->cmd == LC_SYMTAB)
+        {
+            st = (struct symtab_command*)cmd;
+        }
+    }
+    if(fs == NULL && b->file == NULL)
+    {
+        DEBUG("No function starts for image at " ADDR, addr);
+        return 0;
+    }
+    // A fileset's own segments span those of all entries, so in the kernel
+    // only images with function starts have their segments added. A file
+    // also has symbols and prologues to go by, so there it's only the
+    // fileset that is skipped.
+    // dataoff is a file offset, so also find where that's mapped.
+    size_t first = b->nranges;
+    vm_address_t data = 0;
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd != MACH_LC_SEGMENT)
+        {
+            continue;
+        }
+        mach_seg_t *seg = (mach_seg_t*)cmd;
+        if((seg->initprot & VM_PROT_EXECUTE) && seg->vmsize > 0 && hdr->filetype != MH_FILESET)
+        {
+            if(!builder_grow((void**)&b->ranges, &b->capranges, b->nranges + 1, sizeof(*b->ranges)))
+            {
+                return -1;
+            }
+            // Only scanned for prologues if all of it is in the file
+            const uint8_t *content = b->file != NULL && seg->filesize >= seg->vmsize && seg->fileoff <= b->filesize && seg->vmsize <= b->filesize - seg->fileoff ? b->file + seg->fileoff : NULL;
+            b->ranges[b->nranges++] = (range_t){ seg->vmaddr + slide, seg->vmaddr + slide + seg->vmsize, content };
+        }
+        if(fs != NULL && data == 0 && fs->dataoff >= seg->fileoff && fs->dataoff - seg->fileoff < seg->filesize && fs->datasize <= seg->filesize - (fs->dataoff - seg->fileoff))
+        {
+            data = seg->vmaddr + slide + (fs->dataoff - seg->fileoff);
+        }
+    }
+    if(fs != NULL && builder_starts(b, fs, data, addr) != 0)
+    {
+        return -1;
+    }
+    if(b->file != NULL && st != NULL && builder_symbols(b, st, slide, first) != 0)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static int addr_cmp(const void *a, const void *b)
+{
+    vm_address_t x = *(const vm_address_t*)a,
+                 y = *(const vm_address_t*)b;
+    return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static int range_cmp(const void *a, const void *b)
+{
+    return addr_cmp(&((const range_t*)a)->start, &((const range_t*)b)->start);
+}
+
+// Executable ranges of a file without a single entry in LC_FUNCTION_STARTS,
+// like the prelinked kexts of older kernelcaches, are scanned for prologues:
+// a PACIBSP, or a pre-indexed STP to sp that doesn't directly follow one.
+// Functions without a frame are missed and become part of the one before,
+// unless there's a symbol for them. Symbols are added after that.
+static int builder_prologues(builder_t *b)
+{
+    if(b->count > 0)
+    {
+        qsort(b->starts, b->count, sizeof(*b->starts), &addr_cmp);
+    }
+    size_t known = b->count;
+    for(size_t r = 0; r < b->nranges; ++r)
+    {
+        const range_t *range = &b->ranges[r];
+        if(range->data == NULL)
+        {
+            continue;
+        }
+        size_t lo = 0,
+               hi = known;
+        while(lo < hi)
+        {
+            size_t mid = lo + (hi - lo) / 2;
+            if(b->starts[mid] < range->start)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+        if(lo < known && b->starts[lo] < range->end)
+        {
+            continue;
+        }
+        size_t n = (range->end - range->start) / sizeof(uint32_t),
+               found = 0;
+        const uint32_t *insn = (const uint32_t*)range->data;
+        for(size_t i = 0; i < n; ++i)
+        {
+            if(insn[i] != INSN_PACIBSP && ((insn[i] & 0xffe003e0) != 0xa9a003e0 || (i > 0 && insn[i - 1] == INSN_PACIBSP)))
+            {
+                continue;
+            }
+            if(!builder_grow((void**)&b->starts, &b->cap, b->count + 1, sizeof(*b->starts)))
+            {
+                return -1;
+            }
+            b->starts[b->count++] = range->start + i * sizeof(uint32_t);
+            ++found;
+        }
+        DEBUG("Found %zu prologues in " ADDR "-" ADDR, found, range->start, range->end);
+    }
+    if(b->nsyms == 0)
+    {
+        return 0;
+    }
+    if(!builder_grow((void**)&b->starts, &b->cap, b->count + b->nsyms, sizeof(*b->starts)))
+    {
+        return -1;
+    }
+    memcpy(&b->starts[b->count], b->syms, b->nsyms * sizeof(*b->syms));
+    b->count += b->nsyms;
+    return 0;
+}
+
+// Sort, drop duplicates and work out where each function ends
+static func_table_t* builder_finish(builder_t *b)
+{
+    qsort(b->starts, b->count, sizeof(*b->starts), &addr_cmp);
+    qsort(b->ranges, b->nranges, sizeof(*b->ranges), &range_cmp);
+    size_t n = 0;
+    for(size_t i = 0; i < b->count; ++i)
+    {
+        if(n == 0 || b->starts[i] != b->starts[n - 1])
+        {
+            b->starts[n++] = b->starts[i];
+        }
+    }
+    func_table_t *ft = malloc(sizeof(*ft));
+    vm_address_t *ends = malloc((n + 1) * sizeof(*ends));
+    if(ft == NULL || ends == NULL)
+    {
+        free(ft);
+        free(ends);
+        return NULL;
+    }
+    // Both are sorted, so one pass over the ranges will do
+    size_t r = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        vm_address_t s = b->starts[i],
+                     e = i + 1 < n ? b->starts[i + 1] : 0;
+        while(r < b->nranges && b->ranges[r].end <= s)
+        {
+            ++r;
+        }
+        if(r < b->nranges && b->ranges[r].start <= s && (e == 0 || b->ranges[r].end < e))
+        {
+            e = b->ranges[r].end;
+        }
+        // The very last function, outside of any executable segment, has no known size
+        ends[i] = e != 0 ? e : s;
+    }
+    ft->count = n;
+    ft->starts = b->starts;
+    ft->ends = ends;
+    b->starts = NULL;
+    return ft;
+}
+
+/* ----- Cache ----- */
+
+static func_table_t* table_from_cache(const uint8_t uuid[16], vm_address_t kbase)
+{
+    size_t size;
+    char *data = cache_load(uuid, FUNC_CACHE_KIND, &size);
+    if(data == NULL)
+    {
+        return NULL;
+    }
+    func_table_t *ft = NULL;
+    func_cache_hdr_t *hdr = (func_cache_hdr_t*)data;
+    if(size < sizeof(*hdr) || hdr->magic != FUNC_CACHE_MAGIC || hdr->version != FUNC_CACHE_VERSION ||
+       hdr->count > (size - sizeof(*hdr)) / (2 * sizeof(uint64_t)) || size != sizeof(*hdr) + hdr->count * 2 * sizeof(uint64_t))
+    {
+        DEBUG("Ignoring invalid function cache");
+        goto out;
+    }
+    const uint64_t *ent = (const uint64_t*)(hdr + 1);
+    ft = malloc(sizeof(*ft));
+    if(ft == NULL)
+    {
+        goto out;
+    }
+    ft->starts = malloc((hdr->count + 1) * sizeof(*ft->starts));
+    ft->ends = malloc((hdr->count + 1) * sizeof(*ft->ends));
+    if(ft->starts == NULL || ft->ends == NULL)
+    {
+        func_table_free(ft);
+        ft = NULL;
+        goto out;
+    }
+    memcpy(ft->uuid, uuid, sizeof(ft->uuid));
+    ft->base = kbase;
+    ft->count = hdr->count;
+    for(size_t i = 0; i < ft->count; ++i)
+    {
+        ft->starts[i] = kbase + ent[2 * i];
+        ft->ends[i] = kbase + ent[2 * i + 1];
+    }
+
+    out:;
+    free(data);
+    return ft;
+}
+
+static void table_to_cache(const func_table_t *ft)
+{
+    size_t size = sizeof(func_cache_hdr_t) + ft->count * 2 * sizeof(uint64_t);
+    char *data = malloc(size);
+    if(data == NULL)
+    {
+        return;
+    }
+    func_cache_hdr_t *hdr = (func_cache_hdr_t*)data;
+    hdr->magic = FUNC_CACHE_MAGIC;
+    hdr->version = FUNC_CACHE_VERSION;
+    hdr->count = ft->count;
+    uint64_t *ent = (uint64_t*)(hdr + 1);
+    for(size_t i = 0; i < ft->count; ++i)
+    {
+        ent[2 * i] = ft->starts[i] - ft->base;
+        ent[2 * i + 1] = ft->ends[i] - ft->base;
+    }
+    cache_store(ft->uuid, FUNC_CACHE_KIND, data, size);
+    free(data);
+}
+
+/* ----- Table ----- */
+
+func_table_t* func_table(vm_address_t kbase)
+{
+    func_table_t *ft = NULL;
+    builder_t b;
+    memset(&b, 0, sizeof(b));
+
+    mach_hdr_t *hdr = kernel_header(kbase);
+    if(hdr == NULL)
+    {
+        return NULL;
+    }
+    uint8_t uuid[16];
+    bool have_uuid = macho_uuid(hdr, uuid);
+    if(have_uuid)
+    {
+        ft = table_from_cache(uuid, kbase);
+        if(ft != NULL)
+        {
+            goto out;
+        }
+    }
+
+    vm_address_t slide = macho_slide(hdr, kbase);
+    if(builder_image(&b, hdr, kbase, slide) != 0)
+    {
+        goto out;
+    }
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == LC_FILESET_ENTRY)
+        {
+            // Entries are slid along with the container
+            vm_address_t addr = ((struct fileset_entry_command*)cmd)->vmaddr + slide;
+            mach_hdr_t *ehdr = kernel_header(addr);
+            if(ehdr == NULL)
+            {
+                DEBUG("Failed to read fileset entry header at " ADDR, addr);
+                continue;
+            }
+            int r = builder_image(&b, ehdr, addr, slide);
+            free(ehdr);
+            if(r != 0)
+            {
+                goto out;
+            }
+        }
+    }
+    if(b.count == 0)
+    {
+        DEBUG("Kernel has no function starts");
+        goto out;
+    }
+
+    ft = builder_finish(&b);
+    if(ft == NULL)
+    {
+        goto out;
+    }
+    memcpy(ft->uuid, have_uuid ? uuid : (uint8_t[16]){ 0 }, sizeof(ft->uuid));
+    ft->base = kbase;
+    if(have_uuid)
+    {
+        table_to_cache(ft);
+    }
+
+    out:;
+    free(b.starts);
+    free(b.ranges);
+    free(hdr);
+    return ft;
+}
+
+func_table_t* func_table_file(const mach_hdr_t *hdr, size_t filesize)
+{
+    func_table_t *ft = NULL;
+    builder_t b;
+    memset(&b, 0, sizeof(b));
+    b.file = (const uint8_t*)hdr;
+    b.filesize = filesize;
+
+    // The header is where the segment mapping file offset 0 wants it
+    vm_address_t base = 0;
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == MACH_LC_SEGMENT && ((mach_seg_t*)cmd)->fileoff == 0 && ((mach_seg_t*)cmd)->filesize > 0)
+        {
+            base = ((mach_seg_t*)cmd)->vmaddr;
+            break;
+        }
+    }
+    if(base == 0)
+    {
+        DEBUG("No segment maps the header");
+        return NULL;
+    }
+    if(builder_image(&b, hdr, base, 0) != 0)
+    {
+        goto out;
+    }
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == LC_FILESET_ENTRY)
+        {
+            struct fileset_entry_command *entry = (struct fileset_entry_command*)cmd;
+            const mach_hdr_t *ehdr = (const mach_hdr_t*)(b.file + entry->fileoff);
+            if(entry->fileoff > filesize - sizeof(*ehdr) || ehdr->magic != MACH_HEADER_MAGIC || ehdr->sizeofcmds > filesize - entry->fileoff - sizeof(*ehdr))
+            {
+                DEBUG("Fileset entry at 0x%llx is not a Mach-O", (unsigned long long)entry->fileoff);
+                continue;
+            }
+            if(builder_image(&b, ehdr, entry->vmaddr, 0) != 0)
+            {
+                goto out;
+            }
+        }
+    }
+    if(builder_prologues(&b) != 0)
+    {
+        goto out;
+    }
+    if(b.count == 0)
+    {
+        DEBUG("File has no functions");
+        goto out;
+    }
+
+    ft = builder_finish(&b);
+    if(ft == NULL)
+    {
+        goto out;
+    }
+    if(!macho_uuid(hdr, ft->uuid))
+    {
+        memset(ft->uuid, 0, sizeof(ft->uuid));
+    }
+    ft->base = base;
+
+    out:;
+    free(b.starts);
+    free(b.syms);
+    free(b.ranges);
+    return ft;
+}
+
+void func_table_free(func_table_t *ft)
+{
+    if(ft != NULL)
+    {
+        free(ft->starts);
+        free(ft->ends);
+        free(ft);
+    }
+}
+
+ssize_t func_lookup(const func_table_t *ft, vm_address_t addr)
+{
+    if(ft->count == 0 || addr < ft->starts[0])
+    {
+        return -1;
+    }
+    // Halve the range without branching on the comparison
+    const vm_address_t *p = ft->starts;
+    size_t n = ft->count;
+    while(n > 1)
+    {
+        size_t half = n / 2;
+        p = p[half] <= addr ? p + half : p;
+        n -= half;
+    }
+    size_t i = p - ft->starts;
+    return addr < ft->ends[i] ? (ssize_t)i : -1;
+}
+
+vm_size_t func_size(const func_table_t *ft, size_t i)
+{
+    return ft->ends[i] - ft->starts[i];
+}
@@ -0,0 +1,77 @@
+/*
+ * func.h - Function table from LC_FUNCTION_STARTS.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef FUNC_H
+#define FUNC_H
+
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint8_t
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <sys/types.h>          // ssize_t
+
+#include "arch.h"               // mach_hdr_t
+
+/*
+ * LC_FUNCTION_STARTS is a stream of ULEB128 deltas, the first one relative
+ * to the image's __TEXT, ending with a zero. The kernel has one, and so has
+ * every entry of a fileset kernelcache; older kernelcaches only have the
+ * kernel's own, the prelinked kexts' are stripped.
+ *
+ * A function ends where the next one starts, or at the end of the
+ * executable segment it is in, whichever comes first.
+ */
+
+typedef struct
+{
+    uint8_t uuid[16];       // Kernel UUID
+    vm_address_t base;      // Kernel base the table is slid to
+    size_t count;
+    vm_address_t *starts;   // Sorted, no duplicates
+    vm_address_t *ends;     // ends[i] belongs to starts[i]
+} func_table_t;
+
+/*
+ * Decode a function starts stream of size bytes, adding base to the offsets.
+ * out must have room for size entries, which is the most there can be.
+ *
+ * Returns the number of function starts.
+ */
+size_t func_starts_decode(const uint8_t *data, size_t size, vm_address_t base, vm_address_t *out);
+
+/*
+ * Build the function table of the kernel at kbase, and its fileset entries
+ * if it has any. Like the kext index, it is cached on disk per kernel UUID.
+ *
+ * Returns NULL on failure.
+ */
+func_table_t* func_table(vm_address_t kbase);
+
+/*
+ * Build the function table of a decompressed kernelcache of filesize bytes
+ * mapped at hdr, at unslid addresses. Besides LC_FUNCTION_STARTS, this takes
+ * defined symbols, and scans executable segments that have neither for
+ * function prologues. It is not cached, since the file is right there.
+ *
+ * Returns NULL on failure.
+ */
+func_table_t* func_table_file(const mach_hdr_t *hdr, size_t filesize);
+
+void func_table_free(func_table_t *ft);
+
+/*
+ * Find the function containing addr, in O(log n).
+ *
+ * Returns its index, or -1 if addr is not inside any function.
+ */
+ssize_t func_lookup(const func_table_t *ft, vm_address_t addr);
+
+/*
+ * Size of function i.
+ */
+vm_size_t func_size(const func_table_t *ft, size_t i);
+
+#endif
@@ -0,0 +1,222 @@
+/*
+ * guard.c - Checking kernel accesses against the region map.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <pthread.h>            // pthread_rwlock_*
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint64_t
+#include <stdlib.h>             // calloc, free, getenv, realloc
+#include <string.h>             // strcmp
+
+#include <mach/kern_return.h>   // KERN_SUCCESS
+#include <mach/vm_prot.h>       // vm_prot_t, VM_PROT_*
+#include <mach/vm_region.h>     // vm_region_submap_info_data_64_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <sys/types.h>          // ssize_t
+
+#include "backend.h"            // kbackend_t
+#include "debug.h"              // DEBUG
+#include "kutil.h"              // kutil_backend, kutil_region, kutil_ctx_t
+#include "libkern.h"            // kernel_set_guard, GUARD_ENV
+#include "timer.h"              // timer_ns
+
+#include "guard.h"
+
+typedef struct
+{
+    vm_address_t start;
+    vm_address_t end;
+    vm_prot_t prot;
+} range_t;
+
+struct guard
+{
+    pthread_rwlock_t lock;
+    kbackend_t *be;         // What the map is of
+    uint64_t loaded_ns;     // 0 if never loaded
+    size_t count;
+    size_t cap;
+    range_t *ranges;        // Sorted by start, no overlaps
+};
+
+guard_t* guard_create(void)
+{
+    guard_t *g = calloc(1, sizeof(*g));
+    if(g == NULL)
+    {
+        return NULL;
+    }
+    if(pthread_rwlock_init(&g->lock, NULL) != 0)
+    {
+        free(g);
+        return NULL;
+    }
+    return g;
+}
+
+void guard_destroy(guard_t *g)
+{
+    if(g == NULL)
+    {
+        return;
+    }
+    pthread_rwlock_destroy(&g->lock);
+    free(g->ranges);
+    free(g);
+}
+
+// Must hold g->lock for writing
+static bool add(guard_t *g, vm_address_t start, vm_address_t end, vm_prot_t prot)
+{
+    if(g->count > 0)
+    {
+        range_t *last = &g->ranges[g->count - 1];
+        if(last->end == start && last->prot == prot)
+        {
+            last->end = end;
+            return true;
+        }
+    }
+    if(g->count == g->cap)
+    {
+        size_t cap = g->cap == 0 ? 0x100 : g->cap * 2;
+        range_t *ranges = realloc(g->ranges, cap * sizeof(*ranges));
+        if(ranges == NULL)
+        {
+            return false;
+        }
+        g->ranges = ranges;
+        g->cap = cap;
+    }
+    g->ranges[g->count++] = (range_t){ .start = start, .end = end, .prot = prot };
+    return true;
+}
+
+// Walk [min, max) of the map at the given submap level, like kmap does
+static bool walk(guard_t *g, kutil_ctx_t *ctx, unsigned int level, vm_address_t min, vm_address_t max)
+{
+    vm_size_t size;
+    for(vm_address_t addr = min; addr < max; addr += size)
+    {
+        vm_region_submap_info_data_64_t info;
+        unsigned int depth = level;
+        size = 0;
+        if(kutil_region(ctx, &addr, &size, &depth, &info) != KERN_SUCCESS || addr >= max || size == 0)
+        {
+            break;
+        }
+        vm_address_t end = addr + size > addr && addr + size < max ? addr + size : max;
+        if(info.is_submap)
+        {
+            if(!walk(g, ctx, level + 1, addr, end))
+            {
+                return false;
+            }
+        }
+        else if(!add(g, addr, end, info.protection))
+        {
+            return false;
+        }
+        if(end == max)
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+// Must hold g->lock for writing
+static void load(guard_t *g, kutil_ctx_t *ctx)
+{
+    uint64_t start = timer_ns();
+    g->count = 0;
+    g->be = kutil_backend(ctx);
+    g->loaded_ns = start;
+    if(!walk(g, ctx, 0, 0, ~(vm_address_t)0))
+    {
+        // A partial map only rejects more than it should
+        DEBUG("Out of memory for the region map, guard has %zu ranges", g->count);
+    }
+    DEBUG("Loaded region map with %zu ranges in %llu us", g->count, (unsigned long long)((timer_ns() - start) / 1000));
+}
+
+// Must hold g->lock. Returns the last range starting at or below addr, or -1.
+static ssize_t range_floor(const guard_t *g, vm_address_t addr)
+{
+    size_t lo = 0,
+           hi = g->count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(g->ranges[mid].start <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return (ssize_t)lo - 1;
+}
+
+// Must hold g->lock
+static vm_size_t allowed(const guard_t *g, vm_address_t addr, vm_size_t size, vm_prot_t need)
+{
+    vm_size_t ok = 0;
+    for(ssize_t i = range_floor(g, addr); i >= 0 && (size_t)i < g->count && ok < size; ++i)
+    {
+        const range_t *r = &g->ranges[i];
+        if(r->start > addr + ok || r->end <= addr + ok || (r->prot & need) != need)
+        {
+            break;
+        }
+        vm_size_t n = r->end - (addr + ok);
+        ok += n < size - ok ? n : size - ok;
+    }
+    return ok;
+}
+
+vm_size_t guard_check(guard_t *g, kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size, bool write)
+{
+    vm_prot_t need = write ? VM_PROT_WRITE : VM_PROT_READ;
+    kbackend_t *be = kutil_backend(ctx);
+    pthread_rwlock_rdlock(&g->lock);
+    bool stale = g->loaded_ns == 0 || g->be != be;
+    vm_size_t ok = stale ? 0 : allowed(g, addr, size, need);
+    bool retry = ok < size && (stale || timer_ns() - g->loaded_ns >= GUARD_REFRESH_MS * 1000000ULL);
+    pthread_rwlock_unlock(&g->lock);
+    if(!retry)
+    {
+        return ok;
+    }
+
+    // Could be newly mapped; reload, unless someone else just did
+    pthread_rwlock_wrlock(&g->lock);
+    if(g->loaded_ns == 0 || g->be != be || timer_ns() - g->loaded_ns >= GUARD_REFRESH_MS * 1000000ULL)
+    {
+        load(g, ctx);
+    }
+    ok = allowed(g, addr, size, need);
+    pthread_rwlock_unlock(&g->lock);
+    return ok;
+}
+
+size_t guard_ranges(guard_t *g)
+{
+    pthread_rwlock_rdlock(&g->lock);
+    size_t count = g->count;
+    pthread_rwlock_unlock(&g->lock);
+    return count;
+}
+
+__attribute__((constructor)) static void guard_init(void)
+{
+    const char *env = getenv(GUARD_ENV);
+    if(env != NULL && env[0] != '\0' && strcmp(env, "0") != 0)
+    {
+        kernel_set_guard(true);
+    }
+}
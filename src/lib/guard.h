@@ -0,0 +1,45 @@
+/*
+ * guard.h - Checking kernel accesses against the region map.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef GUARD_H
+#define GUARD_H
+
+#include <stdbool.h>            // bool
+#include <stddef.h>             // size_t
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "kutil.h"              // kutil_ctx_t
+
+/*
+ * A guard keeps the kernel's region map the way kmap walks it, submaps
+ * resolved, as a sorted array of ranges with their current protection.
+ * Adjacent ranges with the same protection are merged. It is loaded on
+ * the first check and reloaded on a miss, but no more often than every
+ * GUARD_REFRESH_MS, so that a stream of junk addresses costs nothing but
+ * a binary search.
+ */
+#define GUARD_REFRESH_MS 1000
+
+typedef struct guard guard_t;
+
+guard_t* guard_create(void);
+
+void guard_destroy(guard_t *g);
+
+/*
+ * How many bytes from the start of the range are mapped readable (or, if
+ * write is true, writable), according to the region map of ctx's backend.
+ * Walks the map first if need be.
+ */
+vm_size_t guard_check(guard_t *g, kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size, bool write);
+
+/*
+ * Number of ranges in the map, 0 if it isn't loaded.
+ */
+size_t guard_ranges(guard_t *g);
+
+#endif
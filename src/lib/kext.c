@@ -0,0 +1,676 @@
+/*
+ * kext.c - Locate kexts in the running kernel.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+#include <stdio.h>              // fprintf, stderr
+#include <stdlib.h>             // free, malloc, realloc, qsort, strtoull
+#include <string.h>             // memcpy, memcmp, strcmp, strlen, strncpy
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // ADDR, MACH_LC_SEGMENT, VM_KERNEL_LINK_ADDRESS, mach_*
+#include "cache.h"              // cache_load, cache_store
+#include "debug.h"              // DEBUG
+#include "libkern.h"            // kernel_header, kernel_read
+#include "mach-o.h"             // CMD_ITERATE, LC_FILESET_ENTRY, macho_*
+#include "xml.h"                // xml_*
+
+#include "kext.h"
+
+#define KEXT_CACHE_KIND     "kext"
+#define KEXT_CACHE_MAGIC    0x4b455854 /* KEXT */
+#define KEXT_CACHE_VERSION  1
+
+#define PRELINK_INFO_SEG    "__PRELINK_INFO"
+#define PRELINK_INFO_SEC    "__info"
+
+/* Cache layout: header, entries, name pool. Addresses are relative to the kernel base. */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    uint64_t namesize;
+} kext_cache_hdr_t;
+
+typedef struct
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t name;
+    char segname[16];
+} kext_cache_entry_t;
+
+typedef struct
+{
+    size_t count;
+    size_t cap;
+    kext_entry_t *entries;  // While building, name holds an offset into names
+    size_t namesize;
+    size_t namecap;
+    char *names;
+    size_t lastname;
+} builder_t;
+
+static int builder_name(builder_t *b, const char *name, size_t len)
+{
+    if(b->namesize > 0 && strlen(&b->names[b->lastname]) == len && memcmp(&b->names[b->lastname], name, len) == 0)
+    {
+        return 0;
+    }
+    if(b->namesize + len + 1 > b->namecap)
+    {
+        size_t cap = b->namecap ? b->namecap * 2 : 0x4000;
+        while(cap < b->namesize + len + 1)
+        {
+            cap *= 2;
+        }
+        char *names = realloc(b->names, cap);
+        if(names == NULL)
+        {
+            return -1;
+        }
+        b->names = names;
+        b->namecap = cap;
+    }
+    memcpy(&b->names[b->namesize], name, len);
+    b->names[b->namesize + len] = '\0';
+    b->lastname = b->namesize;
+    b->namesize += len + 1;
+    return 0;
+}
+
+static int builder_add(builder_t *b, vm_address_t start, vm_address_t end, const char *segname)
+{
+    if(b->count >= b->cap)
+    {
+        size_t cap = b->cap ? b->cap * 2 : 0x100;
+        kext_entry_t *entries = realloc(b->entries, cap * sizeof(*entries));
+        if(entries == NULL)
+        {
+            return -1;
+        }
+        b->entries = entries;
+        b->cap = cap;
+    }
+    kext_entry_t *e = &b->entries[b->count++];
+    e->start = start;
+    e->end = end;
+    e->name = (const char*)(uintptr_t)b->lastname;
+    strncpy(e->segname, segname, sizeof(e->segname) - 1);
+    e->segname[sizeof(e->segname) - 1] = '\0';
+    return 0;
+}
+
+// Add all segments of the kext whose header lives at addr
+static int builder_add_kext(builder_t *b, vm_address_t addr, const char *name, size_t namelen)
+{
+    mach_hdr_t *hdr = kernel_header(addr);
+    if(hdr == NULL)
+    {
+        return -1;
+    }
+    int ret = builder_name(b, name, namelen);
+    vm_address_t slide = macho_slide(hdr, addr);
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(ret != 0)
+        {
+            break;
+        }
+        if(cmd->cmd == MACH_LC_SEGMENT)
+        {
+            mach_seg_t *seg = (mach_seg_t*)cmd;
+            // __LINKEDIT is shared between all kexts of a kernelcache
+            if(seg->vmsize == 0 || strncmp(seg->segname, "__LINKEDIT", sizeof(seg->segname)) == 0)
+            {
+                continue;
+            }
+            char segname[sizeof(seg->segname) + 1] = { 0 };
+            memcpy(segname, seg->segname, sizeof(seg->segname));
+            ret = builder_add(b, seg->vmaddr + slide, seg->vmaddr + slide + seg->vmsize, segname);
+        }
+    }
+    free(hdr);
+    return ret;
+}
+
+/* ----- __PRELINK_INFO ----- */
+
+#define PRELINK_INFO_DICT   "_PrelinkInfoDictionary"
+#define PRELINK_BUNDLE_ID   "CFBundleIdentifier"
+#define PRELINK_LOAD_ADDR   "_PrelinkExecutableLoadAddr"
+#define PRELINK_EXEC_SIZE   "_PrelinkExecutableSize"
+
+typedef enum
+{
+    KEY_NONE,
+    KEY_INFO,
+    KEY_NAME,
+    KEY_ADDR,
+    KEY_SIZE,
+} prelink_key_t;
+
+typedef struct
+{
+    const char *id;
+    size_t idlen;
+    const char *str;
+    size_t len;
+} plist_ref_t;
+
+typedef struct
+{
+    const char *name;
+    size_t namelen;
+    uint64_t addr;
+    uint64_t size;
+} prelink_kext_t;
+
+typedef int (*prelink_cb_t)(void *arg, const prelink_kext_t *kext);
+
+static bool text_is(const char *str, size_t len, const char *s)
+{
+    return strlen(s) == len && memcmp(str, s, len) == 0;
+}
+
+static uint64_t parse_integer(const char *str, size_t len)
+{
+    char buf[32];
+    if(len >= sizeof(buf))
+    {
+        return 0;
+    }
+    memcpy(buf, str, len);
+    buf[len] = '\0';
+    return strtoull(buf, NULL, 0);
+}
+
+/*
+ * Walk the prelink info plist token by token and invoke cb for every kext
+ * dictionary in _PrelinkInfoDictionary. The only state kept besides the
+ * current kext is a table of ID="..." values, because later entries
+ * may refer back to them with IDREF="...".
+ */
+static int prelink_parse(const char *buf, size_t len, prelink_cb_t cb, void *arg)
+{
+    xml_t x;
+    xml_tok_t tok;
+    int ret = 0;
+    unsigned int depth = 0,
+                 info_depth = 0;
+    prelink_key_t pending = KEY_NONE;
+    prelink_kext_t kext;
+    const char *text = NULL,
+               *id = NULL;
+    size_t textlen = 0,
+           idlen = 0,
+           nrefs = 0,
+           refcap = 0;
+    plist_ref_t *refs = NULL;
+
+    memset(&kext, 0, sizeof(kext));
+    xml_init(&x, buf, len);
+    while(ret == 0 && xml_next(&x, &tok) != XML_END)
+    {
+        const char *val = NULL;
+        size_t vallen = 0;
+        bool have_value = false;
+        switch(tok.type)
+        {
+            case XML_ERROR:
+                DEBUG("Malformed prelink info plist");
+                ret = -1;
+                break;
+            case XML_TEXT:
+                text = tok.str;
+                textlen = tok.len;
+                break;
+            case XML_OPEN:
+                if(xml_is(&tok, "dict") || xml_is(&tok, "array"))
+                {
+                    ++depth;
+                    if(info_depth == 0 && pending == KEY_INFO && xml_is(&tok, "array"))
+                    {
+                        info_depth = depth;
+                    }
+                    else if(info_depth != 0 && depth == info_depth + 1)
+                    {
+                        memset(&kext, 0, sizeof(kext));
+                    }
+                    pending = KEY_NONE;
+                }
+                text = NULL;
+                textlen = 0;
+                if(!xml_attr(&tok, "ID", &id, &idlen))
+                {
+                    id = NULL;
+                }
+                break;
+            case XML_CLOSE:
+                if(xml_is(&tok, "dict") || xml_is(&tok, "array"))
+                {
+                    if(info_depth != 0 && depth == info_depth + 1 && kext.name != NULL && kext.addr != 0)
+                    {
+                        ret = cb(arg, &kext);
+                    }
+                    else if(depth == info_depth)
+                    {
+                        info_depth = 0;
+                    }
+                    --depth;
+                    pending = KEY_NONE;
+                }
+                else if(xml_is(&tok, "key"))
+                {
+                    pending = KEY_NONE;
+                    if(depth == 1 && info_depth == 0 && text_is(text, textlen, PRELINK_INFO_DICT))
+                    {
+                        pending = KEY_INFO;
+                    }
+                    else if(info_depth != 0 && depth == info_depth + 1)
+                    {
+                        pending = text_is(text, textlen, PRELINK_BUNDLE_ID) ? KEY_NAME :
+                                  text_is(text, textlen, PRELINK_LOAD_ADDR) ? KEY_ADDR :
+                                  text_is(text, textlen, PRELINK_EXEC_SIZE) ? KEY_SIZE : KEY_NONE;
+                    }
+                }
+                else
+                {
+                    val = text != NULL ? text : "";
+                    vallen = textlen;
+                    have_value = true;
+                    if(id != NULL)
+                    {
+                        if(nrefs >= refcap)
+                        {
+                            refcap = refcap ? refcap * 2 : 0x400;
+                            plist_ref_t *r = realloc(refs, refcap * sizeof(*refs));
+                            if(r == NULL)
+                            {
+                                ret = -1;
+                                break;
+                            }
+                            refs = r;
+                        }
+                        refs[nrefs++] = (plist_ref_t){ .id = id, .idlen = idlen, .str = val, .len = vallen };
+                        id = NULL;
+                    }
+                }
+                break;
+            case XML_EMPTY:
+                {
+                    const char *ref;
+                    size_t reflen;
+                    have_value = true;
+                    val = "";
+                    if(xml_attr(&tok, "IDREF", &ref, &reflen))
+                    {
+                        for(size_t i = nrefs; i-- > 0; )
+                        {
+                            if(refs[i].idlen == reflen && memcmp(refs[i].id, ref, reflen) == 0)
+                            {
+                                val = refs[i].str;
+                                vallen = refs[i].len;
+                                break;
+                            }
+                        }
+                    }
+                }
+                break;
+            case XML_END:
+                break;
+        }
+        if(have_value)
+        {
+            if(info_depth != 0 && depth == info_depth + 1)
+            {
+                switch(pending)
+                {
+                    case KEY_NAME:
+                        kext.name = val;
+                        kext.namelen = vallen;
+                        break;
+                    case KEY_ADDR:
+                        kext.addr = parse_integer(val, vallen);
+                        break;
+                    case KEY_SIZE:
+                        kext.size = parse_integer(val, vallen);
+                        break;
+                    default:
+                        break;
+                }
+            }
+            pending = KEY_NONE;
+        }
+    }
+
+    free(refs);
+    return ret;
+}
+
+typedef struct
+{
+    builder_t *b;
+    mach_hdr_t *khdr;
+    vm_address_t slide;     // Of the segments in khdr
+    vm_address_t kslide;    // Of the kernel
+    vm_address_t add;       // What the plist addresses need
+    size_t raw;             // Kexts inside the kernel as they are
+    size_t slid;            // And with kslide added
+} prelink_arg_t;
+
+// Whether addr lies in the kernel as it is mapped now
+static bool kernel_contains(const mach_hdr_t *hdr, vm_address_t slide, vm_address_t addr)
+{
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == MACH_LC_SEGMENT)
+        {
+            mach_seg_t *seg = (mach_seg_t*)cmd;
+            vm_address_t start = seg->vmaddr + slide;
+            if(addr >= start && addr - start < seg->vmsize)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int prelink_count(void *arg, const prelink_kext_t *kext)
+{
+    prelink_arg_t *a = arg;
+    a->raw += kernel_contains(a->khdr, a->slide, kext->addr);
+    a->slid += kernel_contains(a->khdr, a->slide, kext->addr + a->kslide);
+    return 0;
+}
+
+static int prelink_kext(void *arg, const prelink_kext_t *kext)
+{
+    prelink_arg_t *a = arg;
+    vm_address_t addr = kext->addr + a->add;
+    // Never probe addresses outside the kernel image, that would panic
+    if(!kernel_contains(a->khdr, a->slide, addr))
+    {
+        DEBUG("Kext %.*s at " ADDR " is outside the kernel, skipping", (int)kext->namelen, kext->name, (vm_address_t)kext->addr);
+        return 0;
+    }
+    if(builder_add_kext(a->b, addr, kext->name, kext->namelen) == 0)
+    {
+        return 0;
+    }
+    // No readable header, fall back to the size recorded in the plist
+    DEBUG("No Mach-O header for kext %.*s at " ADDR, (int)kext->namelen, kext->name, addr);
+    if(builder_name(a->b, kext->name, kext->namelen) != 0)
+    {
+        return -1;
+    }
+    return builder_add(a->b, addr, addr + kext->size, "");
+}
+
+/* ----- Index ----- */
+
+static int entry_cmp(const void *a, const void *b)
+{
+    const kext_entry_t *x = a,
+                       *y = b;
+    return x->start < y->start ? -1 : x->start > y->start ? 1 : 0;
+}
+
+static kext_index_t* index_from_cache(const uint8_t uuid[16], vm_address_t kbase)
+{
+    size_t size;
+    char *data = cache_load(uuid, KEXT_CACHE_KIND, &size);
+    if(data == NULL)
+    {
+        return NULL;
+    }
+    kext_index_t *idx = NULL;
+    kext_cache_hdr_t *hdr = (kext_cache_hdr_t*)data;
+    if
+    (
+        size < sizeof(*hdr) || hdr->magic != KEXT_CACHE_MAGIC || hdr->version != KEXT_CACHE_VERSION ||
+        hdr->count > (size - sizeof(*hdr)) / sizeof(kext_cache_entry_t) ||
+        size != sizeof(*hdr) + hdr->count * sizeof(kext_cache_entry_t) + hdr->namesize
+    )
+    {
+        DEBUG("Ignoring invalid kext cache");
+        goto out;
+    }
+    kext_cache_entry_t *ent = (kext_cache_entry_t*)(hdr + 1);
+    const char *names = (const char*)&ent[hdr->count];
+    idx = malloc(sizeof(*idx));
+    if(idx == NULL)
+    {
+        goto out;
+    }
+    idx->entries = malloc(hdr->count * sizeof(*idx->entries));
+    idx->names = malloc(hdr->namesize + 1);
+    if(idx->entries == NULL || idx->names == NULL)
+    {
+        kext_index_free(idx);
+        idx = NULL;
+        goto out;
+    }
+    memcpy(idx->uuid, uuid, sizeof(idx->uuid));
+    memcpy(idx->names, names, hdr->namesize);
+    idx->names[hdr->namesize] = '\0';
+    idx->base = kbase;
+    idx->count = hdr->count;
+    for(size_t i = 0; i < idx->count; ++i)
+    {
+        idx->entries[i].start = kbase + ent[i].start;
+        idx->entries[i].end = kbase + ent[i].end;
+        idx->entries[i].name = &idx->names[ent[i].name < hdr->namesize ? ent[i].name : hdr->namesize];
+        memcpy(idx->entries[i].segname, ent[i].segname, sizeof(ent[i].segname));
+        idx->entries[i].segname[sizeof(ent[i].segname)] = '\0';
+    }
+
+    out:;
+    free(data);
+    return idx;
+}
+
+static void index_to_cache(const kext_index_t *idx, size_t namesize)
+{
+    size_t size = sizeof(kext_cache_hdr_t) + idx->count * sizeof(kext_cache_entry_t) + namesize;
+    char *data = malloc(size);
+    if(data == NULL)
+    {
+        return;
+    }
+    kext_cache_hdr_t *hdr = (kext_cache_hdr_t*)data;
+    hdr->magic = KEXT_CACHE_MAGIC;
+    hdr->version = KEXT_CACHE_VERSION;
+    hdr->count = idx->count;
+    hdr->namesize = namesize;
+    kext_cache_entry_t *ent = (kext_cache_entry_t*)(hdr + 1);
+    for(size_t i = 0; i < idx->count; ++i)
+    {
+        ent[i].start = idx->entries[i].start - idx->base;
+        ent[i].end = idx->entries[i].end - idx->base;
+        ent[i].name = idx->entries[i].name - idx->names;
+        memcpy(ent[i].segname, idx->entries[i].segname, sizeof(ent[i].segname));
+    }
+    memcpy(&ent[idx->count], idx->names, namesize);
+    cache_store(idx->uuid, KEXT_CACHE_KIND, data, size);
+    free(data);
+}
+
+kext_index_t* kext_index(vm_address_t kbase)
+{
+    kext_index_t *idx = NULL;
+    builder_t b;
+    memset(&b, 0, sizeof(b));
+
+    mach_hdr_t *hdr = kernel_header(kbase);
+    if(hdr == NULL)
+    {
+        return NULL;
+    }
+    uint8_t uuid[16];
+    bool have_uuid = macho_uuid(hdr, uuid);
+    if(have_uuid)
+    {
+        idx = index_from_cache(uuid, kbase);
+        if(idx != NULL)
+        {
+            goto out;
+        }
+    }
+
+    bool fileset = false;
+    vm_address_t slide = macho_slide(hdr, kbase);
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == LC_FILESET_ENTRY)
+        {
+            struct fileset_entry_command *ent = (struct fileset_entry_command*)cmd;
+            const char *name = (const char*)cmd + ent->entry_id.offset;
+            size_t maxlen = ent->entry_id.offset < cmd->cmdsize ? cmd->cmdsize - ent->entry_id.offset : 0;
+            fileset = true;
+            DEBUG("Found fileset entry %.*s at " ADDR, (int)maxlen, name, (vm_address_t)(ent->vmaddr + slide));
+            if(builder_add_kext(&b, ent->vmaddr + slide, name, strnlen(name, maxlen)) != 0)
+            {
+                DEBUG("Failed to add fileset entry %.*s", (int)maxlen, name);
+            }
+        }
+    }
+    if(!fileset)
+    {
+        mach_sec_t *sec = macho_section(hdr, PRELINK_INFO_SEG, PRELINK_INFO_SEC);
+        if(sec == NULL || sec->size == 0)
+        {
+            fprintf(stderr, "[!] Kernel has neither fileset entries nor " PRELINK_INFO_SEG "." PRELINK_INFO_SEC "\n");
+            goto out;
+        }
+        char *info = malloc(sec->size);
+        if(info == NULL)
+        {
+            goto out;
+        }
+        DEBUG("Parsing " PRELINK_INFO_SEG "." PRELINK_INFO_SEC " at " ADDR, (vm_address_t)(sec->addr + slide));
+        if(kernel_read(sec->addr + slide, sec->size, info) != sec->size)
+        {
+            fprintf(stderr, "[!] Kernel I/O error\n");
+            free(info);
+            goto out;
+        }
+        prelink_arg_t arg =
+        {
+            .b = &b,
+            .khdr = hdr,
+            .slide = slide,
+#ifdef VM_KERNEL_LINK_ADDRESS
+            .kslide = kbase > VM_KERNEL_LINK_ADDRESS ? kbase - VM_KERNEL_LINK_ADDRESS : 0,
+#else
+            .kslide = 0,
+#endif
+        };
+        // Depending on the version, load addresses may or may not have been
+        // slid, but all of them alike. Whichever way puts more kexts inside
+        // the kernel wins, and if that doesn't tell, they went the same way
+        // as the header.
+        int r = prelink_parse(info, sec->size, &prelink_count, &arg);
+        if(r == 0)
+        {
+            arg.add = arg.slid > arg.raw || (arg.slid == arg.raw && slide != 0) ? arg.kslide : 0;
+            DEBUG("%zu of the prelinked kexts are inside the kernel as they are, %zu slid, adding " ADDR, arg.raw, arg.slid, arg.add);
+            r = prelink_parse(info, sec->size, &prelink_kext, &arg);
+        }
+        free(info);
+        if(r != 0)
+        {
+            goto out;
+        }
+    }
+
+    idx = malloc(sizeof(*idx));
+    if(idx == NULL)
+    {
+        goto out;
+    }
+    for(size_t i = 0; i < b.count; ++i)
+    {
+        b.entries[i].name = b.names + (uintptr_t)b.entries[i].name;
+    }
+    qsort(b.entries, b.count, sizeof(*b.entries), &entry_cmp);
+    memcpy(idx->uuid, have_uuid ? uuid : (uint8_t[16]){ 0 }, sizeof(idx->uuid));
+    idx->base = kbase;
+    idx->count = b.count;
+    idx->entries = b.entries;
+    idx->names = b.names;
+    b.entries = NULL;
+    b.names = NULL;
+    if(have_uuid && idx->count > 0)
+    {
+        index_to_cache(idx, b.namesize);
+    }
+
+    out:;
+    free(b.entries);
+    free(b.names);
+    free(hdr);
+    return idx;
+}
+
+void kext_index_free(kext_index_t *idx)
+{
+    if(idx != NULL)
+    {
+        free(idx->entries);
+        free(idx->names);
+        free(idx);
+    }
+}
+
+const kext_entry_t* kext_lookup(const kext_index_t *idx, vm_address_t addr)
+{
+    size_t lo = 0,
+           hi = idx->count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(idx->entries[mid].start <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    // lo is now the first entry starting above addr
+    if(lo > 0 && addr < idx->entries[lo - 1].end)
+    {
+        return &idx->entries[lo - 1];
+    }
+    return NULL;
+}
+
+int kext_find(const kext_index_t *idx, const char *name, vm_address_t *start, vm_address_t *end)
+{
+    bool found = false;
+    for(size_t i = 0; i < idx->count; ++i)
+    {
+        const kext_entry_t *e = &idx->entries[i];
+        if(strcmp(e->name, name) == 0)
+        {
+            if(!found || e->start < *start)
+            {
+                *start = e->start;
+            }
+            if(!found || e->end > *end)
+            {
+                *end = e->end;
+            }
+            found = true;
+        }
+    }
+    return found ? 0 : -1;
+}
@@ -0,0 +1,60 @@
+/*
+ * kext.h - Locate kexts in the running kernel.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef KEXT_H
+#define KEXT_H
+
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint8_t
+
+#include <mach/vm_types.h>      // vm_address_t
+
+/*
+ * One mapped segment of a kext. A kext usually owns several of these,
+ * and in split/fileset kernelcaches they are not adjacent to each other.
+ */
+typedef struct
+{
+    vm_address_t start;
+    vm_address_t end;
+    const char *name;       // Bundle identifier
+    char segname[17];
+} kext_entry_t;
+
+typedef struct
+{
+    uint8_t uuid[16];       // Kernel UUID
+    vm_address_t base;      // Kernel base the entries are slid to
+    size_t count;
+    kext_entry_t *entries;  // Sorted by start address
+    char *names;
+} kext_index_t;
+
+/*
+ * Build the kext index of the kernel at kbase, from either LC_FILESET_ENTRY
+ * load commands or the __PRELINK_INFO plist. The result is cached on disk
+ * per kernel UUID (see cache.h), so only the first call for any given
+ * kernel actually has to parse anything.
+ *
+ * Returns NULL on failure.
+ */
+kext_index_t* kext_index(vm_address_t kbase);
+
+void kext_index_free(kext_index_t *idx);
+
+/*
+ * Find the kext segment containing addr, or NULL.
+ */
+const kext_entry_t* kext_lookup(const kext_index_t *idx, vm_address_t addr);
+
+/*
+ * Find the address range spanned by all segments of the given kext.
+ *
+ * Returns 0 on success, -1 if no such kext exists.
+ */
+int kext_find(const kext_index_t *idx, const char *name, vm_address_t *start, vm_address_t *end);
+
+#endif
@@ -0,0 +1,275 @@
+/*
+ * kio.c - Asynchronous kernel reads and writes.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <pthread.h>            // pthread_*
+#include <stdbool.h>            // bool, true, false
+#include <stdlib.h>             // calloc, free, malloc
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // ADDR
+#include "debug.h"              // DEBUG
+#include "kutil.h"              // kutil_*, kutil_ctx_t
+
+#include "kio.h"
+
+enum
+{
+    KIO_QUEUED,
+    KIO_BUSY,
+    KIO_DONE,               // On the completion queue
+    KIO_TAKEN,
+};
+
+struct kio
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    kutil_ctx_t *ctx;
+    bool stop;
+    unsigned int workers;
+    size_t pending;         // Submitted and not taken yet
+    // Waiting for a worker, linked through next only
+    kio_req_t *queue_head;
+    kio_req_t *queue_tail;
+    // Completion queue, oldest first
+    kio_req_t *done_head;
+    kio_req_t *done_tail;
+    pthread_t threads[KIO_MAX_DEPTH];
+};
+
+static void* worker(void *arg)
+{
+    kio_t *kio = arg;
+    pthread_mutex_lock(&kio->lock);
+    while(1)
+    {
+        kio_req_t *req = kio->queue_head;
+        if(req == NULL)
+        {
+            if(kio->stop)
+            {
+                break;
+            }
+            pthread_cond_wait(&kio->work, &kio->lock);
+            continue;
+        }
+        kio->queue_head = req->next;
+        if(kio->queue_head == NULL)
+        {
+            kio->queue_tail = NULL;
+        }
+        req->state = KIO_BUSY;
+        pthread_mutex_unlock(&kio->lock);
+
+        req->result = req->op == KIO_READ ? kutil_read(kio->ctx, req->addr, req->size, req->buf) : kutil_write(kio->ctx, req->addr, req->size, req->buf);
+
+        pthread_mutex_lock(&kio->lock);
+        req->state = KIO_DONE;
+        req->next = NULL;
+        req->prev = kio->done_tail;
+        if(kio->done_tail != NULL)
+        {
+            kio->done_tail->next = req;
+        }
+        else
+        {
+            kio->done_head = req;
+        }
+        kio->done_tail = req;
+        pthread_cond_broadcast(&kio->done);
+    }
+    pthread_mutex_unlock(&kio->lock);
+    return NULL;
+}
+
+// Must hold kio->lock
+static void take(kio_t *kio, kio_req_t *req)
+{
+    if(req->prev != NULL)
+    {
+        req->prev->next = req->next;
+    }
+    else
+    {
+        kio->done_head = req->next;
+    }
+    if(req->next != NULL)
+    {
+        req->next->prev = req->prev;
+    }
+    else
+    {
+        kio->done_tail = req->prev;
+    }
+    req->next = NULL;
+    req->prev = NULL;
+    req->state = KIO_TAKEN;
+    --kio->pending;
+}
+
+kio_t* kio_create(unsigned int depth)
+{
+    return kio_create_ctx(kutil_ctx_default(), depth);
+}
+
+kio_t* kio_create_ctx(kutil_ctx_t *ctx, unsigned int depth)
+{
+    if(depth == 0)
+    {
+        depth = KIO_DEFAULT_DEPTH;
+    }
+    if(depth > KIO_MAX_DEPTH)
+    {
+        depth = KIO_MAX_DEPTH;
+    }
+    if(!kutil_backend(ctx)->concurrent)
+    {
+        depth = 1;
+    }
+    kio_t *kio = calloc(1, sizeof(*kio));
+    if(kio == NULL)
+    {
+        return NULL;
+    }
+    if(pthread_mutex_init(&kio->lock, NULL) != 0)
+    {
+        free(kio);
+        return NULL;
+    }
+    pthread_cond_init(&kio->work, NULL);
+    pthread_cond_init(&kio->done, NULL);
+    kio->ctx = ctx;
+    for(; kio->workers < depth; ++kio->workers)
+    {
+        if(pthread_create(&kio->threads[kio->workers], NULL, &worker, kio) != 0)
+        {
+            break;
+        }
+    }
+    if(kio->workers == 0)
+    {
+        kio_destroy(kio);
+        return NULL;
+    }
+    DEBUG("Started %u kio workers", kio->workers);
+    return kio;
+}
+
+void kio_destroy(kio_t *kio)
+{
+    if(kio == NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&kio->lock);
+    kio->stop = true;
+    pthread_cond_broadcast(&kio->work);
+    pthread_mutex_unlock(&kio->lock);
+    // Workers only stop once the queue is empty
+    for(unsigned int i = 0; i < kio->workers; ++i)
+    {
+        pthread_join(kio->threads[i], NULL);
+    }
+    for(kio_req_t *req = kio->done_head, *next; req != NULL; req = next)
+    {
+        next = req->next;
+        free(req);
+    }
+    pthread_cond_destroy(&kio->work);
+    pthread_cond_destroy(&kio->done);
+    pthread_mutex_destroy(&kio->lock);
+    free(kio);
+}
+
+kio_req_t* kio_submit(kio_t *kio, kio_op_t op, vm_address_t addr, vm_size_t size, void *buf, void *user)
+{
+    kio_req_t *req = malloc(sizeof(*req));
+    if(req == NULL)
+    {
+        return NULL;
+    }
+    *req = (kio_req_t)
+    {
+        .op = op,
+        .addr = addr,
+        .size = size,
+        .buf = buf,
+        .user = user,
+        .result = 0,
+        .kio = kio,
+        .next = NULL,
+        .prev = NULL,
+        .state = KIO_QUEUED,
+    };
+    DEBUG("Queueing kernel %s " ADDR "-" ADDR, op == KIO_READ ? "read" : "write", addr, addr + size);
+    pthread_mutex_lock(&kio->lock);
+    if(kio->queue_tail != NULL)
+    {
+        kio->queue_tail->next = req;
+    }
+    else
+    {
+        kio->queue_head = req;
+    }
+    kio->queue_tail = req;
+    ++kio->pending;
+    pthread_cond_signal(&kio->work);
+    pthread_mutex_unlock(&kio->lock);
+    return req;
+}
+
+kio_req_t* kio_reap(kio_t *kio, bool wait)
+{
+    kio_req_t *req = NULL;
+    pthread_mutex_lock(&kio->lock);
+    while(1)
+    {
+        req = kio->done_head;
+        if(req != NULL)
+        {
+            take(kio, req);
+            break;
+        }
+        if(!wait || kio->pending == 0)
+        {
+            break;
+        }
+        pthread_cond_wait(&kio->done, &kio->lock);
+    }
+    pthread_mutex_unlock(&kio->lock);
+    return req;
+}
+
+vm_size_t kio_wait(kio_req_t *req)
+{
+    kio_t *kio = req->kio;
+    pthread_mutex_lock(&kio->lock);
+    while(req->state == KIO_QUEUED || req->state == KIO_BUSY)
+    {
+        pthread_cond_wait(&kio->done, &kio->lock);
+    }
+    if(req->state == KIO_DONE)
+    {
+        take(kio, req);
+    }
+    pthread_mutex_unlock(&kio->lock);
+    return req->result;
+}
+
+size_t kio_pending(kio_t *kio)
+{
+    pthread_mutex_lock(&kio->lock);
+    size_t pending = kio->pending;
+    pthread_mutex_unlock(&kio->lock);
+    return pending;
+}
+
+void kio_release(kio_req_t *req)
+{
+    free(req);
+}
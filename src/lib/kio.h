@@ -0,0 +1,110 @@
+/*
+ * kio.h - Asynchronous kernel reads and writes.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef KIO_H
+#define KIO_H
+
+#include <stdbool.h>            // bool
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "kutil.h"              // kutil_ctx_t
+
+/*
+ * Requests submitted to a kio_t are carried out by its worker threads with
+ * kernel_read/kernel_write (or their kutil.h counterparts), as many at a
+ * time as there are workers, so that independent round trips overlap while
+ * the submitting thread gets on with other things. Each finished request
+ * is put on the completion queue, from where it is taken either in
+ * completion order by kio_reap, or by waiting on that request in
+ * particular with kio_wait.
+ *
+ * Backends that can't take concurrent calls (see backend.h) get a single
+ * worker, which still takes the round trips off the submitting thread.
+ */
+
+#define KIO_DEFAULT_DEPTH   8
+#define KIO_MAX_DEPTH       64
+
+typedef enum
+{
+    KIO_READ,
+    KIO_WRITE,
+} kio_op_t;
+
+typedef struct kio kio_t;
+
+typedef struct kio_req kio_req_t;
+struct kio_req
+{
+    kio_op_t op;
+    vm_address_t addr;
+    vm_size_t size;
+    void *buf;
+    void *user;             // Whatever the submitter wants
+    vm_size_t result;       // Bytes transferred, once done
+
+    // Private to kio.c
+    kio_t *kio;
+    kio_req_t *next;
+    kio_req_t *prev;
+    int state;
+};
+
+/*
+ * Start depth worker threads (0 for KIO_DEFAULT_DEPTH, at most
+ * KIO_MAX_DEPTH), for the backend that is active at this point.
+ *
+ * Returns NULL on failure.
+ */
+kio_t* kio_create(unsigned int depth);
+
+/*
+ * The same, with workers that use kutil_read/kutil_write on ctx.
+ */
+kio_t* kio_create_ctx(kutil_ctx_t *ctx, unsigned int depth);
+
+/*
+ * Wait for all submitted requests to finish, then stop the workers and free
+ * everything, including requests that were never reaped.
+ */
+void kio_destroy(kio_t *kio);
+
+/*
+ * Queue a read into or a write from buf, which has to stay around until the
+ * request is done.
+ *
+ * Returns the request, or NULL if it couldn't be allocated.
+ */
+kio_req_t* kio_submit(kio_t *kio, kio_op_t op, vm_address_t addr, vm_size_t size, void *buf, void *user);
+
+/*
+ * Take the oldest finished request off the completion queue. If there is
+ * none and wait is true, wait for one, unless no request is outstanding.
+ *
+ * Returns the request, or NULL if there is none.
+ */
+kio_req_t* kio_reap(kio_t *kio, bool wait);
+
+/*
+ * Wait for the request to finish and take it off the completion queue, so
+ * that kio_reap won't return it.
+ *
+ * Returns its result.
+ */
+vm_size_t kio_wait(kio_req_t *req);
+
+/*
+ * Number of requests submitted but not yet taken by kio_reap or kio_wait.
+ */
+size_t kio_pending(kio_t *kio);
+
+/*
+ * Free a request that kio_reap or kio_wait returned.
+ */
+void kio_release(kio_req_t *req);
+
+#endif
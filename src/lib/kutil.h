@@ -0,0 +1,117 @@
+/*
+ * kutil.h - Contexts, for using libkutil from many threads at once.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef KUTIL_H
+#define KUTIL_H
+
+#include <stdbool.h>            // bool
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint8_t, uint64_t
+
+#include <mach/kern_return.h>   // kern_return_t
+#include <mach/mach_types.h>    // task_t
+#include <mach/vm_region.h>     // vm_region_submap_info_data_64_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // mach_hdr_t
+#include "backend.h"            // kbackend_t
+#include "libkern.h"            // kernel_iov_t
+#include "stats.h"              // stat_t, stat_op_t
+
+/*
+ * A context owns everything the functions in libkern.h otherwise keep per
+ * process: the backend, the kernel base once found, the pages known to be
+ * unreadable, the workers for kernel_read_list, the guard and its region
+ * map, statistics and whether to print debug output. Each function below
+ * does what its kernel_* namesake does, against the context's backend, and
+ * may be called from any number of threads on the same context. Contexts with different backends are
+ * completely independent of each other.
+ *
+ * The kernel_* functions are wrappers around the default context, which
+ * follows kernel_set_backend and so whatever KUTIL_SIM, KUTIL_SNAP etc.
+ * selected.
+ *
+ * What stays process-wide: read-ahead and large transfer tuning, both of
+ * which are kept per backend anyway, recording with KUTIL_RECORD, and the
+ * statistics printed at exit, which include every context's.
+ */
+
+typedef struct kutil_ctx kutil_ctx_t;
+
+#define KUTIL_CTX_VERBOSE   0x1     /* Debug output for this context, even without -v */
+#define KUTIL_CTX_GUARD     0x2     /* Start out with the guard on */
+
+/*
+ * Create a context for be, which has to outlive it. NULL means the native
+ * backend (tfp0, or Corellium).
+ *
+ * Returns NULL on failure.
+ */
+kutil_ctx_t* kutil_ctx_create(kbackend_t *be, unsigned int flags);
+
+/*
+ * Free a context. Nothing may be using it anymore. The default context is
+ * never freed.
+ */
+void kutil_ctx_destroy(kutil_ctx_t *ctx);
+
+/*
+ * The context the kernel_* functions use.
+ */
+kutil_ctx_t* kutil_ctx_default(void);
+
+kbackend_t* kutil_backend(kutil_ctx_t *ctx);
+
+void kutil_set_verbose(kutil_ctx_t *ctx, bool verbose);
+
+/*
+ * See kernel_set_guard. Each context has a guard and region map of its own.
+ */
+int kutil_set_guard(kutil_ctx_t *ctx, bool enable);
+
+kern_return_t kutil_task(kutil_ctx_t *ctx, task_t *task);
+
+/*
+ * Only asks the backend once, unless that fails.
+ */
+vm_address_t kutil_base(kutil_ctx_t *ctx);
+
+vm_size_t kutil_read(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size, void *buf);
+
+size_t kutil_read_list(kutil_ctx_t *ctx, kernel_iov_t *iov, size_t count);
+
+vm_size_t kutil_read_sparse(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size, void *buf, uint8_t *valid);
+
+vm_size_t kutil_page_size(kutil_ctx_t *ctx);
+
+size_t kutil_page_count(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size);
+
+void kutil_forget_bad_pages(kutil_ctx_t *ctx);
+
+vm_size_t kutil_write(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size, void *buf);
+
+bool kutil_has_phys(kutil_ctx_t *ctx);
+
+vm_size_t kutil_read_phys(kutil_ctx_t *ctx, uint64_t paddr, vm_size_t size, void *buf);
+
+vm_size_t kutil_write_phys(kutil_ctx_t *ctx, uint64_t paddr, vm_size_t size, void *buf);
+
+vm_size_t kutil_copy_phys(kutil_ctx_t *ctx, uint64_t dst, uint64_t src, vm_size_t size);
+
+vm_address_t kutil_find(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t len, void *buf, size_t size);
+
+kern_return_t kutil_region(kutil_ctx_t *ctx, vm_address_t *addr, vm_size_t *size, unsigned int *depth, vm_region_submap_info_data_64_t *info);
+
+mach_hdr_t* kutil_header(kutil_ctx_t *ctx, vm_address_t addr);
+
+/*
+ * Statistics of the calls made through this context only (see stats.h).
+ */
+void kutil_stats(kutil_ctx_t *ctx, stat_op_t op, stat_t *out);
+
+void kutil_stats_reset(kutil_ctx_t *ctx);
+
+#endif
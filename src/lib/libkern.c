@@ -5,13 +5,18 @@
  * Copyright (c) 2016-2017 Siguza
  */
 
-#define CORELLIUM 1
+// Host builds (e.g. benchmarks) define NATIVE_TFP0 to do without corellium.s
+#if defined(__arm64__) && !defined(NATIVE_TFP0)
+#   define CORELLIUM 1
+#endif
 
 #include <dlfcn.h>              // RTLD_*, dl*
 #include <limits.h>             // UINT_MAX
+#include <pthread.h>            // pthread_mutex_*, pthread_once
 #include <stdio.h>              // fprintf, snprintf
-#include <stdlib.h>             // free, malloc, random, srandom
-#include <string.h>             // memmem
+#include <stdbool.h>            // bool, true, false
+#include <stdlib.h>             // calloc, exit, free, getenv, malloc, random, srandom
+#include <string.h>             // memcpy, memmem, memset, strcmp
 #include <time.h>               // time
 
 #include <mach/mach.h>          // Everything mach
@@ -22,9 +27,19 @@
 #include <sys/syscall.h>        // syscall
 
 #include "arch.h"               // TARGET_MACOS, IMAGE_OFFSET, MACH_TYPE, MACH_HEADER_MAGIC, mach_hdr_t
-#include "debug.h"              // DEBUG
+#include "backend.h"            // kbackend_t
+#include "debug.h"              // DEBUG, DEBUG_IF, verbose
+#include "guard.h"              // guard_*
+#include "kio.h"                // kio_*, KIO_READ
 #include "mach-o.h"             // CMD_ITERATE
+#include "readahead.h"          // readahead_*, READAHEAD_SPAN
+#include "sim.h"                // sim_from_spec, SIM_ENV
+#include "snap.h"               // snap_backend, SNAP_ENV
+#include "stats.h"              // stats_record, stats_record_set, stat_t, STAT_*
+#include "timer.h"              // timer_ns
+#include "trace.h"              // trace_record, trace_recording, trace_replay, TRACE_*
 
+#include "kutil.h"
 #include "libkern.h"
 
 #ifdef CORELLIUM
@@ -34,10 +49,10 @@
 
 
 #define MAX_CHUNK_SIZE 0xFFF /* MIG limitation */
+#define MAX_LARGE_XFER 0x400000 /* upper bound for large transfer tuning */
+#define MAX_HEADER_CMDS_SIZE 0x100000 /* sanity limit for kernel_header */
 #define SYS_MAX                                 530
 #define ALIGNTO(addr,align) ((addr+align-1)&~(align-1))
-// https://opensource.apple.com/source/xnu/xnu-3789.51.2/osfmk/mach/vm_statistics.h.auto.html
-#define VM_KERNEL_LINK_ADDRESS (0xFFFFFFF007004000ULL)
 #define VM_KERN_MEMORY_CPU (9)
 #ifdef __arm64e__
 # define CPU_DATA_RTCLOCK_DATAP_OFF (0x190)
@@ -48,26 +63,29 @@
 kern_return_t mach_vm_region(vm_map_t map, mach_vm_address_t* address, mach_vm_size_t* size, vm_region_flavor_t flavor, vm_region_info_t info,
     mach_msg_type_number_t* count, mach_port_t* object_name);
 
+static pthread_once_t tfp0_once = PTHREAD_ONCE_INIT;
+static task_t tfp0 = MACH_PORT_NULL;
+
 // Only support for arm64 iOS11 and later
-kern_return_t get_kernel_task(task_t* ptask) 
-{
-    static bool init = false;
-    static task_t tfp0 = MACH_PORT_NULL;
-    if (!init) {
-        kern_return_t ret = task_for_pid(mach_task_self(), 0, &tfp0);
-        if(ret != KERN_SUCCESS) {
-            host_get_special_port(mach_host_self(), HOST_LOCAL_NODE, 4, &tfp0);
-        }
-        if(MACH_PORT_VALID(tfp0)) {
-            pid_t pid;
-            if(pid_for_task(tfp0, &pid) != KERN_SUCCESS || pid != 0) {
-                tfp0 = MACH_PORT_NULL;
-            }
-        } else {
+static void tfp0_init(void)
+{
+    kern_return_t ret = task_for_pid(mach_task_self(), 0, &tfp0);
+    if(ret != KERN_SUCCESS) {
+        host_get_special_port(mach_host_self(), HOST_LOCAL_NODE, 4, &tfp0);
+    }
+    if(MACH_PORT_VALID(tfp0)) {
+        pid_t pid;
+        if(pid_for_task(tfp0, &pid) != KERN_SUCCESS || pid != 0) {
             tfp0 = MACH_PORT_NULL;
         }
-        init = true;
+    } else {
+        tfp0 = MACH_PORT_NULL;
     }
+}
+
+static kern_return_t native_task(kbackend_t *be, task_t* ptask)
+{
+    pthread_once(&tfp0_once, &tfp0_init);
     *ptask = tfp0;
     if (tfp0 == MACH_PORT_NULL) {
         return KERN_FAILURE;
@@ -75,30 +93,71 @@ kern_return_t get_kernel_task(task_t* ptask)
     return KERN_SUCCESS;
 }
 
+static kern_return_t native_region(kbackend_t *be, vm_address_t *addr, vm_size_t *size, unsigned int *depth, vm_region_submap_info_data_64_t *info)
+{
+    task_t kernel_task;
+    kern_return_t ret = native_task(be, &kernel_task);
+    if(ret != KERN_SUCCESS)
+    {
+        return ret;
+    }
+    mach_msg_type_number_t info_count = VM_REGION_SUBMAP_INFO_COUNT_64;
+    return vm_region_recurse_64(kernel_task, addr, size, depth, (vm_region_info_t)info, &info_count);
+}
+
 typedef uint64_t kaddr_t;
 
 #ifdef CORELLIUM
-vm_size_t kernel_read(vm_address_t addr, vm_size_t size, void *buf)
+static vm_size_t native_read(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf)
 {
     return unicopy(UNICOPY_DST_USER|UNICOPY_SRC_KERN, (uintptr_t)buf, addr, size);
 }
 
-vm_size_t kernel_write(vm_address_t addr, vm_size_t size, void *buf)
+static vm_size_t native_write(kbackend_t *be, vm_address_t addr, vm_size_t size, const void *buf)
 {
     return unicopy(UNICOPY_DST_KERN|UNICOPY_SRC_USER, (uintptr_t)addr, (uintptr_t)buf, size);
 }
 
-vm_address_t get_kernel_base(void)
+static vm_size_t native_read_phys(kbackend_t *be, uint64_t paddr, vm_size_t size, void *buf)
+{
+    return unicopy(UNICOPY_DST_USER|UNICOPY_SRC_PHYS, (uintptr_t)buf, paddr, size);
+}
+
+static vm_size_t native_write_phys(kbackend_t *be, uint64_t paddr, vm_size_t size, const void *buf)
+{
+    return unicopy(UNICOPY_DST_PHYS|UNICOPY_SRC_USER, paddr, (uintptr_t)buf, size);
+}
+
+static vm_size_t native_copy_phys(kbackend_t *be, uint64_t dst, uint64_t src, vm_size_t size)
+{
+    return unicopy(UNICOPY_DST_PHYS|UNICOPY_SRC_PHYS, dst, src, size);
+}
+
+static vm_address_t native_base(kbackend_t *be)
 {
     return get_kernel_addr(0);
 }
 
+// unicopy loops over arbitrarily large ranges by itself,
+// and has no round trip worth batching
+#define NATIVE_MAX_XFER 0
+#define NATIVE_READ_LARGE NULL
+#define NATIVE_WRITE_LARGE NULL
+#define NATIVE_READ_LIST NULL
+#define NATIVE_MAX_LIST 0
+// and would panic on an unmapped address
+#define NATIVE_SPECULATIVE false
+// Physical memory is only a different unicopy mode away
+#define NATIVE_READ_PHYS &native_read_phys
+#define NATIVE_WRITE_PHYS &native_write_phys
+#define NATIVE_COPY_PHYS &native_copy_phys
+
 #else
 
-vm_address_t get_kernel_base(void)
+static vm_address_t native_base(kbackend_t *be)
 {
     task_t tfp0;
-    kern_return_t ret = get_kernel_task(&tfp0);
+    kern_return_t ret = native_task(be, &tfp0);
     if(ret != KERN_SUCCESS)
     {
         return 0;
@@ -118,7 +177,7 @@ vm_address_t get_kernel_base(void)
     for(addr = 0; mach_vm_region(tfp0, &addr, &sz, VM_REGION_EXTENDED_INFO, (vm_region_info_t)&extended_info, &cnt, &obj_nm) == KERN_SUCCESS; addr += sz) {
         mach_port_deallocate(mach_task_self(), obj_nm);
         if(extended_info.user_tag == VM_KERN_MEMORY_CPU && extended_info.protection == VM_PROT_DEFAULT) {
-            if(kernel_read(addr + CPU_DATA_RTCLOCK_DATAP_OFF, sizeof(rtclock_datap), &rtclock_datap) != KERN_SUCCESS) {
+            if(kernel_read(addr + CPU_DATA_RTCLOCK_DATAP_OFF, sizeof(rtclock_datap), &rtclock_datap) != sizeof(rtclock_datap)) {
                 break;
             }
             rtclock_datap = trunc_page_kernel(rtclock_datap);
@@ -127,7 +186,7 @@ vm_address_t get_kernel_base(void)
                     return 0;
                 }
                 rtclock_datap -= vm_kernel_page_size;
-                if(kernel_read(rtclock_datap, sizeof(mh64), &mh64) != KERN_SUCCESS) {
+                if(kernel_read(rtclock_datap, sizeof(mh64), &mh64) != sizeof(mh64)) {
                     return 0;
                 }
             } while(mh64.magic != MH_MAGIC_64 || mh64.cputype != CPU_TYPE_ARM64 || mh64.filetype != MH_EXECUTE);
@@ -137,81 +196,1126 @@ vm_address_t get_kernel_base(void)
     return 0;
 }
 
+static vm_size_t native_read(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf)
+{
+    task_t kernel_task;
+    if(native_task(be, &kernel_task) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    kern_return_t ret = vm_read_overwrite(kernel_task, addr, size, (vm_address_t)buf, &size);
+    if(ret != KERN_SUCCESS)
+    {
+        DEBUG("vm_read error: %s", mach_error_string(ret));
+        return 0;
+    }
+    return size;
+}
+
+static vm_size_t native_write(kbackend_t *be, vm_address_t addr, vm_size_t size, const void *buf)
+{
+    task_t kernel_task;
+    if(native_task(be, &kernel_task) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    kern_return_t ret = vm_write(kernel_task, addr, (vm_offset_t)buf, size);
+    if(ret != KERN_SUCCESS)
+    {
+        DEBUG("vm_write error: %s", mach_error_string(ret));
+        return 0;
+    }
+    return size;
+}
 
-vm_size_t kernel_read(vm_address_t addr, vm_size_t size, void *buf)
+// vm_read hands back an out-of-line copy, so it isn't subject to the MIG
+// limit below. Mapping it costs more than a small inline copy though,
+// so kernel_read only uses this for whole pages.
+static vm_size_t native_read_large(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf)
 {
-    DEBUG("Reading kernel bytes " ADDR "-" ADDR, addr, addr + size);
-    kern_return_t ret;
     task_t kernel_task;
-    vm_size_t remainder = size,
-              bytes_read = 0;
+    if(native_task(be, &kernel_task) != KERN_SUCCESS)
+    {
+        return 0;
+    }
+    vm_offset_t data;
+    mach_msg_type_number_t count;
+    kern_return_t ret = vm_read(kernel_task, addr, size, &data, &count);
+    if(ret != KERN_SUCCESS)
+    {
+        DEBUG("vm_read error: %s", mach_error_string(ret));
+        return 0;
+    }
+    if(count > size)
+    {
+        count = size;
+    }
+    memcpy(buf, (void*)data, count);
+    vm_deallocate(mach_task_self(), data, count);
+    return count;
+}
 
-    ret = get_kernel_task(&kernel_task);
+// vm_read_list maps every entry out-of-line on its own, but all of them in
+// a single round trip. Entries it couldn't read come back zeroed, but it
+// also returns the error of the last entry, and MIG doesn't copy the list
+// back on error. So the last entry is always one that is known to be good.
+static void native_read_list(kbackend_t *be, kernel_iov_t *iov, size_t count)
+{
+    // Shared by kio workers; they may all look it up, but agree on the result
+    static vm_address_t known_good = 0;
+    task_t kernel_task;
+    vm_read_entry_t list;
+    for(size_t i = 0; i < count; ++i)
+    {
+        iov[i].result = 0;
+    }
+    vm_address_t good = __atomic_load_n(&known_good, __ATOMIC_RELAXED);
+    if(good == 0)
+    {
+        good = native_base(be);
+        __atomic_store_n(&known_good, good, __ATOMIC_RELAXED);
+    }
+    if(good == 0 || count >= VM_MAP_ENTRY_MAX || native_task(be, &kernel_task) != KERN_SUCCESS)
+    {
+        return;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+        list[i].address = iov[i].addr;
+        list[i].size = iov[i].size;
+    }
+    list[count].address = good;
+    list[count].size = 1;
+    kern_return_t ret = vm_read_list(kernel_task, list, count + 1);
     if(ret != KERN_SUCCESS)
     {
-        return -1;
+        DEBUG("vm_read_list error: %s", mach_error_string(ret));
+        return;
+    }
+    for(size_t i = 0; i <= count; ++i)
+    {
+        if(list[i].address == 0)
+        {
+            continue;
+        }
+        if(i < count && list[i].size == iov[i].size)
+        {
+            memcpy(iov[i].buf, (void*)list[i].address, iov[i].size);
+            iov[i].result = iov[i].size;
+        }
+        vm_deallocate(mach_task_self(), list[i].address, list[i].size);
+    }
+}
+
+// The vm_* APIs are part of the mach_vm subsystem, which is a MIG thing
+// and therefore has a hard limit of 0x1000 bytes that it accepts. Due to
+// this, we have to do both reading and writing in chunks smaller than that.
+// The exception are out-of-line transfers: vm_read above, and vm_write,
+// whose data is always sent out-of-line anyway.
+#define NATIVE_MAX_XFER MAX_CHUNK_SIZE
+#define NATIVE_READ_LARGE &native_read_large
+#define NATIVE_WRITE_LARGE &native_write
+#define NATIVE_READ_LIST &native_read_list
+#define NATIVE_MAX_LIST (VM_MAP_ENTRY_MAX - 1)
+// vm_read just fails on unmapped memory
+#define NATIVE_SPECULATIVE true
+// The kernel task only has virtual addresses
+#define NATIVE_READ_PHYS NULL
+#define NATIVE_WRITE_PHYS NULL
+#define NATIVE_COPY_PHYS NULL
+
+#endif  /* CORELLIUM */
+
+static kbackend_t native_backend =
+{
+    .name = "native",
+    .task = &native_task,
+    .base = &native_base,
+    .read = &native_read,
+    .write = &native_write,
+    .region = &native_region,
+    .max_xfer = NATIVE_MAX_XFER,
+    .read_large = NATIVE_READ_LARGE,
+    .write_large = NATIVE_WRITE_LARGE,
+    .page_size = 0,
+    .large_xfer = 0,
+    .read_list = NATIVE_READ_LIST,
+    .max_list = NATIVE_MAX_LIST,
+    .speculative = NATIVE_SPECULATIVE,
+    .concurrent = true,
+    .read_phys = NATIVE_READ_PHYS,
+    .write_phys = NATIVE_WRITE_PHYS,
+    .copy_phys = NATIVE_COPY_PHYS,
+    .priv = NULL,
+};
+
+static kbackend_t *backend = &native_backend;
+
+// Pages kernel_read_sparse failed on, as a sparse bitmap: the set of page
+// numbers is split into blocks of BAD_BLOCK_PAGES, hashed by block number.
+#define BAD_BLOCK_PAGES 0x1000
+
+typedef struct
+{
+    uint64_t block;
+    uint8_t bits[BAD_BLOCK_PAGES / 8];
+} bad_block_t;
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    kbackend_t *be;         // What the pages are bad for
+    vm_size_t page_size;
+    size_t count;
+    size_t cap;             // Power of two
+    bad_block_t **blocks;
+} bad_t;
+
+struct kutil_ctx
+{
+    kbackend_t *be;         // NULL for the default context, which follows backend
+    bool verbose;
+    pthread_mutex_t lock;   // For base, list_kio and guard
+    kbackend_t *base_be;    // What base was found for
+    vm_address_t base;
+    kio_t *list_kio;        // Workers for kutil_read_list on backends without read_list
+    bool list_kio_failed;
+    guard_t *guard;         // Created the first time it is turned on
+    bool guard_on;
+    bad_t bad;
+    stat_t stats[STAT_MAX];
+};
+
+static kutil_ctx_t default_ctx =
+{
+    .be = NULL,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .bad = { .lock = PTHREAD_MUTEX_INITIALIZER },
+};
+
+#define CDEBUG(ctx, str, args...) DEBUG_IF(verbose || (ctx)->verbose, str, ##args)
+
+static kbackend_t* ctx_be(kutil_ctx_t *ctx)
+{
+    return ctx->be != NULL ? ctx->be : __atomic_load_n(&backend, __ATOMIC_ACQUIRE);
+}
+
+// Count towards the process-wide statistics, and the context's if there is one
+static void record(kutil_ctx_t *ctx, stat_op_t op, uint64_t start, uint64_t requested, uint64_t done, uint64_t chunks)
+{
+    stats_record(op, start, requested, done, chunks);
+    if(ctx != NULL)
+    {
+        stats_record_set(ctx->stats, op, start, requested, done, chunks);
+    }
+}
+
+kbackend_t* kernel_backend(void)
+{
+    return ctx_be(&default_ctx);
+}
+
+void kernel_set_backend(kbackend_t *be)
+{
+    __atomic_store_n(&backend, be != NULL ? be : &native_backend, __ATOMIC_RELEASE);
+}
+
+// The backends that can be picked through the environment. They are set up
+// from here rather than from constructors of their own: nothing else pulls
+// sim.o or snap.o out of libkutil.a, so those would be left out of the tools.
+static const struct
+{
+    const char *env;
+    kbackend_t* (*load)(const char *arg);
+} env_backends[] =
+{
+    { SIM_ENV,          &sim_from_spec },
+    { SNAP_ENV,         &snap_backend },
+    { TRACE_REPLAY_ENV, &trace_replay },
+};
+
+__attribute__((constructor)) static void backend_init(void)
+{
+    const char *env = NULL;
+    for(size_t i = 0; i < sizeof(env_backends) / sizeof(*env_backends); ++i)
+    {
+        const char *arg = getenv(env_backends[i].env);
+        // SIM_ENV=0 is documented as off
+        if(arg == NULL || arg[0] == '\0' || (env_backends[i].load == &sim_from_spec && strcmp(arg, "0") == 0))
+        {
+            continue;
+        }
+        if(env != NULL)
+        {
+            fprintf(stderr, "[!] %s and %s can't be used together\n", env, env_backends[i].env);
+            exit(-1);
+        }
+        env = env_backends[i].env;
+        kbackend_t *be = env_backends[i].load(arg);
+        // Carrying on against the real kernel would be a nasty surprise
+        if(be == NULL)
+        {
+            fprintf(stderr, "[!] Failed to set up backend from %s=%s\n", env, arg);
+            exit(-1);
+        }
+        kernel_set_backend(be);
+    }
+    if(env != NULL && kernel_backend() == &native_backend)
+    {
+        fprintf(stderr, "[!] %s is set, but no backend was installed\n", env);
+        exit(-1);
+    }
+}
+
+kutil_ctx_t* kutil_ctx_create(kbackend_t *be, unsigned int flags)
+{
+    kutil_ctx_t *ctx = calloc(1, sizeof(*ctx));
+    if(ctx == NULL)
+    {
+        return NULL;
+    }
+    if(pthread_mutex_init(&ctx->lock, NULL) != 0)
+    {
+        free(ctx);
+        return NULL;
+    }
+    if(pthread_mutex_init(&ctx->bad.lock, NULL) != 0)
+    {
+        pthread_mutex_destroy(&ctx->lock);
+        free(ctx);
+        return NULL;
+    }
+    ctx->be = be != NULL ? be : &native_backend;
+    ctx->verbose = (flags & KUTIL_CTX_VERBOSE) != 0;
+    if((flags & KUTIL_CTX_GUARD) != 0 && kutil_set_guard(ctx, true) != 0)
+    {
+        kutil_ctx_destroy(ctx);
+        return NULL;
+    }
+    CDEBUG(ctx, "Created context for %s backend", ctx->be->name);
+    return ctx;
+}
+
+static void bad_reset(kutil_ctx_t *ctx);
+
+void kutil_ctx_destroy(kutil_ctx_t *ctx)
+{
+    if(ctx == NULL || ctx == &default_ctx)
+    {
+        return;
+    }
+    if(ctx->list_kio != NULL)
+    {
+        kio_destroy(ctx->list_kio);
+    }
+    guard_destroy(ctx->guard);
+    bad_reset(ctx);
+    pthread_mutex_destroy(&ctx->bad.lock);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+}
+
+kutil_ctx_t* kutil_ctx_default(void)
+{
+    return &default_ctx;
+}
+
+kbackend_t* kutil_backend(kutil_ctx_t *ctx)
+{
+    return ctx_be(ctx);
+}
+
+void kutil_set_verbose(kutil_ctx_t *ctx, bool verbose)
+{
+    __atomic_store_n(&ctx->verbose, verbose, __ATOMIC_RELAXED);
+}
+
+int kutil_set_guard(kutil_ctx_t *ctx, bool enable)
+{
+    pthread_mutex_lock(&ctx->lock);
+    if(enable && ctx->guard == NULL)
+    {
+        ctx->guard = guard_create();
+    }
+    bool ok = !enable || ctx->guard != NULL;
+    if(ok)
+    {
+        __atomic_store_n(&ctx->guard_on, enable, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    return ok ? 0 : -1;
+}
+
+int kernel_set_guard(bool enable)
+{
+    return kutil_set_guard(&default_ctx, enable);
+}
+
+// How much of the range the guard lets through, all of it if it's off
+static vm_size_t guarded(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size, bool write)
+{
+    if(size == 0 || !__atomic_load_n(&ctx->guard_on, __ATOMIC_ACQUIRE))
+    {
+        return size;
+    }
+    vm_size_t ok = guard_check(ctx->guard, ctx, addr, size, write);
+    if(ok < size)
+    {
+        CDEBUG(ctx, "Guard stopped %s at " ADDR, write ? "write" : "read", addr + ok);
+    }
+    return ok;
+}
+
+void kutil_stats(kutil_ctx_t *ctx, stat_op_t op, stat_t *out)
+{
+    stats_get_set(ctx->stats, op, out);
+}
+
+void kutil_stats_reset(kutil_ctx_t *ctx)
+{
+    stats_reset_set(ctx->stats);
+}
+
+kern_return_t kutil_task(kutil_ctx_t *ctx, task_t *task)
+{
+    kbackend_t *be = ctx_be(ctx);
+    return be->task(be, task);
+}
+
+kern_return_t get_kernel_task(task_t *task)
+{
+    return kutil_task(&default_ctx, task);
+}
+
+vm_address_t kutil_base(kutil_ctx_t *ctx)
+{
+    kbackend_t *be = ctx_be(ctx);
+    uint64_t start = timer_ns();
+    pthread_mutex_lock(&ctx->lock);
+    vm_address_t base = ctx->base_be == be ? ctx->base : 0;
+    if(base == 0)
+    {
+        base = be->base(be);
+        if(base != 0)
+        {
+            ctx->base_be = be;
+            ctx->base = base;
+        }
+    }
+    pthread_mutex_unlock(&ctx->lock);
+    record(ctx, STAT_BASE, start, 1, base != 0, 0);
+    if(trace_recording())
+    {
+        trace_record(TRACE_BASE, start, 0, 0, base, NULL);
+    }
+    return base;
+}
+
+vm_address_t get_kernel_base(void)
+{
+    return kutil_base(&default_ctx);
+}
+
+static vm_size_t xfer_page_size(kbackend_t *be)
+{
+    return be->page_size != 0 ? be->page_size : vm_kernel_page_size;
+}
+
+// Large transfer sizes are tuned on the first big transfer, by doubling the
+// chunk size from one page until throughput stops improving. Only one
+// backend is tuned at a time, which is all the tools ever use.
+static struct
+{
+    pthread_mutex_t lock;   // Read-ahead transfers run on their own thread
+    kbackend_t *be;
+    vm_size_t probe;
+    vm_size_t best;
+    double best_rate;
+} tune = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// large_xfer is set under tune.lock, but read without it
+static vm_size_t large_chunk(kbackend_t *be, vm_size_t ps)
+{
+    vm_size_t large = __atomic_load_n(&be->large_xfer, __ATOMIC_ACQUIRE);
+    if(large != 0)
+    {
+        return large;
+    }
+    pthread_mutex_lock(&tune.lock);
+    if(tune.be != be)
+    {
+        tune.be = be;
+        tune.probe = tune.best = ps;
+        tune.best_rate = 0;
+    }
+    vm_size_t chunk = tune.probe;
+    pthread_mutex_unlock(&tune.lock);
+    return chunk;
+}
+
+static void large_tune(kbackend_t *be, vm_size_t chunk, vm_size_t done, uint64_t start)
+{
+    // Only full-sized, successful probes say anything useful
+    if(__atomic_load_n(&be->large_xfer, __ATOMIC_ACQUIRE) != 0 || done != chunk)
+    {
+        return;
+    }
+    pthread_mutex_lock(&tune.lock);
+    if(__atomic_load_n(&be->large_xfer, __ATOMIC_ACQUIRE) != 0 || tune.be != be || chunk != tune.probe)
+    {
+        pthread_mutex_unlock(&tune.lock);
+        return;
+    }
+    uint64_t ns = timer_ns() - start;
+    double rate = (double)done / (ns != 0 ? ns : 1);
+    if(rate > tune.best_rate)
+    {
+        tune.best_rate = rate;
+        tune.best = chunk;
+    }
+    if(rate < tune.best_rate * 0.9 || tune.probe >= MAX_LARGE_XFER)
+    {
+        __atomic_store_n(&be->large_xfer, tune.best, __ATOMIC_RELEASE);
+        DEBUG("Large transfer size for %s backend: 0x%lx", be->name, (unsigned long)tune.best);
+    }
+    else
+    {
+        tune.probe *= 2;
+    }
+    pthread_mutex_unlock(&tune.lock);
+}
+
+// Size of the next transfer at addr with left bytes to go. Page-aligned runs
+// of whole pages go out-of-line if possible. Everything else is done inline,
+// and if there are whole pages to follow, without crossing a page boundary
+// so that they can start out aligned.
+static vm_size_t xfer_size(kbackend_t *be, bool large, vm_address_t addr, vm_size_t left, bool *ool)
+{
+    vm_size_t ps = xfer_page_size(be),
+              off = addr & (ps - 1);
+    *ool = false;
+    if(large && off == 0 && left >= ps)
+    {
+        vm_size_t chunk = large_chunk(be, ps),
+                  body = left & ~(ps - 1);
+        *ool = true;
+        return chunk < body ? chunk : body;
+    }
+    vm_size_t chunk = left;
+    if(large && off != 0 && chunk > ps - off)
+    {
+        chunk = ps - off;
+    }
+    if(be->max_xfer != 0 && chunk > be->max_xfer)
+    {
+        chunk = be->max_xfer;
     }
+    return chunk;
+}
 
-    // The vm_* APIs are part of the mach_vm subsystem, which is a MIG thing
-    // and therefore has a hard limit of 0x1000 bytes that it accepts. Due to
-    // this, we have to do both reading and writing in chunks smaller than that.
-    for(vm_address_t end = addr + size; addr < end; remainder -= size)
+// The transfers a read is split into; ctx may be NULL
+static vm_size_t xfer_read(kutil_ctx_t *ctx, kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf, uint64_t *chunks)
+{
+    vm_size_t bytes_read = 0;
+    bool large = be->read_large != NULL;
+    while(bytes_read < size)
     {
-        size = remainder > MAX_CHUNK_SIZE ? MAX_CHUNK_SIZE : remainder;
-        ret = vm_read_overwrite(kernel_task, addr, size, (vm_address_t)&((char*)buf)[bytes_read], &size);
-        if(ret != KERN_SUCCESS || size == 0)
+        bool ool;
+        vm_size_t chunk = xfer_size(be, large, addr + bytes_read, size - bytes_read, &ool);
+        uint64_t xfer_start = timer_ns();
+        vm_size_t ret = (ool ? be->read_large : be->read)(be, addr + bytes_read, chunk, &((char*)buf)[bytes_read]);
+        record(ctx, STAT_XFER, xfer_start, chunk, ret, 1);
+        ++*chunks;
+        if(ool)
+        {
+            large_tune(be, chunk, ret, xfer_start);
+            if(ret == 0)
+            {
+                // Let inline reads find out where exactly the trouble starts
+                large = false;
+                continue;
+            }
+        }
+        if(ret == 0)
         {
-            DEBUG("vm_read error: %s", mach_error_string(ret));
             break;
         }
-        bytes_read += size;
-        addr += size;
+        bytes_read += ret;
     }
+    return bytes_read;
+}
 
+// Read-ahead goes straight to the backend, so it mustn't go past what the
+// guard would let through
+static vm_address_t ahead_limit(kutil_ctx_t *ctx, vm_address_t end)
+{
+    if(!__atomic_load_n(&ctx->guard_on, __ATOMIC_ACQUIRE))
+    {
+        return ~(vm_address_t)0;
+    }
+    return end + guard_check(ctx->guard, ctx, end, READAHEAD_SPAN, false);
+}
+
+vm_size_t backend_read(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf, uint64_t *chunks)
+{
+    return xfer_read(NULL, be, addr, size, buf, chunks);
+}
+
+vm_size_t kutil_read(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size, void *buf)
+{
+    CDEBUG(ctx, "Reading kernel bytes " ADDR "-" ADDR, addr, addr + size);
+    kbackend_t *be = ctx_be(ctx);
+    uint64_t start = timer_ns(),
+             chunks = 0;
+    vm_size_t want = guarded(ctx, addr, size, false);
+    // Whatever read-ahead already has, and the rest the usual way
+    vm_size_t bytes_read = readahead_take(be, addr, want, buf);
+    if(bytes_read < want)
+    {
+        bytes_read += xfer_read(ctx, be, addr + bytes_read, want - bytes_read, &((char*)buf)[bytes_read], &chunks);
+    }
+    if(bytes_read == size)
+    {
+        readahead_note(be, addr, size, ahead_limit(ctx, addr + size));
+    }
+    record(ctx, STAT_READ, start, size, bytes_read, chunks);
+    if(trace_recording())
+    {
+        trace_record(TRACE_READ, start, addr, size, bytes_read, buf);
+    }
     return bytes_read;
 }
 
-vm_size_t kernel_write(vm_address_t addr, vm_size_t size, void *buf)
+vm_size_t kernel_read(vm_address_t addr, vm_size_t size, void *buf)
 {
-    DEBUG("Writing to kernel at " ADDR "-" ADDR, addr, addr + size);
-    kern_return_t ret;
-    task_t kernel_task;
-    vm_size_t remainder = size,
-              bytes_written = 0;
+    return kutil_read(&default_ctx, addr, size, buf);
+}
 
-    ret = get_kernel_task(&kernel_task);
-    if(ret != KERN_SUCCESS)
+static kio_t* get_list_kio(kutil_ctx_t *ctx)
+{
+    pthread_mutex_lock(&ctx->lock);
+    if(ctx->list_kio == NULL && !ctx->list_kio_failed)
+    {
+        ctx->list_kio = kio_create_ctx(ctx, 0);
+        ctx->list_kio_failed = ctx->list_kio == NULL;
+    }
+    kio_t *kio = ctx->list_kio;
+    pthread_mutex_unlock(&ctx->lock);
+    return kio;
+}
+
+static size_t read_list(kutil_ctx_t *ctx, kernel_iov_t *iov, size_t count)
+{
+    kbackend_t *be = ctx_be(ctx);
+    if(be->read_list == NULL || be->max_list == 0)
+    {
+        // Without a batch call, at least have the round trips overlap.
+        // The workers are shared, so wait on our own requests only.
+        kio_t *kio = count > 1 && be->concurrent ? get_list_kio(ctx) : NULL;
+        kio_req_t **reqs = kio != NULL ? malloc(count * sizeof(*reqs)) : NULL;
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(reqs == NULL || (reqs[i] = kio_submit(kio, KIO_READ, iov[i].addr, iov[i].size, iov[i].buf, NULL)) == NULL)
+            {
+                iov[i].result = kutil_read(ctx, iov[i].addr, iov[i].size, iov[i].buf);
+            }
+        }
+        size_t done = 0;
+        for(size_t i = 0; i < count; ++i)
+        {
+            if(reqs != NULL && reqs[i] != NULL)
+            {
+                iov[i].result = kio_wait(reqs[i]);
+                kio_release(reqs[i]);
+            }
+            if(iov[i].result != iov[i].size)
+            {
+                iov[i].result = 0;
+            }
+            done += iov[i].result != 0;
+        }
+        free(reqs);
+        return done;
+    }
+    uint64_t start = timer_ns(),
+             chunks = 0;
+    vm_size_t size = 0,
+              bytes_read = 0;
+    size_t done = 0;
+    for(size_t i = 0; i < count; i += be->max_list)
+    {
+        size_t n = count - i < be->max_list ? count - i : be->max_list;
+        vm_size_t xfer_size = 0,
+                  xfer_read = 0;
+        uint64_t xfer_start = timer_ns();
+        be->read_list(be, &iov[i], n);
+        for(size_t j = i; j < i + n; ++j)
+        {
+            xfer_size += iov[j].size;
+            xfer_read += iov[j].result;
+            done += iov[j].result != 0;
+        }
+        record(ctx, STAT_XFER, xfer_start, xfer_size, xfer_read, 1);
+        size += xfer_size;
+        bytes_read += xfer_read;
+        ++chunks;
+    }
+    record(ctx, STAT_READ, start, size, bytes_read, chunks);
+    if(trace_recording())
+    {
+        // Replay doesn't need to know these were batched
+        for(size_t i = 0; i < count; ++i)
+        {
+            trace_record(TRACE_READ, start, iov[i].addr, iov[i].size, iov[i].result, iov[i].buf);
+        }
+    }
+    return done;
+}
+
+size_t kutil_read_list(kutil_ctx_t *ctx, kernel_iov_t *iov, size_t count)
+{
+    CDEBUG(ctx, "Reading %zu kernel ranges", count);
+    if(!__atomic_load_n(&ctx->guard_on, __ATOMIC_ACQUIRE))
+    {
+        return read_list(ctx, iov, count);
+    }
+    // Entries are all or nothing, so any the guard cuts short are dropped
+    // and the rest is read as a batch of its own
+    kernel_iov_t *pass = malloc(count * sizeof(*pass));
+    size_t *from = malloc(count * sizeof(*from));
+    if(pass == NULL || from == NULL)
+    {
+        free(pass);
+        free(from);
+        return 0;
+    }
+    size_t n = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        iov[i].result = 0;
+        if(guarded(ctx, iov[i].addr, iov[i].size, false) == iov[i].size)
+        {
+            from[n] = i;
+            pass[n++] = iov[i];
+        }
+    }
+    size_t done = n > 0 ? read_list(ctx, pass, n) : 0;
+    for(size_t j = 0; j < n; ++j)
+    {
+        iov[from[j]].result = pass[j].result;
+    }
+    free(pass);
+    free(from);
+    return done;
+}
+
+size_t kernel_read_list(kernel_iov_t *iov, size_t count)
+{
+    return kutil_read_list(&default_ctx, iov, count);
+}
+
+static size_t bad_slot(bad_t *bad, uint64_t block)
+{
+    size_t i = (block * 0x9e3779b97f4a7c15ULL) & (bad->cap - 1);
+    while(bad->blocks[i] != NULL && bad->blocks[i]->block != block)
+    {
+        i = (i + 1) & (bad->cap - 1);
+    }
+    return i;
+}
+
+static void bad_reset(kutil_ctx_t *ctx)
+{
+    bad_t *bad = &ctx->bad;
+    for(size_t i = 0; i < bad->cap; ++i)
+    {
+        free(bad->blocks[i]);
+    }
+    free(bad->blocks);
+    bad->blocks = NULL;
+    bad->count = bad->cap = 0;
+    bad->be = ctx_be(ctx);
+    bad->page_size = xfer_page_size(bad->be);
+}
+
+// Must hold ctx->bad.lock
+static void bad_check_backend(kutil_ctx_t *ctx)
+{
+    kbackend_t *be = ctx_be(ctx);
+    if(ctx->bad.be != be || ctx->bad.page_size != xfer_page_size(be))
+    {
+        bad_reset(ctx);
+    }
+}
+
+static bool bad_test(kutil_ctx_t *ctx, vm_address_t addr)
+{
+    bad_t *bad = &ctx->bad;
+    pthread_mutex_lock(&bad->lock);
+    bad_check_backend(ctx);
+    bool ret = false;
+    if(bad->count > 0)
+    {
+        uint64_t page = addr / bad->page_size;
+        bad_block_t *b = bad->blocks[bad_slot(bad, page / BAD_BLOCK_PAGES)];
+        ret = b != NULL && (b->bits[(page % BAD_BLOCK_PAGES) / 8] & (1 << (page % 8)));
+    }
+    pthread_mutex_unlock(&bad->lock);
+    return ret;
+}
+
+static void bad_set(kutil_ctx_t *ctx, vm_address_t addr)
+{
+    bad_t *bad = &ctx->bad;
+    pthread_mutex_lock(&bad->lock);
+    bad_check_backend(ctx);
+    if(bad->count * 2 >= bad->cap)
+    {
+        size_t cap = bad->cap == 0 ? 0x40 : bad->cap * 2;
+        bad_block_t **blocks = calloc(cap, sizeof(*blocks)),
+                    **old = bad->blocks;
+        if(blocks == NULL)
+        {
+            // Not remembering is fine, it just costs a round trip next time
+            pthread_mutex_unlock(&bad->lock);
+            return;
+        }
+        size_t oldcap = bad->cap;
+        bad->blocks = blocks;
+        bad->cap = cap;
+        for(size_t i = 0; i < oldcap; ++i)
+        {
+            if(old[i] != NULL)
+            {
+                bad->blocks[bad_slot(bad, old[i]->block)] = old[i];
+            }
+        }
+        free(old);
+    }
+    uint64_t page = addr / bad->page_size;
+    size_t i = bad_slot(bad, page / BAD_BLOCK_PAGES);
+    if(bad->blocks[i] == NULL)
+    {
+        bad->blocks[i] = calloc(1, sizeof(bad_block_t));
+        if(bad->blocks[i] == NULL)
+        {
+            pthread_mutex_unlock(&bad->lock);
+            return;
+        }
+        bad->blocks[i]->block = page / BAD_BLOCK_PAGES;
+        ++bad->count;
+    }
+    bad->blocks[i]->bits[(page % BAD_BLOCK_PAGES) / 8] |= 1 << (page % 8);
+    pthread_mutex_unlock(&bad->lock);
+}
+
+void kutil_forget_bad_pages(kutil_ctx_t *ctx)
+{
+    pthread_mutex_lock(&ctx->bad.lock);
+    bad_reset(ctx);
+    pthread_mutex_unlock(&ctx->bad.lock);
+}
+
+void kernel_forget_bad_pages(void)
+{
+    kutil_forget_bad_pages(&default_ctx);
+}
+
+vm_size_t kutil_page_size(kutil_ctx_t *ctx)
+{
+    return xfer_page_size(ctx_be(ctx));
+}
+
+vm_size_t kernel_page_size(void)
+{
+    return kutil_page_size(&default_ctx);
+}
+
+size_t kutil_page_count(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size)
+{
+    vm_size_t ps = kutil_page_size(ctx);
+    if(size == 0)
     {
-        return -1;
+        return 0;
     }
+    return ((addr + size - 1) / ps) - (addr / ps) + 1;
+}
+
+size_t kernel_page_count(vm_address_t addr, vm_size_t size)
+{
+    return kutil_page_count(&default_ctx, addr, size);
+}
 
-    for(vm_address_t end = addr + size; addr < end; remainder -= size)
+vm_size_t kutil_read_sparse(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size, void *buf, uint8_t *valid)
+{
+    vm_size_t ps = kutil_page_size(ctx),
+              first = addr / ps,
+              done = 0,
+              off = 0;
+    if(valid != NULL)
+    {
+        memset(valid, 0, (kutil_page_count(ctx, addr, size) + 7) / 8);
+    }
+    while(off < size)
     {
-        size = remainder > MAX_CHUNK_SIZE ? MAX_CHUNK_SIZE : remainder;
-        ret = vm_write(kernel_task, addr, (vm_offset_t)&((char*)buf)[bytes_written], size);
-        if(ret != KERN_SUCCESS)
+        // Gather a run of pages not known to be bad...
+        vm_address_t at = addr + off;
+        vm_size_t run = 0;
+        while(off + run < size && !bad_test(ctx, at + run))
+        {
+            vm_size_t piece = ps - ((at + run) & (ps - 1));
+            run += piece < size - off - run ? piece : size - off - run;
+        }
+
+        // ... and read it in one go. Everything before the page that failed is good.
+        vm_size_t good = 0;
+        if(run > 0)
+        {
+            vm_size_t got = kutil_read(ctx, at, run, &((char*)buf)[off]);
+            if(got == run)
+            {
+                good = run;
+            }
+            else if((at + got) / ps > at / ps)
+            {
+                good = (at + got) / ps * ps - at;
+            }
+        }
+        if(valid != NULL)
+        {
+            for(vm_size_t p = at / ps; good > 0 && p <= (at + good - 1) / ps; ++p)
+            {
+                valid[(p - first) / 8] |= 1 << ((p - first) % 8);
+            }
+        }
+        done += good;
+        off += good;
+        if(off >= size)
         {
-            DEBUG("vm_write error: %s", mach_error_string(ret));
             break;
         }
-        bytes_written += size;
-        addr += size;
+
+        // off is now at a bad page, or one that just turned out to be
+        vm_size_t piece = ps - ((addr + off) & (ps - 1));
+        if(piece > size - off)
+        {
+            piece = size - off;
+        }
+        if(good < run)
+        {
+            CDEBUG(ctx, "Unreadable kernel page at " ADDR, (addr + off) / ps * ps);
+            bad_set(ctx, addr + off);
+        }
+        memset(&((char*)buf)[off], 0, piece);
+        off += piece;
     }
+    return done;
+}
 
+vm_size_t kernel_read_sparse(vm_address_t addr, vm_size_t size, void *buf, uint8_t *valid)
+{
+    return kutil_read_sparse(&default_ctx, addr, size, buf, valid);
+}
+
+vm_size_t kutil_write(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t size, void *buf)
+{
+    CDEBUG(ctx, "Writing to kernel at " ADDR "-" ADDR, addr, addr + size);
+    kbackend_t *be = ctx_be(ctx);
+    readahead_invalidate(addr, size);
+    uint64_t start = timer_ns(),
+             chunks = 0;
+    vm_size_t want = guarded(ctx, addr, size, true),
+              bytes_written = 0;
+    bool large = be->write_large != NULL;
+    while(bytes_written < want)
+    {
+        bool ool;
+        vm_size_t chunk = xfer_size(be, large, addr + bytes_written, want - bytes_written, &ool);
+        uint64_t xfer_start = timer_ns();
+        vm_size_t ret = (ool ? be->write_large : be->write)(be, addr + bytes_written, chunk, &((char*)buf)[bytes_written]);
+        record(ctx, STAT_XFER, xfer_start, chunk, ret, 1);
+        ++chunks;
+        if(ool && ret == 0)
+        {
+            large = false;
+            continue;
+        }
+        if(ret == 0)
+        {
+            break;
+        }
+        bytes_written += ret;
+    }
+    record(ctx, STAT_WRITE, start, size, bytes_written, chunks);
+    if(trace_recording())
+    {
+        trace_record(TRACE_WRITE, start, addr, size, bytes_written, buf);
+    }
     return bytes_written;
 }
-#endif  /* CORELLIUM */
 
-vm_address_t kernel_find(vm_address_t addr, vm_size_t len, void *buf, size_t size)
+vm_size_t kernel_write(vm_address_t addr, vm_size_t size, void *buf)
+{
+    return kutil_write(&default_ctx, addr, size, buf);
+}
+
+bool kutil_has_phys(kutil_ctx_t *ctx)
+{
+    kbackend_t *be = ctx_be(ctx);
+    return be->read_phys != NULL && be->write_phys != NULL;
+}
+
+bool kernel_has_phys(void)
+{
+    return kutil_has_phys(&default_ctx);
+}
+
+// One backend call after another, until done or one comes up empty
+static vm_size_t phys_xfer(kutil_ctx_t *ctx, bool write, uint64_t paddr, vm_size_t size, void *buf)
 {
+    kbackend_t *be = ctx_be(ctx);
+    uint64_t start = timer_ns(),
+             chunks = 0;
+    vm_size_t done = 0;
+    while(done < size && be->read_phys != NULL && be->write_phys != NULL)
+    {
+        vm_size_t ret = write ? be->write_phys(be, paddr + done, size - done, &((char*)buf)[done])
+                              : be->read_phys(be, paddr + done, size - done, &((char*)buf)[done]);
+        ++chunks;
+        if(ret == 0)
+        {
+            break;
+        }
+        done += ret;
+    }
+    record(ctx, STAT_PHYS, start, size, done, chunks);
+    return done;
+}
+
+vm_size_t kutil_read_phys(kutil_ctx_t *ctx, uint64_t paddr, vm_size_t size, void *buf)
+{
+    CDEBUG(ctx, "Reading physical bytes 0x%llx-0x%llx", (unsigned long long)paddr, (unsigned long long)(paddr + size));
+    return phys_xfer(ctx, false, paddr, size, buf);
+}
+
+vm_size_t kernel_read_phys(uint64_t paddr, vm_size_t size, void *buf)
+{
+    return kutil_read_phys(&default_ctx, paddr, size, buf);
+}
+
+vm_size_t kutil_write_phys(kutil_ctx_t *ctx, uint64_t paddr, vm_size_t size, void *buf)
+{
+    CDEBUG(ctx, "Writing to physical memory at 0x%llx-0x%llx", (unsigned long long)paddr, (unsigned long long)(paddr + size));
+    return phys_xfer(ctx, true, paddr, size, buf);
+}
+
+vm_size_t kernel_write_phys(uint64_t paddr, vm_size_t size, void *buf)
+{
+    return kutil_write_phys(&default_ctx, paddr, size, buf);
+}
+
+#define PHYS_BOUNCE_SIZE 0x100000
+
+vm_size_t kutil_copy_phys(kutil_ctx_t *ctx, uint64_t dst, uint64_t src, vm_size_t size)
+{
+    CDEBUG(ctx, "Copying physical bytes 0x%llx-0x%llx to 0x%llx", (unsigned long long)src, (unsigned long long)(src + size), (unsigned long long)dst);
+    kbackend_t *be = ctx_be(ctx);
+    if(be->copy_phys != NULL)
+    {
+        uint64_t start = timer_ns(),
+                 chunks = 0;
+        vm_size_t done = 0;
+        while(done < size)
+        {
+            vm_size_t ret = be->copy_phys(be, dst + done, src + done, size - done);
+            ++chunks;
+            if(ret == 0)
+            {
+                break;
+            }
+            done += ret;
+        }
+        record(ctx, STAT_PHYS, start, size, done, chunks);
+        return done;
+    }
+    if(!kutil_has_phys(ctx))
+    {
+        return 0;
+    }
+
+    // Bounce through a buffer, back to front if that's what keeps an
+    // overlapping source intact
+    vm_size_t bounce = size < PHYS_BOUNCE_SIZE ? size : PHYS_BOUNCE_SIZE;
+    char *buf = malloc(bounce > 0 ? bounce : 1);
+    if(buf == NULL)
+    {
+        return 0;
+    }
+    bool backwards = dst > src && dst < src + size;
+    vm_size_t done = 0;
+    while(done < size)
+    {
+        vm_size_t len = size - done < bounce ? size - done : bounce,
+                  off = backwards ? size - done - len : done,
+                  got = kutil_read_phys(ctx, src + off, len, buf),
+                  put = got > 0 ? kutil_write_phys(ctx, dst + off, got, buf) : 0;
+        if(put != len)
+        {
+            // Only a prefix of the range counts as copied
+            done += backwards ? 0 : put;
+            break;
+        }
+        done += len;
+    }
+    free(buf);
+    return done;
+}
+
+vm_size_t kernel_copy_phys(uint64_t dst, uint64_t src, vm_size_t size)
+{
+    return kutil_copy_phys(&default_ctx, dst, src, size);
+}
+
+kern_return_t kutil_region(kutil_ctx_t *ctx, vm_address_t *addr, vm_size_t *size, unsigned int *depth, vm_region_submap_info_data_64_t *info)
+{
+    kbackend_t *be = ctx_be(ctx);
+    if(!trace_recording())
+    {
+        return be->region(be, addr, size, depth, info);
+    }
+    uint64_t start = timer_ns();
+    vm_address_t in_addr = *addr;
+    unsigned int in_depth = *depth;
+    kern_return_t ret = be->region(be, addr, size, depth, info);
+    trace_region_t reg =
+    {
+        .addr = *addr,
+        .size = *size,
+        .depth = *depth,
+        .info = *info,
+    };
+    trace_record(TRACE_REGION, start, in_addr, in_depth, ret, &reg);
+    return ret;
+}
+
+kern_return_t kernel_region(vm_address_t *addr, vm_size_t *size, unsigned int *depth, vm_region_submap_info_data_64_t *info)
+{
+    return kutil_region(&default_ctx, addr, size, depth, info);
+}
+
+vm_address_t kutil_find(kutil_ctx_t *ctx, vm_address_t addr, vm_size_t len, void *buf, size_t size)
+{
+    uint64_t start = timer_ns();
     vm_address_t ret = 0;
+    vm_size_t got = 0;
     unsigned char* b = malloc(len);
     if(b)
     {
         // TODO reading in chunks would probably be better
-        if(kernel_read(addr, len, b))
+        got = kutil_read(ctx, addr, len, b);
+        if(got)
         {
-            void *ptr = memmem(b, len, buf, size);
+            void *ptr = memmem(b, got, buf, size);
             if(ptr)
             {
                 ret = addr + ((char*)ptr - (char*)b);
@@ -219,5 +1323,44 @@ vm_address_t kernel_find(vm_address_t addr, vm_size_t len, void *buf, size_t siz
         }
         free(b);
     }
+    record(ctx, STAT_FIND, start, len, got, 0);
     return ret;
 }
+
+vm_address_t kernel_find(vm_address_t addr, vm_size_t len, void *buf, size_t size)
+{
+    return kutil_find(&default_ctx, addr, len, buf, size);
+}
+
+mach_hdr_t* kutil_header(kutil_ctx_t *ctx, vm_address_t addr)
+{
+    mach_hdr_t hdr_buf;
+    if(kutil_read(ctx, addr, sizeof(hdr_buf), &hdr_buf) != sizeof(hdr_buf))
+    {
+        CDEBUG(ctx, "Failed to read Mach-O header at " ADDR, addr);
+        return NULL;
+    }
+    if(hdr_buf.magic != MACH_HEADER_MAGIC || hdr_buf.sizeofcmds > MAX_HEADER_CMDS_SIZE)
+    {
+        CDEBUG(ctx, "No valid Mach-O header at " ADDR, addr);
+        return NULL;
+    }
+    size_t hdr_size = sizeof(hdr_buf) + hdr_buf.sizeofcmds;
+    mach_hdr_t *hdr = malloc(hdr_size);
+    if(hdr == NULL)
+    {
+        return NULL;
+    }
+    if(kutil_read(ctx, addr, hdr_size, hdr) != hdr_size)
+    {
+        CDEBUG(ctx, "Failed to read Mach-O load commands at " ADDR, addr);
+        free(hdr);
+        return NULL;
+    }
+    return hdr;
+}
+
+mach_hdr_t* kernel_header(vm_address_t addr)
+{
+    return kutil_header(&default_ctx, addr);
+}
@@ -8,6 +8,8 @@
 #ifndef LIBKERN_H
 #define LIBKERN_H
 
+#include <stdbool.h>            // bool
+#include <stdint.h>             // uint8_t
 #include <stdio.h>              // fprintf, stderr
 #include <unistd.h>             // geteuid
 
@@ -15,8 +17,11 @@
 #include <mach/mach_error.h>    // mach_error_string
 #include <mach/mach_types.h>    // task_t
 #include <mach/port.h>          // MACH_PORT_NULL, MACH_PORT_VALID
+#include <mach/vm_region.h>     // vm_region_submap_info_data_64_t
 #include <mach/vm_types.h>      // vm_address_t, vm_size_t
 
+#include "arch.h"               // mach_hdr_t
+
 /*
  * Functions and macros to interact with the kernel address space.
  *
@@ -48,6 +53,84 @@ vm_address_t get_kernel_base(void);
  */
 vm_size_t kernel_read(vm_address_t addr, vm_size_t size, void *buf);
 
+typedef struct
+{
+    vm_address_t addr;
+    vm_size_t size;
+    void *buf;
+    vm_size_t result;       // Bytes read
+} kernel_iov_t;
+
+/*
+ * Read many small ranges, in as few round trips as the backend allows
+ * (vm_read_list with tfp0), or else with the round trips overlapping on
+ * worker threads (see kio.h). Each entry is all or nothing.
+ *
+ * Returns the number of entries read, and sets the result of each.
+ */
+size_t kernel_read_list(kernel_iov_t *iov, size_t count);
+
+/*
+ * Read data from the kernel address space, carrying on past pages that
+ * can't be read. Those are zero-filled, and remembered so that later calls
+ * skip them without asking the kernel again.
+ *
+ * If valid is not NULL, it receives one bit per page the range touches
+ * (kernel_page_count), least significant bit first, set if the page was read.
+ *
+ * Returns the number of bytes actually read.
+ */
+vm_size_t kernel_read_sparse(vm_address_t addr, vm_size_t size, void *buf, uint8_t *valid);
+
+/*
+ * The page size kernel_read_sparse works with.
+ */
+vm_size_t kernel_page_size(void);
+
+/*
+ * Number of pages the range touches, i.e. bits in kernel_read_sparse's bitmap.
+ */
+size_t kernel_page_count(vm_address_t addr, vm_size_t size);
+
+/*
+ * Forget about pages kernel_read_sparse found to be unreadable.
+ */
+void kernel_forget_bad_pages(void);
+
+/*
+ * Turn read-ahead on or off. While on (off by default, unless KUTIL_READAHEAD=1
+ * is set), kernel_read notices runs of back-to-back sequential reads and
+ * reads the next window in the background, so that the following reads are
+ * served from memory. Data read ahead is dropped on overlapping kernel_write
+ * calls and once it is READAHEAD_MAX_AGE_MS old. It reads memory no tool
+ * asked for, though never past what the guard, if on, would let through.
+ *
+ * Only backends that can take speculative reads (see backend.h) do this,
+ * which rules out Corellium.
+ */
+#define READAHEAD_ENV           "KUTIL_READAHEAD"
+#define READAHEAD_MAX_AGE_MS    100
+
+void kernel_set_readahead(bool enable);
+
+/*
+ * Turn the guard on or off. While on (off by default, unless KUTIL_GUARD=1
+ * is set), every kernel_read and kernel_write is first checked against the
+ * kernel's region map (see guard.h), and only the part of the range that is
+ * mapped readable, or writable, is passed on to the kernel. Reads and
+ * writes of unmapped addresses then fail without a round trip, and without
+ * the risk of a panic.
+ *
+ * The map is reloaded when an access misses it, at most once a second, so
+ * a region that was just unmapped may still get through. Physical accesses
+ * are not checked.
+ *
+ * Returns 0 on success, -1 if the guard couldn't be set up.
+ */
+#define GUARD_ENV               "KUTIL_GUARD"
+
+int kernel_set_guard(bool enable);
+
 /*
  * Write data into the kernel address space.
  *
@@ -55,6 +138,38 @@ vm_size_t kernel_read(vm_address_t addr, vm_size_t size, void *buf);
  */
 vm_size_t kernel_write(vm_address_t addr, vm_size_t size, void *buf);
 
+/*
+ * Whether the active backend can access physical memory (Corellium can,
+ * tfp0 can't). The kernel_*_phys functions below fail if it can't.
+ *
+ * Physical accesses don't go through the kernel's page tables, so they work
+ * where there is no virtual mapping, but nothing stops them from touching
+ * something that isn't DRAM either, which may well panic.
+ */
+bool kernel_has_phys(void);
+
+/*
+ * Read data from physical memory.
+ *
+ * Returns the number of bytes read.
+ */
+vm_size_t kernel_read_phys(uint64_t paddr, vm_size_t size, void *buf);
+
+/*
+ * Write data into physical memory.
+ *
+ * Returns the number of bytes written.
+ */
+vm_size_t kernel_write_phys(uint64_t paddr, vm_size_t size, void *buf);
+
+/*
+ * Copy size bytes of physical memory from src to dst, without a round trip
+ * through user memory if the backend can help it.
+ *
+ * Returns the number of bytes copied.
+ */
+vm_size_t kernel_copy_phys(uint64_t dst, uint64_t src, vm_size_t size);
+
 /*
  * Find the given byte sequence in the kernel address space between start and end.
  *
@@ -62,6 +177,22 @@ vm_size_t kernel_write(vm_address_t addr, vm_size_t size, void *buf);
  */
 vm_address_t kernel_find(vm_address_t addr, vm_size_t len, void *buf, size_t size);
 
+/*
+ * Get the memory region at or after *addr.
+ *
+ * Same semantics as vm_region_recurse_64 on the kernel task.
+ *
+ * This function should be safe.
+ */
+kern_return_t kernel_region(vm_address_t *addr, vm_size_t *size, unsigned int *depth, vm_region_submap_info_data_64_t *info);
+
+/*
+ * Read the Mach-O header and all load commands located at addr.
+ *
+ * Returns a malloc'ed buffer that the caller has to free, or NULL on failure.
+ */
+mach_hdr_t* kernel_header(vm_address_t addr);
+
 /*
  * Test for kernel task access and return -1 on failure.
  *
@@ -0,0 +1,113 @@
+/*
+ * mach-o.c - Code that deals with the Mach-O file format
+ *
+ * Copyright (c) 2012 comex
+ * Copyright (c) 2016 Siguza
+ */
+
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t
+#include <string.h>             // memcpy, strncmp
+
+#include <mach/vm_types.h>      // vm_address_t
+#include <mach-o/loader.h>      // LC_UUID, struct uuid_command
+
+#include "arch.h"               // MACH_LC_SEGMENT, mach_*
+
+#include "mach-o.h"
+
+mach_seg_t* macho_segment(const mach_hdr_t *hdr, const char *segname)
+{
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == MACH_LC_SEGMENT)
+        {
+            mach_seg_t *seg = (mach_seg_t*)cmd;
+            if(strncmp(seg->segname, segname, sizeof(seg->segname)) == 0)
+            {
+                return seg;
+            }
+        }
+    }
+    return NULL;
+}
+
+mach_sec_t* macho_section(const mach_hdr_t *hdr, const char *segname, const char *sectname)
+{
+    mach_seg_t *seg = macho_segment(hdr, segname);
+    if(seg != NULL)
+    {
+        mach_sec_t *sec = (mach_sec_t*)(seg + 1);
+        for(size_t i = 0; i < seg->nsects; ++i)
+        {
+            if(strncmp(sec[i].sectname, sectname, sizeof(sec[i].sectname)) == 0)
+            {
+                return &sec[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+bool macho_uuid(const mach_hdr_t *hdr, uint8_t uuid[16])
+{
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == LC_UUID)
+        {
+            memcpy(uuid, ((struct uuid_command*)cmd)->uuid, 16);
+            return true;
+        }
+    }
+    return false;
+}
+
+vm_address_t macho_slide(const mach_hdr_t *hdr, vm_address_t addr)
+{
+    // The segment that maps the header is the one with file offset 0
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == MACH_LC_SEGMENT)
+        {
+            mach_seg_t *seg = (mach_seg_t*)cmd;
+            if(seg->fileoff == 0 && seg->filesize != 0)
+            {
+                return addr - seg->vmaddr;
+            }
+        }
+    }
+    return 0;
+}
+
+mach_sec_t* macho_section_at(const mach_hdr_t *hdr, vm_address_t addr, mach_seg_t **segp)
+{
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == MACH_LC_SEGMENT)
+        {
+            mach_seg_t *seg = (mach_seg_t*)cmd;
+            if(addr < seg->vmaddr || addr - seg->vmaddr >= seg->vmsize)
+            {
+                continue;
+            }
+            if(segp != NULL)
+            {
+                *segp = seg;
+            }
+            mach_sec_t *sec = (mach_sec_t*)(seg + 1);
+            for(size_t i = 0; i < seg->nsects; ++i)
+            {
+                if(addr >= sec[i].addr && addr - sec[i].addr < sec[i].size)
+                {
+                    return &sec[i];
+                }
+            }
+            return NULL;
+        }
+    }
+    if(segp != NULL)
+    {
+        *segp = NULL;
+    }
+    return NULL;
+}
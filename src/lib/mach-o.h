@@ -8,8 +8,14 @@
 #ifndef MACH_O_H
 #define MACH_O_H
 
+#include <stdbool.h>            // bool
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+
+#include <mach/vm_types.h>      // vm_address_t
 #include <mach-o/loader.h>      // load_command
 
+#include "arch.h"               // mach_hdr_t, mach_seg_t, mach_sec_t
+
 /*
  * Iterate over all load commands in a Mach-O header
  */
@@ -19,4 +25,51 @@ for(struct load_command *cmd = (struct load_command *) ((hdr) + 1), \
     cmd < end; \
     cmd = (struct load_command *) ((char *) cmd + cmd->cmdsize))
 
+/*
+ * Fileset kernelcaches (iOS 14+) aren't known to older SDKs
+ */
+#ifndef MH_FILESET
+#   define MH_FILESET 0xc
+#endif
+#ifndef LC_FILESET_ENTRY
+#   define LC_FILESET_ENTRY (0x35 | LC_REQ_DYLD)
+struct fileset_entry_command
+{
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint64_t vmaddr;
+    uint64_t fileoff;
+    union lc_str entry_id;
+    uint32_t reserved;
+};
+#endif
+
+/*
+ * Find a segment by name, returns NULL if not present.
+ */
+mach_seg_t* macho_segment(const mach_hdr_t *hdr, const char *segname);
+
+/*
+ * Find a section by segment and section name, returns NULL if not present.
+ */
+mach_sec_t* macho_section(const mach_hdr_t *hdr, const char *segname, const char *sectname);
+
+/*
+ * Copy the LC_UUID of the binary to uuid, returns false if there is none.
+ */
+bool macho_uuid(const mach_hdr_t *hdr, uint8_t uuid[16]);
+
+/*
+ * Given that hdr was found at address addr, return the slide that has to be
+ * added to the vmaddr of its segments. This is 0 for headers that have already
+ * been slid in memory (like the one of the running kernel).
+ */
+vm_address_t macho_slide(const mach_hdr_t *hdr, vm_address_t addr);
+
+/*
+ * Find the section containing addr, and the segment it's in if segp is given.
+ * Returns NULL if no section contains addr, *segp can still be set then.
+ */
+mach_sec_t* macho_section_at(const mach_hdr_t *hdr, vm_address_t addr, mach_seg_t **segp);
+
 #endif
@@ -0,0 +1,122 @@
+/*
+ * merkle.c - Hash tree over fixed-size leaves.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // bool
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint8_t
+#include <stdlib.h>             // calloc, free
+#include <string.h>             // memcmp, memcpy
+
+#include <CommonCrypto/CommonDigest.h> // CC_SHA256_*
+
+#include "merkle.h"
+
+// Leaves and inner nodes are hashed with different prefixes,
+// so that one can't be passed off as the other.
+#define PREFIX_LEAF 0x00
+#define PREFIX_NODE 0x01
+
+struct merkle
+{
+    size_t nleaves;
+    size_t cap;                 // Power of two, leaves are nodes[cap..cap+nleaves)
+    uint8_t (*nodes)[MERKLE_HASH_SIZE]; // nodes[1] is the root
+};
+
+merkle_t* merkle_create(size_t nleaves)
+{
+    merkle_t *tree = calloc(1, sizeof(*tree));
+    if(tree == NULL)
+    {
+        return NULL;
+    }
+    tree->nleaves = nleaves;
+    tree->cap = 1;
+    while(tree->cap < nleaves)
+    {
+        tree->cap *= 2;
+    }
+    tree->nodes = calloc(2 * tree->cap, sizeof(*tree->nodes));
+    if(tree->nodes == NULL)
+    {
+        free(tree);
+        return NULL;
+    }
+    return tree;
+}
+
+void merkle_destroy(merkle_t *tree)
+{
+    if(tree != NULL)
+    {
+        free(tree->nodes);
+        free(tree);
+    }
+}
+
+size_t merkle_leaves(const merkle_t *tree)
+{
+    return tree->nleaves;
+}
+
+void merkle_hash(const void *data, size_t size, uint8_t hash[MERKLE_HASH_SIZE])
+{
+    uint8_t prefix = PREFIX_LEAF;
+    CC_SHA256_CTX ctx;
+    CC_SHA256_Init(&ctx);
+    CC_SHA256_Update(&ctx, &prefix, 1);
+    CC_SHA256_Update(&ctx, data, size);
+    CC_SHA256_Final(hash, &ctx);
+}
+
+static void hash_node(merkle_t *tree, size_t i)
+{
+    uint8_t prefix = PREFIX_NODE;
+    CC_SHA256_CTX ctx;
+    CC_SHA256_Init(&ctx);
+    CC_SHA256_Update(&ctx, &prefix, 1);
+    CC_SHA256_Update(&ctx, tree->nodes[2 * i], 2 * MERKLE_HASH_SIZE);
+    CC_SHA256_Final(tree->nodes[i], &ctx);
+}
+
+void merkle_set(merkle_t *tree, size_t leaf, const uint8_t hash[MERKLE_HASH_SIZE])
+{
+    memcpy(tree->nodes[tree->cap + leaf], hash, MERKLE_HASH_SIZE);
+}
+
+void merkle_rebuild(merkle_t *tree)
+{
+    for(size_t i = tree->cap - 1; i > 0; --i)
+    {
+        hash_node(tree, i);
+    }
+}
+
+bool merkle_update(merkle_t *tree, size_t leaf, const uint8_t hash[MERKLE_HASH_SIZE])
+{
+    size_t i = tree->cap + leaf;
+    if(memcmp(tree->nodes[i], hash, MERKLE_HASH_SIZE) == 0)
+    {
+        return false;
+    }
+    memcpy(tree->nodes[i], hash, MERKLE_HASH_SIZE);
+    for(i /= 2; i > 0; i /= 2)
+    {
+        hash_node(tree, i);
+    }
+    return true;
+}
+
+const uint8_t* merkle_leaf(const merkle_t *tree, size_t leaf)
+{
+    return tree->nodes[tree->cap + leaf];
+}
+
+const uint8_t* merkle_root(const merkle_t *tree)
+{
+    // A single leaf is its own root
+    return tree->nodes[tree->cap > 1 ? 1 : tree->cap];
+}
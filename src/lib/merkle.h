@@ -0,0 +1,53 @@
+/*
+ * merkle.h - Hash tree over fixed-size leaves.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef MERKLE_H
+#define MERKLE_H
+
+#include <stdbool.h>            // bool
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint8_t
+
+#define MERKLE_HASH_SIZE 32     // SHA-256
+
+typedef struct merkle merkle_t;
+
+/*
+ * Create a tree with nleaves leaves, all hashes zeroed.
+ *
+ * Returns NULL on failure.
+ */
+merkle_t* merkle_create(size_t nleaves);
+
+void merkle_destroy(merkle_t *tree);
+
+size_t merkle_leaves(const merkle_t *tree);
+
+/*
+ * Hash data the way leaves are hashed.
+ */
+void merkle_hash(const void *data, size_t size, uint8_t hash[MERKLE_HASH_SIZE]);
+
+/*
+ * Set a leaf without updating its ancestors, for filling a new tree.
+ * merkle_rebuild has to be called before the root is valid.
+ */
+void merkle_set(merkle_t *tree, size_t leaf, const uint8_t hash[MERKLE_HASH_SIZE]);
+
+void merkle_rebuild(merkle_t *tree);
+
+/*
+ * Set a leaf and rehash the path up to the root.
+ *
+ * Returns true if the leaf changed.
+ */
+bool merkle_update(merkle_t *tree, size_t leaf, const uint8_t hash[MERKLE_HASH_SIZE]);
+
+const uint8_t* merkle_leaf(const merkle_t *tree, size_t leaf);
+
+const uint8_t* merkle_root(const merkle_t *tree);
+
+#endif
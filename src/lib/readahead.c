@@ -0,0 +1,433 @@
+/*
+ * readahead.c - Background read-ahead for sequential kernel reads.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <pthread.h>            // pthread_*
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint32_t, uint64_t
+#include <stdlib.h>             // getenv, malloc
+#include <string.h>             // memcpy, strcmp
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // ADDR
+#include "backend.h"            // backend_read, kbackend_t
+#include "debug.h"              // DEBUG
+#include "libkern.h"            // READAHEAD_*
+#include "stats.h"              // stats_record, STAT_AHEAD
+#include "timer.h"              // timer_ns
+
+#include "readahead.h"
+
+/*
+ * Streams are runs of reads that each start where the last one ended.
+ * Once a stream has RA_TRIGGER of those in a row, the windows after it are
+ * queued for the worker threads, so that up to RA_DEPTH of them are read
+ * at the same time. Round trips to the kernel mostly wait, so that many
+ * in flight take about as long as one.
+ *
+ * A window that is used up completely doubles the stream's window size,
+ * one that has to be dropped with data left in it halves it.
+ */
+#define RA_STREAMS      4
+#define RA_WORKERS      4
+#define RA_DEPTH        RA_WORKERS
+#define RA_BUFS         (2 * RA_WORKERS)
+#define RA_TRIGGER      2
+#define RA_MIN_WINDOW   0x10000
+#define RA_MAX_WINDOW   (READAHEAD_SPAN / RA_DEPTH)
+#define RA_MAX_AGE_NS   (READAHEAD_MAX_AGE_MS * 1000000ULL)
+
+typedef struct
+{
+    kbackend_t *be;
+    vm_address_t next;      // End of the last read
+    vm_address_t ahead;     // End of what is queued or read ahead
+    vm_address_t limit;     // Reading ahead stops here
+    vm_size_t window;
+    unsigned int run;       // Sequential reads in a row
+    uint64_t used;          // For replacing the least recently used
+    uint32_t gen;           // Tells buffers whether this is still their stream
+} ra_stream_t;
+
+typedef enum
+{
+    RA_FREE,
+    RA_QUEUED,
+    RA_BUSY,                // Worker is reading it
+    RA_READY,
+} ra_state_t;
+
+typedef struct
+{
+    ra_state_t state;
+    bool stale;             // Written to while busy
+    kbackend_t *be;
+    vm_address_t addr;
+    vm_size_t size;
+    vm_size_t got;
+    vm_size_t used;         // Highest offset handed out
+    uint64_t seq;           // Queue order
+    uint64_t done_ns;
+    size_t stream;
+    uint32_t gen;
+    char *data;             // RA_MAX_WINDOW bytes, allocated on first use
+} ra_buf_t;
+
+static struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    bool enabled;
+    unsigned int workers;
+    uint64_t clock;
+    ra_stream_t streams[RA_STREAMS];
+    ra_buf_t bufs[RA_BUFS];
+} ra =
+{
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .work = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+    .enabled = false,
+};
+
+void kernel_set_readahead(bool enable)
+{
+    pthread_mutex_lock(&ra.lock);
+    ra.enabled = enable;
+    pthread_mutex_unlock(&ra.lock);
+}
+
+// Must hold ra.lock
+static void retire(ra_buf_t *b)
+{
+    ra_stream_t *s = &ra.streams[b->stream];
+    if(s->gen == b->gen)
+    {
+        if(b->got == b->size && b->used == b->size)
+        {
+            s->window = s->window * 2 < RA_MAX_WINDOW ? s->window * 2 : RA_MAX_WINDOW;
+        }
+        else
+        {
+            s->window = s->window / 2 > RA_MIN_WINDOW ? s->window / 2 : RA_MIN_WINDOW;
+        }
+    }
+    b->state = RA_FREE;
+}
+
+static void* worker(void *arg)
+{
+    pthread_mutex_lock(&ra.lock);
+    while(1)
+    {
+        ra_buf_t *b = NULL;
+        for(size_t i = 0; i < RA_BUFS; ++i)
+        {
+            if(ra.bufs[i].state == RA_QUEUED && (b == NULL || ra.bufs[i].seq < b->seq))
+            {
+                b = &ra.bufs[i];
+            }
+        }
+        if(b == NULL)
+        {
+            pthread_cond_wait(&ra.work, &ra.lock);
+            continue;
+        }
+        b->state = RA_BUSY;
+        b->got = 0;
+        b->used = 0;
+
+        // Readers can have what is there while the rest is on its way, so
+        // the window goes in pieces, unless large transfers make it cheap
+        // to do in one go.
+        kbackend_t *be = b->be;
+        vm_size_t piece = be->read_large == NULL && be->max_xfer != 0 ? be->max_xfer : b->size;
+        uint64_t start = timer_ns(),
+                 chunks = 0;
+        while(b->got < b->size && !b->stale)
+        {
+            vm_address_t addr = b->addr + b->got;
+            vm_size_t want = b->size - b->got < piece ? b->size - b->got : piece;
+            pthread_mutex_unlock(&ra.lock);
+            vm_size_t got = backend_read(be, addr, want, &b->data[addr - b->addr], &chunks);
+            pthread_mutex_lock(&ra.lock);
+            b->got += got;
+            pthread_cond_broadcast(&ra.done);
+            if(got != want)
+            {
+                break;
+            }
+        }
+        stats_record(STAT_AHEAD, start, b->size, b->got, chunks);
+        b->done_ns = timer_ns();
+        b->state = RA_READY;
+        if(b->stale)
+        {
+            b->stale = false;
+            retire(b);
+        }
+        pthread_cond_broadcast(&ra.done);
+    }
+    return NULL;
+}
+
+// Must hold ra.lock
+static void queue(ra_stream_t *s)
+{
+    ra_buf_t *b = NULL;
+    for(size_t i = 0; i < RA_BUFS && (b == NULL || b->state != RA_FREE); ++i)
+    {
+        ra_buf_t *c = &ra.bufs[i];
+        // Otherwise the one that has been waiting the longest
+        if(c->state == RA_FREE || (c->state == RA_READY && (b == NULL || c->done_ns < b->done_ns)))
+        {
+            b = c;
+        }
+    }
+    if(b == NULL)
+    {
+        return;
+    }
+    if(b->data == NULL && (b->data = malloc(RA_MAX_WINDOW)) == NULL)
+    {
+        return;
+    }
+    while(ra.workers < RA_WORKERS)
+    {
+        pthread_t thread;
+        if(pthread_create(&thread, NULL, &worker, NULL) != 0)
+        {
+            break;
+        }
+        pthread_detach(thread);
+        ++ra.workers;
+    }
+    if(ra.workers == 0)
+    {
+        // Don't try again on every read
+        ra.enabled = false;
+        return;
+    }
+    if(b->state == RA_READY)
+    {
+        retire(b);
+    }
+    vm_size_t size = s->limit - s->ahead < s->window ? s->limit - s->ahead : s->window;
+    *b = (ra_buf_t)
+    {
+        .state = RA_QUEUED,
+        .be = s->be,
+        .addr = s->ahead,
+        .size = size,
+        .seq = ++ra.clock,
+        .stream = s - ra.streams,
+        .gen = s->gen,
+        .data = b->data,
+    };
+    s->ahead += size;
+    pthread_cond_signal(&ra.work);
+}
+
+vm_size_t readahead_take(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf)
+{
+    if(!be->speculative || !be->concurrent)
+    {
+        return 0;
+    }
+    vm_size_t done = 0;
+    pthread_mutex_lock(&ra.lock);
+    while(ra.enabled && done < size)
+    {
+        vm_address_t at = addr + done;
+        ra_buf_t *b = NULL;
+        for(size_t i = 0; i < RA_BUFS && b == NULL; ++i)
+        {
+            ra_buf_t *c = &ra.bufs[i];
+            if(c->state != RA_FREE && c->be == be && at >= c->addr && at - c->addr < c->size)
+            {
+                b = c;
+            }
+        }
+        if(b == NULL)
+        {
+            break;
+        }
+        if(b->state == RA_QUEUED)
+        {
+            // Not started yet, the reader is as quick doing it itself
+            b->state = RA_FREE;
+            break;
+        }
+        vm_size_t off = at - b->addr;
+        if(b->state == RA_BUSY && (off >= b->got || b->stale))
+        {
+            if(b->stale)
+            {
+                break;
+            }
+            // Already on its way, which beats starting over
+            pthread_cond_wait(&ra.done, &ra.lock);
+            continue;
+        }
+        if(b->state == RA_READY && (timer_ns() - b->done_ns > RA_MAX_AGE_NS || off >= b->got))
+        {
+            retire(b);
+            break;
+        }
+        vm_size_t n = b->got - off < size - done ? b->got - off : size - done;
+        memcpy(&((char*)buf)[done], &b->data[off], n);
+        done += n;
+        if(off + n > b->used)
+        {
+            b->used = off + n;
+        }
+        if(b->state == RA_READY && b->used == b->got)
+        {
+            retire(b);
+        }
+    }
+    pthread_mutex_unlock(&ra.lock);
+    if(done > 0)
+    {
+        DEBUG("Read-ahead had " ADDR "-" ADDR, addr, addr + done);
+    }
+    return done;
+}
+
+void readahead_note(kbackend_t *be, vm_address_t addr, vm_size_t size, vm_address_t limit)
+{
+    if(!be->speculative || !be->concurrent)
+    {
+        return;
+    }
+    pthread_mutex_lock(&ra.lock);
+    if(!ra.enabled)
+    {
+        pthread_mutex_unlock(&ra.lock);
+        return;
+    }
+    ra_stream_t *s = NULL,
+                *lru = &ra.streams[0];
+    for(size_t i = 0; i < RA_STREAMS && s == NULL; ++i)
+    {
+        if(ra.streams[i].be == be && ra.streams[i].next == addr)
+        {
+            s = &ra.streams[i];
+        }
+        else if(ra.streams[i].used < lru->used)
+        {
+            lru = &ra.streams[i];
+        }
+    }
+    if(s == NULL)
+    {
+        s = lru;
+        ++s->gen;
+        s->be = be;
+        s->ahead = addr;
+        s->window = RA_MIN_WINDOW;
+        s->run = 0;
+    }
+    ++s->run;
+    s->used = ++ra.clock;
+    s->next = addr + size;
+    s->limit = limit;
+    if(s->ahead < s->next)
+    {
+        s->ahead = s->next;
+    }
+    while(s->run >= RA_TRIGGER && s->ahead - s->next < RA_DEPTH * s->window && s->ahead < s->limit)
+    {
+        vm_address_t ahead = s->ahead;
+        queue(s);
+        if(s->ahead == ahead)
+        {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&ra.lock);
+}
+
+void readahead_invalidate(vm_address_t addr, vm_size_t size)
+{
+    pthread_mutex_lock(&ra.lock);
+    for(size_t i = 0; i < RA_BUFS; ++i)
+    {
+        ra_buf_t *b = &ra.bufs[i];
+        if(b->state == RA_FREE || addr >= b->addr + b->size || b->addr >= addr + size)
+        {
+            continue;
+        }
+        if(b->state == RA_BUSY)
+        {
+            b->stale = true;
+        }
+        else
+        {
+            b->state = RA_FREE;
+        }
+    }
+    for(size_t i = 0; i < RA_STREAMS; ++i)
+    {
+        ra_stream_t *s = &ra.streams[i];
+        if(s->ahead > addr && s->next < addr + size)
+        {
+            s->ahead = s->next;
+        }
+    }
+    pthread_mutex_unlock(&ra.lock);
+}
+
+void readahead_forget(kbackend_t *be)
+{
+    pthread_mutex_lock(&ra.lock);
+    while(1)
+    {
+        bool busy = false;
+        for(size_t i = 0; i < RA_BUFS; ++i)
+        {
+            ra_buf_t *b = &ra.bufs[i];
+            if(b->state == RA_FREE || b->be != be)
+            {
+                continue;
+            }
+            if(b->state == RA_BUSY)
+            {
+                // The worker stops after its current piece
+                b->stale = true;
+                busy = true;
+            }
+            else
+            {
+                b->state = RA_FREE;
+            }
+        }
+        if(!busy)
+        {
+            break;
+        }
+        pthread_cond_wait(&ra.done, &ra.lock);
+    }
+    for(size_t i = 0; i < RA_STREAMS; ++i)
+    {
+        ra_stream_t *s = &ra.streams[i];
+        if(s->be == be)
+        {
+            *s = (ra_stream_t){ .gen = s->gen + 1 };
+        }
+    }
+    pthread_mutex_unlock(&ra.lock);
+}
+
+__attribute__((constructor)) static void readahead_init(void)
+{
+    const char *env = getenv(READAHEAD_ENV);
+    if(env != NULL && env[0] != '\0' && strcmp(env, "0") != 0)
+    {
+        ra.enabled = true;
+    }
+}
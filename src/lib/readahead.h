@@ -0,0 +1,44 @@
+/*
+ * readahead.h - Background read-ahead for sequential kernel reads.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef READAHEAD_H
+#define READAHEAD_H
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t
+
+/*
+ * Copy as much of the start of the range as has been read ahead into buf,
+ * waiting for read-ahead that is in progress.
+ *
+ * Returns the number of bytes copied.
+ */
+vm_size_t readahead_take(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf);
+
+/*
+ * Furthest read-ahead goes past the end of the last read.
+ */
+#define READAHEAD_SPAN 0x100000
+
+/*
+ * Tell read-ahead about a successful kernel_read, to track sequential
+ * streams and start reading ahead of them, up to limit at most.
+ */
+void readahead_note(kbackend_t *be, vm_address_t addr, vm_size_t size, vm_address_t limit);
+
+/*
+ * Drop everything read ahead that overlaps the range.
+ */
+void readahead_invalidate(vm_address_t addr, vm_size_t size);
+
+/*
+ * Drop everything read ahead from a backend and its streams, waiting for
+ * reads still in progress. Backends must call this before going away.
+ */
+void readahead_forget(kbackend_t *be);
+
+#endif
@@ -0,0 +1,344 @@
+/*
+ * sim-image.c - Kernel images for the simulator.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <stdint.h>             // uint32_t, uint64_t
+#include <stdio.h>              // FILE, fopen, fread, fclose
+#include <stdlib.h>             // calloc, free, malloc
+#include <string.h>             // memcpy, memset, strcpy, strerror, strlen, strncmp
+
+#include <mach/vm_prot.h>       // VM_PROT_*
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <mach-o/loader.h>      // LC_*, MH_*, S_CSTRING_LITERALS, struct *_command
+#include <sys/stat.h>           // fstat, struct stat
+
+#include "arch.h"               // ADDR, KERNEL_SPACE, MACH_*, mach_*
+#include "debug.h"              // DEBUG
+#include "mach-o.h"             // CMD_ITERATE
+
+#include "sim.h"
+
+#define IMAGE_TEXT_SIZE 0x1000000
+#define IMAGE_DATA_SIZE 0x100000
+#define IMAGE_LINK_SIZE 0x20000
+#define FUNCS_OFF       0x8000      /* Where functions start in __TEXT */
+#define FUNC_MAX_GAP    0x800
+#define CSTRING_OFF     0x4000
+#define OFVARS_OFF      0x1000
+#define HEAP_BASE       0xffffffe000000000ULL
+#define HEAP_SIZE       0x4000
+#define HEAP_TAG_MAX    29
+
+typedef struct
+{
+    uint64_t name;
+    uint32_t type;
+    uint32_t perm;
+    int32_t offset;
+} ofvar_t;
+
+static const char *nvram_names[] =
+{
+    "little-endian?", "real-mode?", "auto-boot?", "diag-switch?", "fcode-debug?", "oem-banner?",
+    "oem-logo?", "use-nvramrc?", "use-generic?", "default-mac-address?", "real-base", "real-size",
+    "virt-base", "virt-size", "load-base", "pci-probe-list", "pci-probe-mask", "screen-#columns",
+    "screen-#rows", "selftest-#megs", "boot-device", "boot-file", "boot-screen", "console-screen",
+    "diag-device", "diag-file", "input-device", "output-device", "input-device-1", "output-device-1",
+    "mouse-device", "oem-banner", "oem-logo", "nvramrc", "boot-command", "default-client-ip",
+    "default-server-ip", "default-gateway-ip", "default-subnet-mask", "default-router-ip",
+    "boot-script", "boot-args", "aapl,pci", "security-mode", "security-password", "boot-image",
+    "com.apple.System.fp-state", "backlight-level", "com.apple.System.boot-nonce", "SystemAudioVolume",
+};
+
+static uint64_t xorshift(uint64_t *s)
+{
+    uint64_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *s = x;
+}
+
+static void fill(unsigned char *buf, size_t len, uint64_t *seed)
+{
+    size_t i = 0;
+    for(; i + 8 <= len; i += 8)
+    {
+        uint64_t v = xorshift(seed);
+        memcpy(&buf[i], &v, 8);
+    }
+    for(; i < len; ++i)
+    {
+        buf[i] = xorshift(seed);
+    }
+}
+
+int sim_image_build(kbackend_t *be, sim_image_t *img, vm_address_t slide, uint64_t seed, size_t nheap)
+{
+    vm_address_t base = SIM_IMAGE_BASE + slide;
+    img->base = base;
+    img->text_size = IMAGE_TEXT_SIZE;
+    img->data_size = IMAGE_DATA_SIZE;
+    img->needle = base + IMAGE_TEXT_SIZE - 16;
+
+    unsigned char *text = malloc(IMAGE_TEXT_SIZE),
+                  *data = malloc(IMAGE_DATA_SIZE),
+                  *link = calloc(1, IMAGE_LINK_SIZE);
+    if(text == NULL || data == NULL || link == NULL)
+    {
+        free(text);
+        free(data);
+        free(link);
+        return -1;
+    }
+    seed = seed ? seed : 1;
+    fill(text, IMAGE_TEXT_SIZE, &seed);
+    fill(data, IMAGE_DATA_SIZE, &seed);
+
+    // __cstring and gOFVariables
+    size_t nvars = sizeof(nvram_names) / sizeof(*nvram_names),
+           coff = 0;
+    unsigned char *cstring = &text[CSTRING_OFF];
+    ofvar_t *vars = (ofvar_t*)&data[OFVARS_OFF];
+    for(size_t i = 0; i < nvars; ++i)
+    {
+        strcpy((char*)&cstring[coff], nvram_names[i]);
+        vars[i] = (ofvar_t)
+        {
+            .name = base + CSTRING_OFF + coff,
+            .type = 1 + i % 4,
+            .perm = i % 4,
+            .offset = -1,
+        };
+        coff += strlen(nvram_names[i]) + 1;
+    }
+    memset(&vars[nvars], 0, sizeof(*vars));
+    vm_size_t cstring_size = (coff + 0xfff) & ~0xfffULL;
+    memset(&cstring[coff], 0, cstring_size - coff);
+
+    // Function starts, 4-byte aligned at random distances up to FUNC_MAX_GAP,
+    // as ULEB128 deltas from the header
+    size_t loff = 0;
+    for(vm_size_t off = 0, next = FUNCS_OFF; next < IMAGE_TEXT_SIZE - 16; next += 4 + (xorshift(&seed) % FUNC_MAX_GAP & ~3ULL))
+    {
+        uint64_t delta = next - off;
+        do
+        {
+            link[loff++] = (delta & 0x7f) | (delta >= 0x80 ? 0x80 : 0);
+            delta >>= 7;
+        } while(delta != 0);
+        off = next;
+    }
+    link[loff++] = 0;
+    vm_size_t fstarts_size = (loff + 7) & ~7ULL;
+
+    // Header
+    memset(text, 0, CSTRING_OFF);
+    mach_hdr_t *hdr = (mach_hdr_t*)text;
+    hdr->magic = MACH_HEADER_MAGIC;
+    hdr->cputype = MACH_TYPE;
+    hdr->filetype = MH_EXECUTE;
+    char *cmds = (char*)(hdr + 1);
+
+    mach_seg_t *seg = (mach_seg_t*)cmds;
+    mach_sec_t *sec = (mach_sec_t*)(seg + 1);
+    seg->cmd = MACH_LC_SEGMENT;
+    seg->cmdsize = sizeof(*seg) + sizeof(*sec);
+    strcpy(seg->segname, "__TEXT");
+    seg->vmaddr = base;
+    seg->vmsize = seg->filesize = IMAGE_TEXT_SIZE;
+    seg->fileoff = 0;
+    seg->maxprot = seg->initprot = VM_PROT_READ | VM_PROT_EXECUTE;
+    seg->nsects = 1;
+    strcpy(sec->sectname, "__cstring");
+    strcpy(sec->segname, "__TEXT");
+    sec->addr = base + CSTRING_OFF;
+    sec->size = cstring_size;
+    sec->offset = CSTRING_OFF;
+    sec->flags = S_CSTRING_LITERALS;
+    cmds += seg->cmdsize;
+
+    seg = (mach_seg_t*)cmds;
+    sec = (mach_sec_t*)(seg + 1);
+    seg->cmd = MACH_LC_SEGMENT;
+    seg->cmdsize = sizeof(*seg) + sizeof(*sec);
+    strcpy(seg->segname, "__DATA");
+    seg->vmaddr = base + IMAGE_TEXT_SIZE;
+    seg->vmsize = seg->filesize = IMAGE_DATA_SIZE;
+    seg->fileoff = IMAGE_TEXT_SIZE;
+    seg->maxprot = seg->initprot = VM_PROT_READ | VM_PROT_WRITE;
+    seg->nsects = 1;
+    strcpy(sec->sectname, "__data");
+    strcpy(sec->segname, "__DATA");
+    sec->addr = base + IMAGE_TEXT_SIZE;
+    sec->size = IMAGE_DATA_SIZE;
+    sec->offset = IMAGE_TEXT_SIZE;
+    cmds += seg->cmdsize;
+
+    seg = (mach_seg_t*)cmds;
+    seg->cmd = MACH_LC_SEGMENT;
+    seg->cmdsize = sizeof(*seg);
+    strcpy(seg->segname, "__LINKEDIT");
+    seg->vmaddr = base + IMAGE_TEXT_SIZE + IMAGE_DATA_SIZE;
+    seg->vmsize = seg->filesize = IMAGE_LINK_SIZE;
+    seg->fileoff = IMAGE_TEXT_SIZE + IMAGE_DATA_SIZE;
+    seg->maxprot = seg->initprot = VM_PROT_READ;
+    seg->nsects = 0;
+    cmds += seg->cmdsize;
+
+    struct linkedit_data_command *fstarts = (struct linkedit_data_command*)cmds;
+    fstarts->cmd = LC_FUNCTION_STARTS;
+    fstarts->cmdsize = sizeof(*fstarts);
+    fstarts->dataoff = IMAGE_TEXT_SIZE + IMAGE_DATA_SIZE;
+    fstarts->datasize = fstarts_size;
+    cmds += fstarts->cmdsize;
+
+    struct uuid_command *uuid = (struct uuid_command*)cmds;
+    uuid->cmd = LC_UUID;
+    uuid->cmdsize = sizeof(*uuid);
+    fill(uuid->uuid, sizeof(uuid->uuid), &seed);
+    cmds += uuid->cmdsize;
+
+    hdr->ncmds = 5;
+    hdr->sizeofcmds = cmds - (char*)(hdr + 1);
+
+    int ret = 0;
+    if
+    (
+        sim_map(be, base, IMAGE_TEXT_SIZE, VM_PROT_READ | VM_PROT_EXECUTE, 0, text) == NULL ||
+        sim_map(be, base + IMAGE_TEXT_SIZE, IMAGE_DATA_SIZE, VM_PROT_READ | VM_PROT_WRITE, 0, data) == NULL ||
+        sim_map(be, base + IMAGE_TEXT_SIZE + IMAGE_DATA_SIZE, IMAGE_LINK_SIZE, VM_PROT_READ, 0, link) == NULL
+    )
+    {
+        ret = -1;
+    }
+    free(text);
+    free(data);
+    free(link);
+    if(ret == 0)
+    {
+        sim_set_base(be, base);
+        ret = sim_heap_build(be, nheap);
+    }
+    return ret;
+}
+
+int sim_heap_build(kbackend_t *be, size_t nheap)
+{
+    // With a guard page between each
+    for(size_t i = 0; i < nheap; ++i)
+    {
+        if(sim_map(be, HEAP_BASE + i * (HEAP_SIZE + 0x4000), HEAP_SIZE, VM_PROT_READ | VM_PROT_WRITE, 1 + i % HEAP_TAG_MAX, NULL) == NULL)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int sim_phys_build(kbackend_t *be, vm_size_t size, uint64_t seed)
+{
+    unsigned char *mem = sim_map_phys(be, SIM_PHYS_BASE, size, NULL);
+    if(mem == NULL)
+    {
+        return -1;
+    }
+    fill(mem, size, &seed);
+    return 0;
+}
+
+int sim_image_load(kbackend_t *be, sim_image_t *img, const char *path, vm_address_t slide)
+{
+    FILE *f = fopen(path, "rb");
+    if(f == NULL)
+    {
+        DEBUG("Failed to open %s: %s", path, strerror(errno));
+        return -1;
+    }
+    int ret = -1;
+    unsigned char *file = NULL;
+    struct stat s;
+    if(fstat(fileno(f), &s) != 0 || s.st_size < sizeof(mach_hdr_t) || (file = malloc(s.st_size)) == NULL || fread(file, s.st_size, 1, f) != 1)
+    {
+        DEBUG("Failed to read %s", path);
+        goto out;
+    }
+    mach_hdr_t *hdr = (mach_hdr_t*)file;
+    if(hdr->magic != MACH_HEADER_MAGIC || sizeof(*hdr) + hdr->sizeofcmds > s.st_size)
+    {
+        DEBUG("%s is not a supported Mach-O", path);
+        goto out;
+    }
+
+    // Slide the load commands first, so that the header we map matches
+    // what a running kernel would show. Pointers in the data stay unslid.
+    vm_address_t base = 0;
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == MACH_LC_SEGMENT)
+        {
+            mach_seg_t *seg = (mach_seg_t*)cmd;
+            if(seg->fileoff + seg->filesize > s.st_size || seg->filesize > seg->vmsize)
+            {
+                DEBUG("Segment %.16s out of bounds", seg->segname);
+                goto out;
+            }
+            seg->vmaddr += slide;
+            mach_sec_t *sec = (mach_sec_t*)(seg + 1);
+            for(uint32_t i = 0; i < seg->nsects; ++i)
+            {
+                sec[i].addr += slide;
+            }
+            if(seg->fileoff == 0 && seg->filesize != 0)
+            {
+                base = seg->vmaddr;
+            }
+        }
+    }
+    if(base == 0)
+    {
+        DEBUG("No segment maps the header of %s", path);
+        goto out;
+    }
+
+    img->base = base;
+    img->text_size = 0;
+    img->data_size = 0;
+    img->needle = 0;
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == MACH_LC_SEGMENT)
+        {
+            mach_seg_t *seg = (mach_seg_t*)cmd;
+            if(seg->vmsize == 0 || seg->vmaddr < KERNEL_SPACE)
+            {
+                continue;
+            }
+            unsigned char *mem = sim_map(be, seg->vmaddr, seg->vmsize, seg->initprot, 0, NULL);
+            if(mem == NULL)
+            {
+                DEBUG("Failed to map segment %.16s at " ADDR, seg->segname, seg->vmaddr);
+                goto out;
+            }
+            memcpy(mem, &file[seg->fileoff], seg->filesize);
+            if(strncmp(seg->segname, "__TEXT", sizeof(seg->segname)) == 0)
+            {
+                img->text_size = seg->vmsize;
+            }
+            else if(strncmp(seg->segname, "__DATA", sizeof(seg->segname)) == 0)
+            {
+                img->data_size = seg->vmsize;
+            }
+        }
+    }
+    sim_set_base(be, base);
+    ret = 0;
+
+out:;
+    free(file);
+    fclose(f);
+    return ret;
+}
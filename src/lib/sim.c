@@ -0,0 +1,709 @@
+/*
+ * sim.c - Simulated kernel memory backend.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // bool
+#include <errno.h>              // errno
+#include <stdint.h>             // uint64_t, UINT64_MAX
+#include <stdio.h>              // fprintf, stderr
+#include <stdlib.h>             // calloc, free, malloc, realloc, strtod, strtoull
+#include <string.h>             // memcpy, memmove, memset, strchr, strcmp, strdup, strtok_r
+
+#include <mach/kern_return.h>   // KERN_SUCCESS, KERN_INVALID_ADDRESS
+#include <mach/mach.h>          // mach_task_self
+#include <mach/vm_prot.h>       // VM_PROT_*
+#include <mach/vm_region.h>     // SM_PRIVATE, vm_region_submap_info_data_64_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t
+#include "readahead.h"          // readahead_forget
+#include "timer.h"              // timer_spin
+
+#include "sim.h"
+
+#define SIM_MAX_LIST 256        // Same as VM_MAP_ENTRY_MAX
+
+typedef struct
+{
+    vm_address_t start;
+    vm_address_t end;
+    vm_prot_t prot;
+    unsigned int tag;
+    unsigned char *data;
+} sim_region_t;
+
+typedef struct
+{
+    size_t count;
+    size_t cap;
+    sim_region_t *regions;  // Sorted by start
+} sim_space_t;
+
+typedef struct
+{
+    kbackend_t be;
+    vm_address_t base;
+    uint64_t latency_ns;
+    uint64_t page_ns;
+    uint64_t jitter_ns;
+    uint64_t short_max;     // Thresholds against sim_rand output
+    uint64_t fault_max;
+    uint64_t seed;
+    uint64_t draws;         // Numbers handed out by sim_rand so far
+    uint64_t calls;
+    sim_space_t virt;
+    sim_space_t phys;       // Always read/write, tags unused
+} sim_t;
+
+// First region that ends above addr
+static size_t sim_find(const sim_space_t *sp, vm_address_t addr)
+{
+    size_t lo = 0,
+           hi = sp->count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(sp->regions[mid].end <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Copy out of (buf) or into (src) contiguous regions with the given protection,
+// or just measure if both are NULL. Returns bytes covered.
+static vm_size_t sim_copy(sim_space_t *sp, vm_address_t addr, vm_size_t size, void *buf, const void *src, vm_prot_t need)
+{
+    vm_size_t done = 0;
+    for(size_t i = sim_find(sp, addr); i < sp->count && done < size; ++i)
+    {
+        sim_region_t *r = &sp->regions[i];
+        vm_address_t at = addr + done;
+        if(at < r->start || (r->prot & need) != need)
+        {
+            break;
+        }
+        vm_size_t len = r->end - at;
+        if(len > size - done)
+        {
+            len = size - done;
+        }
+        if(buf != NULL)
+        {
+            memcpy((char*)buf + done, r->data + (at - r->start), len);
+        }
+        else if(src != NULL)
+        {
+            memcpy(r->data + (at - r->start), (const char*)src + done, len);
+        }
+        done += len;
+    }
+    return done;
+}
+
+// splitmix64 of the draw number, so the only shared state is a counter
+static uint64_t sim_rand(sim_t *sim)
+{
+    uint64_t x = sim->seed + (__atomic_fetch_add(&sim->draws, 1, __ATOMIC_RELAXED) + 1) * 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Account for and delay a call; false if it is to fail
+static bool sim_call(sim_t *sim, uint64_t extra_ns)
+{
+    __atomic_fetch_add(&sim->calls, 1, __ATOMIC_RELAXED);
+    uint64_t ns = sim->latency_ns + extra_ns;
+    if(sim->jitter_ns != 0)
+    {
+        ns += sim_rand(sim) % sim->jitter_ns;
+    }
+    timer_spin(ns);
+    return sim->fault_max == 0 || sim_rand(sim) >= sim->fault_max;
+}
+
+// Possibly cut a read short, never to nothing
+static vm_size_t sim_short(sim_t *sim, vm_size_t size)
+{
+    if(sim->short_max != 0 && size > 1 && sim_rand(sim) < sim->short_max)
+    {
+        return 1 + sim_rand(sim) % (size - 1);
+    }
+    return size;
+}
+
+static kern_return_t sim_task(kbackend_t *be, task_t *task)
+{
+    // There is no kernel task, but tools insist on having one
+    *task = mach_task_self();
+    return KERN_SUCCESS;
+}
+
+static vm_address_t sim_base(kbackend_t *be)
+{
+    return ((sim_t*)be->priv)->base;
+}
+
+static vm_size_t sim_read(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf)
+{
+    sim_t *sim = be->priv;
+    if(!sim_call(sim, 0))
+    {
+        return 0;
+    }
+    return sim_copy(&sim->virt, addr, sim_short(sim, size), buf, NULL, VM_PROT_READ);
+}
+
+static vm_size_t sim_write(kbackend_t *be, vm_address_t addr, vm_size_t size, const void *buf)
+{
+    sim_t *sim = be->priv;
+    // Like vm_write, this is all or nothing
+    if(!sim_call(sim, 0) || sim_copy(&sim->virt, addr, size, NULL, NULL, VM_PROT_WRITE) != size)
+    {
+        return 0;
+    }
+    return sim_copy(&sim->virt, addr, size, NULL, buf, VM_PROT_WRITE);
+}
+
+// Out-of-line transfers: no size limit, but whole pages only, and each
+// page costs page_ns on top of the call, like mapping a copy would.
+static bool sim_ool_ok(sim_t *sim, vm_address_t addr, vm_size_t size)
+{
+    vm_size_t mask = sim->be.page_size - 1;
+    return sim_call(sim, sim->page_ns * (size / sim->be.page_size)) && (addr & mask) == 0 && (size & mask) == 0;
+}
+
+static vm_size_t sim_read_large(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf)
+{
+    sim_t *sim = be->priv;
+    if(!sim_ool_ok(sim, addr, size))
+    {
+        return 0;
+    }
+    // vm_read is all or nothing too, but a short result is still worth testing
+    return sim_copy(&sim->virt, addr, sim_short(sim, size), buf, NULL, VM_PROT_READ);
+}
+
+static vm_size_t sim_write_large(kbackend_t *be, vm_address_t addr, vm_size_t size, const void *buf)
+{
+    sim_t *sim = be->priv;
+    if(!sim_ool_ok(sim, addr, size) || sim_copy(&sim->virt, addr, size, NULL, NULL, VM_PROT_WRITE) != size)
+    {
+        return 0;
+    }
+    return sim_copy(&sim->virt, addr, size, NULL, buf, VM_PROT_WRITE);
+}
+
+// Like vm_read_list: a single call, but every entry is mapped out-of-line
+// on its own, so each page it touches costs page_ns.
+static void sim_read_list(kbackend_t *be, kernel_iov_t *iov, size_t count)
+{
+    sim_t *sim = be->priv;
+    vm_size_t mask = be->page_size - 1;
+    uint64_t pages = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        pages += (((iov[i].addr + iov[i].size + mask) & ~mask) - (iov[i].addr & ~mask)) / be->page_size;
+    }
+    bool ok = sim_call(sim, sim->page_ns * pages);
+    for(size_t i = 0; i < count; ++i)
+    {
+        kernel_iov_t *v = &iov[i];
+        v->result = ok && v->size != 0 && sim_copy(&sim->virt, v->addr, v->size, NULL, NULL, VM_PROT_READ) == v->size ? sim_copy(&sim->virt, v->addr, v->size, v->buf, NULL, VM_PROT_READ) : 0;
+    }
+}
+
+static kern_return_t sim_region(kbackend_t *be, vm_address_t *addr, vm_size_t *size, unsigned int *depth, vm_region_submap_info_data_64_t *info)
+{
+    sim_t *sim = be->priv;
+    if(!sim_call(sim, 0))
+    {
+        return KERN_FAILURE;
+    }
+    size_t i = sim_find(&sim->virt, *addr);
+    if(i >= sim->virt.count)
+    {
+        return KERN_INVALID_ADDRESS;
+    }
+    sim_region_t *r = &sim->virt.regions[i];
+    *addr = r->start;
+    *size = r->end - r->start;
+    *depth = 0;
+    memset(info, 0, sizeof(*info));
+    info->protection = r->prot;
+    info->max_protection = r->prot;
+    info->inheritance = VM_INHERIT_NONE;
+    info->user_tag = r->tag;
+    info->share_mode = SM_PRIVATE;
+    info->ref_count = 1;
+    info->pages_resident = (r->end - r->start) / 0x1000;
+    return KERN_SUCCESS;
+}
+
+// Physical transfers go straight to DRAM, so unlike read/write
+// they aren't limited to max_xfer, but don't cross holes either.
+static vm_size_t sim_read_phys(kbackend_t *be, uint64_t paddr, vm_size_t size, void *buf)
+{
+    sim_t *sim = be->priv;
+    if(!sim_call(sim, 0))
+    {
+        return 0;
+    }
+    return sim_copy(&sim->phys, paddr, size, buf, NULL, VM_PROT_READ);
+}
+
+static vm_size_t sim_write_phys(kbackend_t *be, uint64_t paddr, vm_size_t size, const void *buf)
+{
+    sim_t *sim = be->priv;
+    if(!sim_call(sim, 0))
+    {
+        return 0;
+    }
+    return sim_copy(&sim->phys, paddr, size, NULL, buf, VM_PROT_WRITE);
+}
+
+static vm_size_t sim_copy_phys(kbackend_t *be, uint64_t dst, uint64_t src, vm_size_t size)
+{
+    sim_t *sim = be->priv;
+    if(!sim_call(sim, 0))
+    {
+        return 0;
+    }
+    // Both ends have to be there, and overlap is fine like with memmove
+    vm_size_t len = sim_copy(&sim->phys, src, size, NULL, NULL, VM_PROT_READ),
+              dlen = sim_copy(&sim->phys, dst, len, NULL, NULL, VM_PROT_WRITE);
+    unsigned char *tmp = malloc(dlen > 0 ? dlen : 1);
+    if(tmp == NULL)
+    {
+        return 0;
+    }
+    sim_copy(&sim->phys, src, dlen, tmp, NULL, VM_PROT_READ);
+    sim_copy(&sim->phys, dst, dlen, NULL, tmp, VM_PROT_WRITE);
+    free(tmp);
+    return dlen;
+}
+
+kbackend_t* sim_create(vm_address_t base, uint64_t latency_ns, vm_size_t max_xfer)
+{
+    sim_t *sim = calloc(1, sizeof(*sim));
+    if(sim == NULL)
+    {
+        return NULL;
+    }
+    sim->base = base;
+    sim->latency_ns = latency_ns;
+    sim->be = (kbackend_t)
+    {
+        .name = "sim",
+        .task = &sim_task,
+        .base = &sim_base,
+        .read = &sim_read,
+        .write = &sim_write,
+        .region = &sim_region,
+        .max_xfer = max_xfer,
+        // Reads only look at regions, which are mapped before anything is read
+        .speculative = true,
+        .concurrent = true,
+        .priv = sim,
+    };
+    return &sim->be;
+}
+
+void sim_destroy(kbackend_t *be)
+{
+    if(be != NULL)
+    {
+        readahead_forget(be);
+        sim_t *sim = be->priv;
+        for(size_t i = 0; i < sim->virt.count; ++i)
+        {
+            free(sim->virt.regions[i].data);
+        }
+        for(size_t i = 0; i < sim->phys.count; ++i)
+        {
+            free(sim->phys.regions[i].data);
+        }
+        free(sim->virt.regions);
+        free(sim->phys.regions);
+        free(sim);
+    }
+}
+
+void sim_set_ool(kbackend_t *be, vm_size_t page_size, uint64_t page_ns)
+{
+    sim_t *sim = be->priv;
+    sim->page_ns = page_ns;
+    be->page_size = page_size;
+    be->large_xfer = 0;
+    be->read_large = page_size != 0 ? &sim_read_large : NULL;
+    be->write_large = page_size != 0 ? &sim_write_large : NULL;
+    be->read_list = page_size != 0 ? &sim_read_list : NULL;
+    be->max_list = SIM_MAX_LIST;
+}
+
+static void* sim_space_map(sim_space_t *sp, vm_address_t addr, vm_size_t size, vm_prot_t prot, unsigned int tag, const void *data)
+{
+    if(size == 0 || addr + size < addr)
+    {
+        return NULL;
+    }
+    size_t i = sim_find(sp, addr);
+    if(i < sp->count && sp->regions[i].start < addr + size)
+    {
+        return NULL;
+    }
+    if(sp->count >= sp->cap)
+    {
+        size_t cap = sp->cap ? sp->cap * 2 : 0x40;
+        sim_region_t *regions = realloc(sp->regions, cap * sizeof(*regions));
+        if(regions == NULL)
+        {
+            return NULL;
+        }
+        sp->regions = regions;
+        sp->cap = cap;
+    }
+    unsigned char *mem = data != NULL ? malloc(size) : calloc(1, size);
+    if(mem == NULL)
+    {
+        return NULL;
+    }
+    if(data != NULL)
+    {
+        memcpy(mem, data, size);
+    }
+    memmove(&sp->regions[i + 1], &sp->regions[i], (sp->count - i) * sizeof(*sp->regions));
+    sp->regions[i] = (sim_region_t)
+    {
+        .start = addr,
+        .end = addr + size,
+        .prot = prot,
+        .tag = tag,
+        .data = mem,
+    };
+    ++sp->count;
+    return mem;
+}
+
+void* sim_map(kbackend_t *be, vm_address_t addr, vm_size_t size, vm_prot_t prot, unsigned int tag, const void *data)
+{
+    return sim_space_map(&((sim_t*)be->priv)->virt, addr, size, prot, tag, data);
+}
+
+void* sim_map_phys(kbackend_t *be, uint64_t paddr, vm_size_t size, const void *data)
+{
+    sim_t *sim = be->priv;
+    void *mem = sim_space_map(&sim->phys, paddr, size, VM_PROT_READ | VM_PROT_WRITE, 0, data);
+    if(mem != NULL)
+    {
+        be->read_phys = &sim_read_phys;
+        be->write_phys = &sim_write_phys;
+        be->copy_phys = &sim_copy_phys;
+    }
+    return mem;
+}
+
+#define PT_T1SZ         25
+#define PT_VALID_TABLE  0x3ULL
+#define PT_PAGE         0x403ULL    /* Valid, page, access flag */
+#define PT_BLOCK        0x401ULL    /* Valid, block, access flag */
+
+typedef struct
+{
+    vm_size_t granule;
+    unsigned int shift;
+    unsigned int bits;
+    size_t count;
+    size_t cap;
+    uint64_t *tables;       // count tables of granule bytes, the first is the root
+} sim_pt_t;
+
+// Entry for va in the table at level, allocating tables on the way down
+static uint64_t* sim_pt_entry(sim_pt_t *pt, vm_address_t va, unsigned int level)
+{
+    size_t entries = pt->granule / sizeof(uint64_t),
+           table = 0;
+    for(unsigned int l = 1; ; ++l)
+    {
+        unsigned int shift = pt->shift + (3 - l) * pt->bits,
+                     bits = l == 1 ? 64 - PT_T1SZ - shift : pt->bits;
+        size_t idx = (va >> shift) & ((1ULL << bits) - 1);
+        if(l == level)
+        {
+            return &pt->tables[table * entries + idx];
+        }
+        uint64_t tte = pt->tables[table * entries + idx];
+        if(tte == 0)
+        {
+            if(pt->count >= pt->cap)
+            {
+                size_t cap = pt->cap * 2;
+                uint64_t *tables = realloc(pt->tables, cap * pt->granule);
+                if(tables == NULL)
+                {
+                    return NULL;
+                }
+                memset(&tables[pt->cap * entries], 0, (cap - pt->cap) * pt->granule);
+                pt->tables = tables;
+                pt->cap = cap;
+            }
+            tte = (SIM_PT_BASE + pt->count++ * pt->granule) | PT_VALID_TABLE;
+            pt->tables[table * entries + idx] = tte;
+        }
+        table = ((tte & ~PT_VALID_TABLE) - SIM_PT_BASE) / pt->granule;
+    }
+}
+
+int sim_pt_build(kbackend_t *be, vm_size_t granule)
+{
+    sim_t *sim = be->priv;
+    if(granule != 0x1000 && granule != 0x4000)
+    {
+        return -1;
+    }
+    sim_pt_t pt =
+    {
+        .granule = granule,
+        .shift = granule == 0x1000 ? 12 : 14,
+        .count = 1,
+        .cap = 0x10,
+    };
+    pt.bits = pt.shift - 3;
+    vm_size_t mask = granule - 1,
+              block = (vm_size_t)1 << (pt.shift + pt.bits);
+    vm_address_t lowest = ~(vm_address_t)0 << (64 - PT_T1SZ);
+
+    // Lay out the physical pages first, each region congruent to its
+    // virtual address modulo the block size
+    uint64_t *offs = malloc((sim->virt.count + 1) * sizeof(*offs));
+    if(offs == NULL)
+    {
+        return -1;
+    }
+    uint64_t frames = 0;
+    vm_address_t prev = 0;
+    for(size_t i = 0; i < sim->virt.count; ++i)
+    {
+        sim_region_t *r = &sim->virt.regions[i];
+        vm_address_t start = r->start & ~mask,
+                     end = (r->end + mask) & ~mask;
+        // Neighbours can share a page
+        start = start > prev ? start : prev;
+        offs[i] = frames + ((start - frames) & (block - 1));
+        if(r->start < lowest || start >= end)
+        {
+            continue;
+        }
+        frames = offs[i] + (end - start);
+        prev = end;
+    }
+    unsigned char *mem = frames > 0 ? sim_map_phys(be, SIM_PT_FRAMES, frames, NULL) : NULL;
+    pt.tables = calloc(pt.cap, granule);
+    int ret = -1;
+    if((frames > 0 && mem == NULL) || pt.tables == NULL)
+    {
+        goto out;
+    }
+
+    prev = 0;
+    for(size_t i = 0; i < sim->virt.count; ++i)
+    {
+        sim_region_t *r = &sim->virt.regions[i];
+        vm_address_t start = r->start & ~mask,
+                     end = (r->end + mask) & ~mask;
+        start = start > prev ? start : prev;
+        if(r->start < lowest || start >= end)
+        {
+            continue;
+        }
+        prev = end;
+        vm_address_t from = r->start > start ? r->start : start;
+        memcpy(&mem[offs[i] + (from - start)], r->data + (from - r->start), r->end - from);
+        for(vm_address_t va = start; va < end; )
+        {
+            uint64_t pa = SIM_PT_FRAMES + offs[i] + (va - start);
+            bool big = (va & (block - 1)) == 0 && end - va >= block;
+            uint64_t *tte = sim_pt_entry(&pt, va, big ? 2 : 3);
+            if(tte == NULL)
+            {
+                goto out;
+            }
+            *tte = pa | (big ? PT_BLOCK : PT_PAGE);
+            va += big ? block : granule;
+        }
+    }
+    if(sim_map_phys(be, SIM_PT_BASE, pt.count * granule, pt.tables) == NULL)
+    {
+        goto out;
+    }
+    ret = 0;
+
+out:;
+    free(pt.tables);
+    free(offs);
+    return ret;
+}
+
+uint64_t sim_calls(kbackend_t *be)
+{
+    return __atomic_load_n(&((sim_t*)be->priv)->calls, __ATOMIC_RELAXED);
+}
+
+void sim_set_base(kbackend_t *be, vm_address_t base)
+{
+    ((sim_t*)be->priv)->base = base;
+}
+
+// Probability as a threshold for sim_rand
+static uint64_t sim_threshold(double p)
+{
+    if(p <= 0)
+    {
+        return 0;
+    }
+    if(p >= 1)
+    {
+        return UINT64_MAX;
+    }
+    return (uint64_t)(p * 18446744073709551616.0);
+}
+
+void sim_set_faults(kbackend_t *be, uint64_t jitter_ns, double short_rate, double fault_rate, uint64_t seed)
+{
+    sim_t *sim = be->priv;
+    sim->jitter_ns = jitter_ns;
+    sim->short_max = sim_threshold(short_rate);
+    sim->fault_max = sim_threshold(fault_rate);
+    sim->seed = seed;
+    sim->draws = 0;
+    // Which call gets which number depends on the order calls come in, so
+    // runs only repeat themselves if calls come in one at a time
+    sim->be.concurrent = jitter_ns == 0 && sim->short_max == 0 && sim->fault_max == 0;
+    // libkern tunes the large transfer size by the clock, which would change
+    // how reads are split, and thus what the numbers are drawn for
+    if(!sim->be.concurrent && sim->be.read_large != NULL && sim->be.large_xfer == 0)
+    {
+        sim->be.large_xfer = 16 * sim->be.page_size;
+    }
+}
+
+kbackend_t* sim_from_spec(const char *spec)
+{
+    const char *image = NULL;
+    uint64_t slide = 0, heap = 256, seed = 1, latency = 0, jitter = 0, max_xfer = 0xfff, page = 0x4000, page_ns = 0, phys = 0x1000000, pt = 0;
+    double short_rate = 0, fault_rate = 0;
+    const struct
+    {
+        const char *name;
+        uint64_t *val;
+    } nums[] =
+    {
+        { "slide",    &slide    },
+        { "heap",     &heap     },
+        { "seed",     &seed     },
+        { "latency",  &latency  },
+        { "jitter",   &jitter   },
+        { "max_xfer", &max_xfer },
+        { "page",     &page     },
+        { "page_ns",  &page_ns  },
+        { "phys",     &phys     },
+        { "pt",       &pt       },
+    };
+
+    char *copy = strdup(spec),
+         *save = NULL;
+    if(copy == NULL)
+    {
+        return NULL;
+    }
+    kbackend_t *be = NULL;
+    // A spec without any key=value (like "1") just asks for the defaults
+    for(char *tok = strchr(copy, '=') != NULL ? strtok_r(copy, ",", &save) : NULL; tok != NULL; tok = strtok_r(NULL, ",", &save))
+    {
+        char *val = strchr(tok, '='),
+             *end;
+        if(val == NULL)
+        {
+            fprintf(stderr, "[!] Expected key=value in simulator spec, got \"%s\"\n", tok);
+            goto out;
+        }
+        *val++ = '\0';
+        if(strcmp(tok, "image") == 0)
+        {
+            image = val;
+            continue;
+        }
+        errno = 0;
+        if(strcmp(tok, "short") == 0 || strcmp(tok, "fault") == 0)
+        {
+            double d = strtod(val, &end);
+            if(val[0] == '\0' || end[0] != '\0' || errno != 0 || d < 0 || d > 1)
+            {
+                fprintf(stderr, "[!] Bad probability for %s: \"%s\"\n", tok, val);
+                goto out;
+            }
+            *(tok[0] == 's' ? &short_rate : &fault_rate) = d;
+            continue;
+        }
+        uint64_t v = strtoull(val, &end, 0);
+        if(val[0] == '\0' || end[0] != '\0' || errno != 0)
+        {
+            fprintf(stderr, "[!] Bad number for %s: \"%s\"\n", tok, val);
+            goto out;
+        }
+        size_t i = 0;
+        while(i < sizeof(nums) / sizeof(*nums) && strcmp(tok, nums[i].name) != 0)
+        {
+            ++i;
+        }
+        if(i >= sizeof(nums) / sizeof(*nums))
+        {
+            fprintf(stderr, "[!] Unknown simulator option: %s\n", tok);
+            goto out;
+        }
+        *nums[i].val = v;
+    }
+    if(page & (page - 1))
+    {
+        fprintf(stderr, "[!] Simulator page size must be a power of two\n");
+        goto out;
+    }
+    if(pt != 0 && pt != 0x1000 && pt != 0x4000)
+    {
+        fprintf(stderr, "[!] Page table granule must be 0x1000 or 0x4000\n");
+        goto out;
+    }
+
+    be = sim_create(SIM_IMAGE_BASE + slide, latency, max_xfer);
+    if(be == NULL)
+    {
+        goto out;
+    }
+    sim_set_ool(be, page, page_ns);
+    sim_image_t img;
+    int r = image != NULL ? sim_image_load(be, &img, image, slide) : sim_image_build(be, &img, slide, seed, 0);
+    if(r != 0 && image != NULL)
+    {
+        fprintf(stderr, "[!] Failed to load kernel image %s\n", image);
+    }
+    if(r != 0 || sim_heap_build(be, heap) != 0 || (phys != 0 && sim_phys_build(be, phys, seed) != 0) || (pt != 0 && sim_pt_build(be, pt) != 0))
+    {
+        sim_destroy(be);
+        be = NULL;
+        goto out;
+    }
+    // Faults come last, building the image shouldn't be subject to them
+    sim_set_faults(be, jitter, short_rate, fault_rate, seed);
+
+out:;
+    free(copy);
+    return be;
+}
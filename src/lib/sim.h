@@ -0,0 +1,174 @@
+/*
+ * sim.h - Simulated kernel memory backend.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint64_t
+
+#include <mach/vm_prot.h>       // vm_prot_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t
+
+/*
+ * An in-process stand-in for kernel memory, made up of individually mapped
+ * regions. Every backend call costs latency_ns of busy waiting, so that
+ * round-trip heavy code paths can be measured without a device.
+ */
+
+/*
+ * Create a simulator. base is what get_kernel_base() will return,
+ * max_xfer is the transfer limit imposed on a single call (0 for none).
+ */
+kbackend_t* sim_create(vm_address_t base, uint64_t latency_ns, vm_size_t max_xfer);
+
+void sim_destroy(kbackend_t *be);
+
+/*
+ * Enable out-of-line transfers (read_large/write_large) for whole pages of
+ * page_size bytes, each page costing page_ns on top of the call latency.
+ * Unaligned requests fail. Batched reads (read_list) come with them, and map
+ * each page an entry touches. A page_size of 0 disables them again.
+ */
+void sim_set_ool(kbackend_t *be, vm_size_t page_size, uint64_t page_ns);
+
+/*
+ * Map a region. data is copied if given, otherwise the region is zero-filled.
+ * Regions must not overlap.
+ *
+ * Returns a pointer to the backing memory, or NULL on failure.
+ */
+void* sim_map(kbackend_t *be, vm_address_t addr, vm_size_t size, vm_prot_t prot, unsigned int tag, const void *data);
+
+/*
+ * Map a range of simulated physical memory, which is separate from the
+ * regions above. The first one enables read_phys/write_phys/copy_phys.
+ * Same rules and return value as sim_map.
+ */
+void* sim_map_phys(kbackend_t *be, uint64_t paddr, vm_size_t size, const void *data);
+
+/*
+ * Number of read/write/region calls served so far.
+ */
+uint64_t sim_calls(kbackend_t *be);
+
+/*
+ * Change what get_kernel_base() returns.
+ */
+void sim_set_base(kbackend_t *be, vm_address_t base);
+
+/*
+ * Make calls less predictable: jitter_ns of extra latency at most, and the
+ * given probabilities for a read to come up short, or for any call to fail.
+ * Decisions come from a PRNG seeded with seed, so runs are reproducible.
+ * For that, the backend is no longer concurrent while any of them is on.
+ */
+void sim_set_faults(kbackend_t *be, uint64_t jitter_ns, double short_rate, double fault_rate, uint64_t seed);
+
+/*
+ * Build a simulator from a spec of comma-separated key=value pairs:
+ *
+ *     image=path      Load a Mach-O kernel instead of the synthetic one
+ *     slide=N         Kernel slide (default 0)
+ *     heap=N          Number of synthetic heap regions (default 256)
+ *     seed=N          Seed for image contents and faults (default 1)
+ *     latency=ns      Latency per call (default 0)
+ *     jitter=ns       Additional random latency (default 0)
+ *     max_xfer=N      Inline transfer limit (default 0xfff)
+ *     page=N          Out-of-line page size, 0 to disable (default 0x4000)
+ *     page_ns=ns      Out-of-line cost per page (default 0)
+ *     short=P         Probability of a short read (default 0)
+ *     fault=P         Probability of a failed call (default 0)
+ *     phys=N          Bytes of physical memory, 0 for none (default 0x1000000)
+ *     pt=N            Build page tables with this granule, 0 for none (default 0)
+ *
+ * Numbers take 0x for hex. Returns NULL on failure.
+ */
+kbackend_t* sim_from_spec(const char *spec);
+
+/*
+ * Setting SIM_ENV to a spec (or just "1" for the defaults) makes every
+ * tool run against a simulator instead of the kernel.
+ */
+#define SIM_ENV "KUTIL_SIM"
+
+/*
+ * Where the synthetic kernel sits without a slide.
+ */
+#define SIM_IMAGE_BASE 0xfffffff007004000ULL
+
+typedef struct
+{
+    vm_address_t base;
+    vm_size_t text_size;    // __TEXT, header and __cstring included
+    vm_size_t data_size;    // __DATA, gOFVariables included
+    vm_address_t needle;    // Address of a unique 16-byte sequence at the end of __TEXT, 0 if loaded
+} sim_image_t;
+
+/*
+ * Map a synthetic kernel at SIM_IMAGE_BASE + slide: a Mach-O header,
+ * __TEXT.__cstring with NVRAM variable names, __DATA.__data with a
+ * gOFVariables table, __LINKEDIT with LC_FUNCTION_STARTS for made-up
+ * functions in __TEXT, and deterministic filler for everything else.
+ * Additionally, nheap regions with kernel allocation tags are mapped
+ * so that kmap has something to walk.
+ *
+ * Returns 0 on success.
+ */
+int sim_image_build(kbackend_t *be, sim_image_t *img, vm_address_t slide, uint64_t seed, size_t nheap);
+
+/*
+ * Map nheap 16K regions with kernel allocation tags in the heap area,
+ * separated by unmapped pages. sim_image_build does this already.
+ *
+ * Returns 0 on success.
+ */
+int sim_heap_build(kbackend_t *be, size_t nheap);
+
+/*
+ * Where simulated physical memory starts, like DRAM on most SoCs.
+ */
+#define SIM_PHYS_BASE 0x800000000ULL
+
+/*
+ * Map size bytes of physical memory at SIM_PHYS_BASE, filled with
+ * deterministic noise from seed.
+ *
+ * Returns 0 on success.
+ */
+int sim_phys_build(kbackend_t *be, vm_size_t size, uint64_t seed);
+
+/*
+ * Where sim_pt_build puts the root table and the rest of the tables, and
+ * the physical pages everything is mapped to.
+ */
+#define SIM_PT_BASE     0xa00000000ULL
+#define SIM_PT_FRAMES   0xb00000000ULL
+
+/*
+ * Build ARM64 page tables for everything mapped so far, as TTBR1 would
+ * have them with the given granule (0x1000 or 0x4000) and a T1SZ of 25,
+ * with the root table at SIM_PT_BASE. Each region is backed by physical
+ * pages of its own, at the same offset modulo the block size as its
+ * virtual address, so that aligned stretches get block mappings.
+ * The contents are copied over, but the two copies aren't kept in sync.
+ *
+ * Returns 0 on success.
+ */
+int sim_pt_build(kbackend_t *be, vm_size_t granule);
+
+/*
+ * Map the segments of a Mach-O kernel (e.g. one written by kdump) at their
+ * vmaddr + slide. Addresses in the load commands are slid to match,
+ * pointers in the data are left as they are.
+ *
+ * Returns 0 on success.
+ */
+int sim_image_load(kbackend_t *be, sim_image_t *img, const char *path, vm_address_t slide);
+
+#endif
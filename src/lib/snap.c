@@ -0,0 +1,579 @@
+/*
+ * snap.c - Compressed snapshots of the kernel address space.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno, EINVAL
+#include <fcntl.h>              // open, O_RDONLY
+#include <pthread.h>            // pthread_mutex_*
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+#include <stdio.h>              // FILE, fopen, fseek, fwrite, fclose
+#include <stdlib.h>             // calloc, free, malloc, qsort, realloc
+#include <string.h>             // memcpy, memset
+#include <unistd.h>             // close, pread
+
+#include <mach/kern_return.h>   // KERN_SUCCESS, KERN_INVALID_ADDRESS
+#include <mach/mach.h>          // mach_task_self
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <sys/stat.h>           // fstat, struct stat
+
+#include <zlib.h>               // compress2, compressBound, uncompress, Z_*
+
+#include "arch.h"               // ADDR, SIZE
+#include "backend.h"            // kbackend_t
+#include "debug.h"              // DEBUG
+
+#include "snap.h"
+
+static bool grow(void **ptr, size_t *cap, size_t need, size_t elem)
+{
+    if(need <= *cap)
+    {
+        return true;
+    }
+    size_t cap2 = *cap == 0 ? 0x100 : *cap;
+    while(cap2 < need)
+    {
+        cap2 *= 2;
+    }
+    void *p = realloc(*ptr, cap2 * elem);
+    if(p == NULL)
+    {
+        return false;
+    }
+    *ptr = p;
+    *cap = cap2;
+    return true;
+}
+
+static bool all_zero(const uint8_t *data, size_t size)
+{
+    for(size_t i = 0; i < size; ++i)
+    {
+        if(data[i] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/********** Writing **********/
+
+struct snap_writer
+{
+    FILE *f;
+    snap_hdr_t hdr;
+    uint64_t off;           // Where the next block goes
+    uint64_t raw;
+    vm_size_t left;         // Bytes of the current region still to come
+    size_t nregions;
+    size_t capregions;
+    snap_region_t *regions;
+    size_t nblocks;
+    size_t capblocks;
+    snap_block_t *blocks;
+    uLongf zcap;
+    uint8_t *zbuf;
+};
+
+static void writer_free(snap_writer_t *w)
+{
+    if(w->f != NULL)
+    {
+        fclose(w->f);
+    }
+    free(w->regions);
+    free(w->blocks);
+    free(w->zbuf);
+    free(w);
+}
+
+snap_writer_t* snap_create(const char *path, vm_address_t kbase, const uint8_t uuid[16], vm_size_t page_size)
+{
+    if(page_size == 0 || SNAP_BLOCK_SIZE % page_size != 0 || SNAP_BLOCK_SIZE / page_size > 32)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+    snap_writer_t *w = calloc(1, sizeof(*w));
+    if(w == NULL)
+    {
+        return NULL;
+    }
+    w->zcap = compressBound(SNAP_BLOCK_SIZE);
+    w->zbuf = malloc(w->zcap);
+    w->f = fopen(path, "wb");
+    if(w->zbuf == NULL || w->f == NULL)
+    {
+        writer_free(w);
+        return NULL;
+    }
+    w->hdr = (snap_hdr_t)
+    {
+        .magic = SNAP_MAGIC,
+        .version = SNAP_VERSION,
+        .block_size = SNAP_BLOCK_SIZE,
+        .page_size = page_size,
+        .kbase = kbase,
+    };
+    memcpy(w->hdr.uuid, uuid, sizeof(w->hdr.uuid));
+    // Filled in for real by snap_finish
+    snap_hdr_t blank = { .magic = 0 };
+    if(fwrite(&blank, sizeof(blank), 1, w->f) != 1)
+    {
+        writer_free(w);
+        return NULL;
+    }
+    w->off = sizeof(blank);
+    return w;
+}
+
+int snap_add_region(snap_writer_t *w, const snap_region_t *region, bool data)
+{
+    if(w->left != 0)
+    {
+        DEBUG("Region added before the previous one was complete");
+        return -1;
+    }
+    if(!grow((void**)&w->regions, &w->capregions, w->nregions + 1, sizeof(*w->regions)))
+    {
+        return -1;
+    }
+    snap_region_t *r = &w->regions[w->nregions++];
+    *r = *region;
+    r->block = data ? w->nblocks : SNAP_NO_DATA;
+    w->left = data ? region->size : 0;
+    return 0;
+}
+
+int snap_add_block(snap_writer_t *w, const void *data, vm_size_t size, uint32_t valid)
+{
+    if(size != (w->left < SNAP_BLOCK_SIZE ? w->left : SNAP_BLOCK_SIZE))
+    {
+        DEBUG("Block of " SIZE " bytes where " SIZE " were expected", size, w->left < SNAP_BLOCK_SIZE ? w->left : SNAP_BLOCK_SIZE);
+        return -1;
+    }
+    if(!grow((void**)&w->blocks, &w->capblocks, w->nblocks + 1, sizeof(*w->blocks)))
+    {
+        return -1;
+    }
+    snap_block_t *b = &w->blocks[w->nblocks];
+    b->off = w->off;
+    b->valid = valid;
+    if(all_zero(data, size))
+    {
+        b->csize = 0;
+    }
+    else
+    {
+        uLongf zlen = w->zcap;
+        const void *out = w->zbuf;
+        if(compress2(w->zbuf, &zlen, data, size, Z_BEST_SPEED) != Z_OK || zlen >= size)
+        {
+            out = data;
+            zlen = size;
+        }
+        if(fwrite(out, 1, zlen, w->f) != zlen)
+        {
+            return -1;
+        }
+        b->csize = zlen;
+        w->off += zlen;
+    }
+    ++w->nblocks;
+    w->left -= size;
+    w->raw += size;
+    return 0;
+}
+
+int snap_finish(snap_writer_t *w)
+{
+    int ret = -1;
+    if(w->left != 0)
+    {
+        DEBUG("Snapshot finished in the middle of a region");
+        goto out;
+    }
+    w->hdr.regions = w->nregions;
+    w->hdr.blocks = w->nblocks;
+    w->hdr.table = w->off;
+    if(fwrite(w->regions, sizeof(*w->regions), w->nregions, w->f) != w->nregions ||
+       fwrite(w->blocks, sizeof(*w->blocks), w->nblocks, w->f) != w->nblocks ||
+       fseek(w->f, 0, SEEK_SET) != 0 ||
+       fwrite(&w->hdr, sizeof(w->hdr), 1, w->f) != 1)
+    {
+        goto out;
+    }
+    FILE *f = w->f;
+    w->f = NULL;
+    if(fclose(f) != 0)
+    {
+        goto out;
+    }
+    ret = 0;
+out:;
+    writer_free(w);
+    return ret;
+}
+
+void snap_written(const snap_writer_t *w, uint64_t *raw, uint64_t *stored)
+{
+    *raw = w->raw;
+    *stored = w->off;
+}
+
+/********** Reading **********/
+
+typedef struct
+{
+    uint64_t block;         // SNAP_NO_DATA if empty
+    uint64_t used;
+    uint8_t *buf;
+} cached_t;
+
+typedef struct
+{
+    kbackend_t be;
+    int fd;
+    snap_hdr_t hdr;
+    snap_region_t *regions;
+    snap_block_t *blocks;
+    // Regions with data, by address
+    size_t ndata;
+    const snap_region_t **data;
+    // What kernel_region sees for each depth up to the deepest recorded one
+    unsigned int levels;
+    size_t *nview;
+    const snap_region_t ***view;
+    // Readers may come from several threads; this covers clock, zbuf and cache
+    pthread_mutex_t lock;
+    uint64_t clock;
+    uint8_t *zbuf;
+    cached_t cache[SNAP_CACHE_BLOCKS];
+} snap_t;
+
+static int region_cmp(const void *a, const void *b)
+{
+    const snap_region_t *x = *(const snap_region_t* const*)a,
+                        *y = *(const snap_region_t* const*)b;
+    return x->addr < y->addr ? -1 : x->addr > y->addr ? 1 : 0;
+}
+
+// Last entry starting at or below addr, or -1
+static ssize_t region_floor(const snap_region_t **list, size_t count, vm_address_t addr)
+{
+    size_t lo = 0,
+           hi = count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(list[mid]->addr <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return (ssize_t)lo - 1;
+}
+
+// Block idx, len bytes long, decompressed into a cache entry. Must be called
+// with the lock held, and the entry is only good until it is dropped.
+static const uint8_t* snap_block(snap_t *s, uint64_t idx, vm_size_t len)
+{
+    cached_t *c = NULL;
+    for(size_t i = 0; i < SNAP_CACHE_BLOCKS; ++i)
+    {
+        cached_t *e = &s->cache[i];
+        if(e->block == idx)
+        {
+            e->used = ++s->clock;
+            return e->buf;
+        }
+        if(c == NULL || e->used < c->used)
+        {
+            c = e;
+        }
+    }
+    const snap_block_t *b = &s->blocks[idx];
+    c->block = SNAP_NO_DATA;
+    if(b->csize == 0)
+    {
+        memset(c->buf, 0, len);
+    }
+    else if(b->csize == len)
+    {
+        if(pread(s->fd, c->buf, len, b->off) != (ssize_t)len)
+        {
+            return NULL;
+        }
+    }
+    else
+    {
+        uLongf zlen = len;
+        if(b->csize > compressBound(SNAP_BLOCK_SIZE) || pread(s->fd, s->zbuf, b->csize, b->off) != (ssize_t)b->csize ||
+           uncompress(c->buf, &zlen, s->zbuf, b->csize) != Z_OK || zlen != len)
+        {
+            DEBUG("Failed to decompress snapshot block %llu", (unsigned long long)idx);
+            return NULL;
+        }
+    }
+    c->block = idx;
+    c->used = ++s->clock;
+    return c->buf;
+}
+
+static kern_return_t snap_task(kbackend_t *be, task_t *task)
+{
+    // No real task to hand out
+    *task = mach_task_self();
+    return KERN_SUCCESS;
+}
+
+static vm_address_t snap_base(kbackend_t *be)
+{
+    return ((snap_t*)be->priv)->hdr.kbase;
+}
+
+static vm_size_t snap_read(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf)
+{
+    snap_t *s = be->priv;
+    vm_size_t done = 0,
+              ps = s->hdr.page_size;
+    while(done < size)
+    {
+        vm_address_t a = addr + done;
+        ssize_t i = region_floor(s->data, s->ndata, a);
+        if(i < 0 || a - s->data[i]->addr >= s->data[i]->size)
+        {
+            break;
+        }
+        const snap_region_t *r = s->data[i];
+        uint64_t off = a - r->addr,
+                 bi = off / SNAP_BLOCK_SIZE;
+        vm_size_t boff = off % SNAP_BLOCK_SIZE,
+                  blen = r->size - bi * SNAP_BLOCK_SIZE;
+        if(blen > SNAP_BLOCK_SIZE)
+        {
+            blen = SNAP_BLOCK_SIZE;
+        }
+        if(!(s->blocks[r->block + bi].valid & (1U << (boff / ps))))
+        {
+            break;
+        }
+        // Up to the end of the page
+        vm_size_t len = (boff / ps + 1) * ps - boff;
+        if(len > blen - boff)
+        {
+            len = blen - boff;
+        }
+        if(len > size - done)
+        {
+            len = size - done;
+        }
+        pthread_mutex_lock(&s->lock);
+        const uint8_t *data = snap_block(s, r->block + bi, blen);
+        if(data != NULL)
+        {
+            memcpy((uint8_t*)buf + done, &data[boff], len);
+        }
+        pthread_mutex_unlock(&s->lock);
+        if(data == NULL)
+        {
+            break;
+        }
+        done += len;
+    }
+    return done;
+}
+
+static vm_size_t snap_write(kbackend_t *be, vm_address_t addr, vm_size_t size, const void *buf)
+{
+    DEBUG("Snapshots are read-only, not writing " ADDR "-" ADDR, addr, addr + size);
+    return 0;
+}
+
+static kern_return_t snap_region(kbackend_t *be, vm_address_t *addr, vm_size_t *size, unsigned int *depth, vm_region_submap_info_data_64_t *info)
+{
+    snap_t *s = be->priv;
+    unsigned int d = *depth < s->levels ? *depth : s->levels - 1;
+    const snap_region_t **view = s->view[d];
+    size_t count = s->nview[d];
+    // Regions in a view don't overlap, so the one containing addr comes last
+    ssize_t i = region_floor(view, count, *addr);
+    if(i < 0 || *addr - view[i]->addr >= view[i]->size)
+    {
+        ++i;
+    }
+    if(i >= count)
+    {
+        return KERN_INVALID_ADDRESS;
+    }
+    *addr = view[i]->addr;
+    *size = view[i]->size;
+    *depth = view[i]->depth;
+    *info = view[i]->info;
+    return KERN_SUCCESS;
+}
+
+static void snap_free(snap_t *s)
+{
+    if(s->fd >= 0)
+    {
+        close(s->fd);
+    }
+    for(unsigned int d = 0; s->view != NULL && d < s->levels; ++d)
+    {
+        free(s->view[d]);
+    }
+    for(size_t i = 0; i < SNAP_CACHE_BLOCKS; ++i)
+    {
+        free(s->cache[i].buf);
+    }
+    free(s->view);
+    free(s->nview);
+    free(s->data);
+    free(s->regions);
+    free(s->blocks);
+    free(s->zbuf);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+}
+
+// At depth d, kernel_region descends into submaps as far as d, so it sees
+// what was found when walking at depth d, plus whatever lies outside of
+// submaps at the levels above.
+static bool snap_views(snap_t *s)
+{
+    s->levels = 1;
+    for(size_t i = 0; i < s->hdr.regions; ++i)
+    {
+        if(s->regions[i].level + 1 > s->levels)
+        {
+            s->levels = s->regions[i].level + 1;
+        }
+    }
+    s->nview = calloc(s->levels, sizeof(*s->nview));
+    s->view = calloc(s->levels, sizeof(*s->view));
+    if(s->nview == NULL || s->view == NULL)
+    {
+        return false;
+    }
+    for(unsigned int d = 0; d < s->levels; ++d)
+    {
+        s->view[d] = malloc((s->hdr.regions + 1) * sizeof(**s->view));
+        if(s->view[d] == NULL)
+        {
+            return false;
+        }
+        for(size_t i = 0; i < s->hdr.regions; ++i)
+        {
+            const snap_region_t *r = &s->regions[i];
+            if(r->level == d || (r->level < d && !r->info.is_submap))
+            {
+                s->view[d][s->nview[d]++] = r;
+            }
+        }
+        qsort(s->view[d], s->nview[d], sizeof(**s->view), &region_cmp);
+    }
+    return true;
+}
+
+kbackend_t* snap_backend(const char *path)
+{
+    snap_t *s = calloc(1, sizeof(*s));
+    if(s == NULL)
+    {
+        return NULL;
+    }
+    if(pthread_mutex_init(&s->lock, NULL) != 0)
+    {
+        free(s);
+        return NULL;
+    }
+    s->fd = open(path, O_RDONLY);
+    if(s->fd < 0)
+    {
+        DEBUG("Failed to open %s", path);
+        goto fail;
+    }
+    struct stat st;
+    if(fstat(s->fd, &st) != 0 || pread(s->fd, &s->hdr, sizeof(s->hdr), 0) != sizeof(s->hdr))
+    {
+        goto fail;
+    }
+    snap_hdr_t *h = &s->hdr;
+    if(h->magic != SNAP_MAGIC || h->version != SNAP_VERSION || h->block_size != SNAP_BLOCK_SIZE ||
+       h->page_size == 0 || SNAP_BLOCK_SIZE % h->page_size != 0 || SNAP_BLOCK_SIZE / h->page_size > 32 ||
+       h->table > st.st_size || h->regions > (st.st_size - h->table) / sizeof(snap_region_t) ||
+       h->blocks > (st.st_size - h->table - h->regions * sizeof(snap_region_t)) / sizeof(snap_block_t))
+    {
+        DEBUG("%s is not a supported snapshot", path);
+        goto fail;
+    }
+    size_t rsize = h->regions * sizeof(*s->regions),
+           bsize = h->blocks * sizeof(*s->blocks);
+    s->regions = malloc(rsize + 1);
+    s->blocks = malloc(bsize + 1);
+    s->data = malloc((h->regions + 1) * sizeof(*s->data));
+    s->zbuf = malloc(compressBound(SNAP_BLOCK_SIZE));
+    if(s->regions == NULL || s->blocks == NULL || s->data == NULL || s->zbuf == NULL ||
+       pread(s->fd, s->regions, rsize, h->table) != (ssize_t)rsize ||
+       pread(s->fd, s->blocks, bsize, h->table + rsize) != (ssize_t)bsize)
+    {
+        goto fail;
+    }
+    for(size_t i = 0; i < h->regions; ++i)
+    {
+        const snap_region_t *r = &s->regions[i];
+        if(r->block == SNAP_NO_DATA)
+        {
+            continue;
+        }
+        if(r->block > h->blocks || (r->size + SNAP_BLOCK_SIZE - 1) / SNAP_BLOCK_SIZE > h->blocks - r->block)
+        {
+            DEBUG("Snapshot region " ADDR " has bad block indices", (vm_address_t)r->addr);
+            goto fail;
+        }
+        s->data[s->ndata++] = r;
+    }
+    qsort(s->data, s->ndata, sizeof(*s->data), &region_cmp);
+    for(size_t i = 0; i < SNAP_CACHE_BLOCKS; ++i)
+    {
+        s->cache[i].block = SNAP_NO_DATA;
+        s->cache[i].buf = malloc(SNAP_BLOCK_SIZE);
+        if(s->cache[i].buf == NULL)
+        {
+            goto fail;
+        }
+    }
+    if(!snap_views(s))
+    {
+        goto fail;
+    }
+    s->be = (kbackend_t)
+    {
+        .name = "snapshot",
+        .task = &snap_task,
+        .base = &snap_base,
+        .read = &snap_read,
+        .write = &snap_write,
+        .region = &snap_region,
+        .max_xfer = 0,
+        // Holes just end the read
+        .speculative = true,
+        .concurrent = true,
+        .priv = s,
+    };
+    DEBUG("Loaded snapshot %s: %llu regions, %llu blocks", path, (unsigned long long)h->regions, (unsigned long long)h->blocks);
+    return &s->be;
+
+fail:;
+    snap_free(s);
+    return NULL;
+}
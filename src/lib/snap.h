@@ -0,0 +1,117 @@
+/*
+ * snap.h - Compressed snapshots of the kernel address space.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef SNAP_H
+#define SNAP_H
+
+#include <stdbool.h>            // bool
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+
+#include <mach/vm_region.h>     // vm_region_submap_info_data_64_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t
+
+/*
+ * A snapshot holds the kernel's region map and the contents of its readable
+ * regions, so that tools can later be run against it with KUTIL_SNAP=file,
+ * without a device.
+ *
+ * File format, all integers little endian:
+ *
+ *     snap_hdr_t          header
+ *     ...                 compressed blocks, in region order
+ *     snap_region_t[]     region table, header.regions entries
+ *     snap_block_t[]      block index, header.blocks entries
+ *
+ * The data of a region is cut into blocks of SNAP_BLOCK_SIZE bytes (the last
+ * one may be shorter), each deflated on its own so that any of them can be
+ * read without touching the rest. Blocks that are all zeroes take no space,
+ * and ones that don't compress are stored as is. Pages that couldn't be read
+ * are zero-filled and left out of the block's valid mask, and reading them
+ * from the snapshot fails just like it did on the device.
+ */
+
+#define SNAP_ENV            "KUTIL_SNAP"
+#define SNAP_MAGIC          0x504e534b /* KSNP */
+#define SNAP_VERSION        1
+#define SNAP_BLOCK_SIZE     0x10000
+#define SNAP_CACHE_BLOCKS   64      /* Decompressed blocks kept by the reader */
+#define SNAP_NO_DATA        UINT64_MAX
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t page_size;     // Granularity of the valid masks, at least block_size / 32
+    uint64_t kbase;
+    uint8_t uuid[16];       // Zero if the kernel has none
+    uint64_t regions;
+    uint64_t blocks;
+    uint64_t table;         // File offset of the region table
+} snap_hdr_t;
+
+typedef struct
+{
+    uint64_t addr;
+    uint64_t size;
+    uint32_t level;         // Depth this was returned for, as passed to kernel_region
+    uint32_t depth;         // Depth it was found at
+    uint64_t block;         // First block, or SNAP_NO_DATA
+    vm_region_submap_info_data_64_t info;
+} snap_region_t;
+
+typedef struct
+{
+    uint64_t off;
+    uint32_t csize;         // 0 if all zeroes, uncompressed size if stored as is
+    uint32_t valid;         // Bit n set if page n could be read
+} snap_block_t;
+
+/*
+ * Writing a snapshot: add each region in the order kernel_region returned
+ * them, and right after a region with data, all of its blocks in order.
+ */
+typedef struct snap_writer snap_writer_t;
+
+/*
+ * Returns NULL on failure, with errno set.
+ */
+snap_writer_t* snap_create(const char *path, vm_address_t kbase, const uint8_t uuid[16], vm_size_t page_size);
+
+/*
+ * Returns 0 on success, -1 on failure.
+ */
+int snap_add_region(snap_writer_t *w, const snap_region_t *region, bool data);
+
+/*
+ * Add the next block of the current region, of SNAP_BLOCK_SIZE bytes or
+ * whatever is left of the region.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int snap_add_block(snap_writer_t *w, const void *data, vm_size_t size, uint32_t valid);
+
+/*
+ * Write the tables and close the file. Frees w either way.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int snap_finish(snap_writer_t *w);
+
+/*
+ * Bytes of region data added and bytes written to the file so far.
+ */
+void snap_written(const snap_writer_t *w, uint64_t *raw, uint64_t *stored);
+
+/*
+ * A backend serving reads and the region map from a snapshot.
+ * Returns NULL on failure.
+ */
+kbackend_t* snap_backend(const char *path);
+
+#endif
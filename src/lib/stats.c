@@ -0,0 +1,211 @@
+/*
+ * stats.c - Counters and latency histograms for kernel access.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint64_t
+#include <stdio.h>              // FILE, fprintf, stderr
+#include <stdlib.h>             // atexit, getenv
+#include <string.h>             // memset, strcmp
+
+#include "timer.h"              // timer_ns
+
+#include "stats.h"
+
+#define ADD(var, val) __atomic_fetch_add(&(var), (val), __ATOMIC_RELAXED)
+#define GET(var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+#define SET(var, val) __atomic_store_n(&(var), (val), __ATOMIC_RELAXED)
+
+static const char *op_names[STAT_MAX] =
+{
+    [STAT_READ]  = "read",
+    [STAT_WRITE] = "write",
+    [STAT_FIND]  = "find",
+    [STAT_BASE]  = "base",
+    [STAT_XFER]  = "xfer",
+    [STAT_AHEAD] = "ahead",
+    [STAT_PHYS]  = "phys",
+};
+
+static stat_t stats[STAT_MAX];
+static uint64_t start_ns;
+static stats_fmt_t exit_fmt = STATS_OFF;
+
+static unsigned int bucket(uint64_t ns)
+{
+    unsigned int b = ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+    return b < STATS_BUCKETS ? b : STATS_BUCKETS - 1;
+}
+
+void stats_record_set(stat_t *set, stat_op_t op, uint64_t start, uint64_t requested, uint64_t done, uint64_t chunks)
+{
+    uint64_t ns = timer_ns() - start;
+    stat_t *s = &set[op];
+    ADD(s->calls, 1);
+    ADD(s->bytes, done);
+    ADD(s->chunks, chunks);
+    ADD(s->ns, ns);
+    ADD(s->hist[bucket(ns)], 1);
+    if(done == 0 && requested != 0)
+    {
+        ADD(s->failures, 1);
+    }
+    else if(done < requested)
+    {
+        ADD(s->shorts, 1);
+    }
+}
+
+void stats_record(stat_op_t op, uint64_t start, uint64_t requested, uint64_t done, uint64_t chunks)
+{
+    stats_record_set(stats, op, start, requested, done, chunks);
+}
+
+void stats_get_set(stat_t *set, stat_op_t op, stat_t *out)
+{
+    stat_t *s = &set[op];
+    out->calls    = GET(s->calls);
+    out->bytes    = GET(s->bytes);
+    out->chunks   = GET(s->chunks);
+    out->failures = GET(s->failures);
+    out->shorts   = GET(s->shorts);
+    out->ns       = GET(s->ns);
+    for(size_t i = 0; i < STATS_BUCKETS; ++i)
+    {
+        out->hist[i] = GET(s->hist[i]);
+    }
+}
+
+void stats_get(stat_op_t op, stat_t *out)
+{
+    stats_get_set(stats, op, out);
+}
+
+void stats_reset_set(stat_t *set)
+{
+    for(size_t op = 0; op < STAT_MAX; ++op)
+    {
+        stat_t *s = &set[op];
+        SET(s->calls, 0);
+        SET(s->bytes, 0);
+        SET(s->chunks, 0);
+        SET(s->failures, 0);
+        SET(s->shorts, 0);
+        SET(s->ns, 0);
+        for(size_t i = 0; i < STATS_BUCKETS; ++i)
+        {
+            SET(s->hist[i], 0);
+        }
+    }
+}
+
+void stats_reset(void)
+{
+    stats_reset_set(stats);
+    start_ns = timer_ns();
+}
+
+// Upper bound of the bucket the p-th percentile falls into
+static uint64_t percentile(const stat_t *s, unsigned int p)
+{
+    uint64_t rank = (s->calls * p + 99) / 100,
+             seen = 0;
+    for(size_t i = 0; i < STATS_BUCKETS; ++i)
+    {
+        seen += s->hist[i];
+        if(seen >= rank && seen > 0)
+        {
+            return 1ULL << i;
+        }
+    }
+    return 0;
+}
+
+void stats_dump(FILE *f, stats_fmt_t fmt)
+{
+    stat_t s[STAT_MAX];
+    for(size_t op = 0; op < STAT_MAX; ++op)
+    {
+        stats_get(op, &s[op]);
+    }
+    uint64_t wall = timer_ns() - start_ns;
+
+    if(fmt == STATS_JSON)
+    {
+        fprintf(f, "{\"wall_ns\": %llu", (unsigned long long)wall);
+        for(size_t op = 0; op < STAT_MAX; ++op)
+        {
+            fprintf(f, ", \"%s\": {\"calls\": %llu, \"bytes\": %llu, \"chunks\": %llu, \"failures\": %llu, \"shorts\": %llu, \"ns\": %llu"
+                       ", \"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"hist\": ["
+                       , op_names[op]
+                       , (unsigned long long)s[op].calls, (unsigned long long)s[op].bytes, (unsigned long long)s[op].chunks
+                       , (unsigned long long)s[op].failures, (unsigned long long)s[op].shorts, (unsigned long long)s[op].ns
+                       , (unsigned long long)percentile(&s[op], 50), (unsigned long long)percentile(&s[op], 90), (unsigned long long)percentile(&s[op], 99));
+            for(size_t i = 0; i < STATS_BUCKETS; ++i)
+            {
+                fprintf(f, "%s%llu", i == 0 ? "" : ", ", (unsigned long long)s[op].hist[i]);
+            }
+            fprintf(f, "]}");
+        }
+        fprintf(f, "}\n");
+    }
+    else if(fmt == STATS_HUMAN)
+    {
+        fprintf(f, "[*] libkutil statistics (%.3f ms wall time)\n"
+                   "    %-6s %10s %14s %10s %8s %8s %12s %10s %10s %10s\n"
+                   , wall / 1e6, "op", "calls", "bytes", "chunks", "fail", "short", "total ms", "p50 us", "p90 us", "p99 us");
+        for(size_t op = 0; op < STAT_MAX; ++op)
+        {
+            if(s[op].calls == 0)
+            {
+                continue;
+            }
+            fprintf(f, "    %-6s %10llu %14llu %10llu %8llu %8llu %12.3f %10.1f %10.1f %10.1f\n"
+                       , op_names[op]
+                       , (unsigned long long)s[op].calls, (unsigned long long)s[op].bytes, (unsigned long long)s[op].chunks
+                       , (unsigned long long)s[op].failures, (unsigned long long)s[op].shorts, s[op].ns / 1e6
+                       , percentile(&s[op], 50) / 1e3, percentile(&s[op], 90) / 1e3, percentile(&s[op], 99) / 1e3);
+        }
+        for(size_t op = 0; op < STAT_MAX; ++op)
+        {
+            if(s[op].calls == 0)
+            {
+                continue;
+            }
+            fprintf(f, "    %s latency:\n", op_names[op]);
+            for(size_t i = 0; i < STATS_BUCKETS; ++i)
+            {
+                if(s[op].hist[i] != 0)
+                {
+                    fprintf(f, "        < %12llu ns: %llu\n", 1ULL << i, (unsigned long long)s[op].hist[i]);
+                }
+            }
+        }
+    }
+}
+
+static void stats_exit(void)
+{
+    stats_dump(stderr, exit_fmt);
+}
+
+void stats_at_exit(stats_fmt_t fmt)
+{
+    if(exit_fmt == STATS_OFF && fmt != STATS_OFF)
+    {
+        exit_fmt = fmt;
+        atexit(&stats_exit);
+    }
+}
+
+__attribute__((constructor)) static void stats_init(void)
+{
+    start_ns = timer_ns();
+    const char *env = getenv(STATS_ENV);
+    if(env != NULL && env[0] != '\0' && strcmp(env, "0") != 0)
+    {
+        stats_at_exit(strcmp(env, "json") == 0 ? STATS_JSON : STATS_HUMAN);
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * stats.h - Counters and latency histograms for kernel access.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>            // bool
+#include <stdint.h>             // uint64_t
+#include <stdio.h>              // FILE
+
+/*
+ * libkutil counts every kernel_read, kernel_write, kernel_find and
+ * get_kernel_base call, as well as every single backend transfer these
+ * are split into. Updates are relaxed atomics, so this is always on and
+ * safe to use from any thread.
+ *
+ * Set KUTIL_STATS=human or KUTIL_STATS=json in the environment (or pass
+ * -S to any tool) to have the statistics printed to stderr at exit.
+ */
+
+#define STATS_ENV       "KUTIL_STATS"
+#define STATS_BUCKETS   40      /* Bucket n holds latencies in [2^(n-1), 2^n) ns */
+
+typedef enum
+{
+    STAT_READ,
+    STAT_WRITE,
+    STAT_FIND,
+    STAT_BASE,
+    STAT_XFER,      // Individual backend transfers
+    STAT_AHEAD,     // Read-ahead of sequential reads
+    STAT_PHYS,      // Physical memory reads, writes and copies
+    STAT_MAX,
+} stat_op_t;
+
+typedef enum
+{
+    STATS_OFF,
+    STATS_HUMAN,
+    STATS_JSON,
+} stats_fmt_t;
+
+typedef struct
+{
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t chunks;
+    uint64_t failures;      // Nothing transferred at all
+    uint64_t shorts;        // Some, but not all bytes transferred
+    uint64_t ns;
+    uint64_t hist[STATS_BUCKETS];
+} stat_t;
+
+/*
+ * Record one operation that took from start (see timer_ns) until now.
+ */
+void stats_record(stat_op_t op, uint64_t start, uint64_t requested, uint64_t done, uint64_t chunks);
+
+/*
+ * Take a consistent-enough copy of the counters of one operation.
+ */
+void stats_get(stat_op_t op, stat_t *out);
+
+void stats_reset(void);
+
+/*
+ * The same for a set of STAT_MAX counters of one's own, like the ones of a
+ * context (see kutil.h). These are never dumped at exit.
+ */
+void stats_record_set(stat_t *set, stat_op_t op, uint64_t start, uint64_t requested, uint64_t done, uint64_t chunks);
+
+void stats_get_set(stat_t *set, stat_op_t op, stat_t *out);
+
+void stats_reset_set(stat_t *set);
+
+void stats_dump(FILE *f, stats_fmt_t fmt);
+
+/*
+ * Dump statistics to stderr at exit. If the environment already asked
+ * for a format, that one wins.
+ */
+void stats_at_exit(stats_fmt_t fmt);
+
+#endif
@@ -0,0 +1,898 @@
+/*
+ * strindex.c - Extract and index C strings of the running kernel.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <pthread.h>            // pthread_create, pthread_join
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+#include <stdlib.h>             // calloc, free, malloc, qsort, realloc
+#include <string.h>             // memcmp, memcpy
+#include <unistd.h>             // sysconf, _SC_NPROCESSORS_ONLN
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <mach-o/loader.h>      // SECTION_TYPE, S_CSTRING_LITERALS
+
+#include "arch.h"               // ADDR, MACH_LC_SEGMENT, mach_*
+#include "cache.h"              // cache_load, cache_store
+#include "debug.h"              // DEBUG
+#include "libkern.h"            // kernel_header, kernel_read
+#include "mach-o.h"             // CMD_ITERATE, LC_FILESET_ENTRY, macho_*
+
+#include "strindex.h"
+
+#define STR_CACHE_KIND      "strings"
+#define STR_CACHE_MAGIC     0x4b535452 /* KSTR */
+#define STR_CACHE_VERSION   1
+
+#define MIN_CHUNK   0x10000     // Not worth a thread below this
+#define MAX_THREADS 64
+#define MAX_SECTIONS 0x1000
+#define BUCKET_LOAD 4           // Average keys per hash bucket
+#define MAX_DISP    0x100000    // Displacements to try per bucket
+#define MAX_SEEDS   8
+
+/*
+ * Cache layout, which is used as is in memory too:
+ *
+ * - str_cache_hdr_t
+ * - uint64_t addrs[naddrs], relative to the kernel base, grouped by string
+ * - str_cache_entry_t entries[count]
+ * - uint32_t disp[nbuckets], displacement of each hash bucket
+ * - uint32_t slots[nslots], entry index + 1, 0 if free
+ * - char pool[poolsize], the strings with NUL terminators
+ *
+ * A string hashes to a bucket, and the bucket's displacement to a slot.
+ * Displacements are chosen so that no two strings share a slot (CHD).
+ */
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    uint64_t naddrs;
+    uint64_t nbuckets;
+    uint64_t nslots;
+    uint64_t poolsize;
+    uint64_t seed;
+} str_cache_hdr_t;
+
+typedef struct
+{
+    uint32_t str;
+    uint32_t len;
+    uint32_t addr;
+    uint32_t naddrs;
+} str_cache_entry_t;
+
+struct str_index
+{
+    vm_address_t base;
+    char *data;
+    size_t size;
+    const str_cache_hdr_t *hdr;
+    const uint64_t *addrs;
+    const str_cache_entry_t *entries;
+    const uint32_t *disp;
+    const uint32_t *slots;
+    const char *pool;
+};
+
+/* ----- Extraction ----- */
+
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+static bool printable(unsigned char c)
+{
+    return (c >= 0x20 && c < 0x7f) || c == '\t' || c == '\n' || c == '\r';
+}
+
+// Whether all 8 bytes are in 0x20..0x7e: the first term flags bytes below
+// 0x20, the second bytes above 0x7e. String sections are mostly exactly
+// that, so this takes care of the bulk of the work.
+static bool word_printable(uint64_t x)
+{
+    return ((((x - ONES * 0x20) & ~x) | ((x + ONES) | x)) & HIGHS) == 0;
+}
+
+// End of the run of printable characters starting at p
+static size_t run_end(const char *buf, size_t p, size_t size)
+{
+    while(p < size)
+    {
+        uint64_t x;
+        if(p + sizeof(x) <= size)
+        {
+            memcpy(&x, &buf[p], sizeof(x));
+            if(word_printable(x))
+            {
+                p += sizeof(x);
+                continue;
+            }
+        }
+        size_t stop = p + sizeof(x) < size ? p + sizeof(x) : size;
+        for(; p < stop; ++p)
+        {
+            if(!printable(buf[p]))
+            {
+                return p;
+            }
+        }
+    }
+    return p;
+}
+
+typedef struct
+{
+    const char *buf;
+    size_t size;
+    size_t start;
+    size_t end;
+    size_t min_len;
+    str_hit_t *hits;
+    size_t count;
+    size_t cap;
+    bool oom;
+} chunk_t;
+
+// Find the strings starting in [start, end). Runs may go on past end.
+static void* extract_chunk(void *arg)
+{
+    chunk_t *c = arg;
+    const char *buf = c->buf;
+    size_t p = c->start;
+    if(p > 0 && printable(buf[p - 1]))
+    {
+        // Belongs to the previous chunk
+        p = run_end(buf, p, c->size);
+    }
+    while(p < c->end)
+    {
+        if(!printable(buf[p]))
+        {
+            uint64_t x;
+            if(buf[p] == '\0' && p + sizeof(x) <= c->end && (memcpy(&x, &buf[p], sizeof(x)), x == 0))
+            {
+                p += sizeof(x);
+            }
+            else
+            {
+                ++p;
+            }
+            continue;
+        }
+        size_t s = p;
+        p = run_end(buf, p, c->size);
+        if(p < c->size && buf[p] == '\0' && p - s >= c->min_len)
+        {
+            if(c->count >= c->cap)
+            {
+                size_t cap = c->cap == 0 ? 0x400 : c->cap * 2;
+                str_hit_t *hits = realloc(c->hits, cap * sizeof(*hits));
+                if(hits == NULL)
+                {
+                    c->oom = true;
+                    return NULL;
+                }
+                c->hits = hits;
+                c->cap = cap;
+            }
+            c->hits[c->count++] = (str_hit_t){ .off = s, .len = p - s };
+        }
+    }
+    return NULL;
+}
+
+str_hit_t* str_extract(const char *buf, size_t size, size_t min_len, unsigned int threads, size_t *count)
+{
+    if(threads == 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = n > 0 ? n : 1;
+    }
+    size_t nchunks = size / MIN_CHUNK;
+    if(nchunks > threads)
+    {
+        nchunks = threads;
+    }
+    if(nchunks > MAX_THREADS)
+    {
+        nchunks = MAX_THREADS;
+    }
+    if(nchunks == 0)
+    {
+        nchunks = 1;
+    }
+    if(min_len == 0)
+    {
+        min_len = 1;
+    }
+
+    chunk_t chunks[MAX_THREADS];
+    pthread_t tids[MAX_THREADS];
+    bool started[MAX_THREADS];
+    for(size_t i = 0; i < nchunks; ++i)
+    {
+        chunks[i] = (chunk_t)
+        {
+            .buf = buf,
+            .size = size,
+            .start = size / nchunks * i,
+            .end = i + 1 == nchunks ? size : size / nchunks * (i + 1),
+            .min_len = min_len,
+        };
+        // The first chunk is done on this thread, and so is any that fails to start
+        started[i] = i > 0 && pthread_create(&tids[i], NULL, &extract_chunk, &chunks[i]) == 0;
+    }
+    extract_chunk(&chunks[0]);
+    size_t total = 0;
+    bool oom = false;
+    for(size_t i = 0; i < nchunks; ++i)
+    {
+        if(i > 0)
+        {
+            if(started[i])
+            {
+                pthread_join(tids[i], NULL);
+            }
+            else
+            {
+                extract_chunk(&chunks[i]);
+            }
+        }
+        total += chunks[i].count;
+        oom |= chunks[i].oom;
+    }
+
+    str_hit_t *hits = oom ? NULL : malloc((total > 0 ? total : 1) * sizeof(*hits));
+    if(hits != NULL)
+    {
+        size_t off = 0;
+        for(size_t i = 0; i < nchunks; ++i)
+        {
+            memcpy(&hits[off], chunks[i].hits, chunks[i].count * sizeof(*hits));
+            off += chunks[i].count;
+        }
+        *count = total;
+    }
+    for(size_t i = 0; i < nchunks; ++i)
+    {
+        free(chunks[i].hits);
+    }
+    return hits;
+}
+
+/* ----- Kernel sections ----- */
+
+typedef struct
+{
+    vm_address_t done[MAX_SECTIONS];
+    size_t ndone;
+    size_t min_len;
+    unsigned int threads;
+    int (*cb)(vm_address_t addr, const char *str, size_t len, void *arg);
+    void *arg;
+} scan_t;
+
+static int scan_header(scan_t *scan, const mach_hdr_t *hdr, vm_address_t slide)
+{
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd != MACH_LC_SEGMENT)
+        {
+            continue;
+        }
+        mach_seg_t *seg = (mach_seg_t*)cmd;
+        mach_sec_t *sec = (mach_sec_t*)(seg + 1);
+        for(size_t i = 0; i < seg->nsects; ++i)
+        {
+            if((sec[i].flags & SECTION_TYPE) != S_CSTRING_LITERALS || sec[i].size == 0)
+            {
+                continue;
+            }
+            vm_address_t addr = sec[i].addr + slide;
+            // Fileset entries and the kernel can both describe the same section
+            bool seen = false;
+            for(size_t j = 0; j < scan->ndone && !seen; ++j)
+            {
+                seen = scan->done[j] == addr;
+            }
+            if(seen || scan->ndone >= MAX_SECTIONS)
+            {
+                continue;
+            }
+            scan->done[scan->ndone++] = addr;
+
+            DEBUG("Scanning %.16s.%.16s at " ADDR, sec[i].segname, sec[i].sectname, addr);
+            char *buf = malloc(sec[i].size);
+            if(buf == NULL)
+            {
+                return -1;
+            }
+            if(kernel_read(addr, sec[i].size, buf) != sec[i].size)
+            {
+                DEBUG("Failed to read %.16s.%.16s, skipping", sec[i].segname, sec[i].sectname);
+                free(buf);
+                continue;
+            }
+            size_t count;
+            str_hit_t *hits = str_extract(buf, sec[i].size, scan->min_len, scan->threads, &count);
+            if(hits == NULL)
+            {
+                free(buf);
+                return -1;
+            }
+            int r = 0;
+            for(size_t k = 0; k < count && r == 0; ++k)
+            {
+                r = scan->cb(addr + hits[k].off, &buf[hits[k].off], hits[k].len, scan->arg);
+            }
+            free(hits);
+            free(buf);
+            if(r != 0)
+            {
+                return r;
+            }
+        }
+    }
+    return 0;
+}
+
+int str_scan_kernel(vm_address_t kbase, size_t min_len, unsigned int threads, int (*cb)(vm_address_t addr, const char *str, size_t len, void *arg), void *arg)
+{
+    mach_hdr_t *hdr = kernel_header(kbase);
+    if(hdr == NULL)
+    {
+        return -1;
+    }
+    scan_t *scan = malloc(sizeof(*scan));
+    if(scan == NULL)
+    {
+        free(hdr);
+        return -1;
+    }
+    scan->ndone = 0;
+    scan->min_len = min_len;
+    scan->threads = threads;
+    scan->cb = cb;
+    scan->arg = arg;
+
+    vm_address_t slide = macho_slide(hdr, kbase);
+    int r = scan_header(scan, hdr, slide);
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(r != 0)
+        {
+            break;
+        }
+        if(cmd->cmd == LC_FILESET_ENTRY)
+        {
+            struct fileset_entry_command *ent = (struct fileset_entry_command*)cmd;
+            vm_address_t addr = ent->vmaddr + slide;
+            mach_hdr_t *sub = kernel_header(addr);
+            if(sub == NULL)
+            {
+                DEBUG("No Mach-O header for fileset entry at " ADDR, addr);
+                continue;
+            }
+            r = scan_header(scan, sub, macho_slide(sub, addr));
+            free(sub);
+        }
+    }
+    free(scan);
+    free(hdr);
+    return r;
+}
+
+/* ----- Index ----- */
+
+static uint64_t mix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t str_hash(const char *str, size_t len, uint64_t seed)
+{
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for(size_t i = 0; i < len; ++i)
+    {
+        h ^= (uint8_t)str[i];
+        h *= 0x100000001b3ULL;
+    }
+    return mix(h);
+}
+
+static size_t slot_of(uint64_t h, uint32_t disp, uint64_t nslots)
+{
+    return mix(h ^ ((disp + 1) * 0x9e3779b97f4a7c15ULL)) % nslots;
+}
+
+// Point the index at the parts of its data, validating everything
+static bool index_layout(str_index_t *idx)
+{
+    const str_cache_hdr_t *hdr = (const str_cache_hdr_t*)idx->data;
+    size_t size = idx->size,
+           off = sizeof(*hdr);
+    if(size < off || hdr->magic != STR_CACHE_MAGIC || hdr->version != STR_CACHE_VERSION)
+    {
+        return false;
+    }
+    // Bound each count before multiplying, so nothing can overflow
+    if(hdr->naddrs > (size - off) / sizeof(uint64_t) || hdr->naddrs > UINT32_MAX)
+    {
+        return false;
+    }
+    idx->addrs = (const uint64_t*)&idx->data[off];
+    off += hdr->naddrs * sizeof(uint64_t);
+    if(hdr->count > (size - off) / sizeof(str_cache_entry_t))
+    {
+        return false;
+    }
+    idx->entries = (const str_cache_entry_t*)&idx->data[off];
+    off += hdr->count * sizeof(str_cache_entry_t);
+    if(hdr->nbuckets == 0 || hdr->nbuckets > (size - off) / sizeof(uint32_t))
+    {
+        return false;
+    }
+    idx->disp = (const uint32_t*)&idx->data[off];
+    off += hdr->nbuckets * sizeof(uint32_t);
+    if(hdr->nslots == 0 || hdr->nslots > (size - off) / sizeof(uint32_t))
+    {
+        return false;
+    }
+    idx->slots = (const uint32_t*)&idx->data[off];
+    off += hdr->nslots * sizeof(uint32_t);
+    if(hdr->poolsize != size - off)
+    {
+        return false;
+    }
+    idx->pool = &idx->data[off];
+    for(size_t i = 0; i < hdr->count; ++i)
+    {
+        const str_cache_entry_t *e = &idx->entries[i];
+        if(e->str >= hdr->poolsize || e->len >= hdr->poolsize - e->str || e->addr > hdr->naddrs || e->naddrs > hdr->naddrs - e->addr)
+        {
+            return false;
+        }
+    }
+    for(size_t i = 0; i < hdr->nslots; ++i)
+    {
+        if(idx->slots[i] > hdr->count)
+        {
+            return false;
+        }
+    }
+    idx->hdr = hdr;
+    return true;
+}
+
+typedef struct
+{
+    uint32_t entry;
+    uint64_t addr;
+} str_rec_t;
+
+typedef struct
+{
+    vm_address_t kbase;
+    // Distinct strings
+    size_t count;
+    size_t cap;
+    str_cache_entry_t *entries;
+    uint64_t *hashes;           // Unseeded, for deduplication only
+    // Open addressing over entries, entry index + 1
+    size_t tcap;
+    uint32_t *table;
+    // Every occurrence
+    size_t nrecs;
+    size_t reccap;
+    str_rec_t *recs;
+    char *pool;
+    size_t poolsize;
+    size_t poolcap;
+} builder_t;
+
+static int builder_rehash(builder_t *b)
+{
+    size_t tcap = b->tcap == 0 ? 0x1000 : b->tcap * 2;
+    uint32_t *table = calloc(tcap, sizeof(*table));
+    if(table == NULL)
+    {
+        return -1;
+    }
+    for(size_t i = 0; i < b->count; ++i)
+    {
+        size_t s = b->hashes[i] & (tcap - 1);
+        while(table[s] != 0)
+        {
+            s = (s + 1) & (tcap - 1);
+        }
+        table[s] = i + 1;
+    }
+    free(b->table);
+    b->table = table;
+    b->tcap = tcap;
+    return 0;
+}
+
+static int builder_add(vm_address_t addr, const char *str, size_t len, void *arg)
+{
+    builder_t *b = arg;
+    if(b->count * 2 >= b->tcap && builder_rehash(b) != 0)
+    {
+        return -1;
+    }
+    uint64_t h = str_hash(str, len, 0);
+    size_t s = h & (b->tcap - 1);
+    for(; b->table[s] != 0; s = (s + 1) & (b->tcap - 1))
+    {
+        str_cache_entry_t *e = &b->entries[b->table[s] - 1];
+        if(b->hashes[b->table[s] - 1] == h && e->len == len && memcmp(&b->pool[e->str], str, len) == 0)
+        {
+            break;
+        }
+    }
+    if(b->table[s] == 0)
+    {
+        if(b->count >= UINT32_MAX - 1 || b->poolsize + len + 1 > UINT32_MAX)
+        {
+            return -1;
+        }
+        if(b->count >= b->cap)
+        {
+            size_t cap = b->cap == 0 ? 0x1000 : b->cap * 2;
+            str_cache_entry_t *entries = realloc(b->entries, cap * sizeof(*entries));
+            if(entries == NULL)
+            {
+                return -1;
+            }
+            b->entries = entries;
+            uint64_t *hashes = realloc(b->hashes, cap * sizeof(*hashes));
+            if(hashes == NULL)
+            {
+                return -1;
+            }
+            b->hashes = hashes;
+            b->cap = cap;
+        }
+        while(b->poolsize + len + 1 > b->poolcap)
+        {
+            size_t cap = b->poolcap == 0 ? 0x10000 : b->poolcap * 2;
+            char *pool = realloc(b->pool, cap);
+            if(pool == NULL)
+            {
+                return -1;
+            }
+            b->pool = pool;
+            b->poolcap = cap;
+        }
+        memcpy(&b->pool[b->poolsize], str, len);
+        b->pool[b->poolsize + len] = '\0';
+        b->entries[b->count] = (str_cache_entry_t){ .str = b->poolsize, .len = len };
+        b->hashes[b->count] = h;
+        b->poolsize += len + 1;
+        b->table[s] = ++b->count;
+    }
+    if(b->nrecs >= b->reccap)
+    {
+        size_t cap = b->reccap == 0 ? 0x1000 : b->reccap * 2;
+        str_rec_t *recs = realloc(b->recs, cap * sizeof(*recs));
+        if(recs == NULL)
+        {
+            return -1;
+        }
+        b->recs = recs;
+        b->reccap = cap;
+    }
+    b->recs[b->nrecs++] = (str_rec_t){ .entry = b->table[s] - 1, .addr = addr - b->kbase };
+    return 0;
+}
+
+static int rec_cmp(const void *a, const void *b)
+{
+    const str_rec_t *x = a,
+                    *y = b;
+    if(x->entry != y->entry)
+    {
+        return x->entry < y->entry ? -1 : 1;
+    }
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+// Find displacements for all buckets, biggest bucket first
+static bool build_hash(const builder_t *b, uint64_t seed, uint64_t nbuckets, uint32_t *disp, uint64_t nslots, uint32_t *slots)
+{
+    bool ok = false;
+    uint64_t *hashes = malloc(b->count * sizeof(*hashes));
+    uint32_t *start = calloc(nbuckets + 1, sizeof(*start)),
+             *members = malloc(b->count * sizeof(*members)),
+             *order = malloc(nbuckets * sizeof(*order)),
+             *fill = calloc(nbuckets, sizeof(*fill));
+    size_t *cand = malloc(b->count * sizeof(*cand));
+    if(hashes == NULL || start == NULL || members == NULL || order == NULL || fill == NULL || cand == NULL)
+    {
+        goto out;
+    }
+    memset(slots, 0, nslots * sizeof(*slots));
+    for(size_t i = 0; i < b->count; ++i)
+    {
+        hashes[i] = str_hash(&b->pool[b->entries[i].str], b->entries[i].len, seed);
+        ++start[hashes[i] % nbuckets + 1];
+    }
+    size_t maxsize = 0;
+    for(size_t i = 0; i < nbuckets; ++i)
+    {
+        if(start[i + 1] > maxsize)
+        {
+            maxsize = start[i + 1];
+        }
+        start[i + 1] += start[i];
+    }
+    for(size_t i = 0; i < b->count; ++i)
+    {
+        size_t k = hashes[i] % nbuckets;
+        members[start[k] + fill[k]++] = i;
+    }
+    // Counting sort by bucket size, descending
+    uint32_t *pos = calloc(maxsize + 2, sizeof(*pos));
+    if(pos == NULL)
+    {
+        goto out;
+    }
+    for(size_t k = 0; k < nbuckets; ++k)
+    {
+        ++pos[maxsize - (start[k + 1] - start[k]) + 1];
+    }
+    for(size_t i = 0; i <= maxsize; ++i)
+    {
+        pos[i + 1] += pos[i];
+    }
+    for(size_t k = 0; k < nbuckets; ++k)
+    {
+        order[pos[maxsize - (start[k + 1] - start[k])]++] = k;
+    }
+    free(pos);
+    // Empty buckets sort last
+    size_t n = nbuckets;
+    while(n > 0 && start[order[n - 1] + 1] == start[order[n - 1]])
+    {
+        --n;
+    }
+    memset(disp, 0, nbuckets * sizeof(*disp));
+    for(size_t o = 0; o < n; ++o)
+    {
+        size_t k = order[o],
+               size = start[k + 1] - start[k];
+        uint32_t d;
+        for(d = 0; d < MAX_DISP; ++d)
+        {
+            size_t m;
+            for(m = 0; m < size; ++m)
+            {
+                cand[m] = slot_of(hashes[members[start[k] + m]], d, nslots);
+                bool clash = slots[cand[m]] != 0;
+                for(size_t j = 0; j < m && !clash; ++j)
+                {
+                    clash = cand[j] == cand[m];
+                }
+                if(clash)
+                {
+                    break;
+                }
+            }
+            if(m == size)
+            {
+                break;
+            }
+        }
+        if(d == MAX_DISP)
+        {
+            DEBUG("No displacement for bucket of size %zu with seed %llu", size, (unsigned long long)seed);
+            goto out;
+        }
+        disp[k] = d;
+        for(size_t m = 0; m < size; ++m)
+        {
+            slots[cand[m]] = members[start[k] + m] + 1;
+        }
+    }
+    ok = true;
+
+out:;
+    free(hashes);
+    free(start);
+    free(members);
+    free(order);
+    free(fill);
+    free(cand);
+    return ok;
+}
+
+static str_index_t* index_build(builder_t *b)
+{
+    qsort(b->recs, b->nrecs, sizeof(*b->recs), &rec_cmp);
+    for(size_t i = 0, k = 0; i < b->count; ++i)
+    {
+        b->entries[i].addr = k;
+        for(; k < b->nrecs && b->recs[k].entry == i; ++k);
+        b->entries[i].naddrs = k - b->entries[i].addr;
+    }
+
+    uint64_t nbuckets = b->count / BUCKET_LOAD + 1,
+             nslots = b->count + b->count / 4 + 1;
+    size_t size = sizeof(str_cache_hdr_t) + b->nrecs * sizeof(uint64_t) + b->count * sizeof(str_cache_entry_t) +
+                  nbuckets * sizeof(uint32_t) + nslots * sizeof(uint32_t) + b->poolsize;
+    str_index_t *idx = calloc(1, sizeof(*idx));
+    if(idx == NULL)
+    {
+        return NULL;
+    }
+    idx->data = malloc(size);
+    if(idx->data == NULL)
+    {
+        free(idx);
+        return NULL;
+    }
+    idx->size = size;
+    idx->base = b->kbase;
+    str_cache_hdr_t *hdr = (str_cache_hdr_t*)idx->data;
+    char *p = (char*)(hdr + 1);
+    uint64_t *addrs = (uint64_t*)p;
+    for(size_t i = 0; i < b->nrecs; ++i)
+    {
+        addrs[i] = b->recs[i].addr;
+    }
+    p += b->nrecs * sizeof(uint64_t);
+    memcpy(p, b->entries, b->count * sizeof(str_cache_entry_t));
+    p += b->count * sizeof(str_cache_entry_t);
+    uint32_t *disp = (uint32_t*)p;
+    p += nbuckets * sizeof(uint32_t);
+    uint32_t *slots = (uint32_t*)p;
+    p += nslots * sizeof(uint32_t);
+    memcpy(p, b->pool, b->poolsize);
+
+    memset(disp, 0, nbuckets * sizeof(*disp));
+    memset(slots, 0, nslots * sizeof(*slots));
+    uint64_t seed;
+    for(seed = 0; seed < MAX_SEEDS && b->count > 0 && !build_hash(b, seed, nbuckets, disp, nslots, slots); ++seed);
+    if(seed == MAX_SEEDS)
+    {
+        str_index_free(idx);
+        return NULL;
+    }
+    *hdr = (str_cache_hdr_t)
+    {
+        .magic = STR_CACHE_MAGIC,
+        .version = STR_CACHE_VERSION,
+        .count = b->count,
+        .naddrs = b->nrecs,
+        .nbuckets = nbuckets,
+        .nslots = nslots,
+        .poolsize = b->poolsize,
+        .seed = seed,
+    };
+    if(!index_layout(idx))
+    {
+        str_index_free(idx);
+        return NULL;
+    }
+    return idx;
+}
+
+// The cached index for the kernel at kbase, if there is one. Sets *have_uuid
+// and uuid for storing one otherwise.
+static str_index_t* index_load(vm_address_t kbase, uint8_t uuid[16], bool *have_uuid)
+{
+    *have_uuid = false;
+    mach_hdr_t *hdr = kernel_header(kbase);
+    if(hdr == NULL)
+    {
+        return NULL;
+    }
+    *have_uuid = macho_uuid(hdr, uuid);
+    free(hdr);
+    if(!*have_uuid)
+    {
+        return NULL;
+    }
+    str_index_t *idx = calloc(1, sizeof(*idx));
+    if(idx == NULL)
+    {
+        return NULL;
+    }
+    idx->base = kbase;
+    idx->data = cache_load(uuid, STR_CACHE_KIND, &idx->size);
+    if(idx->data != NULL && index_layout(idx))
+    {
+        return idx;
+    }
+    if(idx->data != NULL)
+    {
+        DEBUG("Ignoring invalid string cache");
+    }
+    str_index_free(idx);
+    return NULL;
+}
+
+str_index_t* str_index_cached(vm_address_t kbase)
+{
+    uint8_t uuid[16];
+    bool have_uuid;
+    return index_load(kbase, uuid, &have_uuid);
+}
+
+str_index_t* str_index(vm_address_t kbase, unsigned int threads)
+{
+    uint8_t uuid[16];
+    bool have_uuid;
+    str_index_t *idx = index_load(kbase, uuid, &have_uuid);
+    if(idx != NULL)
+    {
+        return idx;
+    }
+
+    builder_t b;
+    memset(&b, 0, sizeof(b));
+    b.kbase = kbase;
+    if(str_scan_kernel(kbase, 1, threads, &builder_add, &b) == 0)
+    {
+        idx = index_build(&b);
+        if(idx != NULL && have_uuid)
+        {
+            cache_store(uuid, STR_CACHE_KIND, idx->data, idx->size);
+        }
+    }
+    free(b.entries);
+    free(b.hashes);
+    free(b.table);
+    free(b.recs);
+    free(b.pool);
+    return idx;
+}
+
+void str_index_free(str_index_t *idx)
+{
+    if(idx != NULL)
+    {
+        free(idx->data);
+        free(idx);
+    }
+}
+
+size_t str_index_count(const str_index_t *idx)
+{
+    return idx->hdr->count;
+}
+
+size_t str_index_lookup(const str_index_t *idx, const char *str, size_t len, vm_address_t *addrs, size_t max)
+{
+    const str_cache_hdr_t *hdr = idx->hdr;
+    if(hdr->count == 0)
+    {
+        return 0;
+    }
+    uint64_t h = str_hash(str, len, hdr->seed);
+    uint32_t slot = idx->slots[slot_of(h, idx->disp[h % hdr->nbuckets], hdr->nslots)];
+    if(slot == 0)
+    {
+        return 0;
+    }
+    // Strings that aren't in the index still land in some slot
+    const str_cache_entry_t *e = &idx->entries[slot - 1];
+    if(e->len != len || memcmp(&idx->pool[e->str], str, len) != 0)
+    {
+        return 0;
+    }
+    for(size_t i = 0; i < e->naddrs && i < max; ++i)
+    {
+        addrs[i] = idx->base + idx->addrs[e->addr + i];
+    }
+    return e->naddrs;
+}
@@ -0,0 +1,74 @@
+/*
+ * strindex.h - Extract and index C strings of the running kernel.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef STRINDEX_H
+#define STRINDEX_H
+
+#include <stddef.h>             // size_t
+
+#include <mach/vm_types.h>      // vm_address_t
+
+/*
+ * A string found by str_extract: printable characters (plus tab, CR and LF)
+ * followed by a NUL, as an offset into the buffer that was searched.
+ */
+typedef struct
+{
+    size_t off;
+    size_t len;             // Without the NUL
+} str_hit_t;
+
+/*
+ * Find all strings of at least min_len characters in buf, using up to
+ * threads threads (0 for one per CPU).
+ *
+ * Returns a malloc'ed array sorted by offset and sets *count,
+ * or returns NULL on failure.
+ */
+str_hit_t* str_extract(const char *buf, size_t size, size_t min_len, unsigned int threads, size_t *count);
+
+/*
+ * Call cb for every string in the C string sections of the kernel at kbase
+ * (including those of fileset entries), in address order per section.
+ * Stops early if cb returns nonzero.
+ *
+ * Returns 0 on success, -1 on failure, or the nonzero value cb returned.
+ */
+int str_scan_kernel(vm_address_t kbase, size_t min_len, unsigned int threads, int (*cb)(vm_address_t addr, const char *str, size_t len, void *arg), void *arg);
+
+typedef struct str_index str_index_t;
+
+/*
+ * Index all strings str_scan_kernel finds, using a perfect hash. The index
+ * is cached on disk per kernel UUID (see cache.h), so once it exists,
+ * lookups need no kernel reads at all.
+ *
+ * Returns NULL on failure.
+ */
+str_index_t* str_index(vm_address_t kbase, unsigned int threads);
+
+/*
+ * Like str_index, but only if the index is already cached: never scans
+ * the kernel. Returns NULL otherwise.
+ */
+str_index_t* str_index_cached(vm_address_t kbase);
+
+void str_index_free(str_index_t *idx);
+
+/*
+ * Number of distinct strings in the index.
+ */
+size_t str_index_count(const str_index_t *idx);
+
+/*
+ * Find every address the string str of length len is at, and store up to
+ * max of them in addrs, in ascending order.
+ *
+ * Returns the total number of addresses, 0 if the string isn't there.
+ */
+size_t str_index_lookup(const str_index_t *idx, const char *str, size_t len, vm_address_t *addrs, size_t max);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * timer.h - Monotonic time source.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>             // uint32_t, uint64_t
+
+#ifdef __APPLE__
+#   include <mach/mach_time.h>  // mach_absolute_time, mach_timebase_info
+#else
+#   include <time.h>            // clock_gettime, CLOCK_MONOTONIC
+#endif
+
+/*
+ * Nanoseconds since some arbitrary, fixed point in time.
+ */
+static inline uint64_t timer_ns(void)
+{
+#ifdef __APPLE__
+    // clock_gettime only exists from iOS 10 and macOS 10.12 on
+    static uint32_t numer, denom;
+    uint32_t d = __atomic_load_n(&denom, __ATOMIC_ACQUIRE),
+             n;
+    if(d != 0)
+    {
+        n = __atomic_load_n(&numer, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        mach_timebase_info_data_t tb;
+        mach_timebase_info(&tb);
+        n = tb.numer;
+        d = tb.denom;
+        __atomic_store_n(&numer, n, __ATOMIC_RELAXED);
+        __atomic_store_n(&denom, d, __ATOMIC_RELEASE);
+    }
+    uint64_t t = mach_absolute_time();
+    return t / d * n + t % d * n / d;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/*
+ * Burn time until ns nanoseconds have passed. Sleeping is far too coarse
+ * for simulating round trips in the microsecond range.
+ */
+static inline void timer_spin(uint64_t ns)
+{
+    if(ns != 0)
+    {
+        uint64_t until = timer_ns() + ns;
+        while(timer_ns() < until);
+    }
+}
+
+#endif
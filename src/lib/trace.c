@@ -0,0 +1,701 @@
+/*
+ * trace.c - Recording and replaying kernel access traces.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <pthread.h>            // pthread_mutex_*
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t, int64_t
+#include <stdio.h>              // FILE, fopen, fwrite, fread, fclose, fprintf, stderr
+#include <stdlib.h>             // atexit, calloc, free, getenv, malloc, realloc
+#include <string.h>             // memcmp, memcpy, strerror
+
+#include <mach/kern_return.h>   // KERN_SUCCESS, KERN_FAILURE, KERN_INVALID_ADDRESS
+#include <mach/mach.h>          // mach_task_self
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <sys/stat.h>           // fstat, struct stat
+
+#include "arch.h"               // ADDR
+#include "backend.h"            // kbackend_t
+#include "debug.h"              // DEBUG
+#include "timer.h"              // timer_ns
+
+#include "trace.h"
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t page_size;
+    uint32_t reserved;
+} trace_hdr_t;
+
+// Length of the data piece at offset off, cut at page boundaries
+static size_t piece_len(vm_address_t addr, size_t off, size_t len)
+{
+    size_t room = TRACE_PAGE_SIZE - ((addr + off) & (TRACE_PAGE_SIZE - 1));
+    return len - off < room ? len - off : room;
+}
+
+// FNV-1a, folded with the length
+static uint64_t piece_hash(const uint8_t *data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL ^ len;
+    for(size_t i = 0; i < len; ++i)
+    {
+        h = (h ^ data[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Length of the data that follows a record
+static size_t data_len(trace_op_t op, vm_size_t result)
+{
+    switch(op)
+    {
+        case TRACE_READ:
+        case TRACE_WRITE:
+            return result;
+        case TRACE_REGION:
+            return result == KERN_SUCCESS ? sizeof(trace_region_t) : 0;
+        default:
+            return 0;
+    }
+}
+
+/********** Recording **********/
+
+typedef struct
+{
+    uint64_t hash;
+    uint32_t id;
+    uint32_t len;   // 0 marks an empty slot
+    uint8_t *data;  // Copy of the content, so that equal hashes can be told apart
+} page_slot_t;
+
+static struct
+{
+    pthread_mutex_t lock;
+    FILE *f;
+    uint64_t t0;
+    uint64_t last_time;
+    vm_address_t last_end;
+    uint32_t next_id;
+    size_t count;
+    size_t cap;     // Power of two
+    page_slot_t *slots;
+} rec = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static volatile bool recording = false;
+
+static void put_varint(uint64_t v)
+{
+    uint8_t buf[10];
+    size_t n = 0;
+    do
+    {
+        buf[n] = v & 0x7f;
+        v >>= 7;
+        if(v != 0)
+        {
+            buf[n] |= 0x80;
+        }
+        ++n;
+    } while(v != 0);
+    fwrite(buf, 1, n, rec.f);
+}
+
+static bool page_grow(void)
+{
+    size_t cap = rec.cap == 0 ? 0x1000 : rec.cap * 2;
+    page_slot_t *slots = calloc(cap, sizeof(*slots));
+    if(slots == NULL)
+    {
+        return false;
+    }
+    for(size_t i = 0; i < rec.cap; ++i)
+    {
+        if(rec.slots[i].len != 0)
+        {
+            size_t j = rec.slots[i].hash & (cap - 1);
+            while(slots[j].len != 0)
+            {
+                j = (j + 1) & (cap - 1);
+            }
+            slots[j] = rec.slots[i];
+        }
+    }
+    free(rec.slots);
+    rec.slots = slots;
+    rec.cap = cap;
+    return true;
+}
+
+static void page_forget(void)
+{
+    for(size_t i = 0; i < rec.cap; ++i)
+    {
+        free(rec.slots[i].data);
+    }
+    free(rec.slots);
+    rec.slots = NULL;
+    rec.cap = rec.count = 0;
+}
+
+// Returns the id of a known page, or assigns a new one and returns -1
+static int64_t page_intern(const uint8_t *data, size_t len, uint32_t *id)
+{
+    *id = rec.next_id;
+    // Without memory to track it, the page just doesn't get deduplicated
+    if(rec.count * 2 >= rec.cap && !page_grow())
+    {
+        ++rec.next_id;
+        return -1;
+    }
+    uint64_t h = piece_hash(data, len);
+    size_t j = h & (rec.cap - 1);
+    for(; rec.slots[j].len != 0; j = (j + 1) & (rec.cap - 1))
+    {
+        if(rec.slots[j].hash == h && rec.slots[j].len == len && memcmp(rec.slots[j].data, data, len) == 0)
+        {
+            return rec.slots[j].id;
+        }
+    }
+    ++rec.next_id;
+    uint8_t *copy = malloc(len);
+    if(copy != NULL)
+    {
+        memcpy(copy, data, len);
+        rec.slots[j].hash = h;
+        rec.slots[j].len = len;
+        rec.slots[j].id = *id;
+        rec.slots[j].data = copy;
+        ++rec.count;
+    }
+    return -1;
+}
+
+int trace_record_start(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if(f == NULL)
+    {
+        DEBUG("Failed to open %s for writing: %s", path, strerror(errno));
+        return -1;
+    }
+    setvbuf(f, NULL, _IOFBF, 0x100000);
+    trace_hdr_t hdr =
+    {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .page_size = TRACE_PAGE_SIZE,
+        .reserved = 0,
+    };
+    if(fwrite(&hdr, sizeof(hdr), 1, f) != 1)
+    {
+        fclose(f);
+        return -1;
+    }
+
+    pthread_mutex_lock(&rec.lock);
+    if(rec.f != NULL)
+    {
+        fclose(rec.f);
+    }
+    page_forget();
+    rec.f = f;
+    rec.t0 = timer_ns();
+    rec.last_time = 0;
+    rec.last_end = 0;
+    rec.next_id = 0;
+    recording = true;
+    pthread_mutex_unlock(&rec.lock);
+    return 0;
+}
+
+void trace_record_stop(void)
+{
+    pthread_mutex_lock(&rec.lock);
+    recording = false;
+    if(rec.f != NULL)
+    {
+        if(fclose(rec.f) != 0)
+        {
+            fprintf(stderr, "[!] Failed to write trace: %s\n", strerror(errno));
+        }
+        rec.f = NULL;
+    }
+    page_forget();
+    pthread_mutex_unlock(&rec.lock);
+}
+
+bool trace_recording(void)
+{
+    return recording;
+}
+
+void trace_record(trace_op_t op, uint64_t start, vm_address_t addr, vm_size_t size, vm_size_t result, const void *data)
+{
+    uint64_t end = timer_ns();
+    pthread_mutex_lock(&rec.lock);
+    if(rec.f == NULL)
+    {
+        pthread_mutex_unlock(&rec.lock);
+        return;
+    }
+    // Concurrent callers can finish out of order, keep time monotonic
+    uint64_t time = start > rec.t0 ? start - rec.t0 : 0;
+    if(time < rec.last_time)
+    {
+        time = rec.last_time;
+    }
+    int64_t delta = (int64_t)(addr - rec.last_end);
+
+    fputc(op, rec.f);
+    put_varint(time - rec.last_time);
+    put_varint(end > start ? end - start : 0);
+    put_varint(((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+    put_varint(size);
+    put_varint(result);
+    rec.last_time = time;
+    rec.last_end = addr + size;
+
+    size_t datalen = data_len(op, result);
+    const uint8_t *d = data;
+    for(size_t off = 0; off < datalen; )
+    {
+        size_t len = piece_len(addr, off, datalen);
+        uint32_t id;
+        int64_t known = page_intern(&d[off], len, &id);
+        if(known >= 0)
+        {
+            put_varint((uint64_t)known << 1);
+        }
+        else
+        {
+            put_varint(((uint64_t)id << 1) | 1);
+            fwrite(&d[off], 1, len, rec.f);
+        }
+        off += len;
+    }
+    pthread_mutex_unlock(&rec.lock);
+}
+
+/********** Reading **********/
+
+typedef struct
+{
+    size_t off;
+    size_t len;
+} trace_page_t;
+
+struct trace
+{
+    size_t count;
+    trace_rec_t *recs;
+    uint8_t *data;
+    size_t pages;
+    size_t filesize;
+};
+
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    bool err;
+} cursor_t;
+
+static uint64_t get_varint(cursor_t *c)
+{
+    uint64_t v = 0;
+    for(unsigned int shift = 0; shift < 64; shift += 7)
+    {
+        if(c->p >= c->end)
+        {
+            break;
+        }
+        uint8_t b = *c->p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if(!(b & 0x80))
+        {
+            return v;
+        }
+    }
+    c->err = true;
+    return 0;
+}
+
+static bool grow(void **ptr, size_t *cap, size_t need, size_t elem)
+{
+    if(need <= *cap)
+    {
+        return true;
+    }
+    size_t n = *cap == 0 ? 0x100 : *cap;
+    while(n < need)
+    {
+        n *= 2;
+    }
+    void *p = realloc(*ptr, n * elem);
+    if(p == NULL)
+    {
+        return false;
+    }
+    *ptr = p;
+    *cap = n;
+    return true;
+}
+
+static uint8_t* read_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if(f == NULL)
+    {
+        DEBUG("Failed to open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+    uint8_t *buf = NULL;
+    struct stat s;
+    if(fstat(fileno(f), &s) == 0 && s.st_size > 0)
+    {
+        buf = malloc(s.st_size);
+        if(buf != NULL && fread(buf, s.st_size, 1, f) != 1)
+        {
+            free(buf);
+            buf = NULL;
+        }
+        *size = s.st_size;
+    }
+    fclose(f);
+    return buf;
+}
+
+trace_t* trace_open(const char *path)
+{
+    size_t filesize = 0;
+    uint8_t *file = read_file(path, &filesize);
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    trace_t *t = NULL;
+    trace_rec_t *recs = NULL;
+    trace_page_t *pages = NULL;
+    size_t *offs = NULL;
+    uint8_t *data = NULL;
+    size_t nrecs = 0, caprecs = 0, capoffs = 0,
+           npages = 0, cappages = 0,
+           ndata = 0, capdata = 0;
+
+    const trace_hdr_t *hdr = (const trace_hdr_t*)file;
+    if(filesize < sizeof(*hdr) || hdr->magic != TRACE_MAGIC || hdr->version != TRACE_VERSION || hdr->page_size != TRACE_PAGE_SIZE)
+    {
+        DEBUG("%s is not a supported trace file", path);
+        goto out;
+    }
+
+    cursor_t c = { .p = file + sizeof(*hdr), .end = file + filesize, .err = false };
+    uint64_t time = 0;
+    vm_address_t last_end = 0;
+    while(c.p < c.end)
+    {
+        trace_op_t op = *c.p++;
+        if(op < TRACE_READ || op > TRACE_REGION)
+        {
+            DEBUG("Bad trace op %u at offset 0x%zx", op, (size_t)(c.p - 1 - file));
+            goto out;
+        }
+        time += get_varint(&c);
+        uint64_t duration = get_varint(&c),
+                 zz = get_varint(&c);
+        vm_address_t addr = last_end + (vm_address_t)((zz >> 1) ^ -(zz & 1));
+        vm_size_t size = get_varint(&c),
+                  result = get_varint(&c);
+        last_end = addr + size;
+        if(c.err || !grow((void**)&recs, &caprecs, nrecs + 1, sizeof(*recs)) || !grow((void**)&offs, &capoffs, nrecs + 1, sizeof(*offs)))
+        {
+            goto out;
+        }
+        size_t len = data_len(op, result);
+        if(len > 0 && !grow((void**)&data, &capdata, ndata + len, 1))
+        {
+            goto out;
+        }
+        for(size_t off = 0; off < len; )
+        {
+            size_t plen = piece_len(addr, off, len);
+            uint64_t ref = get_varint(&c),
+                     id = ref >> 1;
+            if(ref & 1)
+            {
+                if(c.err || id != npages || (size_t)(c.end - c.p) < plen || !grow((void**)&pages, &cappages, npages + 1, sizeof(*pages)))
+                {
+                    goto out;
+                }
+                pages[npages].off = ndata + off;
+                pages[npages].len = plen;
+                ++npages;
+                memcpy(&data[ndata + off], c.p, plen);
+                c.p += plen;
+            }
+            else
+            {
+                if(c.err || id >= npages || pages[id].len != plen)
+                {
+                    goto out;
+                }
+                memcpy(&data[ndata + off], &data[pages[id].off], plen);
+            }
+            off += plen;
+        }
+        recs[nrecs] = (trace_rec_t)
+        {
+            .op = op,
+            .time = time,
+            .duration = duration,
+            .addr = addr,
+            .size = size,
+            .result = result,
+            .data = NULL,
+        };
+        offs[nrecs] = len > 0 ? ndata : SIZE_MAX;
+        ++nrecs;
+        ndata += len;
+    }
+
+    t = malloc(sizeof(*t));
+    if(t == NULL)
+    {
+        goto out;
+    }
+    // data has stopped moving, now turn offsets into pointers
+    for(size_t i = 0; i < nrecs; ++i)
+    {
+        if(offs[i] != SIZE_MAX)
+        {
+            recs[i].data = &data[offs[i]];
+        }
+    }
+    t->count = nrecs;
+    t->recs = recs;
+    t->data = data;
+    t->pages = npages;
+    t->filesize = filesize;
+    recs = NULL;
+    data = NULL;
+
+out:;
+    if(t == NULL)
+    {
+        DEBUG("Failed to load trace %s", path);
+    }
+    free(recs);
+    free(data);
+    free(offs);
+    free(pages);
+    free(file);
+    return t;
+}
+
+void trace_close(trace_t *t)
+{
+    if(t != NULL)
+    {
+        free(t->recs);
+        free(t->data);
+        free(t);
+    }
+}
+
+size_t trace_count(const trace_t *t)
+{
+    return t->count;
+}
+
+const trace_rec_t* trace_get(const trace_t *t, size_t i)
+{
+    return i < t->count ? &t->recs[i] : NULL;
+}
+
+void trace_info(const trace_t *t, size_t *pages, size_t *filesize)
+{
+    *pages = t->pages;
+    *filesize = t->filesize;
+}
+
+/********** Replay **********/
+
+typedef struct
+{
+    kbackend_t be;
+    trace_t *t;
+    size_t cursor;
+    vm_address_t fail_at;   // Where a recorded short transfer stopped
+} replay_t;
+
+static bool match(const trace_rec_t *r, trace_op_t op, vm_address_t addr, vm_size_t size)
+{
+    return r->op == op && (op == TRACE_BASE || (r->addr == addr && r->size == size));
+}
+
+// The next matching record in recording order, wrapping around
+static const trace_rec_t* replay_find(replay_t *rp, trace_op_t op, vm_address_t addr, vm_size_t size)
+{
+    size_t n = rp->t->count;
+    for(size_t k = 0; k < n; ++k)
+    {
+        size_t i = (rp->cursor + k) % n;
+        if(match(&rp->t->recs[i], op, addr, size))
+        {
+            rp->cursor = i + 1;
+            return &rp->t->recs[i];
+        }
+    }
+    return NULL;
+}
+
+// Most recent recorded read covering addr, as of the cursor
+static const trace_rec_t* replay_cover(replay_t *rp, vm_address_t addr)
+{
+    size_t n = rp->t->count;
+    for(size_t k = 1; k <= n; ++k)
+    {
+        const trace_rec_t *r = &rp->t->recs[(rp->cursor + n - k) % n];
+        if(r->op == TRACE_READ && addr >= r->addr && addr - r->addr < r->result)
+        {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+static kern_return_t replay_task(kbackend_t *be, task_t *task)
+{
+    // Nothing that could go wrong, and no real task to hand out
+    *task = mach_task_self();
+    return KERN_SUCCESS;
+}
+
+static vm_address_t replay_base(kbackend_t *be)
+{
+    const trace_rec_t *r = replay_find(be->priv, TRACE_BASE, 0, 0);
+    return r != NULL ? r->result : 0;
+}
+
+static vm_size_t replay_read(kbackend_t *be, vm_address_t addr, vm_size_t size, void *buf)
+{
+    replay_t *rp = be->priv;
+    if(rp->fail_at != 0 && addr == rp->fail_at)
+    {
+        rp->fail_at = 0;
+        return 0;
+    }
+    const trace_rec_t *r = replay_find(rp, TRACE_READ, addr, size);
+    if(r != NULL)
+    {
+        memcpy(buf, r->data, r->result);
+        rp->fail_at = r->result < size ? addr + r->result : 0;
+        return r->result;
+    }
+
+    // Not recorded as such, piece it together from what we've got
+    DEBUG("Read " ADDR "-" ADDR " not in trace", addr, addr + size);
+    vm_size_t done = 0;
+    while(done < size && (r = replay_cover(rp, addr + done)) != NULL)
+    {
+        vm_size_t off = addr + done - r->addr,
+                  len = r->result - off;
+        if(len > size - done)
+        {
+            len = size - done;
+        }
+        memcpy(&((uint8_t*)buf)[done], &r->data[off], len);
+        done += len;
+    }
+    return done;
+}
+
+static vm_size_t replay_write(kbackend_t *be, vm_address_t addr, vm_size_t size, const void *buf)
+{
+    const trace_rec_t *r = replay_find(be->priv, TRACE_WRITE, addr, size);
+    if(r == NULL)
+    {
+        DEBUG("Write " ADDR "-" ADDR " not in trace", addr, addr + size);
+        return 0;
+    }
+    return r->result;
+}
+
+static kern_return_t replay_region(kbackend_t *be, vm_address_t *addr, vm_size_t *size, unsigned int *depth, vm_region_submap_info_data_64_t *info)
+{
+    const trace_rec_t *r = replay_find(be->priv, TRACE_REGION, *addr, *depth);
+    if(r == NULL)
+    {
+        return KERN_INVALID_ADDRESS;
+    }
+    if(r->result == KERN_SUCCESS)
+    {
+        trace_region_t reg;
+        memcpy(&reg, r->data, sizeof(reg));
+        *addr = reg.addr;
+        *size = reg.size;
+        *depth = reg.depth;
+        *info = reg.info;
+    }
+    return r->result;
+}
+
+kbackend_t* trace_replay(const char *path)
+{
+    trace_t *t = trace_open(path);
+    if(t == NULL)
+    {
+        return NULL;
+    }
+    if(t->count == 0)
+    {
+        trace_close(t);
+        return NULL;
+    }
+    replay_t *rp = malloc(sizeof(*rp));
+    if(rp == NULL)
+    {
+        trace_close(t);
+        return NULL;
+    }
+    rp->be = (kbackend_t)
+    {
+        .name = "replay",
+        .task = &replay_task,
+        .base = &replay_base,
+        .read = &replay_read,
+        .write = &replay_write,
+        .region = &replay_region,
+        // Records are whole kernel_read/kernel_write calls
+        .max_xfer = 0,
+        .priv = rp,
+    };
+    rp->t = t;
+    rp->cursor = 0;
+    rp->fail_at = 0;
+    return &rp->be;
+}
+
+// TRACE_REPLAY_ENV is handled along with the other backends in libkern.c
+__attribute__((constructor)) static void trace_init(void)
+{
+    const char *path = getenv(TRACE_RECORD_ENV);
+    if(path != NULL && path[0] != '\0')
+    {
+        if(trace_record_start(path) == 0)
+        {
+            atexit(&trace_record_stop);
+        }
+        else
+        {
+            fprintf(stderr, "[!] Failed to open trace %s: %s\n", path, strerror(errno));
+        }
+    }
+}
@@ -0,0 +1,121 @@
+/*
+ * trace.h - Recording and replaying kernel access traces.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>            // bool
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint8_t, uint64_t
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t
+
+/*
+ * KUTIL_RECORD=file makes any tool write a trace of all its kernel accesses,
+ * KUTIL_REPLAY=file makes it run against a previously recorded trace instead
+ * of the kernel, with no device required.
+ *
+ * Trace format: a header followed by records of the form
+ *
+ *     u8      op
+ *     varint  start time, delta to previous record in ns
+ *     varint  duration in ns
+ *     varint  address, zigzag delta to end of previous record
+ *     varint  requested size
+ *     varint  result (bytes transferred, or the address for TRACE_BASE)
+ *     ...     data
+ *
+ * Data is cut at TRACE_PAGE_SIZE boundaries of the address space, and each
+ * piece is encoded as varint (id << 1 | new), followed by the raw bytes only
+ * if new is set. Pages that were already seen with identical content thus
+ * cost a byte or two. Content is looked up by a 64-bit hash, and compared
+ * in full before a page is reused.
+ */
+
+#define TRACE_RECORD_ENV    "KUTIL_RECORD"
+#define TRACE_REPLAY_ENV    "KUTIL_REPLAY"
+#define TRACE_MAGIC         0x4352544b /* KTRC */
+#define TRACE_VERSION       1
+#define TRACE_PAGE_SIZE     0x1000
+
+typedef enum
+{
+    TRACE_READ = 1,
+    TRACE_WRITE,
+    TRACE_BASE,
+    TRACE_REGION,   // Data is a trace_region_t
+} trace_op_t;
+
+typedef struct
+{
+    uint64_t addr;
+    uint64_t size;
+    uint32_t depth;
+    vm_region_submap_info_data_64_t info;
+} trace_region_t;
+
+typedef struct
+{
+    trace_op_t op;
+    uint64_t time;          // ns since start of recording
+    uint64_t duration;
+    vm_address_t addr;
+    vm_size_t size;
+    vm_size_t result;
+    const uint8_t *data;    // result bytes of data, or NULL
+} trace_rec_t;
+
+/*
+ * Start recording to path. Returns 0 on success.
+ */
+int trace_record_start(const char *path);
+
+/*
+ * Flush and close the trace.
+ */
+void trace_record_stop(void);
+
+/*
+ * Whether a recording is in progress. Cheap enough for hot paths.
+ */
+bool trace_recording(void);
+
+/*
+ * Append a record. start is the timer_ns value from before the operation.
+ * For TRACE_READ and TRACE_WRITE, data holds result bytes. For TRACE_REGION,
+ * size is the depth passed in, result the kern_return_t, and data the
+ * trace_region_t that came out if successful.
+ */
+void trace_record(trace_op_t op, uint64_t start, vm_address_t addr, vm_size_t size, vm_size_t result, const void *data);
+
+/*
+ * Sequential access to a recorded trace. Records and their data stay valid
+ * until trace_close.
+ */
+typedef struct trace trace_t;
+
+trace_t* trace_open(const char *path);
+
+void trace_close(trace_t *t);
+
+size_t trace_count(const trace_t *t);
+
+const trace_rec_t* trace_get(const trace_t *t, size_t i);
+
+/*
+ * Number of distinct data pages and total encoded file size.
+ */
+void trace_info(const trace_t *t, size_t *pages, size_t *filesize);
+
+/*
+ * A backend serving the exact responses recorded in a trace.
+ * Returns NULL on failure.
+ */
+kbackend_t* trace_replay(const char *path);
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * vtop.c - Translate kernel virtual addresses by walking the page tables.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint64_t
+#include <stdlib.h>             // calloc, free, malloc
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "debug.h"              // DEBUG
+#include "libkern.h"            // kernel_has_phys, kernel_read_list, kernel_read_phys, kernel_iov_t
+
+#include "vtop.h"
+
+#define TTE_VALID       0x1ULL
+#define TTE_TABLE       0x2ULL                  /* Page at the last level */
+#define TTE_OA_MASK     0x0000fffffffff000ULL
+
+// Most tables read at once, so that a batch never evicts itself
+#define BATCH_TABLES    (VTOP_CACHE_TABLES / 2)
+
+typedef struct
+{
+    uint64_t pa;
+    bool valid;
+    unsigned int pins;      // Being walked, don't evict
+    uint64_t used;
+    uint64_t *tte;
+} vt_table_t;
+
+struct vtop
+{
+    vtop_cfg_t cfg;
+    bool phys;              // Read tables by physical address
+    unsigned int shift;     // log2(granule)
+    unsigned int bits;      // Index bits per level
+    unsigned int vabits;
+    unsigned int start;     // Level of the root table
+    uint64_t clock;
+    uint64_t reads;
+    uint64_t hits;
+    vt_table_t cache[VTOP_CACHE_TABLES];
+};
+
+typedef struct
+{
+    int (*cb)(const vtop_run_t *run, void *arg);
+    void *arg;
+    bool have;
+    vtop_run_t run;
+} walk_t;
+
+// Lowest VA bit a level's entries translate
+static unsigned int level_shift(const vtop_t *vt, unsigned int level)
+{
+    return vt->shift + (3 - level) * vt->bits;
+}
+
+static size_t level_index(const vtop_t *vt, unsigned int level, vm_address_t va)
+{
+    unsigned int shift = level_shift(vt, level),
+                 bits = level == vt->start ? vt->vabits - shift : vt->bits;
+    return (va >> shift) & ((1ULL << bits) - 1);
+}
+
+static bool block_ok(const vtop_t *vt, unsigned int level)
+{
+    // 4K: 1G and 2M blocks, 16K: 32M blocks only
+    return vt->shift == 12 ? level == 1 || level == 2 : level == 2;
+}
+
+static vt_table_t* cache_find(vtop_t *vt, uint64_t pa)
+{
+    for(size_t i = 0; i < VTOP_CACHE_TABLES; ++i)
+    {
+        if(vt->cache[i].valid && vt->cache[i].pa == pa)
+        {
+            return &vt->cache[i];
+        }
+    }
+    return NULL;
+}
+
+static vt_table_t* cache_victim(vtop_t *vt)
+{
+    vt_table_t *v = NULL;
+    for(size_t i = 0; i < VTOP_CACHE_TABLES; ++i)
+    {
+        vt_table_t *t = &vt->cache[i];
+        if(t->pins > 0)
+        {
+            continue;
+        }
+        if(!t->valid)
+        {
+            return t;
+        }
+        if(v == NULL || t->used < v->used)
+        {
+            v = t;
+        }
+    }
+    return v;
+}
+
+// Read up to BATCH_TABLES tables that aren't cached yet, in one go if possible
+static void fetch(vtop_t *vt, const uint64_t *pas, size_t count)
+{
+    vt_table_t *slots[BATCH_TABLES];
+    kernel_iov_t iov[BATCH_TABLES];
+    size_t n = 0;
+    for(size_t i = 0; i < count && n < BATCH_TABLES; ++i)
+    {
+        if(cache_find(vt, pas[i]) != NULL)
+        {
+            continue;
+        }
+        vt_table_t *t = cache_victim(vt);
+        if(t == NULL)
+        {
+            break;
+        }
+        // Keeps it from being picked twice and from being found half-read
+        t->valid = false;
+        t->pins = 1;
+        slots[n] = t;
+        iov[n] = (kernel_iov_t)
+        {
+            .addr = pas[i] - vt->cfg.phys_base + vt->cfg.virt_base,
+            .size = vt->cfg.granule,
+            .buf = t->tte,
+            .result = 0,
+        };
+        t->pa = pas[i];
+        ++n;
+    }
+    if(n == 0)
+    {
+        return;
+    }
+    DEBUG("Reading %zu page tables", n);
+    if(vt->phys)
+    {
+        for(size_t i = 0; i < n; ++i)
+        {
+            iov[i].result = kernel_read_phys(slots[i]->pa, vt->cfg.granule, slots[i]->tte);
+        }
+    }
+    else
+    {
+        kernel_read_list(iov, n);
+    }
+    for(size_t i = 0; i < n; ++i)
+    {
+        slots[i]->pins = 0;
+        slots[i]->valid = iov[i].result == vt->cfg.granule;
+        slots[i]->used = ++vt->clock;
+        vt->reads += slots[i]->valid;
+    }
+}
+
+static vt_table_t* get_table(vtop_t *vt, uint64_t pa)
+{
+    vt_table_t *t = cache_find(vt, pa);
+    if(t != NULL)
+    {
+        ++vt->hits;
+    }
+    else
+    {
+        fetch(vt, &pa, 1);
+        t = cache_find(vt, pa);
+    }
+    if(t != NULL)
+    {
+        t->used = ++vt->clock;
+    }
+    return t;
+}
+
+// Add a piece to the run being built, handing the run to cb once it ends.
+// last is inclusive, so that the top of the address space works.
+static int emit(walk_t *w, vm_address_t va, vm_address_t last, bool mapped, uint64_t pa)
+{
+    vm_size_t size = last - va + 1;
+    if(w->have && w->run.mapped == mapped && w->run.va + w->run.size == va && (!mapped || w->run.pa + w->run.size == pa))
+    {
+        w->run.size += size;
+        return 0;
+    }
+    int ret = w->have ? w->cb(&w->run, w->arg) : 0;
+    w->run = (vtop_run_t)
+    {
+        .va = va,
+        .pa = mapped ? pa : 0,
+        .size = size,
+        .mapped = mapped,
+    };
+    w->have = true;
+    return ret;
+}
+
+static int walk(vtop_t *vt, walk_t *w, unsigned int level, uint64_t table, vm_address_t start, vm_address_t last)
+{
+    vt_table_t *t = get_table(vt, table);
+    if(t == NULL)
+    {
+        DEBUG("Failed to read page table at 0x%llx", (unsigned long long)table);
+        return emit(w, start, last, false, 0);
+    }
+    ++t->pins;
+    int ret = 0;
+    unsigned int shift = level_shift(vt, level);
+    vm_size_t span = (vm_size_t)1 << shift;
+    uint64_t oa_page = TTE_OA_MASK & ~(uint64_t)(vt->cfg.granule - 1),
+             oa_block = TTE_OA_MASK & ~(uint64_t)(span - 1);
+    size_t i0 = level_index(vt, level, start),
+           i1 = level_index(vt, level, last);
+    vm_address_t base = start & ~(span - 1);
+    for(size_t i = i0; i <= i1 && ret == 0; ++i)
+    {
+        vm_address_t ebase = base + (i - i0) * span,
+                     s = start > ebase ? start : ebase,
+                     l = last < ebase + (span - 1) ? last : ebase + (span - 1);
+        uint64_t tte = t->tte[i];
+        if(!(tte & TTE_VALID))
+        {
+            ret = emit(w, s, l, false, 0);
+        }
+        else if(level == 3)
+        {
+            ret = emit(w, s, l, (tte & TTE_TABLE) != 0, (tte & oa_page) + (s - ebase));
+        }
+        else if(tte & TTE_TABLE)
+        {
+            // Get this table and the next few in one batch
+            if(cache_find(vt, tte & oa_page) == NULL)
+            {
+                uint64_t pas[BATCH_TABLES];
+                size_t n = 0;
+                for(size_t j = i; j <= i1 && n < BATCH_TABLES; ++j)
+                {
+                    if((t->tte[j] & (TTE_VALID | TTE_TABLE)) == (TTE_VALID | TTE_TABLE))
+                    {
+                        pas[n++] = t->tte[j] & oa_page;
+                    }
+                }
+                fetch(vt, pas, n);
+            }
+            ret = walk(vt, w, level + 1, tte & oa_page, s, l);
+        }
+        else
+        {
+            ret = emit(w, s, l, block_ok(vt, level), (tte & oa_block) + (s - ebase));
+        }
+    }
+    --t->pins;
+    return ret;
+}
+
+vtop_t* vtop_create(const vtop_cfg_t *cfg)
+{
+    unsigned int t1sz = cfg->t1sz != 0 ? cfg->t1sz : VTOP_DEFAULT_T1SZ;
+    if((cfg->granule != 0x1000 && cfg->granule != 0x4000) || t1sz < 16 || t1sz > 39 || (cfg->root & (cfg->granule - 1)) != 0)
+    {
+        return NULL;
+    }
+    bool phys = kernel_has_phys();
+    if(!phys && cfg->virt_base == 0)
+    {
+        // Nothing to read the tables through
+        return NULL;
+    }
+    vtop_t *vt = calloc(1, sizeof(*vt));
+    if(vt == NULL)
+    {
+        return NULL;
+    }
+    vt->cfg = *cfg;
+    vt->cfg.t1sz = t1sz;
+    vt->phys = phys;
+    vt->shift = cfg->granule == 0x1000 ? 12 : 14;
+    vt->bits = vt->shift - 3;
+    vt->vabits = 64 - t1sz;
+    vt->start = 3 - (vt->vabits - vt->shift - 1) / vt->bits;
+    for(size_t i = 0; i < VTOP_CACHE_TABLES; ++i)
+    {
+        vt->cache[i].tte = malloc(cfg->granule);
+        if(vt->cache[i].tte == NULL)
+        {
+            vtop_free(vt);
+            return NULL;
+        }
+    }
+    return vt;
+}
+
+void vtop_free(vtop_t *vt)
+{
+    if(vt != NULL)
+    {
+        for(size_t i = 0; i < VTOP_CACHE_TABLES; ++i)
+        {
+            free(vt->cache[i].tte);
+        }
+        free(vt);
+    }
+}
+
+int vtop_walk(vtop_t *vt, vm_address_t va, vm_size_t size, int (*cb)(const vtop_run_t *run, void *arg), void *arg)
+{
+    if(size == 0)
+    {
+        return 0;
+    }
+    vm_address_t last = va + (size - 1);
+    // TTBR1 only covers the top of the address space
+    if(last < va || (va >> vt->vabits) != (~(vm_address_t)0 >> vt->vabits))
+    {
+        return -1;
+    }
+    walk_t w =
+    {
+        .cb = cb,
+        .arg = arg,
+        .have = false,
+    };
+    int ret = walk(vt, &w, vt->start, vt->cfg.root, va, last);
+    if(ret == 0 && w.have)
+    {
+        ret = cb(&w.run, arg);
+    }
+    return ret;
+}
+
+static int translate_cb(const vtop_run_t *run, void *arg)
+{
+    *(vtop_run_t*)arg = *run;
+    return 0;
+}
+
+bool vtop_translate(vtop_t *vt, vm_address_t va, uint64_t *pa)
+{
+    vtop_run_t run;
+    if(vtop_walk(vt, va, 1, &translate_cb, &run) != 0 || !run.mapped)
+    {
+        return false;
+    }
+    *pa = run.pa;
+    return true;
+}
+
+void vtop_counts(const vtop_t *vt, uint64_t *reads, uint64_t *hits)
+{
+    *reads = vt->reads;
+    *hits = vt->hits;
+}
@@ -0,0 +1,81 @@
+/*
+ * vtop.h - Translate kernel virtual addresses by walking the page tables.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef VTOP_H
+#define VTOP_H
+
+#include <stdbool.h>            // bool
+#include <stddef.h>             // size_t
+#include <stdint.h>             // uint64_t
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+/*
+ * The walker follows the ARM64 stage 1 tables TTBR1_EL1 points to, with 4K
+ * or 16K granules, and understands block mappings.
+ *
+ * Whole table pages are read and kept in a small cache, so that upper
+ * levels cost nothing after the first walk, and a range walk reads all
+ * the next-level tables it is going to need in one batch. Translating
+ * a range of several MB thus takes a handful of reads.
+ *
+ * Tables are read by physical address if the backend can do that
+ * (kernel_has_phys), or otherwise through the kernel's physmap, i.e. at
+ * paddr - phys_base + virt_base (gPhysBase and gVirtBase).
+ */
+
+#define VTOP_DEFAULT_T1SZ   25      /* 39-bit kernel address space */
+#define VTOP_CACHE_TABLES   64
+
+typedef struct
+{
+    uint64_t root;          // Physical address of the level 0/1 table (TTBR1 BADDR)
+    vm_size_t granule;      // 0x1000 or 0x4000
+    unsigned int t1sz;      // 0 for VTOP_DEFAULT_T1SZ
+    vm_address_t virt_base; // Physmap, only needed without physical access
+    uint64_t phys_base;
+} vtop_cfg_t;
+
+typedef struct
+{
+    vm_address_t va;
+    uint64_t pa;            // Undefined if not mapped
+    vm_size_t size;
+    bool mapped;
+} vtop_run_t;
+
+typedef struct vtop vtop_t;
+
+/*
+ * Returns NULL on failure (bad configuration, or out of memory).
+ */
+vtop_t* vtop_create(const vtop_cfg_t *cfg);
+
+void vtop_free(vtop_t *vt);
+
+/*
+ * Translate a single address.
+ *
+ * Returns true and sets *pa if it is mapped.
+ */
+bool vtop_translate(vtop_t *vt, vm_address_t va, uint64_t *pa);
+
+/*
+ * Call cb for the range va to va + size in address order, with runs that
+ * are contiguous both virtually and physically merged into one. Unmapped
+ * parts, and parts whose tables couldn't be read, come as runs with mapped
+ * set to false. Stops early if cb returns nonzero.
+ *
+ * Returns 0 on success, -1 on failure, or the nonzero value cb returned.
+ */
+int vtop_walk(vtop_t *vt, vm_address_t va, vm_size_t size, int (*cb)(const vtop_run_t *run, void *arg), void *arg);
+
+/*
+ * Table pages read from the kernel, and table lookups served from the cache.
+ */
+void vtop_counts(const vtop_t *vt, uint64_t *reads, uint64_t *hits);
+
+#endif
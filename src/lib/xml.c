@@ -0,0 +1,180 @@
+/*
+ * xml.c - Minimal streaming XML tokenizer.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // bool, true, false
+#include <stddef.h>             // size_t
+#include <string.h>             // memchr, memcmp, strlen
+
+#include "xml.h"
+
+#define IS_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+void xml_init(xml_t *x, const char *buf, size_t len)
+{
+    x->cur = buf;
+    x->end = buf + len;
+}
+
+static const char* xml_find(const char *from, const char *end, const char *needle)
+{
+    size_t n = strlen(needle);
+    for(const char *p = from; p + n <= end; ++p)
+    {
+        p = memchr(p, needle[0], end - p);
+        if(p == NULL || p + n > end)
+        {
+            break;
+        }
+        if(memcmp(p, needle, n) == 0)
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+xml_type_t xml_next(xml_t *x, xml_tok_t *tok)
+{
+    while(x->cur < x->end)
+    {
+        const char *p = x->cur;
+        if(*p != '<')
+        {
+            const char *lt = memchr(p, '<', x->end - p);
+            if(lt == NULL)
+            {
+                lt = x->end;
+            }
+            x->cur = lt;
+            // Kernel plists are mostly free of whitespace, but don't count on it
+            bool blank = true;
+            for(const char *q = p; q < lt; ++q)
+            {
+                if(!IS_SPACE(*q) && *q != '\0')
+                {
+                    blank = false;
+                    break;
+                }
+            }
+            if(blank)
+            {
+                continue;
+            }
+            tok->type = XML_TEXT;
+            tok->str = p;
+            tok->len = lt - p;
+            tok->attr = NULL;
+            tok->attrlen = 0;
+            return XML_TEXT;
+        }
+
+        const char *gt;
+        if(p + 4 <= x->end && memcmp(p, "<!--", 4) == 0)
+        {
+            gt = xml_find(p + 4, x->end, "-->");
+            if(gt == NULL)
+            {
+                break;
+            }
+            x->cur = gt + 3;
+            continue;
+        }
+        gt = memchr(p, '>', x->end - p);
+        if(gt == NULL)
+        {
+            break;
+        }
+        x->cur = gt + 1;
+        if(p[1] == '?' || p[1] == '!')
+        {
+            continue;
+        }
+
+        const char *name = p + 1,
+                   *last = gt;
+        tok->type = XML_OPEN;
+        if(*name == '/')
+        {
+            tok->type = XML_CLOSE;
+            ++name;
+        }
+        else if(last[-1] == '/')
+        {
+            tok->type = XML_EMPTY;
+            --last;
+        }
+        const char *e = name;
+        while(e < last && !IS_SPACE(*e))
+        {
+            ++e;
+        }
+        if(e == name)
+        {
+            break;
+        }
+        tok->str = name;
+        tok->len = e - name;
+        tok->attr = e;
+        tok->attrlen = last - e;
+        return tok->type;
+    }
+    if(x->cur < x->end)
+    {
+        tok->type = XML_ERROR;
+        return XML_ERROR;
+    }
+    tok->type = XML_END;
+    return XML_END;
+}
+
+bool xml_is(const xml_tok_t *tok, const char *name)
+{
+    size_t len = strlen(name);
+    return tok->len == len && memcmp(tok->str, name, len) == 0;
+}
+
+bool xml_attr(const xml_tok_t *tok, const char *name, const char **val, size_t *len)
+{
+    size_t n = strlen(name);
+    const char *p   = tok->attr,
+               *end = tok->attr + tok->attrlen;
+    while(p < end)
+    {
+        while(p < end && IS_SPACE(*p))
+        {
+            ++p;
+        }
+        const char *key = p;
+        while(p < end && *p != '=' && !IS_SPACE(*p))
+        {
+            ++p;
+        }
+        size_t keylen = p - key;
+        while(p < end && (IS_SPACE(*p) || *p == '='))
+        {
+            ++p;
+        }
+        if(p >= end || (*p != '"' && *p != '\''))
+        {
+            return false;
+        }
+        char quote = *p++;
+        const char *v = p;
+        p = memchr(p, quote, end - p);
+        if(p == NULL)
+        {
+            return false;
+        }
+        if(keylen == n && memcmp(key, name, n) == 0)
+        {
+            *val = v;
+            *len = p - v;
+            return true;
+        }
+        ++p;
+    }
+    return false;
+}
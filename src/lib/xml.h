@@ -0,0 +1,62 @@
+/*
+ * xml.h - Minimal streaming XML tokenizer.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef XML_H
+#define XML_H
+
+#include <stdbool.h>            // bool
+#include <stddef.h>             // size_t
+
+/*
+ * This is just enough XML to walk property lists as the kernel emits them.
+ * Tokens point into the input buffer, nothing is allocated or copied, and
+ * entities are not decoded.
+ */
+
+typedef enum
+{
+    XML_END = 0,    // End of input
+    XML_ERROR,      // Malformed input
+    XML_OPEN,       // <name attr="...">
+    XML_CLOSE,      // </name>
+    XML_EMPTY,      // <name attr="..."/>
+    XML_TEXT,       // Character data between tags
+} xml_type_t;
+
+typedef struct
+{
+    xml_type_t type;
+    const char *str;    // Tag name or text
+    size_t len;
+    const char *attr;   // Raw attribute string of open/empty tags
+    size_t attrlen;
+} xml_tok_t;
+
+typedef struct
+{
+    const char *cur;
+    const char *end;
+} xml_t;
+
+void xml_init(xml_t *x, const char *buf, size_t len);
+
+/*
+ * Advance to the next token. Comments, processing instructions, doctype
+ * declarations and whitespace-only text are skipped.
+ */
+xml_type_t xml_next(xml_t *x, xml_tok_t *tok);
+
+/*
+ * Compare the name of a tag token.
+ */
+bool xml_is(const xml_tok_t *tok, const char *name);
+
+/*
+ * Look up an attribute value of an open/empty tag token.
+ */
+bool xml_attr(const xml_tok_t *tok, const char *name, const char **val, size_t *len);
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * guard.c - Rejecting accesses outside the region map.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdint.h>             // uint8_t, uint64_t
+#include <string.h>             // memset
+#include <unistd.h>             // usleep
+
+#include <mach/vm_prot.h>       // VM_PROT_*
+#include <mach/vm_types.h>      // vm_address_t
+
+#include "guard.h"              // GUARD_REFRESH_MS
+#include "kutil.h"              // kutil_*
+#include "sim.h"                // sim_*, SIM_IMAGE_BASE
+
+#include "test.h"
+
+#define PAGE    0x4000
+#define RW      0xffffffe000000000ULL   /* Two pages, then a gap */
+#define RO      0xffffffe000100000ULL
+#define LATE    0xffffffe000200000ULL   /* Mapped once the guard has its map */
+
+static int test_reject(void)
+{
+    kbackend_t *be = sim_create(SIM_IMAGE_BASE, 0, 0);
+    CHECK(be != NULL);
+    CHECK(sim_map(be, RW, 2 * PAGE, VM_PROT_READ | VM_PROT_WRITE, 0, NULL) != NULL);
+    CHECK(sim_map(be, RO, PAGE, VM_PROT_READ, 0, NULL) != NULL);
+    kutil_ctx_t *ctx = kutil_ctx_create(be, KUTIL_CTX_GUARD);
+    CHECK(ctx != NULL);
+
+    static uint8_t buf[4 * PAGE];
+    memset(buf, 0x41, sizeof(buf));
+    CHECK(kutil_read(ctx, RW, 2 * PAGE, buf) == 2 * PAGE);
+
+    // Neither of these may reach the backend
+    uint64_t calls = sim_calls(be);
+    CHECK(kutil_read(ctx, RW + 2 * PAGE, 8, buf) == 0);
+    CHECK(kutil_write(ctx, RO, 8, buf) == 0);
+    CHECK(kutil_read(ctx, 0x4141414141414141ULL, 8, buf) == 0);
+    CHECK(sim_calls(be) == calls);
+
+    // Only the mapped part of a range that runs off the end
+    CHECK(kutil_read(ctx, RW + PAGE, 2 * PAGE, buf) == PAGE);
+    CHECK(kutil_write(ctx, RW + 2 * PAGE - 4, 8, buf) == 4);
+    CHECK(kutil_read(ctx, RO, 8, buf) == 8);
+
+    // Without the guard, the backend has to find out for itself
+    CHECK(kutil_set_guard(ctx, false) == 0);
+    calls = sim_calls(be);
+    CHECK(kutil_read(ctx, RW + 2 * PAGE, 8, buf) == 0);
+    CHECK(sim_calls(be) > calls);
+
+    // A region that appears later is found once the map may be reloaded
+    CHECK(kutil_set_guard(ctx, true) == 0);
+    CHECK(sim_map(be, LATE, PAGE, VM_PROT_READ, 0, NULL) != NULL);
+    CHECK(kutil_read(ctx, LATE, 8, buf) == 0);
+    usleep((GUARD_REFRESH_MS + 100) * 1000);
+    CHECK(kutil_read(ctx, LATE, 8, buf) == 8);
+
+    kutil_ctx_destroy(ctx);
+    sim_destroy(be);
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+    RUN(fails, test_reject);
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/*
+ * kio.c - Asynchronous reads and their completion queue.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // true, false
+#include <stdint.h>             // uint8_t
+#include <string.h>             // memcmp, memset
+
+#include <mach/vm_prot.h>       // VM_PROT_*
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t, kernel_set_backend
+#include "kio.h"                // kio_*
+#include "sim.h"                // sim_*, SIM_IMAGE_BASE
+
+#include "test.h"
+
+#define REGION  0xffffffe000000000ULL
+#define LENGTH  0x40000
+#define XFER    0x1000
+#define SMALL   16
+
+static uint8_t data[LENGTH];
+
+// A whole region's worth of transfers takes a lot longer than a single one
+static kbackend_t* setup(void)
+{
+    for(size_t i = 0; i < LENGTH; ++i)
+    {
+        data[i] = (uint8_t)(i * 7 + i / 251);
+    }
+    kbackend_t *be = sim_create(SIM_IMAGE_BASE, 200000, XFER);
+    if(be == NULL)
+    {
+        return NULL;
+    }
+    if(sim_map(be, REGION, LENGTH, VM_PROT_READ | VM_PROT_WRITE, 0, data) == NULL)
+    {
+        sim_destroy(be);
+        return NULL;
+    }
+    kernel_set_backend(be);
+    return be;
+}
+
+static void teardown(kbackend_t *be)
+{
+    kernel_set_backend(NULL);
+    sim_destroy(be);
+}
+
+// Finished requests come out in the order they finished, not submitted
+static int test_reap(void)
+{
+    kbackend_t *be = setup();
+    CHECK(be != NULL);
+    kio_t *kio = kio_create(2);
+    CHECK(kio != NULL);
+    static uint8_t big[LENGTH], small[SMALL];
+    int tag[2];
+    CHECK(kio_submit(kio, KIO_READ, REGION, LENGTH, big, &tag[0]) != NULL);
+    CHECK(kio_submit(kio, KIO_READ, REGION + 0x100, SMALL, small, &tag[1]) != NULL);
+    CHECK(kio_pending(kio) == 2);
+    kio_req_t *req = kio_reap(kio, true);
+    CHECK(req != NULL && req->user == &tag[1] && req->result == SMALL);
+    CHECK(memcmp(small, &data[0x100], SMALL) == 0);
+    kio_release(req);
+    req = kio_reap(kio, true);
+    CHECK(req != NULL && req->user == &tag[0] && req->result == LENGTH);
+    CHECK(memcmp(big, data, LENGTH) == 0);
+    kio_release(req);
+    // Nothing outstanding, so nothing to wait for
+    CHECK(kio_pending(kio) == 0);
+    CHECK(kio_reap(kio, true) == NULL);
+    kio_destroy(kio);
+    teardown(be);
+    return 0;
+}
+
+// A backend that can't take concurrent calls gets a single worker, which
+// does everything in the order it was submitted. Waiting on the last
+// request therefore means all the others are done already.
+static int test_serial(void)
+{
+    kbackend_t *be = setup();
+    CHECK(be != NULL);
+    sim_set_faults(be, 1000, 0, 0, 1);
+    CHECK(!be->concurrent);
+    kio_t *kio = kio_create(8);
+    CHECK(kio != NULL);
+    static uint8_t big[LENGTH], small[4][SMALL];
+    kio_req_t *reqs[5];
+    CHECK((reqs[0] = kio_submit(kio, KIO_READ, REGION, LENGTH, big, NULL)) != NULL);
+    for(size_t i = 0; i < 4; ++i)
+    {
+        CHECK((reqs[i + 1] = kio_submit(kio, KIO_READ, REGION + i * XFER, SMALL, small[i], NULL)) != NULL);
+    }
+    CHECK(kio_wait(reqs[4]) == SMALL);
+    kio_release(reqs[4]);
+    CHECK(kio_pending(kio) == 4);
+    // Already done, so kio_wait returns right away, and kio_reap doesn't
+    // hand it out a second time
+    CHECK(kio_wait(reqs[2]) == SMALL);
+    CHECK(memcmp(small[1], &data[XFER], SMALL) == 0);
+    kio_release(reqs[2]);
+    kio_req_t *req = kio_reap(kio, false);
+    CHECK(req == reqs[0] && req->result == LENGTH);
+    CHECK(memcmp(big, data, LENGTH) == 0);
+    kio_release(req);
+    CHECK(kio_reap(kio, false) == reqs[1]);
+    kio_release(reqs[1]);
+    CHECK(kio_reap(kio, false) == reqs[3]);
+    kio_release(reqs[3]);
+    CHECK(kio_reap(kio, false) == NULL);
+    kio_destroy(kio);
+    teardown(be);
+    return 0;
+}
+
+// Destroying waits for whatever is still queued and frees what was never
+// reaped (which ASan or valgrind would notice otherwise)
+static int test_destroy(void)
+{
+    kbackend_t *be = setup();
+    CHECK(be != NULL);
+    kio_t *kio = kio_create(0);
+    CHECK(kio != NULL);
+    static uint8_t buf[LENGTH / XFER][XFER];
+    memset(buf, 0, sizeof(buf));
+    for(size_t i = 0; i < LENGTH / XFER; ++i)
+    {
+        CHECK(kio_submit(kio, KIO_READ, REGION + i * XFER, XFER, buf[i], NULL) != NULL);
+    }
+    kio_req_t *req = kio_reap(kio, true);
+    CHECK(req != NULL);
+    kio_release(req);
+    kio_destroy(kio);
+    CHECK(memcmp(buf, data, LENGTH) == 0);
+    teardown(be);
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+    RUN(fails, test_reap);
+    RUN(fails, test_serial);
+    RUN(fails, test_destroy);
+    return fails == 0 ? 0 : 1;
+}
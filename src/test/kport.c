@@ -0,0 +1,526 @@
+/*
+ * kport.c - Porting addresses between two synthetic kernelcaches.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <fcntl.h>              // open, O_*
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+#include <stdio.h>              // FILE, fclose, fflush, fgets, fopen, fprintf, fwrite, snprintf, sscanf, stderr, stdout
+#include <stdlib.h>             // calloc, free, malloc, realloc
+#include <string.h>             // memcpy, memset, strcmp, strlen
+#include <unistd.h>             // close, dup, dup2, unlink
+
+#include <mach/vm_prot.h>       // VM_PROT_*
+#include <mach-o/loader.h>      // struct mach_header_64, struct segment_command_64, ...
+#include <mach-o/nlist.h>       // struct nlist_64, N_EXT, N_SECT
+
+#include "test.h"
+
+// Linked in with its main renamed (see Makefile)
+int kport_main(int argc, const char **argv);
+
+/*
+ * Two builds of the same made-up kernel, like genuinely different releases:
+ * the new one drops a few functions, moves others around, renames registers
+ * in all of them, adds an instruction to some, and reorders strings and
+ * globals. Functions reference strings (adrp/add), globals (adrp/ldr) and
+ * each other (bl), and some have symbols.
+ */
+
+#define BASE        0xfffffff007004000ULL
+#define NFUNCS      2000
+#define NSTRS       (NFUNCS / 2)
+#define NGLOBS      (NFUNCS / 4)
+#define NADDRS      300
+#define ROUND(x)    (((x) + 0x3fff) & ~(uint64_t)0x3fff)
+
+enum { OP_STR, OP_GLOB, OP_CALL, OP_LOAD, OP_ALU };
+
+typedef struct
+{
+    uint8_t kind;
+    uint32_t a, b, c, d;
+} op_t;
+
+typedef struct
+{
+    op_t *ops;
+    size_t nops;
+    bool named;
+} func_t;
+
+typedef struct
+{
+    size_t *order;          // Functions in layout order
+    size_t norder;
+    size_t *strorder;
+    size_t *globorder;
+    uint8_t (*regs)[32];    // Register renaming of each function
+    bool *modified;         // Has an extra instruction at the start
+    uint64_t faddr[NFUNCS]; // 0 if not in this build
+    uint64_t saddr[NSTRS];
+    uint64_t gaddr[NGLOBS];
+} build_t;
+
+static const uint8_t pool[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 19, 20, 21, 22, 23 };
+static func_t funcs[NFUNCS];
+static char strs[NSTRS][48];
+static uint64_t rng = 1;
+
+static uint64_t rnd(uint64_t n)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng % n;
+}
+
+static void shuffle(size_t *a, size_t n)
+{
+    for(size_t i = n; i > 1; --i)
+    {
+        size_t j = rnd(i), t = a[i - 1];
+        a[i - 1] = a[j];
+        a[j] = t;
+    }
+}
+
+static uint32_t reg(void)
+{
+    return pool[rnd(sizeof(pool))];
+}
+
+static int make_funcs(void)
+{
+    for(size_t i = 0; i < NSTRS; ++i)
+    {
+        size_t n = 1 + rnd(30);
+        snprintf(strs[i], sizeof(strs[i]), "str_%zu_", i);
+        memset(&strs[i][strlen(strs[i])], 'x', n);
+    }
+    for(size_t i = 0; i < NFUNCS; ++i)
+    {
+        func_t *f = &funcs[i];
+        f->nops = 3 + rnd(200);
+        f->ops = malloc(f->nops * sizeof(*f->ops));
+        if(f->ops == NULL)
+        {
+            return -1;
+        }
+        for(size_t j = 0; j < f->nops; ++j)
+        {
+            uint64_t k = rnd(100);
+            static const uint32_t alu[] = { 0x8b000000, 0xcb000000, 0xaa000000, 0x8a000000 };
+            f->ops[j] = k <  8 ? (op_t){ OP_STR,  rnd(NSTRS), reg(), 0, 0 }
+                      : k < 14 ? (op_t){ OP_GLOB, rnd(NGLOBS), reg(), reg(), 0 }
+                      : k < 22 ? (op_t){ OP_CALL, rnd(NFUNCS), 0, 0, 0 }
+                      : k < 40 ? (op_t){ OP_LOAD, reg(), 24 + rnd(5), rnd(64), 0 }
+                      :          (op_t){ OP_ALU,  alu[rnd(4)], reg(), reg(), reg() };
+        }
+        f->named = rnd(5) == 0;
+    }
+    return 0;
+}
+
+static bool put(uint8_t **buf, size_t *len, size_t *cap, const void *data, size_t size)
+{
+    if(*len + size > *cap)
+    {
+        size_t c = *cap == 0 ? 0x10000 : *cap;
+        while(*len + size > c)
+        {
+            c *= 2;
+        }
+        uint8_t *b = realloc(*buf, c);
+        if(b == NULL)
+        {
+            return false;
+        }
+        *buf = b;
+        *cap = c;
+    }
+    if(data != NULL)
+    {
+        memcpy(*buf + *len, data, size);
+    }
+    else
+    {
+        memset(*buf + *len, 0, size);
+    }
+    *len += size;
+    return true;
+}
+
+static void code_emit(uint32_t *code, size_t *n, uint64_t *pc, uint32_t insn)
+{
+    code[(*n)++] = insn;
+    *pc += 4;
+}
+
+static void adrp(uint32_t *code, size_t *n, uint64_t *pc, uint64_t target, uint32_t rd)
+{
+    uint64_t delta = (((target & ~0xfffULL) - (*pc & ~0xfffULL)) >> 12) & 0x1fffff;
+    code_emit(code, n, pc, 0x90000000 | (uint32_t)((delta & 3) << 29) | (uint32_t)((delta >> 2) << 5) | rd);
+}
+
+static int build_write(build_t *bd, const char *path)
+{
+    // Strings, then globals, then code
+    uint64_t cstr_base = BASE + 0x4000,
+             cstr_len = 0;
+    for(size_t i = 0; i < NSTRS; ++i)
+    {
+        size_t s = bd->strorder[i];
+        bd->saddr[s] = cstr_base + cstr_len;
+        cstr_len += strlen(strs[s]) + 1;
+    }
+    uint64_t cstr_size = ROUND(cstr_len),
+             data_base = cstr_base + cstr_size,
+             data_size = ROUND(NGLOBS * 8);
+    for(size_t i = 0; i < NGLOBS; ++i)
+    {
+        bd->gaddr[bd->globorder[i]] = data_base + i * 8;
+    }
+    uint64_t exec_base = data_base + data_size,
+             pc = exec_base;
+    memset(bd->faddr, 0, sizeof(bd->faddr));
+    for(size_t i = 0; i < bd->norder; ++i)
+    {
+        size_t f = bd->order[i];
+        bd->faddr[f] = pc;
+        size_t n = 4 + bd->modified[f];
+        for(size_t j = 0; j < funcs[f].nops; ++j)
+        {
+            n += funcs[f].ops[j].kind == OP_STR || funcs[f].ops[j].kind == OP_GLOB ? 2 : 1;
+        }
+        pc += 4 * n;
+    }
+    uint64_t exec_size = ROUND(pc - exec_base);
+    uint32_t *code = calloc(exec_size / 4, sizeof(*code));
+    if(code == NULL)
+    {
+        return -1;
+    }
+    size_t ninsns = 0;
+    pc = exec_base;
+    for(size_t i = 0; i < bd->norder; ++i)
+    {
+        size_t f = bd->order[i];
+        const uint8_t *m = bd->regs[f];
+        code_emit(code, &ninsns, &pc, 0xd503237f);     // pacibsp
+        code_emit(code, &ninsns, &pc, 0xa9bf7bfd);     // stp x29, x30, [sp, -0x10]!
+        if(bd->modified[f])
+        {
+            code_emit(code, &ninsns, &pc, 0x8b000000 | (m[1] << 16) | (m[2] << 5) | m[3]);
+        }
+        for(size_t j = 0; j < funcs[f].nops; ++j)
+        {
+            const op_t *op = &funcs[f].ops[j];
+            switch(op->kind)
+            {
+                case OP_STR:
+                    adrp(code, &ninsns, &pc, bd->saddr[op->a], m[op->b]);
+                    code_emit(code, &ninsns, &pc, 0x91000000 | (uint32_t)((bd->saddr[op->a] & 0xfff) << 10) | (m[op->b] << 5) | m[op->b]);
+                    break;
+                case OP_GLOB:
+                    adrp(code, &ninsns, &pc, bd->gaddr[op->a], m[op->b]);
+                    code_emit(code, &ninsns, &pc, 0xf9400000 | (uint32_t)(((bd->gaddr[op->a] & 0xfff) / 8) << 10) | (m[op->b] << 5) | m[op->c]);
+                    break;
+                case OP_CALL:
+                {
+                    uint64_t target = bd->faddr[op->a] != 0 ? bd->faddr[op->a] : exec_base;
+                    code_emit(code, &ninsns, &pc, 0x94000000 | (uint32_t)(((target - pc) >> 2) & 0x3ffffff));
+                    break;
+                }
+                case OP_LOAD:
+                    code_emit(code, &ninsns, &pc, 0xf9400000 | (op->c << 10) | (m[op->b] << 5) | m[op->a]);
+                    break;
+                default:
+                    code_emit(code, &ninsns, &pc, op->a | (m[op->b] << 16) | (m[op->c] << 5) | m[op->d]);
+                    break;
+            }
+        }
+        code_emit(code, &ninsns, &pc, 0xa8c17bfd);     // ldp x29, x30, [sp], 0x10
+        code_emit(code, &ninsns, &pc, 0xd65f0fff);     // retab
+    }
+
+    // Function starts, symbols and their names
+    uint8_t *le = NULL;
+    size_t lelen = 0,
+           lecap = 0;
+    uint64_t prev = BASE;
+    bool ok = true;
+    for(size_t i = 0; i < bd->norder; ++i)
+    {
+        uint64_t d = bd->faddr[bd->order[i]] - prev;
+        prev += d;
+        do
+        {
+            uint8_t byte = (d & 0x7f) | (d > 0x7f ? 0x80 : 0);
+            ok = ok && put(&le, &lelen, &lecap, &byte, 1);
+            d >>= 7;
+        } while(d != 0);
+    }
+    ok = ok && put(&le, &lelen, &lecap, NULL, 8 - lelen % 8);
+    size_t fslen = lelen,
+           nsyms = 0;
+    uint8_t *strtab = NULL;
+    size_t strtablen = 0,
+           strtabcap = 0;
+    ok = ok && put(&strtab, &strtablen, &strtabcap, NULL, 1);
+    for(size_t i = 0; ok && i < bd->norder; ++i)
+    {
+        size_t f = bd->order[i];
+        if(!funcs[f].named)
+        {
+            continue;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "_func_%zu", f);
+        struct nlist_64 sym = { .n_un = { .n_strx = strtablen }, .n_type = N_SECT | N_EXT, .n_sect = 2, .n_value = bd->faddr[f] };
+        ok = put(&le, &lelen, &lecap, &sym, sizeof(sym)) && put(&strtab, &strtablen, &strtabcap, name, strlen(name) + 1);
+        ++nsyms;
+    }
+    ok = ok && put(&le, &lelen, &lecap, strtab, strtablen);
+    free(strtab);
+
+    // And all of it into a file
+    uint64_t text_size = 0x4000 + cstr_size,
+             data_off = text_size,
+             exec_off = data_off + data_size,
+             le_off = exec_off + exec_size;
+    struct
+    {
+        struct mach_header_64 hdr;
+        struct segment_command_64 text;
+        struct section_64 cstring;
+        struct segment_command_64 data;
+        struct segment_command_64 exec;
+        struct segment_command_64 linkedit;
+        struct uuid_command uuid;
+        struct linkedit_data_command fstarts;
+        struct symtab_command symtab;
+    } cmds =
+    {
+        .hdr      = { MH_MAGIC_64, CPU_TYPE_ARM64, 0, MH_EXECUTE, 8, sizeof(cmds) - sizeof(cmds.hdr), 0, 0 },
+        .text     = { LC_SEGMENT_64, sizeof(cmds.text) + sizeof(cmds.cstring), "__TEXT", BASE, text_size, 0, text_size, VM_PROT_ALL, VM_PROT_READ, 1, 0 },
+        .cstring  = { "__cstring", "__TEXT", cstr_base, cstr_len, 0x4000, 0, 0, 0, S_CSTRING_LITERALS, 0, 0, 0 },
+        .data     = { LC_SEGMENT_64, sizeof(cmds.data), "__DATA", data_base, data_size, data_off, data_size, VM_PROT_ALL, VM_PROT_READ | VM_PROT_WRITE, 0, 0 },
+        .exec     = { LC_SEGMENT_64, sizeof(cmds.exec), "__TEXT_EXEC", exec_base, exec_size, exec_off, exec_size, VM_PROT_ALL, VM_PROT_READ | VM_PROT_EXECUTE, 0, 0 },
+        .linkedit = { LC_SEGMENT_64, sizeof(cmds.linkedit), "__LINKEDIT", exec_base + exec_size, ROUND(lelen), le_off, lelen, VM_PROT_ALL, VM_PROT_READ, 0, 0 },
+        .uuid     = { LC_UUID, sizeof(cmds.uuid), { (uint8_t)rnd(256), (uint8_t)rnd(256), (uint8_t)rnd(256), (uint8_t)rnd(256) } },
+        .fstarts  = { LC_FUNCTION_STARTS, sizeof(cmds.fstarts), le_off, fslen },
+        .symtab   = { LC_SYMTAB, sizeof(cmds.symtab), le_off + fslen, nsyms, le_off + fslen + nsyms * sizeof(struct nlist_64), strtablen },
+    };
+    uint8_t *file = NULL;
+    size_t len = 0,
+           cap = 0;
+    ok = ok && put(&file, &len, &cap, &cmds, sizeof(cmds)) && put(&file, &len, &cap, NULL, 0x4000 - sizeof(cmds));
+    for(size_t i = 0; ok && i < NSTRS; ++i)
+    {
+        ok = put(&file, &len, &cap, strs[bd->strorder[i]], strlen(strs[bd->strorder[i]]) + 1);
+    }
+    ok = ok && put(&file, &len, &cap, NULL, cstr_size - cstr_len + data_size) &&
+               put(&file, &len, &cap, code, exec_size) &&
+               put(&file, &len, &cap, le, lelen);
+    free(code);
+    free(le);
+
+    FILE *out = ok ? fopen(path, "wb") : NULL;
+    ok = out != NULL && fwrite(file, 1, len, out) == len;
+    if(out != NULL && fclose(out) != 0)
+    {
+        ok = false;
+    }
+    free(file);
+    return ok ? 0 : -1;
+}
+
+static build_t* build_new(void)
+{
+    build_t *bd = calloc(1, sizeof(*bd));
+    if(bd == NULL)
+    {
+        return NULL;
+    }
+    bd->order = malloc(NFUNCS * sizeof(*bd->order));
+    bd->strorder = malloc(NSTRS * sizeof(*bd->strorder));
+    bd->globorder = malloc(NGLOBS * sizeof(*bd->globorder));
+    bd->regs = malloc(NFUNCS * sizeof(*bd->regs));
+    bd->modified = calloc(NFUNCS, sizeof(*bd->modified));
+    if(bd->order == NULL || bd->strorder == NULL || bd->globorder == NULL || bd->regs == NULL || bd->modified == NULL)
+    {
+        return NULL;
+    }
+    for(size_t i = 0; i < NFUNCS; ++i)
+    {
+        bd->order[i] = i;
+        for(size_t r = 0; r < 32; ++r)
+        {
+            bd->regs[i][r] = r;
+        }
+    }
+    bd->norder = NFUNCS;
+    for(size_t i = 0; i < NSTRS; ++i)
+    {
+        bd->strorder[i] = i;
+    }
+    for(size_t i = 0; i < NGLOBS; ++i)
+    {
+        bd->globorder[i] = i;
+    }
+    return bd;
+}
+
+// The next release: everything above changes
+static void build_change(build_t *bd)
+{
+    size_t n = 0;
+    for(size_t i = 0; i < NFUNCS; ++i)
+    {
+        if(rnd(50) != 0)
+        {
+            bd->order[n++] = i;
+        }
+    }
+    bd->norder = n;
+    for(size_t k = 0; k < NFUNCS / 10; ++k)
+    {
+        size_t a = rnd(n), b = rnd(n), t = bd->order[a];
+        bd->order[a] = bd->order[b];
+        bd->order[b] = t;
+    }
+    for(size_t i = 0; i < NFUNCS; ++i)
+    {
+        size_t p[sizeof(pool)];
+        for(size_t r = 0; r < sizeof(pool); ++r)
+        {
+            p[r] = pool[r];
+        }
+        shuffle(p, sizeof(pool));
+        for(size_t r = 0; r < sizeof(pool); ++r)
+        {
+            bd->regs[i][pool[r]] = p[r];
+        }
+        bd->modified[i] = rnd(10) == 0;
+    }
+    shuffle(bd->strorder, NSTRS);
+    shuffle(bd->globorder, NGLOBS);
+}
+
+typedef struct
+{
+    uint64_t old;
+    uint64_t new;           // 0 if it shouldn't be ported
+} truth_t;
+
+static int test_port(void)
+{
+    char oldpath[256], newpath[256], addrpath[256], outpath[256];
+    test_path(oldpath, sizeof(oldpath), "kport-old");
+    test_path(newpath, sizeof(newpath), "kport-new");
+    test_path(addrpath, sizeof(addrpath), "kport-addrs");
+    test_path(outpath, sizeof(outpath), "kport-out");
+
+    CHECK(make_funcs() == 0);
+    build_t *old = build_new(),
+            *new = build_new();
+    CHECK(old != NULL && new != NULL);
+    build_change(new);
+    CHECK(build_write(old, oldpath) == 0);
+    CHECK(build_write(new, newpath) == 0);
+
+    // Function starts, the middle of functions, strings and globals
+    static truth_t truth[NADDRS];
+    FILE *f = fopen(addrpath, "w");
+    CHECK(f != NULL);
+    for(size_t i = 0; i < NADDRS; ++i)
+    {
+        uint64_t k = rnd(100);
+        size_t fn = rnd(NFUNCS),
+               s = rnd(NSTRS),
+               g = rnd(NGLOBS);
+        if(k < 50)
+        {
+            truth[i] = (truth_t){ old->faddr[fn], new->faddr[fn] };
+        }
+        else if(k < 65)
+        {
+            uint64_t off = 8 + 4 * rnd(funcs[fn].nops);
+            truth[i] = (truth_t){ old->faddr[fn] + off, new->faddr[fn] != 0 ? new->faddr[fn] + off + 4 * new->modified[fn] : 0 };
+        }
+        else if(k < 80)
+        {
+            truth[i] = (truth_t){ old->saddr[s], new->saddr[s] };
+        }
+        else
+        {
+            truth[i] = (truth_t){ old->gaddr[g], new->gaddr[g] };
+        }
+        fprintf(f, "%llx\n", (unsigned long long)truth[i].old);
+    }
+    CHECK(fclose(f) == 0);
+
+    // kport prints its results to stdout
+    fflush(stdout);
+    int fd = open(outpath, O_WRONLY | O_CREAT | O_TRUNC, 0644),
+        saved = dup(1);
+    CHECK(fd >= 0 && saved >= 0);
+    dup2(fd, 1);
+    close(fd);
+    const char *argv[] = { "kport", oldpath, newpath, addrpath, NULL };
+    int ret = kport_main(4, argv);
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+    CHECK(ret == 0 || ret == 1);
+
+    size_t ported = 0,
+           wrong = 0,
+           expected = 0;
+    char line[0x200];
+    f = fopen(outpath, "r");
+    CHECK(f != NULL);
+    for(size_t i = 0; i < NADDRS; ++i)
+    {
+        unsigned long long a, b;
+        char to[32];
+        CHECK(fgets(line, sizeof(line), f) != NULL);
+        CHECK(sscanf(line, "%llx %31s", &a, to) == 2);
+        CHECK(a == truth[i].old);
+        expected += truth[i].new != 0;
+        if(strcmp(to, "-") == 0)
+        {
+            continue;
+        }
+        CHECK(sscanf(to, "%llx", &b) == 1);
+        if(b == truth[i].new)
+        {
+            ++ported;
+        }
+        else
+        {
+            fprintf(stderr, "[!] %llx was ported to %llx instead of %llx\n", a, b, (unsigned long long)truth[i].new);
+            ++wrong;
+        }
+    }
+    fclose(f);
+    unlink(oldpath);
+    unlink(newpath);
+    unlink(addrpath);
+    unlink(outpath);
+    fprintf(stderr, "[*] %zu of %zu addresses ported correctly, %zu wrong\n", ported, expected, wrong);
+    // Scores are confidences, so a few misses are fine, but not many
+    CHECK(wrong <= NADDRS / 100);
+    CHECK(ported >= expected * 95 / 100);
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+    RUN(fails, test_port);
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+/*
+ * readahead.c - Read-ahead across backends going away.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // true, false
+#include <stdint.h>             // uint8_t
+#include <string.h>             // memcmp
+#include <unistd.h>             // usleep
+
+#include <mach/vm_prot.h>       // VM_PROT_*
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t, kernel_set_backend
+#include "libkern.h"            // kernel_read, kernel_set_readahead
+#include "sim.h"                // sim_*, SIM_IMAGE_BASE
+
+#include "test.h"
+
+#define REGION  0xffffffe000000000ULL
+#define LENGTH  0x400000
+#define READ    0x10000
+
+static uint8_t data[2][LENGTH];
+
+// Slow enough calls in small pieces that the workers are still busy when
+// the backend is destroyed.
+static kbackend_t* setup(uint8_t *contents)
+{
+    kbackend_t *be = sim_create(SIM_IMAGE_BASE, 1000000, 0x4000);
+    if(be == NULL)
+    {
+        return NULL;
+    }
+    if(sim_map(be, REGION, LENGTH, VM_PROT_READ, 0, contents) == NULL)
+    {
+        sim_destroy(be);
+        return NULL;
+    }
+    return be;
+}
+
+static int test_destroy(void)
+{
+    for(size_t i = 0; i < LENGTH; ++i)
+    {
+        data[0][i] = (uint8_t)(i * 7);
+        data[1][i] = (uint8_t)(i * 13 + 1);
+    }
+    kernel_set_readahead(true);
+    static uint8_t buf[READ];
+    for(int round = 0; round < 2; ++round)
+    {
+        // The second simulator may well reuse the first one's memory, and
+        // must never get its data
+        kbackend_t *be = setup(data[round]);
+        CHECK(be != NULL);
+        kernel_set_backend(be);
+        for(vm_address_t addr = REGION; addr < REGION + 8 * READ; addr += READ)
+        {
+            CHECK(kernel_read(addr, READ, buf) == READ);
+            CHECK(memcmp(buf, &data[round][addr - REGION], READ) == 0);
+        }
+        // Wait for the workers to get ahead of the reads, then pull the
+        // backend out from under them
+        for(int i = 0; i < 1000 && sim_calls(be) <= 8 * READ / 0x4000; ++i)
+        {
+            usleep(1000);
+        }
+        CHECK(sim_calls(be) > 8 * READ / 0x4000);
+        kernel_set_backend(NULL);
+        sim_destroy(be);
+    }
+    kernel_set_readahead(false);
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+    RUN(fails, test_destroy);
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+/*
+ * snap.c - Writing snapshots and reading them back.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdint.h>             // uint8_t, uint32_t
+#include <stdlib.h>             // free, malloc
+#include <string.h>             // memcmp, memset
+#include <unistd.h>             // unlink
+
+#include <mach/kern_return.h>   // KERN_SUCCESS
+#include <mach/vm_prot.h>       // VM_PROT_*
+#include <mach/vm_region.h>     // SM_PRIVATE, vm_region_submap_info_data_64_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t, kernel_set_backend
+#include "libkern.h"            // get_kernel_base, kernel_read, kernel_region
+#include "sim.h"                // sim_*, SIM_IMAGE_BASE
+#include "snap.h"               // snap_*, SNAP_*
+
+#include "test.h"
+
+// Linked in with its main renamed (see Makefile)
+int ksnap_main(int argc, const char **argv);
+
+#define PAGE    0x4000
+#define R1      0xffffffe000000000ULL
+#define R2      0xffffffe000100000ULL
+
+static vm_region_submap_info_data_64_t region_info(vm_prot_t prot)
+{
+    vm_region_submap_info_data_64_t info;
+    memset(&info, 0, sizeof(info));
+    info.protection = prot;
+    info.max_protection = prot;
+    info.share_mode = SM_PRIVATE;
+    info.pages_resident = 1;
+    return info;
+}
+
+// Three blocks of data: noise, zeroes, and a short one whose second page
+// couldn't be read. Then a region without data.
+static int test_blocks(void)
+{
+    char path[256];
+    test_path(path, sizeof(path), "blocks");
+    static uint8_t data[2 * SNAP_BLOCK_SIZE + 2 * PAGE];
+    uint32_t x = 1;
+    for(size_t i = 0; i < sizeof(data); ++i)
+    {
+        x = x * 1103515245 + 12345;
+        data[i] = (uint8_t)(x >> 16);
+    }
+    memset(&data[SNAP_BLOCK_SIZE], 0, SNAP_BLOCK_SIZE);
+    memset(&data[2 * SNAP_BLOCK_SIZE + PAGE], 0, PAGE);
+
+    uint8_t uuid[16] = { 1 };
+    snap_writer_t *w = snap_create(path, SIM_IMAGE_BASE, uuid, PAGE);
+    CHECK(w != NULL);
+    snap_region_t r1 = { .addr = R1, .size = sizeof(data), .info = region_info(VM_PROT_READ | VM_PROT_WRITE) },
+                  r2 = { .addr = R2, .size = PAGE, .info = region_info(VM_PROT_NONE) };
+    CHECK(snap_add_region(w, &r1, true) == 0);
+    CHECK(snap_add_block(w, &data[0], SNAP_BLOCK_SIZE, 0xf) == 0);
+    CHECK(snap_add_block(w, &data[SNAP_BLOCK_SIZE], SNAP_BLOCK_SIZE, 0xf) == 0);
+    CHECK(snap_add_block(w, &data[2 * SNAP_BLOCK_SIZE], 2 * PAGE, 0x1) == 0);
+    CHECK(snap_add_region(w, &r2, false) == 0);
+    uint64_t raw, stored;
+    snap_written(w, &raw, &stored);
+    CHECK(raw == sizeof(data));
+    CHECK(stored < raw);
+    CHECK(snap_finish(w) == 0);
+
+    kbackend_t *be = snap_backend(path);
+    unlink(path);
+    CHECK(be != NULL);
+    kernel_set_backend(be);
+    CHECK(get_kernel_base() == SIM_IMAGE_BASE);
+
+    static uint8_t buf[sizeof(data)];
+    CHECK(kernel_read(R1, 2 * SNAP_BLOCK_SIZE + PAGE, buf) == 2 * SNAP_BLOCK_SIZE + PAGE);
+    CHECK(memcmp(buf, data, 2 * SNAP_BLOCK_SIZE + PAGE) == 0);
+    // Across a block boundary and unaligned
+    CHECK(kernel_read(R1 + SNAP_BLOCK_SIZE - 3, 6, buf) == 6);
+    CHECK(memcmp(buf, &data[SNAP_BLOCK_SIZE - 3], 6) == 0);
+    // The page that couldn't be read still can't be
+    CHECK(kernel_read(R1 + 2 * SNAP_BLOCK_SIZE + PAGE, 8, buf) == 0);
+    CHECK(kernel_read(R2, 8, buf) == 0);
+
+    vm_address_t addr = 0;
+    vm_size_t size = 0;
+    unsigned int depth = 0;
+    vm_region_submap_info_data_64_t info;
+    CHECK(kernel_region(&addr, &size, &depth, &info) == KERN_SUCCESS);
+    CHECK(addr == R1 && size == sizeof(data) && info.protection == (VM_PROT_READ | VM_PROT_WRITE));
+    addr += size;
+    CHECK(kernel_region(&addr, &size, &depth, &info) == KERN_SUCCESS);
+    CHECK(addr == R2 && size == PAGE && info.protection == VM_PROT_NONE);
+    addr += size;
+    CHECK(kernel_region(&addr, &size, &depth, &info) != KERN_SUCCESS);
+    kernel_set_backend(NULL);
+    return 0;
+}
+
+// A snapshot of the synthetic kernel taken with ksnap has to have the same
+// region map and the same contents as the simulator itself.
+static int test_ksnap(void)
+{
+    char path[256];
+    test_path(path, sizeof(path), "ksnap");
+    kbackend_t *sim = sim_from_spec("heap=64");
+    CHECK(sim != NULL);
+    kernel_set_backend(sim);
+    const char *argv[] = { "ksnap", path, NULL };
+    CHECK(ksnap_main(2, argv) == 0);
+    kbackend_t *snap = snap_backend(path);
+    unlink(path);
+    CHECK(snap != NULL);
+
+    size_t regions = 0;
+    uint8_t *a = NULL,
+            *b = NULL;
+    vm_address_t addr = 0;
+    vm_size_t size = 0;
+    unsigned int depth = 0;
+    vm_region_submap_info_data_64_t info;
+    for(; kernel_region(&addr, &size, &depth, &info) == KERN_SUCCESS; addr += size, ++regions)
+    {
+        vm_address_t saddr = addr;
+        vm_size_t ssize = 0;
+        unsigned int sdepth = depth;
+        vm_region_submap_info_data_64_t sinfo;
+        kernel_set_backend(snap);
+        CHECK(kernel_region(&saddr, &ssize, &sdepth, &sinfo) == KERN_SUCCESS);
+        CHECK(saddr == addr && ssize == size && sdepth == depth);
+        CHECK(memcmp(&sinfo, &info, sizeof(info)) == 0);
+        if(!(info.protection & VM_PROT_READ) || info.pages_resident == 0)
+        {
+            kernel_set_backend(sim);
+            continue;
+        }
+        free(a);
+        free(b);
+        a = malloc(size);
+        b = malloc(size);
+        CHECK(a != NULL && b != NULL);
+        CHECK(kernel_read(addr, size, b) == size);
+        kernel_set_backend(sim);
+        CHECK(kernel_read(addr, size, a) == size);
+        CHECK(memcmp(a, b, size) == 0);
+    }
+    free(a);
+    free(b);
+    CHECK(regions > 64);
+    kernel_set_backend(NULL);
+    sim_destroy(sim);
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+    RUN(fails, test_blocks);
+    RUN(fails, test_ksnap);
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+/*
+ * sparse.c - Reading past unreadable pages, and remembering them.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint64_t
+#include <string.h>             // memcmp, memset
+
+#include <mach/vm_prot.h>       // VM_PROT_*
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t, kernel_set_backend
+#include "libkern.h"            // kernel_*
+#include "sim.h"                // sim_*, SIM_IMAGE_BASE
+
+#include "test.h"
+
+#define PAGE    0x4000
+#define REGION  0xffffffe000000000ULL   /* Five pages, the middle one unmapped */
+
+static uint8_t data[5 * PAGE];
+
+static kbackend_t* setup(bool hole)
+{
+    kbackend_t *be = sim_create(SIM_IMAGE_BASE, 0, 0);
+    if(be == NULL)
+    {
+        return NULL;
+    }
+    if(hole ? sim_map(be, REGION, 2 * PAGE, VM_PROT_READ, 0, data) == NULL ||
+              sim_map(be, REGION + 3 * PAGE, 2 * PAGE, VM_PROT_READ, 0, &data[3 * PAGE]) == NULL
+            : sim_map(be, REGION, 5 * PAGE, VM_PROT_READ, 0, data) == NULL)
+    {
+        sim_destroy(be);
+        return NULL;
+    }
+    return be;
+}
+
+static int test_sparse(void)
+{
+    for(size_t i = 0; i < sizeof(data); ++i)
+    {
+        data[i] = (uint8_t)(i * 7 + 1);
+    }
+    kbackend_t *be = setup(true),
+               *full = setup(false);
+    CHECK(be != NULL && full != NULL);
+    kernel_set_backend(be);
+    CHECK(kernel_page_size() == PAGE);
+    CHECK(kernel_page_count(REGION + 1, 5 * PAGE - 1) == 5);
+
+    static uint8_t buf[5 * PAGE];
+    uint8_t valid;
+    memset(buf, 0xff, sizeof(buf));
+    CHECK(kernel_read_sparse(REGION, 5 * PAGE, buf, &valid) == 4 * PAGE);
+    CHECK(valid == 0x1b);
+    CHECK(memcmp(buf, data, 2 * PAGE) == 0);
+    CHECK(memcmp(&buf[3 * PAGE], &data[3 * PAGE], 2 * PAGE) == 0);
+    for(size_t i = 2 * PAGE; i < 3 * PAGE; ++i)
+    {
+        CHECK(buf[i] == 0);
+    }
+
+    // The bad page is known now and doesn't get asked for again, neither
+    // alone nor as part of a range
+    uint64_t calls = sim_calls(be);
+    CHECK(kernel_read_sparse(REGION + 2 * PAGE + 8, 16, buf, &valid) == 0);
+    CHECK(valid == 0);
+    CHECK(sim_calls(be) == calls);
+    memset(buf, 0xff, sizeof(buf));
+    CHECK(kernel_read_sparse(REGION + PAGE, 3 * PAGE, buf, &valid) == 2 * PAGE);
+    CHECK(valid == 0x5);
+    CHECK(sim_calls(be) == calls + 2);
+    CHECK(buf[PAGE] == 0 && buf[2 * PAGE - 1] == 0);
+
+    // Until told to forget about it
+    kernel_forget_bad_pages();
+    calls = sim_calls(be);
+    CHECK(kernel_read_sparse(REGION + 2 * PAGE, PAGE, buf, NULL) == 0);
+    CHECK(sim_calls(be) > calls);
+
+    // Or until the backend changes, where the page may well be fine
+    calls = sim_calls(be);
+    CHECK(kernel_read_sparse(REGION + 2 * PAGE, PAGE, buf, NULL) == 0);
+    CHECK(sim_calls(be) == calls);
+    kernel_set_backend(full);
+    CHECK(kernel_read_sparse(REGION, 5 * PAGE, buf, &valid) == 5 * PAGE);
+    CHECK(valid == 0x1f);
+    CHECK(memcmp(buf, data, sizeof(data)) == 0);
+    kernel_set_backend(be);
+    CHECK(kernel_read_sparse(REGION + 2 * PAGE, PAGE, buf, NULL) == 0);
+    CHECK(sim_calls(be) > calls);
+
+    kernel_set_backend(NULL);
+    sim_destroy(be);
+    sim_destroy(full);
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+    RUN(fails, test_sparse);
+    return fails == 0 ? 0 : 1;
+}
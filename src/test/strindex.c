@@ -0,0 +1,104 @@
+/*
+ * strindex.c - Indexing the C strings of the synthetic kernel.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <dirent.h>             // DIR, opendir, readdir, closedir
+#include <stdio.h>              // snprintf
+#include <stdlib.h>             // setenv
+#include <string.h>             // memcmp, strlen
+#include <unistd.h>             // rmdir, unlink
+
+#include <mach/vm_types.h>      // vm_address_t
+
+#include "backend.h"            // kbackend_t, kernel_set_backend
+#include "libkern.h"            // get_kernel_base, kernel_read
+#include "sim.h"                // sim_*, SIM_IMAGE_BASE
+#include "strindex.h"           // str_*
+
+#include "test.h"
+
+#define SLIDE   0x200000
+
+static const char *known[] = { "little-endian?", "boot-command", "oem-banner" };
+
+// Every string has to be found exactly once, and really be there
+static int check_index(str_index_t *idx)
+{
+    CHECK(str_index_count(idx) > sizeof(known) / sizeof(*known));
+    for(size_t i = 0; i < sizeof(known) / sizeof(*known); ++i)
+    {
+        size_t len = strlen(known[i]);
+        vm_address_t addr = 0;
+        char buf[32];
+        CHECK(str_index_lookup(idx, known[i], len, &addr, 1) == 1);
+        CHECK(kernel_read(addr, len + 1, buf) == len + 1);
+        CHECK(memcmp(buf, known[i], len + 1) == 0);
+    }
+    CHECK(str_index_lookup(idx, "oem-banner?!", 12, NULL, 0) == 0);
+    return 0;
+}
+
+static int test_index(void)
+{
+    char dir[256];
+    test_path(dir, sizeof(dir), "cache");
+    setenv("KUTIL_CACHE_DIR", dir, 1);
+
+    // Built from scratch, then loaded from the cache at a different slide
+    int ret = 0;
+    for(int round = 0; round < 2 && ret == 0; ++round)
+    {
+        kbackend_t *be = sim_from_spec(round == 0 ? "heap=1" : "heap=1,slide=0x200000");
+        CHECK(be != NULL);
+        kernel_set_backend(be);
+        vm_address_t kbase = get_kernel_base();
+        str_index_t *idx = NULL;
+        if(kbase != SIM_IMAGE_BASE + round * SLIDE)
+        {
+            ret = -1;
+        }
+        else if(round == 0)
+        {
+            // Nothing cached yet
+            idx = str_index_cached(kbase);
+            ret = idx == NULL ? 0 : -1;
+            idx = ret == 0 ? str_index(kbase, 0) : idx;
+        }
+        else
+        {
+            idx = str_index_cached(kbase);
+        }
+        if(ret == 0 && (idx == NULL || check_index(idx) != 0))
+        {
+            ret = -1;
+        }
+        str_index_free(idx);
+        kernel_set_backend(NULL);
+        sim_destroy(be);
+    }
+
+    DIR *d = opendir(dir);
+    if(d != NULL)
+    {
+        struct dirent *ent;
+        while((ent = readdir(d)) != NULL)
+        {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+            unlink(path);
+        }
+        closedir(d);
+    }
+    rmdir(dir);
+    CHECK(ret == 0);
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+    RUN(fails, test_index);
+    return fails == 0 ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+/*
+ * test.h - Checks for libkutil and the tools, against simulated kernels.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>              // fprintf, snprintf, stderr
+#include <stdlib.h>             // getenv
+#include <unistd.h>             // getpid
+
+/*
+ * Each file in src/test is a program of its own (see Makefile), made of
+ * static int functions that return 0 if all their checks passed, and a main
+ * that runs them with RUN. Nothing in here needs a device.
+ */
+
+#define CHECK(cond) \
+do \
+{ \
+    if(!(cond)) \
+    { \
+        fprintf(stderr, "[!] %s:%u: %s\n", __FILE__, __LINE__, #cond); \
+        return -1; \
+    } \
+} while(0)
+
+#define RUN(fails, test) \
+do \
+{ \
+    if((test)() == 0) \
+    { \
+        fprintf(stderr, "[*] %s passed\n", #test); \
+    } \
+    else \
+    { \
+        fprintf(stderr, "[!] %s failed\n", #test); \
+        ++(fails); \
+    } \
+} while(0)
+
+/*
+ * A file name in $TMPDIR (or /tmp) that is unique to this process.
+ */
+static inline const char* test_path(char *buf, size_t size, const char *name)
+{
+    const char *dir = getenv("TMPDIR");
+    snprintf(buf, size, "%s/kutil-test-%d-%s", dir != NULL ? dir : "/tmp", (int)getpid(), name);
+    return buf;
+}
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * trace.c - Recording a trace and replaying it.
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <stdint.h>             // uint8_t
+#include <string.h>             // memcmp, memcpy, memset
+#include <unistd.h>             // unlink
+
+#include <mach/vm_prot.h>       // VM_PROT_*
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "backend.h"            // kbackend_t, kernel_set_backend
+#include "libkern.h"            // get_kernel_base, kernel_read, kernel_write
+#include "sim.h"                // sim_*, SIM_IMAGE_BASE
+#include "trace.h"              // trace_*, TRACE_*
+
+#include "test.h"
+
+#define PAGE    TRACE_PAGE_SIZE
+#define A       0xffffffe000000000ULL
+#define B       0xffffffe000100000ULL
+
+static uint8_t a[4 * PAGE],
+               b[2 * PAGE];
+
+// Pages 0 and 1 of A are the same, page 3 is zero. Page 0 of B is page 2
+// of A, and page 1 of B differs from that in a single byte, so that only
+// really identical pages may end up shared.
+static kbackend_t* setup(void)
+{
+    kbackend_t *be = sim_create(SIM_IMAGE_BASE, 0, 0);
+    if(be == NULL)
+    {
+        return NULL;
+    }
+    for(size_t i = 0; i < PAGE; ++i)
+    {
+        a[i] = a[PAGE + i] = (uint8_t)(i * 7);
+        a[2 * PAGE + i] = (uint8_t)(i * 13 + 1);
+    }
+    memcpy(b, &a[2 * PAGE], PAGE);
+    memcpy(&b[PAGE], &a[2 * PAGE], PAGE);
+    b[PAGE + 0x123] ^= 1;
+    if(sim_map(be, A, sizeof(a), VM_PROT_READ | VM_PROT_WRITE, 0, a) == NULL ||
+       sim_map(be, B, sizeof(b), VM_PROT_READ, 0, b) == NULL)
+    {
+        sim_destroy(be);
+        return NULL;
+    }
+    return be;
+}
+
+static uint8_t patch[4] = { 0xde, 0xad, 0xbe, 0xef };
+
+// The accesses that get recorded and then replayed, checking the results
+// against what the simulator holds each time.
+static int run(void)
+{
+    uint8_t buf[sizeof(a)];
+    CHECK(get_kernel_base() == SIM_IMAGE_BASE);
+    CHECK(kernel_read(A, sizeof(a), buf) == sizeof(a));
+    CHECK(memcmp(buf, a, sizeof(a)) == 0);
+    CHECK(kernel_read(B, sizeof(b), buf) == sizeof(b));
+    CHECK(memcmp(buf, b, sizeof(b)) == 0);
+    CHECK(kernel_write(A + 0x10, sizeof(patch), patch) == sizeof(patch));
+    CHECK(kernel_read(A, sizeof(a), buf) == sizeof(a));
+    CHECK(memcmp(&buf[0x10], patch, sizeof(patch)) == 0);
+    CHECK(memcmp(&buf[PAGE], a, PAGE) == 0);
+    return 0;
+}
+
+static int test_round_trip(void)
+{
+    char path[256];
+    test_path(path, sizeof(path), "trace");
+    kbackend_t *be = setup();
+    CHECK(be != NULL);
+    kernel_set_backend(be);
+    CHECK(trace_record_start(path) == 0);
+    int ret = run();
+    trace_record_stop();
+    kernel_set_backend(NULL);
+    sim_destroy(be);
+    CHECK(ret == 0);
+
+    trace_t *t = trace_open(path);
+    CHECK(t != NULL);
+    size_t pages, filesize;
+    trace_info(t, &pages, &filesize);
+    // A's pages 0/1, 2 and 3, B's page 1, the bytes written,
+    // and A's page 0 after the write
+    CHECK(pages == 6);
+    CHECK(trace_count(t) == 5);
+    const trace_rec_t *r = trace_get(t, 1);
+    CHECK(r->op == TRACE_READ && r->addr == A && r->result == sizeof(a));
+    CHECK(memcmp(r->data, a, sizeof(a)) == 0);
+    r = trace_get(t, 2);
+    CHECK(r->op == TRACE_READ && r->addr == B && r->result == sizeof(b));
+    CHECK(memcmp(r->data, b, sizeof(b)) == 0);
+    r = trace_get(t, 3);
+    CHECK(r->op == TRACE_WRITE && r->addr == A + 0x10 && r->result == sizeof(patch));
+    trace_close(t);
+
+    // Replaying has to give the same answers without the simulator
+    be = trace_replay(path);
+    CHECK(be != NULL);
+    kernel_set_backend(be);
+    ret = run();
+    kernel_set_backend(NULL);
+    unlink(path);
+    CHECK(ret == 0);
+    return 0;
+}
+
+int main(void)
+{
+    int fails = 0;
+    RUN(fails, test_round_trip);
+    return fails == 0 ? 0 : 1;
+}
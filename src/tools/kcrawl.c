@@ -0,0 +1,415 @@
+/*
+ * kcrawl.c - Crawl the kernel pointer graph from a root address
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint64_t
+#include <stdio.h>              // FILE, fopen, fclose, fprintf, setvbuf, stderr, stdout
+#include <stdlib.h>             // free, malloc, realloc, strtoul
+#include <string.h>             // memcpy, strcmp, strerror
+
+#include <mach/kern_return.h>   // KERN_SUCCESS
+#include <mach/vm_prot.h>       // VM_PROT_READ
+#include <mach/vm_region.h>     // vm_region_submap_info_data_64_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <sys/mman.h>           // mmap, munmap, MAP_ANON, MAP_FAILED, MAP_PRIVATE, PROT_READ, PROT_WRITE
+
+#include "arch.h"               // ADDR, KERNEL_SPACE
+#include "debug.h"              // slow, verbose
+#include "libkern.h"            // kernel_read_list, kernel_region, kernel_iov_t
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
+#include "timer.h"              // timer_ns
+
+#define DEFAULT_DEPTH 3
+#define DEFAULT_SIZE 0x100
+#define DEFAULT_MAX_NODES 500000
+#define MAX_OBJ_SIZE 0x4000
+#define BATCH_NODES 0x1000      // Most nodes read in one go
+#define REGION_DEPTH 64         // Descend into submaps all the way
+
+typedef struct
+{
+    vm_address_t start;
+    vm_address_t end;
+    uint64_t bit;               // Index of start in the visited bitmap
+} region_t;
+
+typedef struct
+{
+    region_t *regions;
+    size_t count;
+    uint8_t *visited;           // One bit per pointer-aligned address in all regions
+    size_t visited_size;
+} space_t;
+
+typedef struct
+{
+    vm_address_t *addrs;
+    size_t count;
+    size_t cap;
+} frontier_t;
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-S] [-m depth] [-n nodes] [-s size] [-o file] addr\n"
+                    "Starting at addr, reads objects and follows everything in them that looks\n"
+                    "like a pointer into readable kernel memory, breadth-first.\n"
+                    "\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
+                    "    -h  Print this help\n"
+                    "    -m  Maximum depth (default %u)\n"
+                    "    -n  Maximum number of objects (default %u)\n"
+                    "    -o  Write the graph to file instead of stdout\n"
+                    "    -s  Guessed object size, bytes scanned for pointers (default 0x%x)\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
+                    "    -v  Verbose (debug output)\n"
+                    "\n"
+                    "The graph has one line per object and one per pointer found in it:\n"
+                    "\n"
+                    "    N <addr> <depth> <bytes read>\n"
+                    "    E <from> <offset> <to>\n"
+                    , self, DEFAULT_DEPTH, DEFAULT_MAX_NODES, DEFAULT_SIZE);
+}
+
+static bool parse_num(const char *str, unsigned long *num)
+{
+    char *end;
+    errno = 0;
+    *num = strtoul(str, &end, 0);
+    if(str[0] == '\0' || end[0] != '\0' || errno != 0)
+    {
+        fprintf(stderr, "[!] Failed to parse \"%s\"\n", str);
+        return false;
+    }
+    return true;
+}
+
+// Collect all readable regions, merging adjacent ones
+static bool load_space(space_t *space)
+{
+    size_t cap = 0;
+    uint64_t bits = 0;
+    vm_size_t size;
+    for(vm_address_t addr = KERNEL_SPACE; 1; addr += size)
+    {
+        vm_region_submap_info_data_64_t info;
+        unsigned int depth = REGION_DEPTH;
+        if(kernel_region(&addr, &size, &depth, &info) != KERN_SUCCESS || addr + size < addr)
+        {
+            break;
+        }
+        if(!(info.protection & VM_PROT_READ))
+        {
+            continue;
+        }
+        region_t *last = space->count > 0 ? &space->regions[space->count - 1] : NULL;
+        if(last != NULL && last->end == addr)
+        {
+            last->end += size;
+        }
+        else
+        {
+            if(space->count >= cap)
+            {
+                cap = cap == 0 ? 0x100 : cap * 2;
+                region_t *regions = realloc(space->regions, cap * sizeof(*regions));
+                if(regions == NULL)
+                {
+                    return false;
+                }
+                space->regions = regions;
+            }
+            space->regions[space->count++] = (region_t){ .start = addr, .end = addr + size };
+        }
+    }
+    for(size_t i = 0; i < space->count; ++i)
+    {
+        space->regions[i].bit = bits;
+        bits += (space->regions[i].end - space->regions[i].start) / sizeof(vm_address_t);
+    }
+    // Pages only get backed once touched, so this costs memory in
+    // proportion to how spread out the visited objects are.
+    space->visited_size = (bits + 7) / 8;
+    if(space->visited_size == 0)
+    {
+        return true;
+    }
+    space->visited = mmap(NULL, space->visited_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if(space->visited == MAP_FAILED)
+    {
+        space->visited = NULL;
+        return false;
+    }
+    return true;
+}
+
+static const region_t* find_region(const space_t *space, vm_address_t addr)
+{
+    size_t lo = 0,
+           hi = space->count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(space->regions[mid].end <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo < space->count && space->regions[lo].start <= addr ? &space->regions[lo] : NULL;
+}
+
+// Returns true if addr hadn't been visited before
+static bool visit(space_t *space, const region_t *r, vm_address_t addr)
+{
+    uint64_t bit = r->bit + (addr - r->start) / sizeof(vm_address_t);
+    uint8_t mask = 1 << (bit % 8);
+    if(space->visited[bit / 8] & mask)
+    {
+        return false;
+    }
+    space->visited[bit / 8] |= mask;
+    return true;
+}
+
+static bool push(frontier_t *f, vm_address_t addr)
+{
+    if(f->count >= f->cap)
+    {
+        size_t cap = f->cap == 0 ? 0x1000 : f->cap * 2;
+        vm_address_t *addrs = realloc(f->addrs, cap * sizeof(*addrs));
+        if(addrs == NULL)
+        {
+            return false;
+        }
+        f->addrs = addrs;
+        f->cap = cap;
+    }
+    f->addrs[f->count++] = addr;
+    return true;
+}
+
+int main(int argc, const char **argv)
+{
+    unsigned long max_depth = DEFAULT_DEPTH,
+                  max_nodes = DEFAULT_MAX_NODES,
+                  guess = DEFAULT_SIZE,
+                  root;
+    const char *outfile = NULL;
+
+    int aoff;
+    for(aoff = 1; aoff < argc; ++aoff)
+    {
+        if(argv[aoff][0] != '-')
+        {
+            break;
+        }
+        if(strcmp(argv[aoff], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[aoff], "-d") == 0)
+        {
+            slow = true;
+        }
+        else if(strcmp(argv[aoff], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
+        else if(strcmp(argv[aoff], "-o") == 0 && aoff + 1 < argc)
+        {
+            outfile = argv[++aoff];
+        }
+        else if(strcmp(argv[aoff], "-m") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &max_depth))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-n") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &max_nodes))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-s") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &guess))
+            {
+                return -1;
+            }
+            if(guess < sizeof(vm_address_t) || guess > MAX_OBJ_SIZE)
+            {
+                fprintf(stderr, "[!] Object size must be between %zu and 0x%x\n", sizeof(vm_address_t), MAX_OBJ_SIZE);
+                return -1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(argc - aoff != 1)
+    {
+        fprintf(stderr, "[!] Expected exactly one root address\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if(!parse_num(argv[aoff], &root))
+    {
+        return -1;
+    }
+
+    int ret = -1;
+    FILE *out = stdout;
+    space_t space = { 0 };
+    frontier_t cur = { 0 },
+               next = { 0 };
+    kernel_iov_t *iov = malloc(BATCH_NODES * sizeof(*iov));
+    uint8_t *buf = malloc(BATCH_NODES * guess);
+    if(iov == NULL || buf == NULL)
+    {
+        fprintf(stderr, "[!] Out of memory\n");
+        goto out;
+    }
+    if(!load_space(&space))
+    {
+        fprintf(stderr, "[!] Failed to set up the region map: %s\n", strerror(errno));
+        goto out;
+    }
+    const region_t *r = find_region(&space, root);
+    if(r == NULL)
+    {
+        fprintf(stderr, "[!] " ADDR " is not in any readable region\n", (vm_address_t)root);
+        goto out;
+    }
+    fprintf(stderr, "[*] %zu readable regions, visited bitmap of %zu bytes\n", space.count, space.visited_size);
+    if(outfile != NULL)
+    {
+        out = fopen(outfile, "w");
+        if(out == NULL)
+        {
+            fprintf(stderr, "[!] Failed to open %s: %s\n", outfile, strerror(errno));
+            out = stdout;
+            goto out;
+        }
+    }
+    setvbuf(out, NULL, _IOFBF, 0x100000);
+    visit(&space, r, root);
+    if(!push(&cur, root))
+    {
+        fprintf(stderr, "[!] Out of memory\n");
+        goto out;
+    }
+
+    uint64_t start = timer_ns(),
+             edges = 0;
+    size_t nodes = 1,
+           bad = 0;
+    unsigned long depth = 0;
+    for(; cur.count > 0; ++depth)
+    {
+        next.count = 0;
+        for(size_t first = 0; first < cur.count; first += BATCH_NODES)
+        {
+            size_t n = cur.count - first < BATCH_NODES ? cur.count - first : BATCH_NODES;
+            for(size_t i = 0; i < n; ++i)
+            {
+                vm_address_t addr = cur.addrs[first + i];
+                // Don't run off the end of the region
+                vm_size_t size = find_region(&space, addr)->end - addr;
+                iov[i] = (kernel_iov_t)
+                {
+                    .addr = addr,
+                    .size = size < guess ? size : guess,
+                    .buf = &buf[i * guess],
+                    .result = 0,
+                };
+            }
+            kernel_read_list(iov, n);
+
+            for(size_t i = 0; i < n; ++i)
+            {
+                fprintf(out, "N " ADDR " %lu %lu\n", iov[i].addr, depth, (unsigned long)iov[i].result);
+                if(iov[i].result == 0)
+                {
+                    ++bad;
+                    continue;
+                }
+                const uint8_t *data = iov[i].buf;
+                // Pointers are aligned, even if the object isn't
+                for(vm_size_t off = -iov[i].addr & (sizeof(vm_address_t) - 1); off + sizeof(vm_address_t) <= iov[i].result; off += sizeof(vm_address_t))
+                {
+                    vm_address_t ptr;
+                    memcpy(&ptr, &data[off], sizeof(ptr));
+                    if(ptr < KERNEL_SPACE || (r = find_region(&space, ptr)) == NULL)
+                    {
+                        continue;
+                    }
+                    fprintf(out, "E " ADDR " 0x%lx " ADDR "\n", iov[i].addr, (unsigned long)off, ptr);
+                    ++edges;
+                    if(depth >= max_depth || nodes >= max_nodes || !visit(&space, r, ptr & ~(vm_address_t)(sizeof(vm_address_t) - 1)))
+                    {
+                        continue;
+                    }
+                    if(!push(&next, ptr))
+                    {
+                        fprintf(stderr, "[!] Out of memory\n");
+                        goto out;
+                    }
+                    ++nodes;
+                }
+            }
+        }
+        frontier_t tmp = cur;
+        cur = next;
+        next = tmp;
+        DEBUG("Level %lu done, %zu objects queued", depth, cur.count);
+    }
+    if(fflush(out) != 0)
+    {
+        fprintf(stderr, "[!] Failed to write graph: %s\n", strerror(errno));
+        goto out;
+    }
+    uint64_t elapsed = timer_ns() - start;
+    fprintf(stderr, "[*] %zu objects and %llu pointers over %lu levels, %zu unreadable, %.3f ms\n"
+            , nodes, (unsigned long long)edges, depth, bad, elapsed / 1e6);
+    if(nodes >= max_nodes)
+    {
+        fprintf(stderr, "[!] Stopped at %lu objects, use -n to raise the limit\n", max_nodes);
+    }
+    ret = 0;
+
+out:;
+    if(out != stdout && fclose(out) != 0 && ret == 0)
+    {
+        fprintf(stderr, "[!] Failed to write graph: %s\n", strerror(errno));
+        ret = -1;
+    }
+    if(space.visited != NULL)
+    {
+        munmap(space.visited, space.visited_size);
+    }
+    free(space.regions);
+    free(cur.addrs);
+    free(next.addrs);
+    free(iov);
+    free(buf);
+    return ret;
+}
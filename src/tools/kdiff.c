@@ -0,0 +1,970 @@
+/*
+ * kdiff.c - Compare the running kernel against a kernelcache
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <fcntl.h>              // open, O_RDONLY
+#include <pthread.h>            // pthread_*
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint64_t
+#include <stdio.h>              // printf, fprintf, snprintf, stderr
+#include <stdlib.h>             // calloc, free, malloc, realloc, strtoul
+#include <string.h>             // memcmp, memcpy, strchr, strcmp, strerror, strncmp, strnlen
+#include <unistd.h>             // close, getpid, sysconf, usleep, _SC_NPROCESSORS_ONLN
+
+#include <mach/vm_prot.h>       // VM_PROT_EXECUTE
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <sys/mman.h>           // mmap, munmap, MAP_FAILED, MAP_PRIVATE, PROT_READ
+#include <sys/stat.h>           // fstat, struct stat
+
+#include "arch.h"               // ADDR, KERNEL_SPACE, MACH_*, mach_*
+#include "backend.h"            // kernel_backend
+#include "debug.h"              // slow, verbose
+#include "libkern.h"            // KERNEL_BASE_OR_GTFO, kernel_header, kernel_read_sparse, kernel_page_*
+#include "mach-o.h"             // CMD_ITERATE, macho_*
+#include "merkle.h"             // merkle_*, MERKLE_HASH_SIZE
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
+#include "timer.h"              // timer_ns
+
+#define DEFAULT_SEGMENTS "__TEXT,__TEXT_EXEC,__DATA_CONST"
+#define JOB_PAGES 64
+#define MAX_THREADS 64
+
+// Monitor mode
+#define DEFAULT_INTERVAL 1000   // ms
+#define DEFAULT_PERIOD 60       // s
+#define DEFAULT_TICK_BYTES 0x100000
+#define DEFAULT_TICK_TIME 250   // ms
+#define DRILL_LEVELS 6          // Check up to 64 pages either side of a change
+
+typedef struct
+{
+    vm_address_t start;     // Live addresses
+    vm_address_t end;
+    bool unreadable;
+} range_t;
+
+typedef struct
+{
+    vm_address_t addr;      // Live address
+    const uint8_t *file;
+    vm_size_t size;
+    bool relocs;            // Pointers may have been rebased
+    range_t *ranges;
+    size_t nranges;
+    size_t cap;
+    size_t diff_pages;
+    size_t bad_pages;
+    bool oom;
+} job_t;
+
+typedef struct
+{
+    job_t *jobs;
+    size_t njobs;
+    size_t next;
+    vm_address_t slide;
+    vm_address_t file_base; // Unslid address of the file's header
+    vm_address_t hdr_end;   // Live end of the load commands, which get rebased too
+    bool raw;
+} ctx_t;
+
+typedef struct
+{
+    unsigned long interval;     // ms
+    unsigned long period;       // s
+    unsigned long tick_bytes;
+    unsigned long tick_time;    // ms
+    unsigned long ticks;        // 0 = forever
+} mon_opts_t;
+
+typedef struct
+{
+    vm_address_t addr;      // Live address
+    vm_size_t size;
+    const uint8_t *file;    // Same bytes in the kernelcache, or NULL
+    bool bad;               // Unreadable when last checked
+    bool known;             // Hash is of actual content
+} leaf_t;
+
+typedef struct
+{
+    const ctx_t *ctx;
+    const mach_hdr_t *hdr;  // For section names
+    vm_address_t slide;     // From hdr to live addresses
+    leaf_t *leaves;
+    merkle_t *tree;
+    uint8_t *buf;
+    uint64_t start;
+    uint64_t changes;
+} monitor_t;
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-S] [-f] [-j threads] [-r] [-s segments] kernelcache\n"
+                    "       %s -m [-v [-d]] [-S] [-f] [-i ms] [-p seconds] [-b bytes] [-t ms] [-n ticks] [-s segments] [kernelcache]\n"
+                    "Compares the running kernel to a decompressed kernelcache and lists every\n"
+                    "byte range that differs. Exits with 1 if there are differences.\n"
+                    "\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
+                    "    -f  Compare even if the UUIDs don't match\n"
+                    "    -h  Print this help\n"
+                    "    -j  Number of threads (default: one per CPU)\n"
+                    "    -r  Raw comparison, don't account for rebased pointers\n"
+                    "    -s  Comma-separated segments to compare (default " DEFAULT_SEGMENTS ",\n"
+                    "        or all executable segments in monitor mode)\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
+                    "    -v  Verbose (debug output)\n"
+                    "\n"
+                    "Monitor mode keeps checking a random sample of pages every tick, against the\n"
+                    "kernelcache if given, or else against what they held at startup, until every\n"
+                    "page has been checked within the period. A changed page is reported at once,\n"
+                    "and its neighbours are checked right away.\n"
+                    "\n"
+                    "    -m  Monitor mode\n"
+                    "    -b  Max bytes read per tick (default 0x%x)\n"
+                    "    -i  Milliseconds between ticks (default %u)\n"
+                    "    -n  Stop after this many ticks (default: never)\n"
+                    "    -p  Seconds in which every page is checked once (default %u)\n"
+                    "    -t  Max milliseconds spent per tick (default %u)\n"
+                    , self, self, DEFAULT_TICK_BYTES, DEFAULT_INTERVAL, DEFAULT_PERIOD, DEFAULT_TICK_TIME);
+}
+
+static bool add_range(job_t *job, vm_address_t start, vm_address_t end, bool unreadable)
+{
+    if(job->nranges > 0)
+    {
+        range_t *last = &job->ranges[job->nranges - 1];
+        if(last->end == start && last->unreadable == unreadable)
+        {
+            last->end = end;
+            return true;
+        }
+    }
+    if(job->nranges >= job->cap)
+    {
+        size_t cap = job->cap == 0 ? 8 : job->cap * 2;
+        range_t *ranges = realloc(job->ranges, cap * sizeof(*ranges));
+        if(ranges == NULL)
+        {
+            job->oom = true;
+            return false;
+        }
+        job->ranges = ranges;
+        job->cap = cap;
+    }
+    job->ranges[job->nranges++] = (range_t){ .start = start, .end = end, .unreadable = unreadable };
+    return true;
+}
+
+// Whether live is what the loader would have made of the pointer in the file
+static bool reloc_match(const ctx_t *ctx, uint64_t file, uint64_t live)
+{
+    if(file >= KERNEL_SPACE)
+    {
+        // Plain unslid pointer
+        return file + ctx->slide == live;
+    }
+    // Chained fixup in kernel cache format: target offset in the low 30 bits,
+    // and if bit 63 is set, a signed pointer whose PAC we can't verify.
+    uint64_t target = ctx->file_base + ctx->slide + (file & 0x3fffffff);
+    if(file >> 63)
+    {
+        uint64_t mask = (1ULL << 39) - 1;
+        return (target & mask) == (live & mask);
+    }
+    return target == live;
+}
+
+// Record the differing bytes of one page
+static void diff_page(const ctx_t *ctx, job_t *job, vm_address_t addr, const uint8_t *file, const uint8_t *live, vm_size_t len)
+{
+    vm_size_t i = 0;
+    bool differs = false;
+    while(i < len)
+    {
+        if((job->relocs || addr + i < ctx->hdr_end) && !ctx->raw && ((addr + i) & 7) == 0 && i + 8 <= len)
+        {
+            uint64_t f, l;
+            memcpy(&f, &file[i], 8);
+            memcpy(&l, &live[i], 8);
+            if(f == l || reloc_match(ctx, f, l))
+            {
+                i += 8;
+                continue;
+            }
+        }
+        if(file[i] == live[i])
+        {
+            ++i;
+            continue;
+        }
+        vm_size_t j = i + 1;
+        while(j < len && file[j] != live[j])
+        {
+            ++j;
+        }
+        differs = true;
+        if(!add_range(job, addr + i, addr + j, false))
+        {
+            break;
+        }
+        i = j;
+    }
+    if(differs)
+    {
+        ++job->diff_pages;
+    }
+}
+
+// Pages are compared directly rather than by hash: nothing can hash them on
+// the kernel's side, so each one has to be read in full either way, and then
+// hashing both copies only costs more than a memcmp.
+static void run_job(const ctx_t *ctx, job_t *job, uint8_t *buf, uint8_t *valid)
+{
+    vm_size_t ps = kernel_page_size();
+    kernel_read_sparse(job->addr, job->size, buf, valid);
+    vm_address_t first = job->addr / ps;
+    for(vm_size_t off = 0; off < job->size && !job->oom; )
+    {
+        vm_address_t addr = job->addr + off;
+        vm_size_t len = ps - (addr & (ps - 1));
+        if(len > job->size - off)
+        {
+            len = job->size - off;
+        }
+        size_t p = addr / ps - first;
+        if(!(valid[p / 8] & (1 << (p % 8))))
+        {
+            ++job->bad_pages;
+            add_range(job, addr, addr + len, true);
+        }
+        else if(memcmp(&buf[off], &job->file[off], len) != 0)
+        {
+            diff_page(ctx, job, addr, &job->file[off], &buf[off], len);
+        }
+        off += len;
+    }
+}
+
+static void* worker(void *arg)
+{
+    ctx_t *ctx = arg;
+    vm_size_t ps = kernel_page_size();
+    uint8_t *buf = malloc((JOB_PAGES + 1) * ps),
+            *valid = malloc((JOB_PAGES + 1 + 7) / 8);
+    while(buf != NULL && valid != NULL)
+    {
+        size_t i = __atomic_fetch_add(&ctx->next, 1, __ATOMIC_RELAXED);
+        if(i >= ctx->njobs)
+        {
+            break;
+        }
+        run_job(ctx, &ctx->jobs[i], buf, valid);
+    }
+    if(buf == NULL || valid == NULL)
+    {
+        // Someone else will have to do the work
+        fprintf(stderr, "[!] Failed to allocate thread buffers\n");
+    }
+    free(buf);
+    free(valid);
+    return NULL;
+}
+
+static bool want_segment(const char *list, const char *segname)
+{
+    size_t len = strnlen(segname, 16);
+    for(const char *p = list; p != NULL; p = strchr(p, ','))
+    {
+        if(*p == ',')
+        {
+            ++p;
+        }
+        if(strncmp(p, segname, len) == 0 && (p[len] == ',' || p[len] == '\0'))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void print_range(const mach_hdr_t *hdr, vm_address_t slide, vm_address_t start, vm_address_t end, const char *note)
+{
+    mach_seg_t *seg;
+    mach_sec_t *sec = macho_section_at(hdr, start - slide, &seg);
+    char owner[34];
+    if(sec != NULL)
+    {
+        snprintf(owner, sizeof(owner), "%.16s.%.16s", sec->segname, sec->sectname);
+    }
+    else
+    {
+        snprintf(owner, sizeof(owner), "%.16s", seg != NULL ? seg->segname : "?");
+    }
+    printf(ADDR "-" ADDR "  %-34s  %10lu bytes%s%s%s\n", start, end, owner, (unsigned long)(end - start), note != NULL ? "  (" : "", note != NULL ? note : "", note != NULL ? ")" : "");
+}
+
+static bool parse_num(const char *str, unsigned long *num)
+{
+    char *end;
+    errno = 0;
+    *num = strtoul(str, &end, 0);
+    if(str[0] == '\0' || end[0] != '\0' || errno != 0)
+    {
+        fprintf(stderr, "[!] Failed to parse \"%s\": %s\n", str, str[0] == '\0' ? "zero characters given" : errno != 0 ? strerror(errno) : "not a number");
+        return false;
+    }
+    return true;
+}
+
+static uint64_t xorshift(uint64_t *state)
+{
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+// An attacker shouldn't be able to predict which pages go unchecked for a while
+static void shuffle(size_t *order, size_t n, uint64_t *rng)
+{
+    for(size_t i = n; i > 1; --i)
+    {
+        size_t j = xorshift(rng) % i,
+               tmp = order[i - 1];
+        order[i - 1] = order[j];
+        order[j] = tmp;
+    }
+}
+
+// Returns false if the page only differs from the file by rebased pointers
+static bool report_change(monitor_t *mon, const leaf_t *leaf)
+{
+    job_t job =
+    {
+        .addr = leaf->addr,
+        .file = leaf->file,
+        .size = leaf->size,
+        .relocs = false,
+    };
+    if(leaf->file != NULL)
+    {
+        diff_page(mon->ctx, &job, leaf->addr, leaf->file, mon->buf, leaf->size);
+        if(job.nranges == 0 && !job.oom && memcmp(leaf->file, mon->buf, leaf->size) != 0)
+        {
+            return false;
+        }
+    }
+    ++mon->changes;
+    printf("[!] Change after %.3fs\n", (timer_ns() - mon->start) / 1e9);
+    for(size_t i = 0; i < job.nranges; ++i)
+    {
+        print_range(mon->hdr, mon->slide, job.ranges[i].start, job.ranges[i].end, NULL);
+    }
+    if(job.nranges == 0)
+    {
+        print_range(mon->hdr, mon->slide, leaf->addr, leaf->addr + leaf->size, leaf->file != NULL && !job.oom ? "restored" : "page changed");
+    }
+    free(job.ranges);
+    return true;
+}
+
+// Returns true if the page changed since it was last checked
+static bool check_leaf(monitor_t *mon, size_t i)
+{
+    leaf_t *leaf = &mon->leaves[i];
+    if(kernel_read(leaf->addr, leaf->size, mon->buf) != leaf->size)
+    {
+        if(leaf->bad)
+        {
+            return false;
+        }
+        leaf->bad = true;
+        ++mon->changes;
+        printf("[!] Change after %.3fs\n", (timer_ns() - mon->start) / 1e9);
+        print_range(mon->hdr, mon->slide, leaf->addr, leaf->addr + leaf->size, "unreadable");
+        return true;
+    }
+    leaf->bad = false;
+    uint8_t hash[MERKLE_HASH_SIZE];
+    merkle_hash(mon->buf, leaf->size, hash);
+    if(!merkle_update(mon->tree, i, hash))
+    {
+        return false;
+    }
+    if(!leaf->known)
+    {
+        // Unreadable at startup, this is the first we see of it
+        leaf->known = true;
+        return false;
+    }
+    return report_change(mon, leaf);
+}
+
+// Tampering rarely stops at a single page, so check a window around a
+// changed page, and keep doubling it for as long as that turns up more.
+// Pages count against the tick's budget of *left pages until deadline;
+// returns false if that runs out first.
+static bool drill_down(monitor_t *mon, size_t leaf, size_t nleaves, size_t *left, uint64_t deadline)
+{
+    size_t lo = leaf,
+           hi = leaf + 1;
+    for(unsigned int level = 0; level < DRILL_LEVELS && (lo > 0 || hi < nleaves); ++level)
+    {
+        size_t w = (size_t)1 << level,
+               first = leaf > w ? leaf - w : 0,
+               last = leaf + w + 1 < nleaves ? leaf + w + 1 : nleaves;
+        bool found = false;
+        for(size_t i = first; i < last; ++i)
+        {
+            if(i < lo || i >= hi)
+            {
+                if(*left == 0 || timer_ns() >= deadline)
+                {
+                    return false;
+                }
+                --*left;
+                found |= check_leaf(mon, i);
+            }
+        }
+        lo = first;
+        hi = last;
+        if(!found)
+        {
+            break;
+        }
+    }
+    return true;
+}
+
+static int monitor(const ctx_t *ctx, const mach_hdr_t *hdr, vm_address_t slide, size_t filesize, const char *segments, const mon_opts_t *opts)
+{
+    int ret = -1;
+    vm_size_t ps = kernel_page_size();
+    monitor_t mon =
+    {
+        .ctx = ctx,
+        .hdr = hdr,
+        .slide = slide,
+    };
+    size_t *order = NULL,
+           nleaves = 0,
+           cap = 0;
+
+    // One leaf per page of every segment we watch
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd != MACH_LC_SEGMENT)
+        {
+            continue;
+        }
+        const mach_seg_t *seg = (const mach_seg_t*)cmd;
+        if(segments != NULL ? !want_segment(segments, seg->segname) : !(seg->initprot & VM_PROT_EXECUTE))
+        {
+            continue;
+        }
+        vm_size_t size = seg->filesize < seg->vmsize ? seg->filesize : seg->vmsize;
+        if(filesize != 0 && (seg->fileoff > filesize || size > filesize - seg->fileoff))
+        {
+            fprintf(stderr, "[!] Segment %.16s exceeds the file\n", seg->segname);
+            goto out;
+        }
+        fprintf(stderr, "[*] Watching %.16s (" SIZE " bytes)\n", seg->segname, size);
+        for(vm_size_t off = 0; off < size; )
+        {
+            vm_address_t addr = seg->vmaddr + slide + off;
+            vm_size_t len = ps - (addr & (ps - 1));
+            if(len > size - off)
+            {
+                len = size - off;
+            }
+            if(nleaves >= cap)
+            {
+                cap = cap == 0 ? 0x400 : cap * 2;
+                leaf_t *leaves = realloc(mon.leaves, cap * sizeof(*leaves));
+                if(leaves == NULL)
+                {
+                    fprintf(stderr, "[!] Failed to allocate leaves: %s\n", strerror(errno));
+                    goto out;
+                }
+                mon.leaves = leaves;
+            }
+            mon.leaves[nleaves++] = (leaf_t)
+            {
+                .addr = addr,
+                .size = len,
+                .file = filesize != 0 ? (const uint8_t*)hdr + seg->fileoff + off : NULL,
+                .bad = false,
+                .known = true,
+            };
+            off += len;
+        }
+    }
+    if(nleaves == 0)
+    {
+        fprintf(stderr, "[!] No segments to watch\n");
+        goto out;
+    }
+
+    mon.tree = merkle_create(nleaves);
+    mon.buf = malloc(ps);
+    order = malloc(nleaves * sizeof(*order));
+    if(mon.tree == NULL || mon.buf == NULL || order == NULL)
+    {
+        fprintf(stderr, "[!] Failed to allocate tree: %s\n", strerror(errno));
+        goto out;
+    }
+
+    // Baseline, either from the file or from a full read up front
+    for(size_t i = 0; i < nleaves; ++i)
+    {
+        leaf_t *leaf = &mon.leaves[i];
+        uint8_t hash[MERKLE_HASH_SIZE] = { 0 };
+        if(leaf->file != NULL)
+        {
+            merkle_hash(leaf->file, leaf->size, hash);
+        }
+        else if(kernel_read(leaf->addr, leaf->size, mon.buf) == leaf->size)
+        {
+            merkle_hash(mon.buf, leaf->size, hash);
+        }
+        else
+        {
+            leaf->bad = true;
+            leaf->known = false;
+            print_range(hdr, slide, leaf->addr, leaf->addr + leaf->size, "unreadable");
+        }
+        merkle_set(mon.tree, i, hash);
+        order[i] = i;
+    }
+    merkle_rebuild(mon.tree);
+
+    // Leaves per tick to cover everything once per period, within budget
+    uint64_t period = (uint64_t)opts->period * 1000;
+    size_t per_tick = period == 0 ? nleaves : (nleaves * opts->interval + period - 1) / period,
+           max_tick = opts->tick_bytes / ps;
+    if(per_tick == 0)
+    {
+        per_tick = 1;
+    }
+    if(max_tick == 0)
+    {
+        max_tick = 1;
+    }
+    if(per_tick > max_tick)
+    {
+        fprintf(stderr, "[!] Checking %zu pages per tick would exceed the budget, full coverage will take %.1fs instead\n"
+                , per_tick, (double)nleaves / max_tick * opts->interval / 1e3);
+        per_tick = max_tick;
+    }
+    fprintf(stderr, "[*] %zu pages, %zu per tick every %lu ms\n", nleaves, per_tick, opts->interval);
+
+    uint64_t rng = timer_ns() ^ ((uint64_t)getpid() << 32);
+    if(rng == 0)
+    {
+        rng = 1;
+    }
+    shuffle(order, nleaves, &rng);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    size_t cursor = 0;
+    unsigned long pass = 0;
+    mon.start = timer_ns();
+    for(unsigned long tick = 0; opts->ticks == 0 || tick < opts->ticks; ++tick)
+    {
+        uint64_t t0 = timer_ns(),
+                 deadline = t0 + (uint64_t)opts->tick_time * 1000000;
+        // Drill-downs come out of the same budget
+        size_t left = max_tick;
+        for(size_t done = 0; done < per_tick && left > 0 && timer_ns() < deadline; ++done)
+        {
+            if(cursor == nleaves)
+            {
+                const uint8_t *root = merkle_root(mon.tree);
+                fprintf(stderr, "[*] Pass %lu done after %.3fs, root %02x%02x%02x%02x%02x%02x%02x%02x\n", ++pass, (timer_ns() - mon.start) / 1e9
+                        , root[0], root[1], root[2], root[3], root[4], root[5], root[6], root[7]);
+                shuffle(order, nleaves, &rng);
+                cursor = 0;
+            }
+            size_t i = order[cursor++];
+            --left;
+            if(check_leaf(&mon, i) && !drill_down(&mon, i, nleaves, &left, deadline))
+            {
+                printf("[!] Tick budget ran out, pages around 0x" ADDR " only partially checked\n", mon.leaves[i].addr);
+            }
+        }
+        uint64_t spent = timer_ns() - t0,
+                 interval = (uint64_t)opts->interval * 1000000;
+        if(spent < interval && (opts->ticks == 0 || tick + 1 < opts->ticks))
+        {
+            usleep((interval - spent) / 1000);
+        }
+    }
+    fprintf(stderr, "[*] %llu changes seen\n", (unsigned long long)mon.changes);
+    ret = mon.changes > 0 ? 1 : 0;
+
+out:;
+    merkle_destroy(mon.tree);
+    free(mon.leaves);
+    free(mon.buf);
+    free(order);
+    return ret;
+}
+
+static const mach_hdr_t* map_kernelcache(const char *path, size_t *filesize)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        fprintf(stderr, "[!] Failed to open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat s;
+    if(fstat(fd, &s) != 0)
+    {
+        fprintf(stderr, "[!] Failed to stat %s: %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    *filesize = s.st_size;
+    const mach_hdr_t *hdr = *filesize >= sizeof(mach_hdr_t) ? mmap(NULL, *filesize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(hdr == MAP_FAILED)
+    {
+        fprintf(stderr, "[!] Failed to map %s: %s\n", path, *filesize < sizeof(mach_hdr_t) ? "file too small" : strerror(errno));
+        return NULL;
+    }
+    if(hdr->magic != MACH_HEADER_MAGIC || sizeof(*hdr) + hdr->sizeofcmds > *filesize)
+    {
+        fprintf(stderr, "[!] %s is not a decompressed Mach-O kernelcache\n", path);
+        munmap((void*)hdr, *filesize);
+        return NULL;
+    }
+    return hdr;
+}
+
+int main(int argc, const char **argv)
+{
+    const char *segments = NULL;
+    bool force = false,
+         raw = false,
+         watch = false;
+    unsigned long nthreads = 0;
+    mon_opts_t opts =
+    {
+        .interval = DEFAULT_INTERVAL,
+        .period = DEFAULT_PERIOD,
+        .tick_bytes = DEFAULT_TICK_BYTES,
+        .tick_time = DEFAULT_TICK_TIME,
+        .ticks = 0,
+    };
+    vm_address_t kbase;
+
+    int aoff;
+    for(aoff = 1; aoff < argc; ++aoff)
+    {
+        if(argv[aoff][0] != '-')
+        {
+            break;
+        }
+        if(strcmp(argv[aoff], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[aoff], "-d") == 0)
+        {
+            slow = true;
+        }
+        else if(strcmp(argv[aoff], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
+        else if(strcmp(argv[aoff], "-f") == 0)
+        {
+            force = true;
+        }
+        else if(strcmp(argv[aoff], "-r") == 0)
+        {
+            raw = true;
+        }
+        else if(strcmp(argv[aoff], "-s") == 0 && aoff + 1 < argc)
+        {
+            segments = argv[++aoff];
+        }
+        else if(strcmp(argv[aoff], "-j") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &nthreads))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-m") == 0)
+        {
+            watch = true;
+        }
+        else if(strcmp(argv[aoff], "-b") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &opts.tick_bytes))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-i") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &opts.interval))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-n") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &opts.ticks))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-p") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &opts.period))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-t") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &opts.tick_time))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(argc - aoff > 1 || (argc - aoff == 0 && !watch))
+    {
+        fprintf(stderr, "[!] Expected exactly one kernelcache\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if(nthreads == 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = n > 0 ? n : 1;
+    }
+    if(nthreads > MAX_THREADS)
+    {
+        nthreads = MAX_THREADS;
+    }
+
+    size_t filesize = 0;
+    const mach_hdr_t *hdr = NULL;
+    if(aoff < argc)
+    {
+        hdr = map_kernelcache(argv[aoff], &filesize);
+        if(hdr == NULL)
+        {
+            return -1;
+        }
+    }
+
+    KERNEL_BASE_OR_GTFO(kbase);
+    ctx_t ctx =
+    {
+        .jobs = NULL,
+        .njobs = 0,
+        .next = 0,
+        .slide = hdr != NULL ? macho_slide(hdr, kbase) : 0,
+        .raw = raw,
+    };
+    ctx.file_base = kbase - ctx.slide;
+    ctx.hdr_end = hdr != NULL ? kbase + sizeof(*hdr) + hdr->sizeofcmds : 0;
+    fprintf(stderr, "[*] Kernel base 0x" ADDR ", slide 0x" ADDR "\n", kbase, ctx.slide);
+
+    mach_hdr_t *live = kernel_header(kbase);
+    if(hdr != NULL)
+    {
+        uint8_t file_uuid[16], live_uuid[16];
+        if(live == NULL || !macho_uuid(live, live_uuid) || !macho_uuid(hdr, file_uuid) || memcmp(live_uuid, file_uuid, 16) != 0)
+        {
+            fprintf(stderr, "[!] UUID of %s %s the running kernel's\n", argv[aoff], live == NULL ? "can't be compared to" : "doesn't match");
+            if(!force)
+            {
+                fprintf(stderr, "[!] Use -f to compare anyway\n");
+                free(live);
+                return -1;
+            }
+        }
+    }
+    if(watch)
+    {
+        int ret = -1;
+        if(hdr == NULL && live == NULL)
+        {
+            fprintf(stderr, "[!] Failed to read the kernel's Mach-O header\n");
+        }
+        else
+        {
+            // Without a kernelcache, the live header already has slid addresses
+            ret = monitor(&ctx, hdr != NULL ? hdr : live, ctx.slide, filesize, segments, &opts);
+        }
+        free(live);
+        return ret;
+    }
+    free(live);
+    if(segments == NULL)
+    {
+        segments = DEFAULT_SEGMENTS;
+    }
+
+    // Cut the segments into jobs of JOB_PAGES pages each
+    vm_size_t ps = kernel_page_size();
+    size_t capjobs = 0,
+           npages = 0;
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd != MACH_LC_SEGMENT)
+        {
+            continue;
+        }
+        const mach_seg_t *seg = (const mach_seg_t*)cmd;
+        if(!want_segment(segments, seg->segname))
+        {
+            continue;
+        }
+        vm_size_t size = seg->filesize < seg->vmsize ? seg->filesize : seg->vmsize;
+        if(seg->fileoff > filesize || size > filesize - seg->fileoff)
+        {
+            fprintf(stderr, "[!] Segment %.16s exceeds the file\n", seg->segname);
+            return -1;
+        }
+        fprintf(stderr, "[*] Comparing %.16s (" SIZE " bytes)\n", seg->segname, size);
+        npages += kernel_page_count(seg->vmaddr + ctx.slide, size);
+        for(vm_size_t off = 0; off < size; )
+        {
+            // Jobs after the first start on a page boundary
+            vm_address_t addr = seg->vmaddr + ctx.slide + off;
+            vm_size_t len = JOB_PAGES * ps - (addr & (ps - 1));
+            if(len > size - off)
+            {
+                len = size - off;
+            }
+            if(ctx.njobs >= capjobs)
+            {
+                capjobs = capjobs == 0 ? 0x100 : capjobs * 2;
+                job_t *jobs = realloc(ctx.jobs, capjobs * sizeof(*jobs));
+                if(jobs == NULL)
+                {
+                    fprintf(stderr, "[!] Failed to allocate jobs: %s\n", strerror(errno));
+                    return -1;
+                }
+                ctx.jobs = jobs;
+            }
+            ctx.jobs[ctx.njobs++] = (job_t)
+            {
+                .addr = addr,
+                .file = (const uint8_t*)hdr + seg->fileoff + off,
+                .size = len,
+                .relocs = !(seg->initprot & VM_PROT_EXECUTE) && strncmp(seg->segname, "__TEXT", sizeof(seg->segname)) != 0,
+            };
+            off += len;
+        }
+    }
+    if(ctx.njobs == 0)
+    {
+        fprintf(stderr, "[!] None of the segments %s found\n", segments);
+        return -1;
+    }
+
+    // The workers all read through the same backend
+    if(!kernel_backend()->concurrent)
+    {
+        nthreads = 1;
+    }
+    pthread_t threads[MAX_THREADS];
+    size_t started = 0;
+    for(; started < nthreads && started < ctx.njobs; ++started)
+    {
+        if(pthread_create(&threads[started], NULL, &worker, &ctx) != 0)
+        {
+            break;
+        }
+    }
+    if(started == 0)
+    {
+        // Do it ourselves then
+        worker(&ctx);
+    }
+    for(size_t i = 0; i < started; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+
+    // Jobs are in address order and so are the ranges within them
+    size_t diff_pages = 0,
+           bad_pages = 0,
+           nranges = 0;
+    uint64_t diff_bytes = 0;
+    int ret = 0;
+    range_t cur = { 0 };
+    bool have = false;
+    for(size_t i = 0; i < ctx.njobs; ++i)
+    {
+        job_t *job = &ctx.jobs[i];
+        if(job->oom)
+        {
+            fprintf(stderr, "[!] Out of memory while comparing 0x" ADDR "\n", job->addr);
+            ret = -1;
+        }
+        for(size_t k = 0; k < job->nranges; ++k)
+        {
+            range_t *r = &job->ranges[k];
+            // Ranges can continue across job boundaries
+            if(have && cur.end == r->start && cur.unreadable == r->unreadable)
+            {
+                cur.end = r->end;
+                continue;
+            }
+            if(have)
+            {
+                print_range(hdr, ctx.slide, cur.start, cur.end, cur.unreadable ? "unreadable" : NULL);
+                ++nranges;
+                diff_bytes += cur.unreadable ? 0 : cur.end - cur.start;
+            }
+            cur = *r;
+            have = true;
+        }
+        diff_pages += job->diff_pages;
+        bad_pages += job->bad_pages;
+        free(job->ranges);
+    }
+    if(have)
+    {
+        print_range(hdr, ctx.slide, cur.start, cur.end, cur.unreadable ? "unreadable" : NULL);
+        ++nranges;
+        diff_bytes += cur.unreadable ? 0 : cur.end - cur.start;
+    }
+    free(ctx.jobs);
+    munmap((void*)hdr, filesize);
+
+    printf("[*] %zu pages compared with %lu threads: %zu differ (%llu bytes in %zu ranges), %zu unreadable\n"
+           , npages, started > 0 ? (unsigned long)started : 1UL, diff_pages, (unsigned long long)diff_bytes, nranges, bad_pages);
+    if(ret == 0 && (diff_pages > 0 || bad_pages > 0))
+    {
+        ret = 1;
+    }
+    return ret;
+}
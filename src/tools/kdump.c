@@ -6,6 +6,7 @@
  */
 
 #include <errno.h>              // errno
+#include <stdint.h>             // uint8_t
 #include <stdio.h>              // FILE, fopen, fwrite, fclose, fprintf, stderr
 #include <stdlib.h>             // free, malloc
 #include <string.h>             // memcpy, memset, strerror
@@ -16,21 +17,60 @@
 
 #include "arch.h"               // ADDR, mach_*
 #include "debug.h"              // slow, verbose
-#include "libkern.h"            // KERNEL_BASE_OR_GTFO, kernel_read
+#include "libkern.h"            // KERNEL_BASE_OR_GTFO, kernel_read, kernel_read_sparse, kernel_page_*
 #include "mach-o.h"             // CMD_ITERATE
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
 
 #define max(a, b) (a) > (b) ? (a) : (b)
 
 static void print_usage(const char *self)
 {
-    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [kernel.bin]\n"
-                    "    -d  Debug mode (sleep between function calls, gives\n"
-                    "        sshd time to deliver output before kernel panic)\n"
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-S] [kernel.bin]\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
                     "    -h  Print this help\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
                     "    -v  Verbose (debug output)\n"
                     , self);
 }
 
+// Read a segment, zero-filling and reporting pages that can't be read
+static int dump_segment(mach_seg_t *seg, unsigned char *dst)
+{
+    size_t npages = kernel_page_count(seg->vmaddr, seg->filesize);
+    uint8_t *valid = malloc((npages + 7) / 8);
+    if(valid == NULL)
+    {
+        fprintf(stderr, "[!] Failed to allocate page bitmap: %s\n", strerror(errno));
+        return -1;
+    }
+    vm_size_t got = kernel_read_sparse(seg->vmaddr, seg->filesize, dst, valid);
+    if(got != seg->filesize)
+    {
+        vm_size_t ps = kernel_page_size();
+        vm_address_t page = seg->vmaddr / ps * ps;
+        size_t bad = 0;
+        for(size_t i = 0; i < npages; ++i)
+        {
+            if(valid[i / 8] & (1 << (i % 8)))
+            {
+                continue;
+            }
+            size_t j = i;
+            while(j + 1 < npages && !(valid[(j + 1) / 8] & (1 << ((j + 1) % 8))))
+            {
+                ++j;
+            }
+            fprintf(stderr, "[!] Unreadable: " ADDR "-" ADDR ", zero-filled\n", page + i * ps, page + (j + 1) * ps);
+            bad += j - i + 1;
+            i = j;
+        }
+        fprintf(stderr, "[!] %zu of %zu pages of %s could not be read\n", bad, npages, seg->segname);
+    }
+    free(valid);
+    return 0;
+}
+
 int main(int argc, const char **argv)
 {
     vm_address_t kbase;
@@ -63,6 +103,10 @@ int main(int argc, const char **argv)
         {
             verbose = true;
         }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
         else
         {
             fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
@@ -149,9 +193,8 @@ int main(int argc, const char **argv)
             case MACH_LC_SEGMENT:
                 seg = (mach_seg_t*)cmd;
                 fprintf(stderr, "[+] Found segment %s\n", seg->segname);
-                if(kernel_read(seg->vmaddr, seg->filesize, binary + seg->fileoff) != seg->filesize)
+                if(dump_segment(seg, binary + seg->fileoff) != 0)
                 {
-                    fprintf(stderr, "[!] Kernel I/O error\n");
                     return -1;
                 }
             case LC_UUID:
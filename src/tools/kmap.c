@@ -5,22 +5,28 @@
  * Copyright (c) 2016-2017 Siguza
  */
 
+#include <errno.h>              // errno
 #include <limits.h>             // UINT_MAX
 #include <stdbool.h>            // bool, true, false
 #include <stdio.h>              // printf, fprintf, stderr
+#include <stdlib.h>             // free, qsort, realloc
+#include <string.h>             // strcmp, strerror, strncpy
+#include <unistd.h>             // STDOUT_FILENO
 
 #include <mach/kern_return.h>   // KERN_SUCCESS, kern_return_t
 #include <mach/mach_types.h>    // task_t
-#include <mach/message.h>       // mach_msg_type_number_t
 #include <mach/vm_inherit.h>    // VM_INHERIT_*
-#include <mach/vm_map.h>        // vm_region_recurse_64
 #include <mach/vm_prot.h>       // VM_PROT_READ, VM_PROT_WRITE, VM_PROT_EXECUTE
-#include <mach/vm_region.h>     // VM_REGION_SUBMAP_INFO_COUNT_64, vm_region_info_t, vm_region_submap_info_data_64_t
+#include <mach/vm_region.h>     // vm_region_submap_info_data_64_t
 #include <mach/vm_types.h>      // vm_address_t, vm_size_t
 
-#include "arch.h"               // ADDR
+#include "arch.h"               // ADDR, MACH_LC_SEGMENT, mach_*
 #include "debug.h"              // slow, verbose
-#include "libkern.h"            // get_kernel_task
+#include "emit.h"               // emit_*
+#include "kext.h"               // kext_*
+#include "libkern.h"            // KERNEL_BASE_OR_GTFO, KERNEL_TASK_OR_GTFO, kernel_header, kernel_region
+#include "mach-o.h"             // CMD_ITERATE, macho_slide
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
 
 #define VM_KERN_MEMORY_NONE             0
 #define VM_KERN_MEMORY_OSFMK            1
@@ -274,22 +280,261 @@ static const char* inheritance(vm_inherit_t inh)
 
 static void print_usage(const char *self)
 {
-    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-e]\n"
-                    "    -d  Debug mode (sleep between function calls, gives\n"
-                    "        sshd time to deliver output before kernel panic)\n"
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-S] [-e] [-g] [-k] [-o json|bin]\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
                     "    -e  Extended output (print all information available)\n"
                     "    -g  Show gaps between regions\n"
                     "    -h  Print this help\n"
+                    "    -k  Show the kext and segment or section each region belongs to\n"
+                    "    -o  Output format: text (default), json or bin (see emit.h),\n"
+                    "        structured output always has all information\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
                     "    -v  Verbose (debug output)\n"
                     , self);
 }
 
-static void print_range(task_t kernel_task, bool extended, bool gaps, unsigned int level, vm_address_t min, vm_address_t max)
+static emit_t out;
+
+/*
+ * For -k: the kernel's sections (or segments, if they have none) and the
+ * segments of all kexts, as one sorted list without overlaps, kexts taking
+ * precedence. Regions come in ascending order, so they are matched against
+ * it by a cursor that only ever moves forward.
+ */
+#define OWNER_NAME_SIZE 34
+
+typedef struct
+{
+    vm_address_t start;
+    vm_address_t end;
+    const char *owner;      // Bundle identifier, or "kernel"
+    char name[OWNER_NAME_SIZE]; // seg or seg.sect
+} owner_t;
+
+static struct
+{
+    bool enabled;
+    size_t count;
+    size_t cap;
+    owner_t *list;
+    size_t cursor;
+    kext_index_t *kexts;
+} owners;
+
+static bool owner_add(vm_address_t start, vm_address_t end, const char *owner, const char *name)
+{
+    if(start >= end)
+    {
+        return true;
+    }
+    if(owners.count >= owners.cap)
+    {
+        size_t cap = owners.cap ? owners.cap * 2 : 0x100;
+        owner_t *list = realloc(owners.list, cap * sizeof(*list));
+        if(list == NULL)
+        {
+            return false;
+        }
+        owners.list = list;
+        owners.cap = cap;
+    }
+    owner_t *o = &owners.list[owners.count++];
+    o->start = start;
+    o->end = end;
+    o->owner = owner;
+    strncpy(o->name, name, sizeof(o->name) - 1);
+    o->name[sizeof(o->name) - 1] = '\0';
+    return true;
+}
+
+// Add the parts of a kernel piece that no kext covers, from kext entry *k on
+static bool owner_add_kernel(const owner_t *piece, size_t *k)
+{
+    const kext_index_t *kx = owners.kexts;
+    size_t nk = kx != NULL ? kx->count : 0;
+    vm_address_t start = piece->start;
+    while(*k < nk && kx->entries[*k].end <= start)
+    {
+        ++*k;
+    }
+    for(size_t i = *k; start < piece->end; )
+    {
+        if(i < nk && kx->entries[i].start <= start)
+        {
+            start = kx->entries[i].end > start ? kx->entries[i].end : start;
+            ++i;
+            continue;
+        }
+        vm_address_t next = i < nk && kx->entries[i].start < piece->end ? kx->entries[i].start : piece->end;
+        if(!owner_add(start, next, piece->owner, piece->name))
+        {
+            return false;
+        }
+        start = next;
+    }
+    return true;
+}
+
+static int owner_cmp(const void *a, const void *b)
+{
+    const owner_t *x = a,
+                  *y = b;
+    return x->start < y->start ? -1 : x->start > y->start ? 1 : 0;
+}
+
+static bool owners_build(vm_address_t kbase)
+{
+    owners.kexts = kext_index(kbase);
+    if(owners.kexts == NULL)
+    {
+        fprintf(stderr, "[!] Failed to index kexts, only showing kernel segments\n");
+    }
+    mach_hdr_t *hdr = kernel_header(kbase);
+    if(hdr == NULL)
+    {
+        fprintf(stderr, "[!] Failed to read kernel header\n");
+        return false;
+    }
+    vm_address_t slide = macho_slide(hdr, kbase);
+    bool ok = true;
+    char name[OWNER_NAME_SIZE];
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(!ok || cmd->cmd != MACH_LC_SEGMENT)
+        {
+            continue;
+        }
+        mach_seg_t *seg = (mach_seg_t*)cmd;
+        mach_sec_t *sec = (mach_sec_t*)(seg + 1);
+        if(seg->nsects == 0)
+        {
+            snprintf(name, sizeof(name), "%.16s", seg->segname);
+            ok = owner_add(seg->vmaddr + slide, seg->vmaddr + slide + seg->vmsize, "kernel", name);
+        }
+        // Whatever the sections leave of the segment (like the header)
+        // goes by the segment's name
+        vm_address_t at = seg->vmaddr;
+        for(size_t i = 0; i < seg->nsects && ok; ++i)
+        {
+            snprintf(name, sizeof(name), "%.16s", seg->segname);
+            ok = owner_add(at + slide, sec[i].addr + slide, "kernel", name);
+            snprintf(name, sizeof(name), "%.16s.%.16s", sec[i].segname, sec[i].sectname);
+            ok = ok && owner_add(sec[i].addr + slide, sec[i].addr + slide + sec[i].size, "kernel", name);
+            at = sec[i].addr + sec[i].size > at ? sec[i].addr + sec[i].size : at;
+        }
+        if(seg->nsects > 0 && ok)
+        {
+            snprintf(name, sizeof(name), "%.16s", seg->segname);
+            ok = owner_add(at + slide, seg->vmaddr + slide + seg->vmsize, "kernel", name);
+        }
+    }
+    free(hdr);
+    if(!ok)
+    {
+        return false;
+    }
+    qsort(owners.list, owners.count, sizeof(*owners.list), &owner_cmp);
+
+    // Cut the kernel's pieces around kexts, then add those
+    owner_t *kernel = owners.list;
+    size_t nkernel = owners.count,
+           k = 0;
+    owners.list = NULL;
+    owners.count = owners.cap = 0;
+    for(size_t i = 0; i < nkernel && ok; ++i)
+    {
+        ok = owner_add_kernel(&kernel[i], &k);
+    }
+    free(kernel);
+    for(size_t i = 0; owners.kexts != NULL && i < owners.kexts->count && ok; ++i)
+    {
+        const kext_entry_t *e = &owners.kexts->entries[i];
+        ok = owner_add(e->start, e->end, e->name, e->segname);
+    }
+    if(ok)
+    {
+        qsort(owners.list, owners.count, sizeof(*owners.list), &owner_cmp);
+        DEBUG("%zu owner ranges", owners.count);
+    }
+    return ok;
+}
+
+// First piece overlapping the range, and how many do in total
+static const owner_t* owner_of(vm_address_t addr, vm_size_t size, size_t *count)
+{
+    while(owners.cursor < owners.count && owners.list[owners.cursor].end <= addr)
+    {
+        ++owners.cursor;
+    }
+    size_t i = owners.cursor;
+    while(i < owners.count && owners.list[i].start < addr + size)
+    {
+        ++i;
+    }
+    *count = i - owners.cursor;
+    return *count > 0 ? &owners.list[owners.cursor] : NULL;
+}
+
+static void print_owner(vm_address_t addr, vm_size_t size)
+{
+    size_t count;
+    const owner_t *o = owner_of(addr, size, &count);
+    if(o != NULL)
+    {
+        printf(" %s %s", o->owner, o->name);
+        if(count > 1)
+        {
+            printf(" (+%zu)", count - 1);
+        }
+    }
+}
+
+// One record per region, with everything extended output has
+static void emit_region(vm_address_t addr, vm_size_t size, unsigned int level, unsigned int depth, const vm_region_submap_info_data_64_t *info)
+{
+    const char *tag = kern_tag(info->user_tag);
+    emit_begin(&out, "region");
+    emit_hex(&out, "addr", addr);
+    emit_hex(&out, "end", addr + size);
+    emit_u64(&out, "size", size);
+    emit_u64(&out, "level", level);
+    emit_u64(&out, "prot", info->protection);
+    emit_u64(&out, "max_prot", info->max_protection);
+    emit_str(&out, "kind", info->is_submap ? "map" : depth > 0 ? "sub" : "mem");
+    emit_str(&out, "share_mode", share_mode(info->share_mode));
+    emit_str(&out, "inheritance", inheritance(info->inheritance));
+    emit_hex(&out, "offset", info->offset);
+    emit_u64(&out, "user_tag", info->user_tag);
+    if(tag != 0)
+    {
+        emit_str(&out, "tag", tag);
+    }
+    emit_hex(&out, "object_id", info->object_id);
+    emit_u64(&out, "ref_count", info->ref_count);
+    emit_u64(&out, "pages_swapped_out", info->pages_swapped_out);
+    emit_u64(&out, "pages_shared_now_private", info->pages_shared_now_private);
+    emit_u64(&out, "pages_resident", info->pages_resident);
+    emit_u64(&out, "pages_dirtied", info->pages_dirtied);
+    if(owners.enabled)
+    {
+        size_t count;
+        const owner_t *o = owner_of(addr, size, &count);
+        if(o != NULL)
+        {
+            emit_str(&out, "owner", o->owner);
+            emit_str(&out, "section", o->name);
+        }
+        emit_u64(&out, "owners", count);
+    }
+    emit_end(&out);
+}
+
+static void print_range(bool extended, bool gaps, unsigned int level, vm_address_t min, vm_address_t max)
 {
     vm_region_submap_info_data_64_t info;
     vm_address_t last_addr = min;
     vm_size_t size, last_size;
-    mach_msg_type_number_t info_count = VM_REGION_SUBMAP_INFO_COUNT_64;
     unsigned int depth;
     size_t displaysize, last_displaysize;
     char scale, last_scale;
@@ -299,7 +544,7 @@ static void print_range(task_t kernel_task, bool extended, bool gaps, unsigned i
     {
         // get next memory region
         depth = level;
-        if(vm_region_recurse_64(kernel_task, &addr, &size, &depth, (vm_region_info_t)&info, &info_count) != KERN_SUCCESS)
+        if(kernel_region(&addr, &size, &depth, &info) != KERN_SUCCESS)
         {
             break;
         }
@@ -313,7 +558,16 @@ static void print_range(task_t kernel_task, bool extended, bool gaps, unsigned i
             if(last_addr != 0)
             {
                 last_size = addr - last_addr;
-                if(last_size > 0)
+                if(last_size > 0 && out.fmt != EMIT_TEXT)
+                {
+                    emit_begin(&out, "gap");
+                    emit_hex(&out, "addr", last_addr);
+                    emit_hex(&out, "end", addr);
+                    emit_u64(&out, "size", last_size);
+                    emit_u64(&out, "level", level);
+                    emit_end(&out);
+                }
+                else if(last_size > 0)
                 {
                     last_scale = 'K';
                     last_displaysize = last_size / 1024;
@@ -365,10 +619,14 @@ static void print_range(task_t kernel_task, bool extended, bool gaps, unsigned i
         maxW = (info.max_protection) & VM_PROT_WRITE ? 'w' : '-';
         maxX = (info.max_protection) & VM_PROT_EXECUTE ? 'x' : '-';
 
-        if(extended)
+        if(out.fmt != EMIT_TEXT)
+        {
+            emit_region(addr, size, level, depth, &info);
+        }
+        else if(extended)
         {
             if (kern_tag(info.user_tag) != 0) {
-                printf("%*s" ADDR "-" ADDR "%*s" " [%4zu%c] %c%c%c%c/%c%c%c%c [%s %s %s] %016llx [%u %u %hu %hhu %hu] %08x/%08x:<%10u> %u,%u {%10u,%10u} %s\n"
+                printf("%*s" ADDR "-" ADDR "%*s" " [%4zu%c] %c%c%c%c/%c%c%c%c [%s %s %s] %016llx [%u %u %hu %hhu %hu] %08x/%08x:<%10u> %u,%u {%10u,%10u} %s"
                     , 4 * level, "", addr, addr+size, 4 * (1 - level), ""
                     , displaysize, scale
                     , curA, curR, curW, curX
@@ -380,7 +638,7 @@ static void print_range(task_t kernel_task, bool extended, bool gaps, unsigned i
                     , kern_tag(info.user_tag)
                 );
             } else {
-                printf("%*s" ADDR "-" ADDR "%*s" " [%4zu%c] %c%c%c%c/%c%c%c%c [%s %s %s] %016llx [%u %u %hu %hhu %hu] %08x/%08x:<%10u> %u,%u {%10u,%10u} %d\n"
+                printf("%*s" ADDR "-" ADDR "%*s" " [%4zu%c] %c%c%c%c/%c%c%c%c [%s %s %s] %016llx [%u %u %hu %hhu %hu] %08x/%08x:<%10u> %u,%u {%10u,%10u} %d"
                     , 4 * level, "", addr, addr+size, 4 * (1 - level), ""
                     , displaysize, scale
                     , curA, curR, curW, curX
@@ -395,14 +653,22 @@ static void print_range(task_t kernel_task, bool extended, bool gaps, unsigned i
         }
         else
         {
-            printf(ADDR "-" ADDR " [%4zu%c] %c%c%c/%c%c%c\n"
+            printf(ADDR "-" ADDR " [%4zu%c] %c%c%c/%c%c%c"
                    , addr, addr + size, displaysize, scale
                    , curR, curW, curX, maxR, maxW, maxX);
         }
+        if(out.fmt == EMIT_TEXT)
+        {
+            if(owners.enabled)
+            {
+                print_owner(addr, size);
+            }
+            printf("\n");
+        }
 
         if(info.is_submap)
         {
-            print_range(kernel_task, extended, gaps, level + 1, addr, addr + size);
+            print_range(extended, gaps, level + 1, addr, addr + size);
         }
     }
 }
@@ -411,6 +677,8 @@ int main(int argc, const char **argv)
 {
     bool extended = false,
          gaps     = false;
+    vm_address_t kbase;
+    emit_fmt_t fmt = EMIT_TEXT;
 
     for(int i = 1; i < argc; ++i)
     {
@@ -427,6 +695,10 @@ int main(int argc, const char **argv)
         {
             verbose = true;
         }
+        else if(strcmp(argv[i], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
         else if(strcmp(argv[i], "-e") == 0)
         {
             extended = true;
@@ -435,6 +707,19 @@ int main(int argc, const char **argv)
         {
             gaps = true;
         }
+        else if(strcmp(argv[i], "-k") == 0)
+        {
+            owners.enabled = true;
+        }
+        else if(strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            if(!emit_parse_fmt(argv[++i], &fmt))
+            {
+                fprintf(stderr, "[!] Unknown output format: %s\n\n", argv[i]);
+                print_usage(argv[0]);
+                return -1;
+            }
+        }
         else
         {
             fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[i]);
@@ -443,10 +728,29 @@ int main(int argc, const char **argv)
         }
     }
 
-    task_t kernel_task;
-    KERNEL_TASK_OR_GTFO(kernel_task);
+    if(owners.enabled)
+    {
+        KERNEL_BASE_OR_GTFO(kbase);
+        if(!owners_build(kbase))
+        {
+            fprintf(stderr, "[!] Failed to build kernel segment index\n");
+            return -1;
+        }
+    }
+    else
+    {
+        KERNEL_TASK_OR_GTFO();
+    }
 
-    print_range(kernel_task, extended, gaps, 0, 0, ~0);
+    emit_init(&out, STDOUT_FILENO, fmt);
+    print_range(extended, gaps, 0, 0, ~0);
+    free(owners.list);
+    kext_index_free(owners.kexts);
+    if(emit_flush(&out) != 0)
+    {
+        fprintf(stderr, "[!] Failed to write output (%s)\n", strerror(errno));
+        return -1;
+    }
 
     return 0;
 }
@@ -7,22 +7,28 @@
 
 #include <errno.h>              // errno
 #include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t
 #include <stdio.h>              // printf, fprintf
 #include <stdlib.h>             // free, malloc, strtoull
-#include <string.h>             // memset, strlen
-#include <unistd.h>             // getopt, write, STDOUT_FILENO
+#include <string.h>             // memset, strerror, strlen
+#include <unistd.h>             // getopt, optarg, write, STDOUT_FILENO
 
 #include <mach/mach_types.h>    // task_t
 #include <mach/vm_types.h>      // vm_address_t, vm_size_t
 
 #include "arch.h"               // ADDR
-#include "libkern.h"            // KERNEL_TASK_OR_GTFO, kernel_read
+#include "emit.h"               // emit_*
+#include "func.h"               // func_*
+#include "libkern.h"            // KERNEL_BASE_OR_GTFO, KERNEL_TASK_OR_GTFO, kernel_read_sparse, kernel_page_*
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
 
-static void hexdump(unsigned char *data, size_t size)
+// Bytes on pages that couldn't be read show up as ??
+static void hexdump(unsigned char *data, size_t size, vm_address_t addr, const uint8_t *valid)
 {
     int i;
     char cs[17];
     memset(cs, 0, 17);
+    vm_size_t ps = kernel_page_size();
 
     for(i = 0; i < size; i++)
     {
@@ -35,8 +41,17 @@ static void hexdump(unsigned char *data, size_t size)
         {
             printf(" ");
         }
-        printf("%02X ", data[i]);
-        cs[(i % 0x10)] = (data[i] >= 0x20 && data[i] <= 0x7e) ? data[i] : '.';
+        size_t page = (addr + i) / ps - addr / ps;
+        if(valid[page / 8] & (1 << (page % 8)))
+        {
+            printf("%02X ", data[i]);
+            cs[(i % 0x10)] = (data[i] >= 0x20 && data[i] <= 0x7e) ? data[i] : '.';
+        }
+        else
+        {
+            printf("?? ");
+            cs[(i % 0x10)] = '?';
+        }
     }
 
     i = i % 0x10;
@@ -54,14 +69,45 @@ static void hexdump(unsigned char *data, size_t size)
     printf(" |%s|\n", cs);
 }
 
+#define EMIT_CHUNK 0x1000
+
+static emit_t out;
+
+// One record per chunk, never crossing a page, so each is all valid or not at all
+static void emit_dump(const unsigned char *data, size_t size, vm_address_t addr, const uint8_t *valid)
+{
+    vm_size_t ps = kernel_page_size();
+    for(size_t off = 0; off < size; )
+    {
+        size_t n = ps - (addr + off) % ps;
+        n = n < EMIT_CHUNK ? n : EMIT_CHUNK;
+        n = n < size - off ? n : size - off;
+        size_t page = (addr + off) / ps - addr / ps;
+        bool ok = valid[page / 8] & (1 << (page % 8));
+        emit_begin(&out, "mem");
+        emit_hex(&out, "addr", addr + off);
+        emit_u64(&out, "size", n);
+        emit_bool(&out, "valid", ok);
+        if(ok)
+        {
+            emit_bytes(&out, "data", &data[off], n);
+        }
+        emit_end(&out);
+        off += n;
+    }
+}
+
 static void print_usage(const char *self)
 {
-    fprintf(stderr, "Usage: %s [-r] [-h] addr length\n"
+    fprintf(stderr, "Usage: %s [-r | -o json|bin] [-f] [-S] [-h] addr length\n"
                     "0x for hex, no prefix for decimal\n"
                     "\n"
                     "Options:\n"
+                    "    -f  Show the function addr is in (from LC_FUNCTION_STARTS)\n"
                     "    -h  Help\n"
+                    "    -o  Output format: text (default), json or bin (see emit.h)\n"
                     "    -r  Raw (binary) output (defaults to hex)\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
                     , self);
 }
 
@@ -73,24 +119,47 @@ static void too_few_args(const char *self)
 
 int main(int argc, char **argv)
 {
-    bool raw = false; // print raw bytes instead of a hexdump
+    bool raw = false, // print raw bytes instead of a hexdump
+         func = false;
+    emit_fmt_t fmt = EMIT_TEXT;
     vm_address_t addr;
     vm_size_t size;
     char c, *end;
 
-    while((c = getopt(argc, argv, "rh")) != -1)
+    while((c = getopt(argc, argv, "ro:fSh")) != -1)
     {
         switch (c)
         {
             case 'r':
                 raw = true;
                 break;
+            case 'o':
+                if(!emit_parse_fmt(optarg, &fmt))
+                {
+                    fprintf(stderr, "[!] Unknown output format: %s\n\n", optarg);
+                    print_usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'f':
+                func = true;
+                break;
+            case 'S':
+                stats_at_exit(STATS_HUMAN);
+                break;
             case 'h':
                 print_usage(argv[0]);
                 return 0;
         }
     }
 
+    if(raw && fmt != EMIT_TEXT)
+    {
+        fprintf(stderr, "[!] -r and -o are mutually exclusive\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
     if(argc < optind + 2)
     {
         too_few_args(argv[0]);
@@ -122,22 +191,71 @@ int main(int argc, char **argv)
 
     KERNEL_TASK_OR_GTFO();
 
-    if(!raw)
+    if(func)
+    {
+        vm_address_t kbase;
+        KERNEL_BASE_OR_GTFO(kbase);
+        func_table_t *ft = func_table(kbase);
+        if(ft == NULL)
+        {
+            fprintf(stderr, "[!] Failed to get the kernel's function starts\n");
+            return -1;
+        }
+        ssize_t i = func_lookup(ft, addr);
+        if(i < 0)
+        {
+            fprintf(stderr, "[*] 0x" ADDR " is not in any function\n", addr);
+        }
+        else
+        {
+            fprintf(stderr, "[*] 0x" ADDR " is func_" ADDR "+0x%llx (function size 0x%llx)\n", addr, ft->starts[i], (unsigned long long)(addr - ft->starts[i]), (unsigned long long)func_size(ft, i));
+        }
+        func_table_free(ft);
+    }
+
+    if(!raw && fmt == EMIT_TEXT)
     {
         fprintf(stderr, "[*] Reading " SIZE " bytes from 0x" ADDR "\n", size, addr);
     }
     unsigned char* buf = malloc(size);
-    kernel_read(addr, size, buf);
+    uint8_t *valid = malloc((kernel_page_count(addr, size) + 7) / 8);
+    if(buf == NULL || valid == NULL)
+    {
+        fprintf(stderr, "[!] Failed to allocate buffer: %s\n", strerror(errno));
+        return -1;
+    }
+    vm_size_t got = kernel_read_sparse(addr, size, buf, valid);
+    if(got == 0)
+    {
+        fprintf(stderr, "[!] Failed to read kernel memory at 0x" ADDR "\n", addr);
+        return -1;
+    }
+    if(got != size)
+    {
+        // Raw output is zero-filled, hexdump marks the holes
+        fprintf(stderr, "[!] Only " SIZE " of " SIZE " bytes could be read\n", got, size);
+    }
 
     if(raw)
     {
         write(STDOUT_FILENO, buf, size);
     }
+    else if(fmt != EMIT_TEXT)
+    {
+        emit_init(&out, STDOUT_FILENO, fmt);
+        emit_dump(buf, size, addr, valid);
+        if(emit_flush(&out) != 0)
+        {
+            fprintf(stderr, "[!] Failed to write output (%s)\n", strerror(errno));
+            return -1;
+        }
+    }
     else
     {
-        hexdump(buf, size);
+        hexdump(buf, size, addr, valid);
     }
 
+    free(valid);
     free(buf);
     return 0;
 }
@@ -13,8 +13,9 @@
 #include <mach/vm_types.h>      // vm_address_t, vm_size_t
 
 #include "arch.h"               // SIZE
-#include "debug.h"              // slow, verbose
+#include "debug.h"              // debug_flush, slow, verbose
 #include "libkern.h"            // kernel_write
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
 
 static void print_usage(const char *self)
 {
@@ -24,12 +25,13 @@ static void print_usage(const char *self)
                     "    %s [options] -x addr ...\n"
                     "\n"
                     "Options:\n"
-                    "    -d  Debug mode (sleep between function calls, gives\n"
-                    "        sshd time to deliver output before kernel panic)\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
                     "    -f  Read patch from file\n"
                     "    -h  Print this help\n"
                     "    -q  Patch uint64 from immediate\n"
                     "        (Requires addr to be 8-byte aligned)\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
                     "    -v  Verbose (debug output)\n"
                     "    -w  Patch uint32 from immediate\n"
                     "        (Requires addr to be 4-byte aligned)\n"
@@ -66,6 +68,10 @@ int main(int argc, const char **argv)
         {
             verbose = true;
         }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
         else if(strcmp(argv[aoff], "-f") == 0)
         {
             file = true;
@@ -222,6 +228,7 @@ do \
         return -1;
     }
 
+    debug_flush();
     vm_size_t written = kernel_write(addr, len, patch);
     if(written != len)
     {
@@ -0,0 +1,261 @@
+/*
+ * kphys.c - Read physical memory and dump it, or copy it around
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <fcntl.h>              // open, O_*
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint64_t
+#include <stdio.h>              // printf, fprintf
+#include <stdlib.h>             // free, malloc, strtoull
+#include <string.h>             // memset, strerror
+#include <unistd.h>             // close, getopt, optarg, write, STDOUT_FILENO
+
+#include <mach/vm_types.h>      // vm_size_t
+
+#include "arch.h"               // SIZE
+#include "libkern.h"            // kernel_copy_phys, kernel_has_phys, kernel_read_phys
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
+
+#define DEFAULT_CHUNK 0x100000
+
+static void hexdump(const unsigned char *data, size_t size, uint64_t addr)
+{
+    char cs[17];
+    for(size_t i = 0; i < size; i += 0x10)
+    {
+        memset(cs, 0, sizeof(cs));
+        printf("%016llx: ", (unsigned long long)(addr + i));
+        for(size_t j = 0; j < 0x10; ++j)
+        {
+            if(j == 0x8)
+            {
+                printf(" ");
+            }
+            if(i + j < size)
+            {
+                printf("%02X ", data[i + j]);
+                cs[j] = (data[i + j] >= 0x20 && data[i + j] <= 0x7e) ? data[i + j] : '.';
+            }
+            else
+            {
+                printf("   ");
+            }
+        }
+        printf(" |%s|\n", cs);
+    }
+}
+
+// Write all of it, unless the fd breaks
+static bool write_all(int fd, const unsigned char *data, size_t size)
+{
+    while(size > 0)
+    {
+        ssize_t n = write(fd, data, size);
+        if(n < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool parse_num(const char *str, uint64_t *num)
+{
+    char *end;
+    errno = 0;
+    *num = strtoull(str, &end, 0);
+    if(str[0] == '\0' || end[0] != '\0' || errno != 0)
+    {
+        fprintf(stderr, "[!] Failed to parse \"%s\": %s\n", str, str[0] == '\0' ? "zero characters given" : strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-r | -f file | -c dst] [-b size] [-S] [-h] paddr length\n"
+                    "Dumps physical memory, in chunks, as hex or raw bytes.\n"
+                    "Only works where the kernel can be accessed by physical address (Corellium).\n"
+                    "0x for hex, no prefix for decimal\n"
+                    "\n"
+                    "Options:\n"
+                    "    -b  Bytes per read (default 0x%x)\n"
+                    "    -c  Copy the range to physical address dst instead\n"
+                    "    -f  Write raw bytes to file\n"
+                    "    -h  Help\n"
+                    "    -r  Raw (binary) output (defaults to hex)\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
+                    , self, DEFAULT_CHUNK);
+}
+
+int main(int argc, char **argv)
+{
+    bool raw = false,
+         copy = false;
+    const char *outfile = NULL;
+    uint64_t addr,
+             size,
+             dst = 0,
+             chunk = DEFAULT_CHUNK;
+    int c;
+
+    while((c = getopt(argc, argv, "rf:c:b:Sh")) != -1)
+    {
+        switch(c)
+        {
+            case 'r':
+                raw = true;
+                break;
+            case 'f':
+                outfile = optarg;
+                break;
+            case 'c':
+                if(!parse_num(optarg, &dst))
+                {
+                    return -1;
+                }
+                copy = true;
+                break;
+            case 'b':
+                if(!parse_num(optarg, &chunk))
+                {
+                    return -1;
+                }
+                if(chunk == 0)
+                {
+                    fprintf(stderr, "[!] Chunk size must be > 0\n");
+                    return -1;
+                }
+                break;
+            case 'S':
+                stats_at_exit(STATS_HUMAN);
+                break;
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+            default:
+                print_usage(argv[0]);
+                return -1;
+        }
+    }
+
+    if((raw ? 1 : 0) + (outfile != NULL ? 1 : 0) + (copy ? 1 : 0) > 1)
+    {
+        fprintf(stderr, "[!] -r, -f and -c are mutually exclusive\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if(argc < optind + 2)
+    {
+        fprintf(stderr, "[!] Too few arguments\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if(!parse_num(argv[optind], &addr) || !parse_num(argv[optind + 1], &size))
+    {
+        return -1;
+    }
+    if(size == 0)
+    {
+        fprintf(stderr, "[!] Size must be > 0\n");
+        return -1;
+    }
+    if(addr + size < addr || (copy && dst + size < dst))
+    {
+        fprintf(stderr, "[!] Range wraps around\n");
+        return -1;
+    }
+
+    if(!kernel_has_phys())
+    {
+        fprintf(stderr, "[!] No physical memory access with this backend\n");
+        return -1;
+    }
+
+    if(copy)
+    {
+        fprintf(stderr, "[*] Copying 0x%llx bytes from 0x%llx to 0x%llx\n", (unsigned long long)size, (unsigned long long)addr, (unsigned long long)dst);
+        vm_size_t done = kernel_copy_phys(dst, addr, size);
+        if(done != size)
+        {
+            fprintf(stderr, "[!] Only " SIZE " of 0x%llx bytes could be copied\n", done, (unsigned long long)size);
+            return -1;
+        }
+        return 0;
+    }
+
+    int fd = STDOUT_FILENO;
+    if(outfile != NULL)
+    {
+        fd = open(outfile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+        {
+            fprintf(stderr, "[!] Failed to open %s for writing: %s\n", outfile, strerror(errno));
+            return -1;
+        }
+    }
+    raw = raw || outfile != NULL;
+    if(chunk > size)
+    {
+        chunk = size;
+    }
+    unsigned char *buf = malloc(chunk);
+    if(buf == NULL)
+    {
+        fprintf(stderr, "[!] Failed to allocate buffer: %s\n", strerror(errno));
+        return -1;
+    }
+
+    int ret = 0;
+    uint64_t done = 0;
+    while(done < size)
+    {
+        vm_size_t want = size - done < chunk ? size - done : chunk,
+                  got = kernel_read_phys(addr + done, want, buf);
+        if(raw)
+        {
+            if(!write_all(fd, buf, got))
+            {
+                fprintf(stderr, "[!] Failed to write output: %s\n", strerror(errno));
+                ret = -1;
+                break;
+            }
+        }
+        else
+        {
+            hexdump(buf, got, addr + done);
+        }
+        done += got;
+        if(got != want)
+        {
+            fprintf(stderr, "[!] Failed to read physical memory at 0x%llx, stopping after 0x%llx of 0x%llx bytes\n"
+                    , (unsigned long long)(addr + done), (unsigned long long)done, (unsigned long long)size);
+            ret = -1;
+            break;
+        }
+    }
+    if(outfile != NULL)
+    {
+        if(close(fd) != 0 && ret == 0)
+        {
+            fprintf(stderr, "[!] Failed to write %s: %s\n", outfile, strerror(errno));
+            ret = -1;
+        }
+        else if(ret == 0)
+        {
+            fprintf(stderr, "[*] Done, wrote 0x%llx bytes to %s\n", (unsigned long long)done, outfile);
+        }
+    }
+    free(buf);
+    return ret;
+}
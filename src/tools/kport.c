@@ -0,0 +1,1327 @@
+/*
+ * kport.c - Port addresses from one kernelcache to another
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <fcntl.h>              // open, O_RDONLY
+#include <pthread.h>            // pthread_*
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // int64_t, uint8_t, uint32_t, uint64_t
+#include <stdio.h>              // FILE, fclose, fgets, fopen, printf, fprintf, stderr
+#include <stdlib.h>             // calloc, free, malloc, qsort, realloc, strtoul, strtoull
+#include <string.h>             // memcmp, memset, strcmp, strcspn, strdup, strerror, strlen, strnlen, strspn
+#include <unistd.h>             // close, sysconf, _SC_NPROCESSORS_ONLN
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <mach-o/loader.h>      // LC_SYMTAB, S_CSTRING_LITERALS, SECTION_TYPE, struct symtab_command
+#include <mach-o/nlist.h>       // N_SECT, N_STAB, N_TYPE
+#include <sys/mman.h>           // mmap, munmap, MAP_FAILED, MAP_PRIVATE, PROT_READ
+#include <sys/stat.h>           // fstat, struct stat
+#include <sys/types.h>          // ssize_t
+
+#include "arch.h"               // ADDR, MACH_*, mach_*
+#include "debug.h"              // DEBUG, slow, verbose
+#include "func.h"               // func_*
+#include "mach-o.h"             // CMD_ITERATE, LC_FILESET_ENTRY
+#include "timer.h"              // timer_ns
+
+#define MAX_THREADS 64
+#define JOB_FUNCS   256     /* Functions per job */
+#define MIN_INSNS   4       /* Shorter ones are too alike to match by hash */
+#define MAX_PASSES  8
+#define ALIGN_CONTEXT 3     /* Instructions either side compared within a function */
+#define DEFAULT_MIN_SCORE 50
+
+typedef enum
+{
+    BY_NONE,
+    BY_NAME,
+    BY_EXACT,       // Same instructions, up to registers and PC-relative immediates
+    BY_STRINGS,     // Same set of referenced strings
+    BY_SHAPE,       // Same kinds of instructions
+    BY_CALLS,       // Called at the same place by matched functions
+} how_t;
+
+// Confidence in each way of matching, in percent
+static const unsigned int how_score[] = { 0, 100, 95, 85, 75, 65 };
+
+#define SCORE_STRING 90     /* A unique C string */
+#define SCORE_XREF   90     /* A global, if all references agree */
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-j threads] [-m score] old new [addresses]\n"
+                    "Matches the functions of two decompressed kernelcaches and ports addresses\n"
+                    "from old to new. addresses is a file with one address per line, optionally\n"
+                    "followed by a name. Each is printed with its new address and a confidence\n"
+                    "score from 0 to 100, or \"-\" if it couldn't be ported. Without addresses,\n"
+                    "prints every function match instead. Exits with 1 if any address couldn't\n"
+                    "be ported.\n"
+                    "\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
+                    "    -h  Print this help\n"
+                    "    -j  Number of threads (default: one per CPU)\n"
+                    "    -m  Lowest score to accept (default %u)\n"
+                    "    -v  Verbose (debug output)\n"
+                    , self, DEFAULT_MIN_SCORE);
+}
+
+static bool parse_num(const char *str, unsigned long *num)
+{
+    char *end;
+    errno = 0;
+    *num = strtoul(str, &end, 0);
+    if(str[0] == '\0' || end[0] != '\0' || errno != 0)
+    {
+        fprintf(stderr, "[!] Failed to parse \"%s\": %s\n", str, str[0] == '\0' ? "zero characters given" : errno != 0 ? strerror(errno) : "not a number");
+        return false;
+    }
+    return true;
+}
+
+static inline uint64_t mix(uint64_t v)
+{
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    v *= 0xc4ceb9fe1a85ec53ULL;
+    v ^= v >> 33;
+    return v;
+}
+
+static uint64_t hash_bytes(const char *s, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for(size_t i = 0; i < len; ++i)
+    {
+        h = (h ^ (uint8_t)s[i]) * 0x100000001b3ULL;
+    }
+    return mix(h ^ len);
+}
+
+/********** Images **********/
+
+typedef struct
+{
+    vm_address_t addr;
+    vm_size_t size;
+    size_t off;             // In the file
+} span_t;
+
+typedef struct
+{
+    uint64_t exact;
+    uint64_t shape;
+    uint64_t strings;       // Sum of the hashes of referenced strings, 0 if none
+    uint32_t ninsns;
+    uint32_t ncalls;
+} feat_t;
+
+typedef struct
+{
+    const char *path;
+    const mach_hdr_t *hdr;
+    size_t filesize;
+    func_table_t *ft;
+    span_t *segs;           // Sorted by address
+    size_t nsegs;
+    span_t *cstrings;       // C string sections, sorted by address
+    size_t ncstrings;
+    size_t cap;
+    const char **names;     // Symbol of each function, or NULL
+    feat_t *feat;
+    ssize_t *match;         // Function in the other image, or -1
+    how_t *how;
+} image_t;
+
+static const mach_hdr_t* map_kernelcache(const char *path, size_t *filesize)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        fprintf(stderr, "[!] Failed to open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    struct stat s;
+    if(fstat(fd, &s) != 0)
+    {
+        fprintf(stderr, "[!] Failed to stat %s: %s\n", path, strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    *filesize = s.st_size;
+    const mach_hdr_t *hdr = *filesize >= sizeof(mach_hdr_t) ? mmap(NULL, *filesize, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if(hdr == MAP_FAILED)
+    {
+        fprintf(stderr, "[!] Failed to map %s: %s\n", path, *filesize < sizeof(mach_hdr_t) ? "file too small" : strerror(errno));
+        return NULL;
+    }
+    if(hdr->magic != MACH_HEADER_MAGIC || sizeof(*hdr) + hdr->sizeofcmds > *filesize)
+    {
+        fprintf(stderr, "[!] %s is not a decompressed Mach-O kernelcache\n", path);
+        munmap((void*)hdr, *filesize);
+        return NULL;
+    }
+    return hdr;
+}
+
+static int span_cmp(const void *a, const void *b)
+{
+    vm_address_t x = ((const span_t*)a)->addr,
+                 y = ((const span_t*)b)->addr;
+    return x < y ? -1 : x > y;
+}
+
+// The last span starting at or below addr, if addr is in it
+static const span_t* span_find(const span_t *spans, size_t count, vm_address_t addr)
+{
+    size_t lo = 0,
+           hi = count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(spans[mid].addr <= addr)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo > 0 && addr - spans[lo - 1].addr < spans[lo - 1].size ? &spans[lo - 1] : NULL;
+}
+
+// Where size bytes at addr are in the file, or NULL
+static const uint8_t* file_at(const image_t *img, vm_address_t addr, vm_size_t size)
+{
+    const span_t *seg = span_find(img->segs, img->nsegs, addr);
+    if(seg == NULL || size > seg->size - (addr - seg->addr))
+    {
+        return NULL;
+    }
+    return (const uint8_t*)img->hdr + seg->off + (addr - seg->addr);
+}
+
+// The C string at addr, which may also be in the middle of one
+static const char* string_at(const image_t *img, vm_address_t addr, size_t *len)
+{
+    const span_t *sec = span_find(img->cstrings, img->ncstrings, addr);
+    if(sec == NULL)
+    {
+        return NULL;
+    }
+    const char *str = (const char*)img->hdr + sec->off + (addr - sec->addr);
+    size_t max = sec->size - (addr - sec->addr);
+    *len = strnlen(str, max);
+    return *len > 0 && *len < max ? str : NULL;
+}
+
+static const mach_hdr_t* entry_header(const image_t *img, const struct fileset_entry_command *entry)
+{
+    const mach_hdr_t *hdr = (const mach_hdr_t*)((const uint8_t*)img->hdr + entry->fileoff);
+    if(entry->fileoff > img->filesize - sizeof(*hdr) || hdr->magic != MACH_HEADER_MAGIC || hdr->sizeofcmds > img->filesize - entry->fileoff - sizeof(*hdr))
+    {
+        return NULL;
+    }
+    return hdr;
+}
+
+// C string sections and symbol names of one image in the file
+static int image_scan_header(image_t *img, const mach_hdr_t *hdr)
+{
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd == MACH_LC_SEGMENT)
+        {
+            const mach_seg_t *seg = (const mach_seg_t*)cmd;
+            const mach_sec_t *sec = (const mach_sec_t*)(seg + 1);
+            for(uint32_t i = 0; i < seg->nsects; ++i)
+            {
+                if((sec[i].flags & SECTION_TYPE) != S_CSTRING_LITERALS || sec[i].size == 0 || sec[i].offset > img->filesize || sec[i].size > img->filesize - sec[i].offset)
+                {
+                    continue;
+                }
+                if(img->ncstrings == img->cap)
+                {
+                    img->cap = img->cap == 0 ? 0x100 : img->cap * 2;
+                    span_t *cstrings = realloc(img->cstrings, img->cap * sizeof(*cstrings));
+                    if(cstrings == NULL)
+                    {
+                        return -1;
+                    }
+                    img->cstrings = cstrings;
+                }
+                img->cstrings[img->ncstrings++] = (span_t){ .addr = sec[i].addr, .size = sec[i].size, .off = sec[i].offset };
+            }
+        }
+        else if(cmd->cmd == LC_SYMTAB)
+        {
+            const struct symtab_command *st = (const struct symtab_command*)cmd;
+            if(st->symoff > img->filesize || st->nsyms > (img->filesize - st->symoff) / sizeof(mach_nlist_t) || st->stroff > img->filesize || st->strsize > img->filesize - st->stroff)
+            {
+                DEBUG("Symbol table at 0x%x exceeds %s", st->symoff, img->path);
+                continue;
+            }
+            const mach_nlist_t *sym = (const mach_nlist_t*)((const uint8_t*)img->hdr + st->symoff);
+            const char *strtab = (const char*)img->hdr + st->stroff;
+            for(uint32_t i = 0; i < st->nsyms; ++i)
+            {
+                if((sym[i].n_type & N_STAB) || (sym[i].n_type & N_TYPE) != N_SECT || sym[i].n_un.n_strx >= st->strsize)
+                {
+                    continue;
+                }
+                ssize_t fn = func_lookup(img->ft, sym[i].n_value);
+                const char *name = &strtab[sym[i].n_un.n_strx];
+                if(fn >= 0 && img->ft->starts[fn] == sym[i].n_value && img->names[fn] == NULL && name[0] != '\0' &&
+                   strnlen(name, st->strsize - sym[i].n_un.n_strx) < st->strsize - sym[i].n_un.n_strx)
+                {
+                    img->names[fn] = name;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static int image_load(image_t *img, const char *path)
+{
+    memset(img, 0, sizeof(*img));
+    img->path = path;
+    img->hdr = map_kernelcache(path, &img->filesize);
+    if(img->hdr == NULL)
+    {
+        return -1;
+    }
+    img->ft = func_table_file(img->hdr, img->filesize);
+    if(img->ft == NULL)
+    {
+        fprintf(stderr, "[!] Failed to find the functions of %s\n", path);
+        return -1;
+    }
+    size_t n = img->ft->count;
+    img->names = calloc(n, sizeof(*img->names));
+    img->feat = calloc(n, sizeof(*img->feat));
+    img->match = malloc(n * sizeof(*img->match));
+    img->how = calloc(n, sizeof(*img->how));
+    img->segs = malloc((img->hdr->ncmds + 1) * sizeof(*img->segs));
+    if(img->names == NULL || img->feat == NULL || img->match == NULL || img->how == NULL || img->segs == NULL)
+    {
+        fprintf(stderr, "[!] Failed to allocate function info: %s\n", strerror(errno));
+        return -1;
+    }
+    memset(img->match, 0xff, n * sizeof(*img->match));
+
+    // The file's own segments span those of fileset entries
+    CMD_ITERATE(img->hdr, cmd)
+    {
+        if(cmd->cmd == MACH_LC_SEGMENT)
+        {
+            const mach_seg_t *seg = (const mach_seg_t*)cmd;
+            vm_size_t size = seg->filesize < seg->vmsize ? seg->filesize : seg->vmsize;
+            if(size > 0 && seg->fileoff <= img->filesize && size <= img->filesize - seg->fileoff)
+            {
+                img->segs[img->nsegs++] = (span_t){ .addr = seg->vmaddr, .size = size, .off = seg->fileoff };
+            }
+        }
+    }
+    qsort(img->segs, img->nsegs, sizeof(*img->segs), &span_cmp);
+
+    if(image_scan_header(img, img->hdr) != 0)
+    {
+        fprintf(stderr, "[!] Failed to allocate section list: %s\n", strerror(errno));
+        return -1;
+    }
+    CMD_ITERATE(img->hdr, cmd)
+    {
+        if(cmd->cmd == LC_FILESET_ENTRY)
+        {
+            const mach_hdr_t *hdr = entry_header(img, (const struct fileset_entry_command*)cmd);
+            if(hdr != NULL && image_scan_header(img, hdr) != 0)
+            {
+                fprintf(stderr, "[!] Failed to allocate section list: %s\n", strerror(errno));
+                return -1;
+            }
+        }
+    }
+    qsort(img->cstrings, img->ncstrings, sizeof(*img->cstrings), &span_cmp);
+    return 0;
+}
+
+static void image_free(image_t *img)
+{
+    func_table_free(img->ft);
+    free(img->segs);
+    free(img->cstrings);
+    free(img->names);
+    free(img->feat);
+    free(img->match);
+    free(img->how);
+    if(img->hdr != NULL)
+    {
+        munmap((void*)img->hdr, img->filesize);
+    }
+}
+
+/********** Instructions **********/
+
+typedef struct
+{
+    uint32_t norm;          // Registers and PC-relative immediates masked out
+    vm_address_t ref;       // Address computed or loaded from, or 0
+    vm_address_t call;      // Target of a BL, or 0
+} insn_t;
+
+typedef struct
+{
+    const uint32_t *code;
+    vm_address_t pc;
+    vm_address_t end;
+    uint32_t pages;         // Registers holding the result of an ADRP
+    vm_address_t page[32];
+} dec_t;
+
+static inline int64_t sext(uint64_t v, unsigned int bits)
+{
+    return (int64_t)(v << (64 - bits)) >> (64 - bits);
+}
+
+static bool dec_init(dec_t *d, const image_t *img, size_t fn)
+{
+    vm_size_t size = func_size(img->ft, fn) & ~3ULL;
+    d->pc = img->ft->starts[fn];
+    d->end = d->pc + size;
+    d->pages = 0;
+    d->code = (const uint32_t*)file_at(img, d->pc, size);
+    return d->code != NULL && size > 0;
+}
+
+static bool dec_next(dec_t *d, insn_t *in)
+{
+    if(d->pc >= d->end)
+    {
+        return false;
+    }
+    uint32_t op = *d->code++,
+             rd = op & 0x1f,
+             rn = (op >> 5) & 0x1f;
+    vm_address_t pc = d->pc;
+    d->pc += sizeof(uint32_t);
+    in->ref = 0;
+    in->call = 0;
+    if((op & 0x7c000000) == 0x14000000)         // B, BL
+    {
+        in->norm = op & 0xfc000000;
+        if(op >> 31)
+        {
+            in->call = pc + sext(op & 0x3ffffff, 26) * 4;
+            // Only callee-saved registers survive
+            d->pages &= 0xfff80000;
+        }
+    }
+    else if((op & 0xff000010) == 0x54000000)    // B.cond
+    {
+        in->norm = op & 0xff00001f;
+    }
+    else if((op & 0x7e000000) == 0x34000000)    // CBZ, CBNZ
+    {
+        in->norm = op & 0xff000000;
+    }
+    else if((op & 0x7e000000) == 0x36000000)    // TBZ, TBNZ
+    {
+        in->norm = op & 0xfff80000;
+    }
+    else if((op & 0x1f000000) == 0x10000000)    // ADR, ADRP
+    {
+        int64_t imm = sext(((op >> 3) & 0x1ffffc) | ((op >> 29) & 3), 21);
+        in->norm = op & 0x9f000000;
+        if(op >> 31)
+        {
+            d->page[rd] = (pc & ~0xfffULL) + imm * 0x1000;
+            d->pages |= 1U << rd;
+        }
+        else
+        {
+            in->ref = pc + imm;
+            d->pages &= ~(1U << rd);
+        }
+    }
+    else if((op & 0x3b000000) == 0x18000000)    // LDR literal
+    {
+        in->norm = op & 0xff000000;
+        in->ref = pc + sext((op >> 5) & 0x7ffff, 19) * 4;
+        d->pages &= ~(1U << rd);
+    }
+    else if((op & 0x7f800000) == 0x11000000 && (d->pages & (1U << rn)))   // ADD immediate to an ADRP
+    {
+        in->norm = op & 0xffc00000;
+        in->ref = d->page[rn] + (((op >> 10) & 0xfff) << ((op >> 22) & 1 ? 12 : 0));
+        d->pages &= ~(1U << rd);
+    }
+    else if((op & 0x0a000000) == 0x08000000)    // Loads and stores
+    {
+        bool pair = (op & 0x3a000000) == 0x28000000;
+        in->norm = op & (pair ? ~0x7fffU : ~0x3ffU);
+        if((op & 0x3b200c00) == 0x38200800)     // Register offset
+        {
+            in->norm &= ~0x1f0000U;
+        }
+        if((op & 0x3b000000) == 0x39000000 && (d->pages & (1U << rn)))   // Unsigned offset from an ADRP
+        {
+            in->norm &= 0xffc00000;
+            if(!(op & 0x04000000))
+            {
+                in->ref = d->page[rn] + (((op >> 10) & 0xfff) << (op >> 30));
+            }
+        }
+        if(op & 0x00400000)                     // Loads overwrite Rt
+        {
+            d->pages &= ~(1U << rd);
+        }
+    }
+    else if((op & 0x1c000000) == 0x10000000)    // Data processing, immediate
+    {
+        in->norm = op & ~0x3ffU;
+        d->pages &= ~(1U << rd);
+    }
+    else if((op & 0x0e000000) == 0x0a000000 || (op & 0x0e000000) == 0x0e000000)   // Data processing, register, and SIMD
+    {
+        in->norm = op & ~0x1f03ffU;
+        d->pages &= ~(1U << rd);
+    }
+    else if((op & 0xfe000000) == 0xd6000000)    // BR, BLR, RET
+    {
+        in->norm = op & ~0x3e0U;
+    }
+    else
+    {
+        in->norm = op;
+    }
+    return true;
+}
+
+static void features(const image_t *img, size_t fn, feat_t *f)
+{
+    memset(f, 0, sizeof(*f));
+    dec_t d;
+    if(!dec_init(&d, img, fn))
+    {
+        return;
+    }
+    uint64_t exact = 0,
+             shape = 0;
+    insn_t in;
+    while(dec_next(&d, &in))
+    {
+        exact = (exact + in.norm) * 0x9e3779b97f4a7c15ULL;
+        exact ^= exact >> 32;
+        shape = (shape + (in.norm >> 24)) * 0x9e3779b97f4a7c15ULL;
+        shape ^= shape >> 32;
+        ++f->ninsns;
+        f->ncalls += in.call != 0;
+        size_t len;
+        const char *str = in.ref != 0 ? string_at(img, in.ref, &len) : NULL;
+        if(str != NULL)
+        {
+            f->strings += hash_bytes(str, len);
+        }
+    }
+    f->exact = mix(exact ^ f->ninsns);
+    f->shape = mix(shape ^ f->ninsns);
+}
+
+/********** Matching **********/
+
+typedef struct
+{
+    image_t img[2];         // Old and new
+    size_t jobs0;           // Jobs for the old image, the rest are for the new one
+    size_t njobs;
+    size_t next;            // Next job, atomic
+    size_t count[BY_CALLS + 1];
+} port_t;
+
+static void* worker(void *arg)
+{
+    port_t *p = arg;
+    while(1)
+    {
+        size_t j = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED);
+        if(j >= p->njobs)
+        {
+            break;
+        }
+        image_t *img = j < p->jobs0 ? &p->img[0] : &p->img[1];
+        size_t first = (j < p->jobs0 ? j : j - p->jobs0) * JOB_FUNCS;
+        for(size_t i = first; i < first + JOB_FUNCS && i < img->ft->count; ++i)
+        {
+            features(img, i, &img->feat[i]);
+        }
+    }
+    return NULL;
+}
+
+// Within a factor of two in length
+static bool plausible(const port_t *p, size_t f0, size_t f1)
+{
+    uint32_t a = p->img[0].feat[f0].ninsns,
+             b = p->img[1].feat[f1].ninsns;
+    return a > 0 && b > 0 && a <= 2 * b && b <= 2 * a;
+}
+
+static void link_fn(port_t *p, size_t f0, size_t f1, how_t how)
+{
+    p->img[0].match[f0] = f1;
+    p->img[1].match[f1] = f0;
+    p->img[0].how[f0] = how;
+    p->img[1].how[f1] = how;
+    ++p->count[how];
+}
+
+typedef uint64_t (*key_fn_t)(const image_t *img, size_t fn);
+
+static uint64_t key_name(const image_t *img, size_t fn)
+{
+    const char *name = img->names[fn];
+    return name != NULL ? hash_bytes(name, strlen(name)) | 1 : 0;
+}
+
+static uint64_t key_exact(const image_t *img, size_t fn)
+{
+    return img->feat[fn].ninsns >= MIN_INSNS ? img->feat[fn].exact : 0;
+}
+
+static uint64_t key_strings(const image_t *img, size_t fn)
+{
+    return img->feat[fn].strings;
+}
+
+static uint64_t key_shape(const image_t *img, size_t fn)
+{
+    return img->feat[fn].ninsns >= MIN_INSNS ? img->feat[fn].shape : 0;
+}
+
+typedef struct
+{
+    uint64_t key;
+    uint32_t n[2];
+    uint32_t fn[2];
+} slot_t;
+
+// Hash join of the unmatched functions of both images on key, matching
+// those whose key is unique on both sides. Key 0 means none.
+static ssize_t join(port_t *p, key_fn_t key, how_t how)
+{
+    size_t cap = 1;
+    while(cap < 2 * (p->img[0].ft->count + p->img[1].ft->count))
+    {
+        cap *= 2;
+    }
+    slot_t *tab = calloc(cap, sizeof(*tab));
+    if(tab == NULL)
+    {
+        return -1;
+    }
+    for(size_t side = 0; side < 2; ++side)
+    {
+        const image_t *img = &p->img[side];
+        for(size_t i = 0; i < img->ft->count; ++i)
+        {
+            uint64_t k = img->match[i] < 0 ? key(img, i) : 0;
+            if(k == 0)
+            {
+                continue;
+            }
+            size_t h = k & (cap - 1);
+            while((tab[h].n[0] != 0 || tab[h].n[1] != 0) && tab[h].key != k)
+            {
+                h = (h + 1) & (cap - 1);
+            }
+            tab[h].key = k;
+            if(tab[h].n[side]++ == 0)
+            {
+                tab[h].fn[side] = i;
+            }
+        }
+    }
+    size_t found = 0;
+    for(size_t h = 0; h < cap; ++h)
+    {
+        if(tab[h].n[0] == 1 && tab[h].n[1] == 1 && (how == BY_NAME || plausible(p, tab[h].fn[0], tab[h].fn[1])))
+        {
+            link_fn(p, tab[h].fn[0], tab[h].fn[1], how);
+            ++found;
+        }
+    }
+    free(tab);
+    DEBUG("Joined %zu functions (method %u)", found, how);
+    return found;
+}
+
+static bool next_call(dec_t *d, vm_address_t *target)
+{
+    insn_t in;
+    while(dec_next(d, &in))
+    {
+        if(in.call != 0)
+        {
+            *target = in.call;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Functions called at the same place by matched functions that make the
+// same number of calls are matched too
+static size_t follow_calls(port_t *p)
+{
+    image_t *old = &p->img[0],
+            *new = &p->img[1];
+    size_t found = 0;
+    for(size_t i = 0; i < old->ft->count; ++i)
+    {
+        ssize_t m = old->match[i];
+        if(m < 0 || old->feat[i].ncalls == 0 || old->feat[i].ncalls != new->feat[m].ncalls)
+        {
+            continue;
+        }
+        dec_t a, b;
+        vm_address_t ca, cb;
+        if(!dec_init(&a, old, i) || !dec_init(&b, new, m))
+        {
+            continue;
+        }
+        while(next_call(&a, &ca) && next_call(&b, &cb))
+        {
+            ssize_t f0 = func_lookup(old->ft, ca),
+                    f1 = func_lookup(new->ft, cb);
+            if(f0 >= 0 && f1 >= 0 && old->ft->starts[f0] == ca && new->ft->starts[f1] == cb &&
+               old->match[f0] < 0 && new->match[f1] < 0 && plausible(p, f0, f1))
+            {
+                link_fn(p, f0, f1, BY_CALLS);
+                ++found;
+            }
+        }
+    }
+    DEBUG("Followed calls to %zu functions", found);
+    return found;
+}
+
+static int match_all(port_t *p)
+{
+    if(join(p, &key_name, BY_NAME) < 0)
+    {
+        return -1;
+    }
+    // Every match can make a key unique that wasn't before
+    for(size_t pass = 0; pass < MAX_PASSES; ++pass)
+    {
+        ssize_t exact = join(p, &key_exact, BY_EXACT),
+                strings = exact < 0 ? -1 : join(p, &key_strings, BY_STRINGS),
+                shape = strings < 0 ? -1 : join(p, &key_shape, BY_SHAPE);
+        if(shape < 0)
+        {
+            return -1;
+        }
+        if(exact + strings + shape + follow_calls(p) == 0)
+        {
+            break;
+        }
+    }
+    return 0;
+}
+
+/********** Porting **********/
+
+typedef struct
+{
+    vm_address_t old;
+    vm_address_t new;
+    unsigned int score;
+    char *name;             // NULL if none was given
+} entry_t;
+
+static int entries_load(const char *path, entry_t **out, size_t *count)
+{
+    FILE *f = fopen(path, "r");
+    if(f == NULL)
+    {
+        fprintf(stderr, "[!] Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[0x200];
+    size_t cap = 0,
+           lineno = 0;
+    int ret = 0;
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        ++lineno;
+        char *p = line + strspn(line, " \t");
+        p[strcspn(p, "#\r\n")] = '\0';
+        if(*p == '\0')
+        {
+            continue;
+        }
+        char *end;
+        errno = 0;
+        vm_address_t addr = strtoull(p, &end, 16);
+        if(end == p || errno != 0 || (*end != '\0' && *end != ' ' && *end != '\t'))
+        {
+            fprintf(stderr, "[!] %s:%zu: not an address\n", path, lineno);
+            ret = -1;
+            break;
+        }
+        end += strspn(end, " \t");
+        end[strcspn(end, " \t")] = '\0';
+        if(*count == cap)
+        {
+            cap = cap == 0 ? 0x100 : cap * 2;
+            entry_t *e = realloc(*out, cap * sizeof(*e));
+            if(e == NULL)
+            {
+                fprintf(stderr, "[!] Failed to allocate address list: %s\n", strerror(errno));
+                ret = -1;
+                break;
+            }
+            *out = e;
+        }
+        (*out)[(*count)++] = (entry_t){ .old = addr, .new = 0, .score = 0, .name = *end != '\0' ? strdup(end) : NULL };
+    }
+    fclose(f);
+    return ret;
+}
+
+// Normalized instructions of a function, malloc'ed
+static uint32_t* decode_norms(const image_t *img, size_t fn, size_t *count)
+{
+    dec_t d;
+    insn_t in;
+    uint32_t *norms = malloc((img->feat[fn].ninsns + 1) * sizeof(*norms));
+    if(norms == NULL || !dec_init(&d, img, fn))
+    {
+        free(norms);
+        return NULL;
+    }
+    *count = 0;
+    while(*count < img->feat[fn].ninsns && dec_next(&d, &in))
+    {
+        norms[(*count)++] = in.norm;
+    }
+    return norms;
+}
+
+// An address inside a matched function. Unless both have the same
+// instructions, take the instruction of the same kind whose neighbours
+// match best, and of those the one closest to where it would be if the
+// instructions were spread out evenly.
+static unsigned int port_code(const port_t *p, size_t f0, vm_address_t addr, vm_address_t *out)
+{
+    const image_t *old = &p->img[0],
+                  *new = &p->img[1];
+    size_t f1 = old->match[f0];
+    vm_size_t off = addr - old->ft->starts[f0];
+    unsigned int score = how_score[old->how[f0]];
+    if(off == 0 || old->feat[f0].exact == new->feat[f1].exact)
+    {
+        *out = new->ft->starts[f1] + off;
+        return off < func_size(new->ft, f1) ? score : 0;
+    }
+    size_t n0 = 0,
+           n1 = 0,
+           k = off / sizeof(uint32_t);
+    uint32_t *a = decode_norms(old, f0, &n0),
+             *b = decode_norms(new, f1, &n1);
+    if(a == NULL || b == NULL || k >= n0 || n1 == 0)
+    {
+        free(a);
+        free(b);
+        return 0;
+    }
+    size_t want = k * n1 / n0,
+           best = n1,
+           best_hits = 0,
+           best_possible = 0;
+    for(size_t i = 0; i < n1; ++i)
+    {
+        if(b[i] != a[k])
+        {
+            continue;
+        }
+        size_t hits = 1,
+               possible = 1;
+        for(size_t c = 1; c <= ALIGN_CONTEXT; ++c)
+        {
+            if(k >= c && i >= c)
+            {
+                hits += a[k - c] == b[i - c];
+                ++possible;
+            }
+            if(k + c < n0 && i + c < n1)
+            {
+                hits += a[k + c] == b[i + c];
+                ++possible;
+            }
+        }
+        size_t dist = i > want ? i - want : want - i,
+               best_dist = best > want ? best - want : want - best;
+        if(hits > best_hits || (hits == best_hits && dist < best_dist))
+        {
+            best = i;
+            best_hits = hits;
+            best_possible = possible;
+        }
+    }
+    free(a);
+    free(b);
+    if(best == n1)
+    {
+        *out = new->ft->starts[f1] + want * sizeof(uint32_t) + (off & 3);
+        return score / 2;
+    }
+    *out = new->ft->starts[f1] + best * sizeof(uint32_t) + (off & 3);
+    return best_hits == best_possible ? score * 9 / 10 : score * 2 / 3;
+}
+
+typedef struct
+{
+    uint64_t key;           // 0 if empty
+    vm_address_t addr;
+    uint32_t n;
+} str_slot_t;
+
+typedef struct
+{
+    str_slot_t *slots;
+    size_t mask;
+} str_table_t;
+
+// Every string in the C string sections of img, by hash
+static int strings_index(const image_t *img, str_table_t *tab)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < img->ncstrings; ++i)
+    {
+        const char *s = (const char*)img->hdr + img->cstrings[i].off;
+        for(size_t j = 0; j < img->cstrings[i].size; ++j)
+        {
+            count += s[j] == '\0';
+        }
+    }
+    size_t cap = 1;
+    while(cap < 2 * count)
+    {
+        cap *= 2;
+    }
+    tab->slots = calloc(cap, sizeof(*tab->slots));
+    tab->mask = cap - 1;
+    if(tab->slots == NULL)
+    {
+        return -1;
+    }
+    for(size_t i = 0; i < img->ncstrings; ++i)
+    {
+        const char *s = (const char*)img->hdr + img->cstrings[i].off,
+                   *e = s + img->cstrings[i].size;
+        for(const char *p = s; p < e; )
+        {
+            size_t len = strnlen(p, e - p);
+            if(len > 0 && len < (size_t)(e - p))
+            {
+                uint64_t k = hash_bytes(p, len) | 1;
+                size_t h = k & tab->mask;
+                while(tab->slots[h].key != 0 && tab->slots[h].key != k)
+                {
+                    h = (h + 1) & tab->mask;
+                }
+                if(tab->slots[h].n++ == 0)
+                {
+                    tab->slots[h].key = k;
+                    tab->slots[h].addr = img->cstrings[i].addr + (p - s);
+                }
+            }
+            p += len + 1;
+        }
+    }
+    DEBUG("Indexed %zu strings", count);
+    return 0;
+}
+
+// An address in a C string, if the string exists exactly once in new
+static unsigned int port_string(const port_t *p, const str_table_t *tab, vm_address_t addr, vm_address_t *out)
+{
+    const image_t *old = &p->img[0],
+                  *new = &p->img[1];
+    const span_t *sec = span_find(old->cstrings, old->ncstrings, addr);
+    if(sec == NULL)
+    {
+        return 0;
+    }
+    // Back up to the start of the string
+    const char *base = (const char*)old->hdr + sec->off;
+    vm_address_t start = addr;
+    while(start > sec->addr && base[start - 1 - sec->addr] != '\0')
+    {
+        --start;
+    }
+    size_t len, l;
+    const char *str = string_at(old, start, &len);
+    if(str == NULL)
+    {
+        return 0;
+    }
+    uint64_t k = hash_bytes(str, len) | 1;
+    for(size_t h = k & tab->mask; tab->slots[h].key != 0; h = (h + 1) & tab->mask)
+    {
+        if(tab->slots[h].key != k)
+        {
+            continue;
+        }
+        const char *s = string_at(new, tab->slots[h].addr, &l);
+        if(tab->slots[h].n != 1 || s == NULL || l != len || memcmp(s, str, len) != 0)
+        {
+            return 0;
+        }
+        *out = tab->slots[h].addr + (addr - start);
+        return SCORE_STRING;
+    }
+    return 0;
+}
+
+typedef struct
+{
+    size_t entry;
+    vm_address_t new;
+} vote_t;
+
+static int vote_cmp(const void *a, const void *b)
+{
+    const vote_t *x = a,
+                 *y = b;
+    return x->entry != y->entry ? (x->entry < y->entry ? -1 : 1) : x->new < y->new ? -1 : x->new > y->new;
+}
+
+static int ref_cmp(const void *a, const void *b)
+{
+    const entry_t *x = *(entry_t* const*)a,
+                  *y = *(entry_t* const*)b;
+    return x->old < y->old ? -1 : x->old > y->old;
+}
+
+// Globals, through the functions that reference them: the n-th reference
+// in a matched function is taken to be the n-th one in its match. Every
+// reference gets a vote.
+static int port_refs(const port_t *p, entry_t *entries, size_t count)
+{
+    const image_t *old = &p->img[0],
+                  *new = &p->img[1];
+    entry_t **want = malloc(count * sizeof(*want));
+    if(want == NULL)
+    {
+        return -1;
+    }
+    size_t nwant = 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(entries[i].score == 0)
+        {
+            want[nwant++] = &entries[i];
+        }
+    }
+    qsort(want, nwant, sizeof(*want), &ref_cmp);
+
+    vote_t *votes = NULL;
+    size_t nvotes = 0,
+           cap = 0;
+    int ret = 0;
+    for(size_t f0 = 0; f0 < old->ft->count && nwant > 0; ++f0)
+    {
+        ssize_t f1 = old->match[f0];
+        dec_t a, b;
+        insn_t ia, ib;
+        if(f1 < 0 || !dec_init(&a, old, f0) || !dec_init(&b, new, f1))
+        {
+            continue;
+        }
+        size_t nth = 0,
+               seen = 0;
+        while(dec_next(&a, &ia))
+        {
+            if(ia.ref == 0)
+            {
+                continue;
+            }
+            ++nth;
+            size_t lo = 0,
+                   hi = nwant;
+            while(lo < hi)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                if(want[mid]->old < ia.ref)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+            if(lo == nwant || want[lo]->old != ia.ref)
+            {
+                continue;
+            }
+            // Catch up in the new function
+            bool have = true;
+            while(seen < nth && (have = dec_next(&b, &ib)))
+            {
+                seen += ib.ref != 0;
+            }
+            if(!have)
+            {
+                break;
+            }
+            for(; lo < nwant && want[lo]->old == ia.ref; ++lo)
+            {
+                if(nvotes == cap)
+                {
+                    cap = cap == 0 ? 0x100 : cap * 2;
+                    vote_t *v = realloc(votes, cap * sizeof(*v));
+                    if(v == NULL)
+                    {
+                        ret = -1;
+                        goto out;
+                    }
+                    votes = v;
+                }
+                votes[nvotes++] = (vote_t){ .entry = want[lo] - entries, .new = ib.ref };
+            }
+        }
+    }
+
+    // Most votes wins, scaled by how many agree
+    qsort(votes, nvotes, sizeof(*votes), &vote_cmp);
+    for(size_t i = 0; i < nvotes; )
+    {
+        size_t e = votes[i].entry,
+               total = 0,
+               best = 0;
+        for(size_t j = i; j < nvotes && votes[j].entry == e; )
+        {
+            size_t k = j;
+            while(k < nvotes && votes[k].entry == e && votes[k].new == votes[j].new)
+            {
+                ++k;
+            }
+            if(k - j > best)
+            {
+                best = k - j;
+                entries[e].new = votes[j].new;
+            }
+            total += k - j;
+            j = k;
+        }
+        entries[e].score = SCORE_XREF * best / total;
+        DEBUG("%zu of %zu references to " ADDR " agree", best, total, entries[e].old);
+        i += total;
+    }
+
+    out:;
+    free(votes);
+    free(want);
+    return ret;
+}
+
+static int port_entries(const port_t *p, entry_t *entries, size_t count)
+{
+    const image_t *old = &p->img[0];
+    str_table_t tab = { 0 };
+    for(size_t i = 0; i < count; ++i)
+    {
+        entry_t *e = &entries[i];
+        ssize_t fn = func_lookup(old->ft, e->old);
+        if(fn >= 0)
+        {
+            e->score = old->match[fn] >= 0 ? port_code(p, fn, e->old, &e->new) : 0;
+        }
+        else if(span_find(old->cstrings, old->ncstrings, e->old) != NULL)
+        {
+            if(tab.slots == NULL && strings_index(&p->img[1], &tab) != 0)
+            {
+                return -1;
+            }
+            e->score = port_string(p, &tab, e->old, &e->new);
+        }
+    }
+    free(tab.slots);
+    return port_refs(p, entries, count);
+}
+
+int main(int argc, const char **argv)
+{
+    unsigned long nthreads = 0,
+                  min_score = DEFAULT_MIN_SCORE;
+
+    int aoff;
+    for(aoff = 1; aoff < argc; ++aoff)
+    {
+        if(argv[aoff][0] != '-')
+        {
+            break;
+        }
+        if(strcmp(argv[aoff], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[aoff], "-d") == 0)
+        {
+            slow = true;
+        }
+        else if(strcmp(argv[aoff], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[aoff], "-j") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &nthreads))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-m") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &min_score))
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(argc - aoff < 2 || argc - aoff > 3)
+    {
+        fprintf(stderr, "[!] Expected two kernelcaches and optionally an address list\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if(nthreads == 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = n > 0 ? n : 1;
+    }
+    if(nthreads > MAX_THREADS)
+    {
+        nthreads = MAX_THREADS;
+    }
+
+    int ret = -1;
+    entry_t *entries = NULL;
+    size_t nentries = 0;
+    port_t p;
+    memset(&p, 0, sizeof(p));
+    uint64_t start = timer_ns();
+    if(argc - aoff == 3 && entries_load(argv[aoff + 2], &entries, &nentries) != 0)
+    {
+        goto out;
+    }
+    if(image_load(&p.img[0], argv[aoff]) != 0 || image_load(&p.img[1], argv[aoff + 1]) != 0)
+    {
+        goto out;
+    }
+    for(size_t i = 0; i < 2; ++i)
+    {
+        fprintf(stderr, "[*] %s: %zu functions, %zu string sections\n", p.img[i].path, p.img[i].ft->count, p.img[i].ncstrings);
+    }
+
+    p.jobs0 = (p.img[0].ft->count + JOB_FUNCS - 1) / JOB_FUNCS;
+    p.njobs = p.jobs0 + (p.img[1].ft->count + JOB_FUNCS - 1) / JOB_FUNCS;
+    pthread_t threads[MAX_THREADS];
+    size_t started = 0;
+    for(; started < nthreads && started < p.njobs; ++started)
+    {
+        if(pthread_create(&threads[started], NULL, &worker, &p) != 0)
+        {
+            break;
+        }
+    }
+    if(started == 0)
+    {
+        // Do it ourselves then
+        worker(&p);
+    }
+    for(size_t i = 0; i < started; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    DEBUG("Features done after %.3f ms", (timer_ns() - start) / 1e6);
+
+    if(match_all(&p) != 0)
+    {
+        fprintf(stderr, "[!] Out of memory while matching: %s\n", strerror(errno));
+        goto out;
+    }
+    size_t matched = 0;
+    for(size_t i = BY_NAME; i <= BY_CALLS; ++i)
+    {
+        matched += p.count[i];
+    }
+    fprintf(stderr, "[*] Matched %zu of %zu functions (%zu by name, %zu by instructions, %zu by strings, %zu by shape, %zu by calls) in %.3f ms\n"
+                  , matched, p.img[0].ft->count, p.count[BY_NAME], p.count[BY_EXACT], p.count[BY_STRINGS], p.count[BY_SHAPE], p.count[BY_CALLS], (timer_ns() - start) / 1e6);
+
+    if(entries == NULL)
+    {
+        const image_t *old = &p.img[0];
+        for(size_t i = 0; i < old->ft->count; ++i)
+        {
+            ssize_t m = old->match[i];
+            if(m >= 0 && how_score[old->how[i]] >= min_score)
+            {
+                const char *name = old->names[i] != NULL ? old->names[i] : p.img[1].names[m];
+                printf(ADDR " " ADDR " %3u %s\n", old->ft->starts[i], p.img[1].ft->starts[m], how_score[old->how[i]], name != NULL ? name : "-");
+            }
+        }
+        ret = 0;
+        goto out;
+    }
+
+    if(port_entries(&p, entries, nentries) != 0)
+    {
+        fprintf(stderr, "[!] Out of memory while porting: %s\n", strerror(errno));
+        goto out;
+    }
+    size_t ported = 0;
+    for(size_t i = 0; i < nentries; ++i)
+    {
+        const entry_t *e = &entries[i];
+        const char *name = e->name != NULL ? e->name : "-";
+        if(e->score > 0 && e->score >= min_score)
+        {
+            printf(ADDR " " ADDR " %3u %s\n", e->old, e->new, e->score, name);
+            ++ported;
+        }
+        else
+        {
+            printf(ADDR " %16s %3u %s\n", e->old, "-", e->score, name);
+        }
+    }
+    fprintf(stderr, "[*] Ported %zu of %zu addresses\n", ported, nentries);
+    ret = ported == nentries ? 0 : 1;
+
+out:;
+    for(size_t i = 0; i < nentries; ++i)
+    {
+        free(entries[i].name);
+    }
+    free(entries);
+    image_free(&p.img[0]);
+    image_free(&p.img[1]);
+    return ret;
+}
@@ -0,0 +1,681 @@
+/*
+ * kscan.c - Scan kernel heap memory for objects by vtable
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <pthread.h>            // pthread_*
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+#include <stdio.h>              // FILE, fclose, fgets, fopen, printf, fprintf, stderr
+#include <stdlib.h>             // calloc, free, malloc, qsort, realloc, strtoul, strtoull
+#include <string.h>             // memset, strcmp, strcspn, strdup, strerror, strncmp, strspn
+#include <unistd.h>             // sysconf, _SC_NPROCESSORS_ONLN
+
+#include <mach/kern_return.h>   // KERN_SUCCESS
+#include <mach/vm_prot.h>       // VM_PROT_READ
+#include <mach/vm_region.h>     // vm_region_submap_info_data_64_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+#include <sys/types.h>          // ssize_t
+
+#include "arch.h"               // ADDR
+#include "debug.h"              // DEBUG, slow, verbose
+#include "kutil.h"              // kutil_*, kutil_ctx_t
+#include "libkern.h"            // KERNEL_TASK_OR_GTFO
+#include "snap.h"               // snap_backend
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
+#include "timer.h"              // timer_ns
+
+#define VM_KERN_MEMORY_ZONE     12
+#define VM_KERN_MEMORY_KALLOC   13
+
+#define DEFAULT_WINDOW  0x100000
+#define JOB_WINDOWS     16      /* Larger regions are split up between threads */
+#define MAX_THREADS     64
+#define BLOOM_BITS      16      /* Per vtable */
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-S] [-a] [-c] [-f snapshot] [-j threads] [-t tags] [-w bytes] vtables\n"
+                    "Scans kernel memory for pointers to any of the vtables listed in the file\n"
+                    "vtables, one address per line, optionally followed by a name. Addresses have\n"
+                    "to be what objects point to, i.e. usually vtable + 0x10.\n"
+                    "Prints the address of every hit, the vtable, its name and the region's tag.\n"
+                    "\n"
+                    "    -a  Also scan regions without resident pages\n"
+                    "    -c  Only print the number of hits per vtable\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
+                    "    -f  Scan a snapshot taken with ksnap instead of the kernel\n"
+                    "    -h  Print this help\n"
+                    "    -j  Number of threads (default: one per CPU)\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
+                    "    -t  Comma-separated region tags to scan, as numbers, \"zone\",\n"
+                    "        \"kalloc\" or \"all\" (default zone,kalloc)\n"
+                    "    -v  Verbose (debug output)\n"
+                    "    -w  Bytes read at once per thread (default 0x%x)\n"
+                    "\n"
+                    "KUTIL_SIM=image=file scans a kernelcache image the same way.\n"
+                    , self, DEFAULT_WINDOW);
+}
+
+static bool parse_num(const char *str, unsigned long *num)
+{
+    char *end;
+    errno = 0;
+    *num = strtoul(str, &end, 0);
+    if(str[0] == '\0' || end[0] != '\0' || errno != 0)
+    {
+        fprintf(stderr, "[!] Failed to parse \"%s\": %s\n", str, str[0] == '\0' ? "zero characters given" : errno != 0 ? strerror(errno) : "not a number");
+        return false;
+    }
+    return true;
+}
+
+static const char* tag_name(unsigned int tag)
+{
+    switch(tag)
+    {
+        case VM_KERN_MEMORY_ZONE:   return "zone";
+        case VM_KERN_MEMORY_KALLOC: return "kalloc";
+    }
+    return NULL;
+}
+
+static bool parse_tags(const char *list, bool tags[256])
+{
+    memset(tags, 0, 256 * sizeof(bool));
+    for(const char *p = list; *p != '\0'; )
+    {
+        size_t len = strcspn(p, ",");
+        if(len == 3 && strncmp(p, "all", 3) == 0)
+        {
+            memset(tags, 1, 256 * sizeof(bool));
+        }
+        else if(len == 4 && strncmp(p, "zone", 4) == 0)
+        {
+            tags[VM_KERN_MEMORY_ZONE] = true;
+        }
+        else if(len == 6 && strncmp(p, "kalloc", 6) == 0)
+        {
+            tags[VM_KERN_MEMORY_KALLOC] = true;
+        }
+        else
+        {
+            char *end;
+            unsigned long tag = strtoul(p, &end, 0);
+            if(end != p + len || len == 0 || tag > 255)
+            {
+                fprintf(stderr, "[!] Not a region tag: %.*s\n", (int)len, p);
+                return false;
+            }
+            tags[tag] = true;
+        }
+        p += len;
+        if(*p == ',')
+        {
+            ++p;
+        }
+    }
+    return true;
+}
+
+/********** Vtables **********/
+
+typedef struct
+{
+    vm_address_t addr;
+    char *name;             // NULL if none was given
+    uint64_t hits;
+} vtable_t;
+
+// Bloom filter with all of a key's bits in the same word, so that a test is
+// one load. With BLOOM_BITS bits per key and 4 bits set per key, about one
+// in 300 of the qwords that get past the min/max check are false positives.
+typedef struct
+{
+    vtable_t *vt;           // Sorted by address, no duplicates
+    size_t count;
+    vm_address_t min;
+    vm_address_t max;
+    uint64_t *bloom;
+    uint64_t mask;          // Number of words - 1
+} vtset_t;
+
+static inline uint64_t mix(uint64_t v)
+{
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    v *= 0xc4ceb9fe1a85ec53ULL;
+    v ^= v >> 33;
+    return v;
+}
+
+static inline uint64_t bloom_bits(uint64_t h)
+{
+    return (1ULL << ((h >> 40) & 63)) | (1ULL << ((h >> 46) & 63)) | (1ULL << ((h >> 52) & 63)) | (1ULL << ((h >> 58) & 63));
+}
+
+static inline bool vtset_maybe(const vtset_t *set, uint64_t v)
+{
+    if(v - set->min > set->max - set->min)
+    {
+        return false;
+    }
+    uint64_t h = mix(v),
+             bits = bloom_bits(h);
+    return (set->bloom[h & set->mask] & bits) == bits;
+}
+
+static ssize_t vtset_find(const vtset_t *set, uint64_t v)
+{
+    size_t lo = 0,
+           hi = set->count;
+    while(lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if(set->vt[mid].addr < v)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo < set->count && set->vt[lo].addr == v ? (ssize_t)lo : -1;
+}
+
+static int vt_cmp(const void *a, const void *b)
+{
+    vm_address_t x = ((const vtable_t*)a)->addr,
+                 y = ((const vtable_t*)b)->addr;
+    return x < y ? -1 : x > y;
+}
+
+static int vtset_load(vtset_t *set, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if(f == NULL)
+    {
+        fprintf(stderr, "[!] Failed to open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char line[0x200];
+    size_t cap = 0,
+           lineno = 0;
+    int ret = 0;
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        ++lineno;
+        char *p = line + strspn(line, " \t");
+        p[strcspn(p, "#\r\n")] = '\0';
+        if(*p == '\0')
+        {
+            continue;
+        }
+        char *end;
+        errno = 0;
+        vm_address_t addr = strtoull(p, &end, 16);
+        if(end == p || errno != 0 || (*end != '\0' && *end != ' ' && *end != '\t'))
+        {
+            fprintf(stderr, "[!] %s:%zu: not an address\n", path, lineno);
+            ret = -1;
+            break;
+        }
+        end += strspn(end, " \t");
+        end[strcspn(end, " \t")] = '\0';
+        if(set->count == cap)
+        {
+            cap = cap == 0 ? 0x100 : cap * 2;
+            vtable_t *vt = realloc(set->vt, cap * sizeof(*vt));
+            if(vt == NULL)
+            {
+                fprintf(stderr, "[!] Failed to allocate vtable list: %s\n", strerror(errno));
+                ret = -1;
+                break;
+            }
+            set->vt = vt;
+        }
+        set->vt[set->count++] = (vtable_t){ .addr = addr, .name = *end != '\0' ? strdup(end) : NULL, .hits = 0 };
+    }
+    fclose(f);
+    if(ret != 0)
+    {
+        return ret;
+    }
+    if(set->count == 0)
+    {
+        fprintf(stderr, "[!] No vtables in %s\n", path);
+        return -1;
+    }
+
+    qsort(set->vt, set->count, sizeof(*set->vt), &vt_cmp);
+    size_t n = 1;
+    for(size_t i = 1; i < set->count; ++i)
+    {
+        if(set->vt[i].addr != set->vt[n - 1].addr)
+        {
+            set->vt[n++] = set->vt[i];
+        }
+        else
+        {
+            free(set->vt[i].name);
+        }
+    }
+    set->count = n;
+    set->min = set->vt[0].addr;
+    set->max = set->vt[n - 1].addr;
+
+    size_t words = 1;
+    while(words * 64 < n * BLOOM_BITS)
+    {
+        words *= 2;
+    }
+    set->bloom = calloc(words, sizeof(uint64_t));
+    if(set->bloom == NULL)
+    {
+        fprintf(stderr, "[!] Failed to allocate Bloom filter: %s\n", strerror(errno));
+        return -1;
+    }
+    set->mask = words - 1;
+    for(size_t i = 0; i < n; ++i)
+    {
+        uint64_t h = mix(set->vt[i].addr);
+        set->bloom[h & set->mask] |= bloom_bits(h);
+    }
+    DEBUG("%zu vtables, Bloom filter of %zu words", n, words);
+    return 0;
+}
+
+/********** Scan **********/
+
+typedef struct
+{
+    vm_address_t addr;
+    vm_size_t size;
+    unsigned int tag;
+} region_t;
+
+typedef struct
+{
+    vm_address_t addr;
+    uint32_t vt;            // Index into the vtable set
+    uint32_t tag;
+} hit_t;
+
+typedef struct
+{
+    kutil_ctx_t *ctx;
+    const vtset_t *set;
+    const bool *tags;
+    bool all;
+    vm_size_t window;
+    region_t *regions;
+    size_t nregions;
+    size_t cap;
+    size_t next;            // Next region to scan, atomic
+    uint64_t bytes;         // Atomic
+    uint64_t bloom_pass;    // Atomic
+    pthread_mutex_t lock;   // For merging hits
+    hit_t *hits;
+    size_t nhits;
+    size_t hitcap;
+    bool oom;
+} scan_t;
+
+static int add_region(scan_t *sc, vm_address_t addr, vm_size_t size, unsigned int tag)
+{
+    if(sc->nregions == sc->cap)
+    {
+        size_t cap = sc->cap == 0 ? 0x100 : sc->cap * 2;
+        region_t *regions = realloc(sc->regions, cap * sizeof(*regions));
+        if(regions == NULL)
+        {
+            return -1;
+        }
+        sc->regions = regions;
+        sc->cap = cap;
+    }
+    sc->regions[sc->nregions++] = (region_t){ .addr = addr, .size = size, .tag = tag };
+    return 0;
+}
+
+static int find_regions(scan_t *sc, unsigned int level, vm_address_t min, vm_address_t max)
+{
+    vm_region_submap_info_data_64_t info;
+    vm_size_t size;
+    unsigned int depth;
+    for(vm_address_t addr = min; 1; addr += size)
+    {
+        depth = level;
+        if(kutil_region(sc->ctx, &addr, &size, &depth, &info) != KERN_SUCCESS || addr >= max)
+        {
+            break;
+        }
+        if(info.is_submap)
+        {
+            if(find_regions(sc, level + 1, addr, addr + size) != 0)
+            {
+                return -1;
+            }
+        }
+        else if((info.protection & VM_PROT_READ) && sc->tags[info.user_tag & 0xff] && (sc->all || info.pages_resident > 0))
+        {
+            vm_size_t job = JOB_WINDOWS * sc->window;
+            for(vm_size_t off = 0; off < size; off += job)
+            {
+                if(add_region(sc, addr + off, size - off < job ? size - off : job, info.user_tag) != 0)
+                {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static bool push_hit(hit_t **hits, size_t *count, size_t *cap, hit_t hit)
+{
+    if(*count == *cap)
+    {
+        size_t n = *cap == 0 ? 0x100 : *cap * 2;
+        hit_t *h = realloc(*hits, n * sizeof(*h));
+        if(h == NULL)
+        {
+            return false;
+        }
+        *hits = h;
+        *cap = n;
+    }
+    (*hits)[(*count)++] = hit;
+    return true;
+}
+
+static void* worker(void *arg)
+{
+    scan_t *sc = arg;
+    const vtset_t *set = sc->set;
+    uint64_t *buf = malloc(sc->window);
+    hit_t *hits = NULL;
+    size_t nhits = 0,
+           hitcap = 0;
+    uint64_t bytes = 0,
+             pass = 0;
+    bool oom = buf == NULL;
+    while(!oom)
+    {
+        size_t i = __atomic_fetch_add(&sc->next, 1, __ATOMIC_RELAXED);
+        if(i >= sc->nregions)
+        {
+            break;
+        }
+        const region_t *r = &sc->regions[i];
+        DEBUG("Scanning " ADDR "-" ADDR, r->addr, r->addr + r->size);
+        for(vm_size_t off = 0; off < r->size && !oom; off += sc->window)
+        {
+            vm_size_t len = r->size - off < sc->window ? r->size - off : sc->window;
+            // Unreadable pages come back as zeroes, which never match
+            bytes += kutil_read_sparse(sc->ctx, r->addr + off, len, buf, NULL);
+            size_t n = len / sizeof(uint64_t);
+            for(size_t j = 0; j < n; ++j)
+            {
+                if(!vtset_maybe(set, buf[j]))
+                {
+                    continue;
+                }
+                ++pass;
+                ssize_t vt = vtset_find(set, buf[j]);
+                if(vt >= 0 && !push_hit(&hits, &nhits, &hitcap, (hit_t){ .addr = r->addr + off + j * sizeof(uint64_t), .vt = vt, .tag = r->tag }))
+                {
+                    oom = true;
+                    break;
+                }
+            }
+        }
+    }
+    free(buf);
+
+    __atomic_fetch_add(&sc->bytes, bytes, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&sc->bloom_pass, pass, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&sc->lock);
+    for(size_t i = 0; i < nhits && !oom; ++i)
+    {
+        oom = !push_hit(&sc->hits, &sc->nhits, &sc->hitcap, hits[i]);
+    }
+    sc->oom |= oom;
+    pthread_mutex_unlock(&sc->lock);
+    free(hits);
+    return NULL;
+}
+
+static int hit_cmp(const void *a, const void *b)
+{
+    vm_address_t x = ((const hit_t*)a)->addr,
+                 y = ((const hit_t*)b)->addr;
+    return x < y ? -1 : x > y;
+}
+
+static int count_cmp(const void *a, const void *b)
+{
+    const vtable_t *x = a,
+                   *y = b;
+    return x->hits > y->hits ? -1 : x->hits < y->hits ? 1 : x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+int main(int argc, const char **argv)
+{
+    unsigned long nthreads = 0,
+                  window = DEFAULT_WINDOW;
+    bool all = false,
+         counts = false,
+         tags[256];
+    const char *snapshot = NULL;
+    parse_tags("zone,kalloc", tags);
+    int aoff;
+    for(aoff = 1; aoff < argc; ++aoff)
+    {
+        if(argv[aoff][0] != '-')
+        {
+            break;
+        }
+        if(strcmp(argv[aoff], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[aoff], "-d") == 0)
+        {
+            slow = true;
+        }
+        else if(strcmp(argv[aoff], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
+        else if(strcmp(argv[aoff], "-a") == 0)
+        {
+            all = true;
+        }
+        else if(strcmp(argv[aoff], "-c") == 0)
+        {
+            counts = true;
+        }
+        else if(strcmp(argv[aoff], "-f") == 0 && aoff + 1 < argc)
+        {
+            snapshot = argv[++aoff];
+        }
+        else if(strcmp(argv[aoff], "-j") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &nthreads))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-t") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_tags(argv[++aoff], tags))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-w") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &window))
+            {
+                return -1;
+            }
+            if(window < 0x1000 || window % sizeof(uint64_t) != 0)
+            {
+                fprintf(stderr, "[!] Window must be a multiple of 8 bytes, and at least 0x1000\n");
+                return -1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(argc - aoff != 1)
+    {
+        fprintf(stderr, "[!] Expected a vtable list\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if(nthreads == 0)
+    {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = n > 0 ? n : 1;
+    }
+    if(nthreads > MAX_THREADS)
+    {
+        nthreads = MAX_THREADS;
+    }
+
+    vtset_t set = { 0 };
+    if(vtset_load(&set, argv[aoff]) != 0)
+    {
+        return -1;
+    }
+
+    kutil_ctx_t *ctx;
+    if(snapshot != NULL)
+    {
+        kbackend_t *be = snap_backend(snapshot);
+        if(be == NULL)
+        {
+            fprintf(stderr, "[!] Failed to load snapshot %s\n", snapshot);
+            return -1;
+        }
+        ctx = kutil_ctx_create(be, verbose ? KUTIL_CTX_VERBOSE : 0);
+        if(ctx == NULL)
+        {
+            fprintf(stderr, "[!] Failed to create context\n");
+            return -1;
+        }
+    }
+    else
+    {
+        KERNEL_TASK_OR_GTFO();
+        ctx = kutil_ctx_default();
+    }
+    // The workers all read through the same backend
+    if(!kutil_backend(ctx)->concurrent)
+    {
+        nthreads = 1;
+    }
+
+    scan_t sc =
+    {
+        .ctx = ctx,
+        .set = &set,
+        .tags = tags,
+        .all = all,
+        .window = window,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+    };
+    uint64_t start = timer_ns();
+    if(find_regions(&sc, 0, 0, ~0) != 0)
+    {
+        fprintf(stderr, "[!] Failed to allocate region list: %s\n", strerror(errno));
+        return -1;
+    }
+    DEBUG("%zu regions to scan", sc.nregions);
+
+    pthread_t threads[MAX_THREADS];
+    size_t started = 0;
+    for(; started < nthreads && started < sc.nregions; ++started)
+    {
+        if(pthread_create(&threads[started], NULL, &worker, &sc) != 0)
+        {
+            break;
+        }
+    }
+    if(started == 0)
+    {
+        // Do it ourselves then
+        worker(&sc);
+    }
+    for(size_t i = 0; i < started; ++i)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    if(sc.oom)
+    {
+        fprintf(stderr, "[!] Out of memory for hits, results are incomplete\n");
+    }
+
+    if(sc.nhits > 0)
+    {
+        qsort(sc.hits, sc.nhits, sizeof(*sc.hits), &hit_cmp);
+    }
+    for(size_t i = 0; i < sc.nhits; ++i)
+    {
+        const hit_t *h = &sc.hits[i];
+        vtable_t *vt = &set.vt[h->vt];
+        ++vt->hits;
+        if(!counts)
+        {
+            const char *tag = tag_name(h->tag);
+            if(tag != NULL)
+            {
+                printf(ADDR " " ADDR " %s %s\n", h->addr, vt->addr, vt->name != NULL ? vt->name : "-", tag);
+            }
+            else
+            {
+                printf(ADDR " " ADDR " %s %u\n", h->addr, vt->addr, vt->name != NULL ? vt->name : "-", h->tag);
+            }
+        }
+    }
+    if(counts)
+    {
+        qsort(set.vt, set.count, sizeof(*set.vt), &count_cmp);
+        for(size_t i = 0; i < set.count && set.vt[i].hits > 0; ++i)
+        {
+            printf("%8llu " ADDR " %s\n", (unsigned long long)set.vt[i].hits, set.vt[i].addr, set.vt[i].name != NULL ? set.vt[i].name : "-");
+        }
+    }
+    fprintf(stderr, "[*] %zu hits in %zu regions, %llu MB scanned in %.3f ms (%llu passed the Bloom filter)\n"
+                  , sc.nhits, sc.nregions, (unsigned long long)(sc.bytes >> 20), (timer_ns() - start) / 1e6, (unsigned long long)sc.bloom_pass);
+
+    for(size_t i = 0; i < set.count; ++i)
+    {
+        free(set.vt[i].name);
+    }
+    free(set.vt);
+    free(set.bloom);
+    free(sc.regions);
+    free(sc.hits);
+    if(snapshot != NULL)
+    {
+        kutil_ctx_destroy(ctx);
+    }
+    return 0;
+}
@@ -0,0 +1,300 @@
+/*
+ * ksnap.c - Snapshot the kernel address space to a file
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+#include <stdio.h>              // fprintf, stderr
+#include <stdlib.h>             // free, malloc, strtoul
+#include <string.h>             // memset, strcmp, strerror
+
+#include <mach/kern_return.h>   // KERN_SUCCESS
+#include <mach/vm_prot.h>       // VM_PROT_READ
+#include <mach/vm_region.h>     // vm_region_submap_info_data_64_t
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // ADDR, mach_hdr_t
+#include "debug.h"              // slow, verbose
+#include "kio.h"                // kio_*, KIO_*
+#include "libkern.h"            // KERNEL_BASE_OR_GTFO, kernel_header, kernel_page_size, kernel_region
+#include "mach-o.h"             // macho_uuid
+#include "snap.h"               // snap_*, SNAP_*
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-S] [-a] [-j reads] file\n"
+                    "Writes the kernel's region map and the contents of all readable regions\n"
+                    "to file, for use with KUTIL_SNAP=file.\n"
+                    "\n"
+                    "    -a  Also read regions without resident pages\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
+                    "    -h  Print this help\n"
+                    "    -j  Reads in flight at once (default %u)\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
+                    "    -v  Verbose (debug output)\n"
+                    , self, KIO_DEFAULT_DEPTH);
+}
+
+typedef struct
+{
+    snap_writer_t *w;
+    kio_t *kio;
+    unsigned int window;    // Blocks being read at once
+    uint8_t *bufs;          // window blocks
+    kio_req_t **reqs;
+    bool all;
+    vm_size_t page_size;
+    size_t regions;
+    size_t bad_pages;
+} snapper_t;
+
+// Redo a short read page by page, from the page it stopped at
+static uint32_t read_pages(snapper_t *sn, vm_address_t addr, vm_size_t size, vm_size_t got, uint8_t *buf)
+{
+    vm_size_t ps = sn->page_size;
+    size_t first = got / ps,
+           npages = (size + ps - 1) / ps;
+    uint32_t valid = (1U << first) - 1;
+    kio_req_t *reqs[32];
+    memset(&buf[first * ps], 0, size - first * ps);
+    for(size_t i = first; i < npages; ++i)
+    {
+        vm_size_t len = size - i * ps < ps ? size - i * ps : ps;
+        reqs[i - first] = kio_submit(sn->kio, KIO_READ, addr + i * ps, len, &buf[i * ps], NULL);
+    }
+    for(size_t i = first; i < npages; ++i)
+    {
+        kio_req_t *req = reqs[i - first];
+        if(req == NULL)
+        {
+            ++sn->bad_pages;
+            continue;
+        }
+        if(kio_wait(req) == req->size)
+        {
+            valid |= 1U << i;
+        }
+        else
+        {
+            memset(&buf[i * ps], 0, ps);
+            ++sn->bad_pages;
+            DEBUG("Unreadable: " ADDR "-" ADDR, req->addr, req->addr + req->size);
+        }
+        kio_release(req);
+    }
+    return valid;
+}
+
+// Read a region in blocks, with up to window of them in flight
+static int snap_data(snapper_t *sn, vm_address_t addr, vm_size_t size)
+{
+    size_t nblocks = (size + SNAP_BLOCK_SIZE - 1) / SNAP_BLOCK_SIZE,
+           next = 0;
+    vm_size_t ps = sn->page_size;
+    int ret = 0;
+    for(size_t i = 0; i < nblocks; ++i)
+    {
+        for(; next < nblocks && next < i + sn->window; ++next)
+        {
+            vm_size_t off = next * SNAP_BLOCK_SIZE,
+                      len = size - off < SNAP_BLOCK_SIZE ? size - off : SNAP_BLOCK_SIZE;
+            sn->reqs[next % sn->window] = kio_submit(sn->kio, KIO_READ, addr + off, len, &sn->bufs[(next % sn->window) * SNAP_BLOCK_SIZE], NULL);
+        }
+        vm_size_t off = i * SNAP_BLOCK_SIZE,
+                  len = size - off < SNAP_BLOCK_SIZE ? size - off : SNAP_BLOCK_SIZE,
+                  got = 0;
+        uint8_t *buf = &sn->bufs[(i % sn->window) * SNAP_BLOCK_SIZE];
+        kio_req_t *req = sn->reqs[i % sn->window];
+        if(req != NULL)
+        {
+            got = kio_wait(req);
+            kio_release(req);
+        }
+        if(ret != 0)
+        {
+            // Only collecting what's still in flight
+            continue;
+        }
+        uint32_t valid = got == len ? (uint32_t)((1ULL << ((len + ps - 1) / ps)) - 1) : read_pages(sn, addr + off, len, got, buf);
+        if(snap_add_block(sn->w, buf, len, valid) != 0)
+        {
+            fprintf(stderr, "[!] Failed to write block at " ADDR ": %s\n", addr + off, strerror(errno));
+            ret = -1;
+        }
+    }
+    return ret;
+}
+
+static int snap_range(snapper_t *sn, unsigned int level, vm_address_t min, vm_address_t max)
+{
+    vm_region_submap_info_data_64_t info;
+    vm_size_t size;
+    unsigned int depth;
+    for(vm_address_t addr = min; 1; addr += size)
+    {
+        depth = level;
+        if(kernel_region(&addr, &size, &depth, &info) != KERN_SUCCESS || addr >= max)
+        {
+            break;
+        }
+        snap_region_t r =
+        {
+            .addr = addr,
+            .size = size,
+            .level = level,
+            .depth = depth,
+            .block = SNAP_NO_DATA,
+            .info = info,
+        };
+        bool data = !info.is_submap && (info.protection & VM_PROT_READ) && (sn->all || info.pages_resident > 0);
+        if(snap_add_region(sn->w, &r, data) != 0)
+        {
+            fprintf(stderr, "[!] Failed to add region " ADDR "-" ADDR "\n", addr, addr + size);
+            return -1;
+        }
+        ++sn->regions;
+        if(data)
+        {
+            DEBUG("Reading " ADDR "-" ADDR, addr, addr + size);
+            if(snap_data(sn, addr, size) != 0)
+            {
+                return -1;
+            }
+        }
+        if(info.is_submap && snap_range(sn, level + 1, addr, addr + size) != 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, const char **argv)
+{
+    vm_address_t kbase;
+    unsigned int jobs = KIO_DEFAULT_DEPTH;
+    bool all = false;
+    int aoff;
+    for(aoff = 1; aoff < argc; ++aoff)
+    {
+        if(argv[aoff][0] != '-')
+        {
+            break;
+        }
+        if(strcmp(argv[aoff], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[aoff], "-d") == 0)
+        {
+            slow = true;
+        }
+        else if(strcmp(argv[aoff], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
+        else if(strcmp(argv[aoff], "-a") == 0)
+        {
+            all = true;
+        }
+        else if(strcmp(argv[aoff], "-j") == 0 && aoff + 1 < argc)
+        {
+            char *end;
+            const char *arg = argv[++aoff];
+            jobs = strtoul(arg, &end, 0);
+            if(arg[0] == '\0' || end[0] != '\0' || jobs == 0 || jobs > KIO_MAX_DEPTH)
+            {
+                fprintf(stderr, "[!] Reads in flight must be between 1 and %u\n", KIO_MAX_DEPTH);
+                return -1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(argc - aoff != 1)
+    {
+        fprintf(stderr, "[!] Expected an output file\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    const char *path = argv[aoff];
+
+    KERNEL_BASE_OR_GTFO(kbase);
+
+    uint8_t uuid[16] = { 0 };
+    mach_hdr_t *hdr = kernel_header(kbase);
+    if(hdr == NULL || !macho_uuid(hdr, uuid))
+    {
+        fprintf(stderr, "[!] Failed to get the kernel's UUID, leaving it blank\n");
+    }
+    free(hdr);
+
+    snapper_t sn =
+    {
+        .w = NULL,
+        .kio = NULL,
+        // Twice as many blocks as reads, so the next ones are queued while one is being compressed
+        .window = 2 * jobs,
+        .bufs = malloc(2 * jobs * SNAP_BLOCK_SIZE),
+        .reqs = malloc(2 * jobs * sizeof(kio_req_t*)),
+        .all = all,
+        .page_size = kernel_page_size(),
+        .regions = 0,
+        .bad_pages = 0,
+    };
+    if(sn.bufs == NULL || sn.reqs == NULL)
+    {
+        fprintf(stderr, "[!] Failed to allocate buffers: %s\n", strerror(errno));
+        return -1;
+    }
+    sn.kio = kio_create(jobs);
+    if(sn.kio == NULL)
+    {
+        fprintf(stderr, "[!] Failed to start I/O threads\n");
+        return -1;
+    }
+    sn.w = snap_create(path, kbase, uuid, sn.page_size);
+    if(sn.w == NULL)
+    {
+        fprintf(stderr, "[!] Failed to create %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    int ret = snap_range(&sn, 0, 0, ~0);
+    uint64_t raw, stored;
+    snap_written(sn.w, &raw, &stored);
+    if(snap_finish(sn.w) != 0)
+    {
+        if(ret == 0)
+        {
+            fprintf(stderr, "[!] Failed to write %s: %s\n", path, strerror(errno));
+        }
+        ret = -1;
+    }
+    kio_destroy(sn.kio);
+    free(sn.bufs);
+    free(sn.reqs);
+    if(ret == 0)
+    {
+        fprintf(stderr, "[*] Wrote %zu regions, %llu MB of data in %llu MB to %s\n", sn.regions, (unsigned long long)(raw >> 20), (unsigned long long)(stored >> 20), path);
+        if(sn.bad_pages > 0)
+        {
+            fprintf(stderr, "[!] %zu pages could not be read and were left out\n", sn.bad_pages);
+        }
+    }
+    return ret;
+}
@@ -0,0 +1,289 @@
+/*
+ * kstrings.c - Extract and look up kernel strings
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <stdbool.h>            // bool, true, false
+#include <stdio.h>              // fprintf, fputc, fputs, printf, stderr, stdout
+#include <stdlib.h>             // free, malloc, strtoul
+#include <string.h>             // strchr, strcmp, strerror, strlen, strncmp
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // ADDR, MACH_LC_SEGMENT, mach_*
+#include "debug.h"              // slow, verbose
+#include "libkern.h"            // KERNEL_BASE_OR_GTFO, kernel_header, kernel_read
+#include "mach-o.h"             // CMD_ITERATE, macho_slide
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
+#include "strindex.h"           // str_*
+
+#define DEFAULT_MIN_LEN 4
+#define MAX_ADDRS 0x100
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-S] [-j threads] [-n len] [-a addr size | -s seg.sect | -f string]\n"
+                    "Prints the strings in the kernel's C string sections, or in the given range\n"
+                    "or section, one per line as address and string.\n"
+                    "\n"
+                    "    -a  Search addr to addr + size instead\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
+                    "    -f  Print every address string is at, using the string index\n"
+                    "        (built on first use, then cached per kernel)\n"
+                    "    -h  Print this help\n"
+                    "    -j  Number of threads (default one per CPU)\n"
+                    "    -n  Minimum string length (default %u)\n"
+                    "    -s  Search the given section of the kernel instead\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
+                    "    -v  Verbose (debug output)\n"
+                    , self, DEFAULT_MIN_LEN);
+}
+
+static bool parse_num(const char *str, unsigned long *num)
+{
+    char *end;
+    errno = 0;
+    *num = strtoul(str, &end, 0);
+    if(str[0] == '\0' || end[0] != '\0' || errno != 0)
+    {
+        fprintf(stderr, "[!] Failed to parse \"%s\"\n", str);
+        return false;
+    }
+    return true;
+}
+
+static void print_string(vm_address_t addr, const char *str, size_t len)
+{
+    printf(ADDR " ", addr);
+    for(size_t i = 0; i < len; ++i)
+    {
+        switch(str[i])
+        {
+            case '\t':  fputs("\\t", stdout);   break;
+            case '\n':  fputs("\\n", stdout);   break;
+            case '\r':  fputs("\\r", stdout);   break;
+            case '\\':  fputs("\\\\", stdout);  break;
+            default:    fputc(str[i], stdout);  break;
+        }
+    }
+    fputc('\n', stdout);
+}
+
+static int print_cb(vm_address_t addr, const char *str, size_t len, void *arg)
+{
+    print_string(addr, str, len);
+    return 0;
+}
+
+// Find seg.sect in the kernel header, slid
+static bool find_section(vm_address_t kbase, const char *name, vm_address_t *addr, vm_size_t *size)
+{
+    const char *dot = strchr(name, '.');
+    if(dot == NULL)
+    {
+        fprintf(stderr, "[!] Section must be given as seg.sect\n");
+        return false;
+    }
+    size_t seglen = dot - name;
+    mach_hdr_t *hdr = kernel_header(kbase);
+    if(hdr == NULL)
+    {
+        fprintf(stderr, "[!] Failed to read kernel header\n");
+        return false;
+    }
+    bool found = false;
+    vm_address_t slide = macho_slide(hdr, kbase);
+    CMD_ITERATE(hdr, cmd)
+    {
+        if(cmd->cmd != MACH_LC_SEGMENT)
+        {
+            continue;
+        }
+        mach_seg_t *seg = (mach_seg_t*)cmd;
+        mach_sec_t *sec = (mach_sec_t*)(seg + 1);
+        for(size_t i = 0; i < seg->nsects && !found; ++i)
+        {
+            if(seglen <= sizeof(sec[i].segname) && strncmp(sec[i].segname, name, seglen) == 0 && (seglen == sizeof(sec[i].segname) || sec[i].segname[seglen] == '\0') &&
+               strncmp(sec[i].sectname, dot + 1, sizeof(sec[i].sectname)) == 0 && strlen(dot + 1) <= sizeof(sec[i].sectname))
+            {
+                *addr = sec[i].addr + slide;
+                *size = sec[i].size;
+                found = true;
+            }
+        }
+        if(found)
+        {
+            break;
+        }
+    }
+    free(hdr);
+    if(!found)
+    {
+        fprintf(stderr, "[!] Failed to find section %s\n", name);
+    }
+    return found;
+}
+
+int main(int argc, const char **argv)
+{
+    unsigned long threads = 0,
+                  min_len = DEFAULT_MIN_LEN,
+                  addr = 0,
+                  size = 0;
+    const char *section = NULL,
+               *find = NULL;
+    bool range = false;
+    int aoff;
+    for(aoff = 1; aoff < argc; ++aoff)
+    {
+        if(argv[aoff][0] != '-')
+        {
+            break;
+        }
+        if(strcmp(argv[aoff], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[aoff], "-d") == 0)
+        {
+            slow = true;
+        }
+        else if(strcmp(argv[aoff], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
+        else if(strcmp(argv[aoff], "-j") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &threads))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-n") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &min_len))
+            {
+                return -1;
+            }
+        }
+        else if(strcmp(argv[aoff], "-a") == 0 && aoff + 2 < argc)
+        {
+            if(!parse_num(argv[aoff + 1], &addr) || !parse_num(argv[aoff + 2], &size))
+            {
+                return -1;
+            }
+            aoff += 2;
+            range = true;
+        }
+        else if(strcmp(argv[aoff], "-s") == 0 && aoff + 1 < argc)
+        {
+            section = argv[++aoff];
+        }
+        else if(strcmp(argv[aoff], "-f") == 0 && aoff + 1 < argc)
+        {
+            find = argv[++aoff];
+        }
+        else
+        {
+            fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(argc - aoff > 0)
+    {
+        fprintf(stderr, "[!] Too many arguments\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if((range ? 1 : 0) + (section != NULL ? 1 : 0) + (find != NULL ? 1 : 0) > 1)
+    {
+        fprintf(stderr, "[!] -a, -s and -f are mutually exclusive\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    vm_address_t kbase;
+    KERNEL_BASE_OR_GTFO(kbase);
+
+    if(find != NULL)
+    {
+        str_index_t *idx = str_index(kbase, threads);
+        if(idx == NULL)
+        {
+            fprintf(stderr, "[!] Failed to build string index\n");
+            return -1;
+        }
+        vm_address_t addrs[MAX_ADDRS];
+        size_t n = str_index_lookup(idx, find, strlen(find), addrs, MAX_ADDRS);
+        for(size_t i = 0; i < n && i < MAX_ADDRS; ++i)
+        {
+            printf(ADDR "\n", addrs[i]);
+        }
+        if(n > MAX_ADDRS)
+        {
+            fprintf(stderr, "[*] %zu more not shown\n", n - MAX_ADDRS);
+        }
+        str_index_free(idx);
+        return n > 0 ? 0 : 1;
+    }
+
+    if(section != NULL)
+    {
+        vm_address_t secaddr;
+        vm_size_t secsize;
+        if(!find_section(kbase, section, &secaddr, &secsize))
+        {
+            return -1;
+        }
+        addr = secaddr;
+        size = secsize;
+        range = true;
+    }
+
+    if(!range)
+    {
+        if(str_scan_kernel(kbase, min_len, threads, &print_cb, NULL) != 0)
+        {
+            fprintf(stderr, "[!] Failed to scan kernel strings\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    char *buf = malloc(size > 0 ? size : 1);
+    if(buf == NULL)
+    {
+        fprintf(stderr, "[!] Failed to allocate buffer (%s)\n", strerror(errno));
+        return -1;
+    }
+    if(kernel_read(addr, size, buf) != size)
+    {
+        fprintf(stderr, "[!] Kernel I/O error\n");
+        free(buf);
+        return -1;
+    }
+    size_t count;
+    str_hit_t *hits = str_extract(buf, size, min_len, threads, &count);
+    if(hits == NULL)
+    {
+        fprintf(stderr, "[!] Failed to extract strings\n");
+        free(buf);
+        return -1;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+        print_string(addr + hits[i].off, &buf[hits[i].off], hits[i].len);
+    }
+    free(hits);
+    free(buf);
+    return 0;
+}
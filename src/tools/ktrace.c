@@ -0,0 +1,335 @@
+/*
+ * ktrace.c - Analyze recorded kernel access traces
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint64_t
+#include <stdio.h>              // printf, fprintf, stderr
+#include <stdlib.h>             // calloc, free, malloc, qsort, strtoul
+#include <string.h>             // strcmp, strerror
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // ADDR
+#include "trace.h"              // trace_*, TRACE_*
+
+typedef struct
+{
+    vm_address_t addr;
+    uint64_t reads;
+    uint64_t bytes;
+    uint64_t redundant;
+    uint64_t changed;
+    uint8_t known[TRACE_PAGE_SIZE / 8];
+    uint8_t content[TRACE_PAGE_SIZE];
+} page_t;
+
+typedef struct
+{
+    size_t count;
+    size_t cap;                 // Power of two
+    page_t **slots;
+} page_map_t;
+
+static const char *op_names[] =
+{
+    [TRACE_READ]   = "read",
+    [TRACE_WRITE]  = "write",
+    [TRACE_BASE]   = "base",
+    [TRACE_REGION] = "region",
+};
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-l] [-n count] trace\n"
+                    "    -h  Print this help\n"
+                    "    -l  List all records\n"
+                    "    -n  Number of hot pages to show (default 10)\n"
+                    "\n"
+                    "Traces are recorded by running any tool with KUTIL_RECORD=trace,\n"
+                    "and can be replayed with KUTIL_REPLAY=trace.\n"
+                    , self);
+}
+
+static size_t page_slot(const page_map_t *map, vm_address_t addr)
+{
+    size_t i = (addr / TRACE_PAGE_SIZE * 0x9e3779b97f4a7c15ULL) & (map->cap - 1);
+    while(map->slots[i] != NULL && map->slots[i]->addr != addr)
+    {
+        i = (i + 1) & (map->cap - 1);
+    }
+    return i;
+}
+
+static page_t* page_get(page_map_t *map, vm_address_t addr)
+{
+    if(map->count * 2 >= map->cap)
+    {
+        page_map_t n = { .count = map->count, .cap = map->cap == 0 ? 0x400 : map->cap * 2 };
+        n.slots = calloc(n.cap, sizeof(*n.slots));
+        if(n.slots == NULL)
+        {
+            return NULL;
+        }
+        for(size_t i = 0; i < map->cap; ++i)
+        {
+            if(map->slots[i] != NULL)
+            {
+                n.slots[page_slot(&n, map->slots[i]->addr)] = map->slots[i];
+            }
+        }
+        free(map->slots);
+        *map = n;
+    }
+    size_t i = page_slot(map, addr);
+    if(map->slots[i] == NULL)
+    {
+        page_t *p = calloc(1, sizeof(*p));
+        if(p == NULL)
+        {
+            return NULL;
+        }
+        p->addr = addr;
+        map->slots[i] = p;
+        ++map->count;
+    }
+    return map->slots[i];
+}
+
+static int page_cmp(const void *a, const void *b)
+{
+    const page_t *x = *(const page_t**)a,
+                 *y = *(const page_t**)b;
+    if(x->reads != y->reads)
+    {
+        return x->reads < y->reads ? 1 : -1;
+    }
+    return x->addr < y->addr ? -1 : x->addr > y->addr;
+}
+
+int main(int argc, const char **argv)
+{
+    bool list = false;
+    unsigned long top = 10;
+
+    int aoff;
+    for(aoff = 1; aoff < argc; ++aoff)
+    {
+        if(argv[aoff][0] != '-')
+        {
+            break;
+        }
+        if(strcmp(argv[aoff], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[aoff], "-l") == 0)
+        {
+            list = true;
+        }
+        else if(strcmp(argv[aoff], "-n") == 0 && aoff + 1 < argc)
+        {
+            char *end;
+            errno = 0;
+            top = strtoul(argv[++aoff], &end, 0);
+            if(argv[aoff][0] == '\0' || end[0] != '\0' || errno != 0)
+            {
+                fprintf(stderr, "[!] Failed to parse \"%s\": %s\n", argv[aoff], argv[aoff][0] == '\0' ? "zero characters given" : strerror(errno));
+                return -1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(argc - aoff != 1)
+    {
+        fprintf(stderr, "[!] Expected exactly one trace file\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+
+    trace_t *t = trace_open(argv[aoff]);
+    if(t == NULL)
+    {
+        fprintf(stderr, "[!] Failed to load trace %s\n", argv[aoff]);
+        return -1;
+    }
+
+    int ret = -1;
+    page_map_t map = { 0 };
+    page_t **sorted = NULL;
+    uint64_t ops[TRACE_REGION + 1] = { 0 },
+             requested = 0, transferred = 0, fails = 0, shorts = 0,
+             busy = 0, redundant = 0, changed = 0, dup_reads = 0,
+             runs = 0, run_len = 0, run_bytes = 0, longest = 0, longest_bytes = 0, seq = 0;
+    vm_address_t run_end = 0;
+    size_t n = trace_count(t);
+
+    if(list)
+    {
+        printf("%10s %14s %14s  %-6s %-18s %10s %10s\n", "#", "time ms", "duration us", "op", "address", "size", "result");
+    }
+    for(size_t i = 0; i < n; ++i)
+    {
+        const trace_rec_t *r = trace_get(t, i);
+        if(list)
+        {
+            printf("%10zu %14.3f %14.1f  %-6s " ADDR " %10llx %10llx\n", i, r->time / 1e6, r->duration / 1e3, op_names[r->op]
+                   , r->addr, (unsigned long long)r->size, (unsigned long long)r->result);
+        }
+        ++ops[r->op];
+        busy += r->duration;
+        if(r->op != TRACE_READ && r->op != TRACE_WRITE)
+        {
+            continue;
+        }
+        requested += r->size;
+        transferred += r->result;
+        if(r->result == 0 && r->size != 0)
+        {
+            ++fails;
+        }
+        else if(r->result < r->size)
+        {
+            ++shorts;
+        }
+        if(r->op != TRACE_READ)
+        {
+            continue;
+        }
+
+        // A read starting where the last one ended continues a run
+        if(runs > 0 && r->addr == run_end)
+        {
+            ++seq;
+            ++run_len;
+            run_bytes += r->size;
+        }
+        else
+        {
+            ++runs;
+            run_len = 1;
+            run_bytes = r->size;
+        }
+        run_end = r->addr + r->size;
+        if(run_len > longest)
+        {
+            longest = run_len;
+        }
+        if(run_bytes > longest_bytes)
+        {
+            longest_bytes = run_bytes;
+        }
+
+        // Compare against what previous reads already brought in
+        uint64_t fresh = 0;
+        for(vm_size_t off = 0; off < r->result; )
+        {
+            vm_address_t a = r->addr + off;
+            size_t poff = a & (TRACE_PAGE_SIZE - 1),
+                   len = TRACE_PAGE_SIZE - poff;
+            if(len > r->result - off)
+            {
+                len = r->result - off;
+            }
+            page_t *p = page_get(&map, a - poff);
+            if(p == NULL)
+            {
+                fprintf(stderr, "[!] Out of memory\n");
+                goto out;
+            }
+            ++p->reads;
+            p->bytes += len;
+            for(size_t k = poff; k < poff + len; ++k)
+            {
+                uint8_t b = r->data[off + k - poff];
+                if(!(p->known[k / 8] & (1 << (k % 8))))
+                {
+                    p->known[k / 8] |= 1 << (k % 8);
+                    ++fresh;
+                }
+                else if(p->content[k] == b)
+                {
+                    ++p->redundant;
+                    ++redundant;
+                }
+                else
+                {
+                    ++p->changed;
+                    ++changed;
+                }
+                p->content[k] = b;
+            }
+            off += len;
+        }
+        if(fresh == 0 && r->result > 0)
+        {
+            ++dup_reads;
+        }
+    }
+
+    size_t pages, filesize;
+    trace_info(t, &pages, &filesize);
+    const trace_rec_t *last = n > 0 ? trace_get(t, n - 1) : NULL;
+    printf("[*] %zu records over %.3f ms (%.3f ms in kernel calls)\n", n, last != NULL ? (last->time + last->duration) / 1e6 : 0.0, busy / 1e6);
+    printf("    %llu reads, %llu writes, %llu base lookups, %llu region lookups\n"
+           , (unsigned long long)ops[TRACE_READ], (unsigned long long)ops[TRACE_WRITE], (unsigned long long)ops[TRACE_BASE], (unsigned long long)ops[TRACE_REGION]);
+    printf("    %llu bytes requested, %llu transferred, %llu failed, %llu short\n"
+           , (unsigned long long)requested, (unsigned long long)transferred, (unsigned long long)fails, (unsigned long long)shorts);
+    printf("    %zu bytes on disk, %zu distinct data pages, %.2f bytes transferred per byte stored\n"
+           , filesize, pages, filesize > 0 ? (double)transferred / filesize : 0.0);
+    printf("[*] Sequential runs\n");
+    printf("    %llu runs, %llu of %llu reads continue the previous one (%.1f%%)\n"
+           , (unsigned long long)runs, (unsigned long long)seq, (unsigned long long)ops[TRACE_READ], ops[TRACE_READ] > 0 ? 100.0 * seq / ops[TRACE_READ] : 0.0);
+    printf("    longest: %llu reads, %llu bytes\n", (unsigned long long)longest, (unsigned long long)longest_bytes);
+    printf("[*] Re-reads\n");
+    printf("    %zu distinct pages touched\n", map.count);
+    printf("    %llu bytes re-read unchanged, %llu bytes re-read changed\n", (unsigned long long)redundant, (unsigned long long)changed);
+    printf("    %llu reads brought in nothing new\n", (unsigned long long)dup_reads);
+
+    if(top > 0 && map.count > 0)
+    {
+        sorted = malloc(map.count * sizeof(*sorted));
+        if(sorted == NULL)
+        {
+            fprintf(stderr, "[!] Out of memory\n");
+            goto out;
+        }
+        size_t k = 0;
+        for(size_t i = 0; i < map.cap; ++i)
+        {
+            if(map.slots[i] != NULL)
+            {
+                sorted[k++] = map.slots[i];
+            }
+        }
+        qsort(sorted, map.count, sizeof(*sorted), &page_cmp);
+        printf("[*] Hot pages\n");
+        printf("    %-18s %10s %12s %12s %12s\n", "page", "reads", "bytes", "unchanged", "changed");
+        for(size_t i = 0; i < map.count && i < top; ++i)
+        {
+            page_t *p = sorted[i];
+            printf("    " ADDR " %10llu %12llu %12llu %12llu\n", p->addr
+                   , (unsigned long long)p->reads, (unsigned long long)p->bytes, (unsigned long long)p->redundant, (unsigned long long)p->changed);
+        }
+    }
+    ret = 0;
+
+out:;
+    for(size_t i = 0; i < map.cap; ++i)
+    {
+        free(map.slots[i]);
+    }
+    free(map.slots);
+    free(sorted);
+    trace_close(t);
+    return ret;
+}
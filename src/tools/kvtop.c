@@ -0,0 +1,194 @@
+/*
+ * kvtop.c - Translate kernel virtual addresses to physical ones
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint64_t
+#include <stdio.h>              // fprintf, printf, stderr
+#include <stdlib.h>             // strtoull
+#include <string.h>             // strchr, strcmp, strerror
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // ADDR
+#include "debug.h"              // slow, verbose
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
+#include "vtop.h"               // vtop_*, VTOP_DEFAULT_T1SZ
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-S] [-g granule] [-z t1sz] [-p virt:phys] -t ttbr addr [size]\n"
+                    "Prints the physical ranges addr to addr + size (default 1) is mapped to,\n"
+                    "merging contiguous ones, by walking the TTBR1 page tables at ttbr.\n"
+                    "0x for hex, no prefix for decimal\n"
+                    "\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
+                    "    -g  Translation granule, 0x1000 or 0x4000 (default 0x4000)\n"
+                    "    -h  Print this help\n"
+                    "    -p  Read the tables through the physmap at virt, which maps phys\n"
+                    "        (gVirtBase and gPhysBase), if there is no physical access\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
+                    "    -t  Physical address of the root table (TTBR1_EL1)\n"
+                    "    -v  Verbose (debug output)\n"
+                    "    -z  T1SZ, i.e. 64 minus the kernel address bits (default %u)\n"
+                    , self, VTOP_DEFAULT_T1SZ);
+}
+
+static bool parse_num(const char *str, uint64_t *num)
+{
+    char *end;
+    errno = 0;
+    *num = strtoull(str, &end, 0);
+    if(str[0] == '\0' || end[0] != '\0' || errno != 0)
+    {
+        fprintf(stderr, "[!] Failed to parse \"%s\"\n", str);
+        return false;
+    }
+    return true;
+}
+
+static int print_run(const vtop_run_t *run, void *arg)
+{
+    size_t *runs = arg;
+    ++*runs;
+    if(run->mapped)
+    {
+        printf(ADDR "-" ADDR " -> %016llx-%016llx\n", run->va, run->va + run->size, (unsigned long long)run->pa, (unsigned long long)(run->pa + run->size));
+    }
+    else
+    {
+        printf(ADDR "-" ADDR "    unmapped\n", run->va, run->va + run->size);
+    }
+    return 0;
+}
+
+int main(int argc, const char **argv)
+{
+    vtop_cfg_t cfg =
+    {
+        .root = 0,
+        .granule = 0x4000,
+        .t1sz = 0,
+        .virt_base = 0,
+        .phys_base = 0,
+    };
+    bool have_root = false;
+    uint64_t num;
+    int aoff;
+    for(aoff = 1; aoff < argc; ++aoff)
+    {
+        if(argv[aoff][0] != '-')
+        {
+            break;
+        }
+        if(strcmp(argv[aoff], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[aoff], "-d") == 0)
+        {
+            slow = true;
+        }
+        else if(strcmp(argv[aoff], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
+        else if(strcmp(argv[aoff], "-t") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &cfg.root))
+            {
+                return -1;
+            }
+            have_root = true;
+        }
+        else if(strcmp(argv[aoff], "-g") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &num))
+            {
+                return -1;
+            }
+            cfg.granule = num;
+        }
+        else if(strcmp(argv[aoff], "-z") == 0 && aoff + 1 < argc)
+        {
+            if(!parse_num(argv[++aoff], &num))
+            {
+                return -1;
+            }
+            cfg.t1sz = num;
+        }
+        else if(strcmp(argv[aoff], "-p") == 0 && aoff + 1 < argc)
+        {
+            char buf[64];
+            const char *arg = argv[++aoff],
+                       *colon = strchr(arg, ':');
+            if(colon == NULL || colon - arg >= sizeof(buf))
+            {
+                fprintf(stderr, "[!] Physmap must be given as virt:phys\n");
+                return -1;
+            }
+            memcpy(buf, arg, colon - arg);
+            buf[colon - arg] = '\0';
+            if(!parse_num(buf, &num) || !parse_num(colon + 1, &cfg.phys_base))
+            {
+                return -1;
+            }
+            cfg.virt_base = num;
+        }
+        else
+        {
+            fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(!have_root)
+    {
+        fprintf(stderr, "[!] Need the root table (-t)\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if(argc - aoff < 1 || argc - aoff > 2)
+    {
+        fprintf(stderr, "[!] Expected addr and optionally size\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    uint64_t addr,
+             size = 1;
+    if(!parse_num(argv[aoff], &addr) || (argc - aoff > 1 && !parse_num(argv[aoff + 1], &size)))
+    {
+        return -1;
+    }
+
+    vtop_t *vt = vtop_create(&cfg);
+    if(vt == NULL)
+    {
+        fprintf(stderr, "[!] Failed to set up page table walker (bad granule, T1SZ or root,\n"
+                        "    or no way to read physical memory; see -p)\n");
+        return -1;
+    }
+    size_t runs = 0;
+    int ret = vtop_walk(vt, addr, size, &print_run, &runs);
+    if(ret != 0)
+    {
+        fprintf(stderr, "[!] " ADDR "-" ADDR " is not a kernel address range for this T1SZ\n", (vm_address_t)addr, (vm_address_t)(addr + size));
+    }
+    else
+    {
+        uint64_t reads, hits;
+        vtop_counts(vt, &reads, &hits);
+        fprintf(stderr, "[*] %zu runs, %llu table reads, %llu cached lookups\n", runs, (unsigned long long)reads, (unsigned long long)hits);
+    }
+    vtop_free(vt);
+    return ret != 0 ? -1 : 0;
+}
@@ -0,0 +1,631 @@
+/*
+ * kwalk.c - Walk kernel data structures described by a schema
+ *
+ * Copyright (c) 2026 ios-kern-utils contributors
+ */
+
+#include <errno.h>              // errno
+#include <stdbool.h>            // bool, true, false
+#include <stdint.h>             // uint8_t, uint32_t, uint64_t
+#include <stdio.h>              // FILE, fopen, fgets, fclose, printf, fprintf, putchar, stderr
+#include <stdlib.h>             // calloc, free, malloc, realloc, strtoul
+#include <string.h>             // memcpy, memset, strchr, strcmp, strerror, strlen, strncpy, strtok_r
+
+#include <mach/vm_types.h>      // vm_address_t, vm_size_t
+
+#include "arch.h"               // ADDR, KERNEL_SPACE
+#include "debug.h"              // slow, verbose
+#include "libkern.h"            // kernel_read, kernel_read_list, kernel_iov_t
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
+#include "timer.h"              // timer_ns
+
+#define NAME_LEN 32
+#define MAX_STRUCT_SIZE 0x10000
+#define BATCH_NODES 0x1000      // Most nodes read in one go, bounds memory
+#define DEFAULT_MAX_NODES 100000
+
+enum
+{
+    FMT_HEX,
+    FMT_DEC,
+    FMT_STR,
+    FMT_PTR,
+};
+
+static const char *fmt_names[] =
+{
+    [FMT_HEX] = "hex",
+    [FMT_DEC] = "dec",
+    [FMT_STR] = "str",
+    [FMT_PTR] = "ptr",
+};
+
+typedef struct
+{
+    char name[NAME_LEN];
+    uint32_t off;
+    uint32_t size;
+    int fmt;
+} field_t;
+
+typedef struct
+{
+    char name[NAME_LEN];
+    char target_name[NAME_LEN];
+    uint32_t off;               // Of the pointer
+    uint32_t target_off;        // Where in the target the pointer points
+    size_t target;
+} follow_t;
+
+typedef struct
+{
+    char name[NAME_LEN];
+    uint32_t size;
+    field_t *fields;
+    size_t nfields;
+    follow_t *follows;
+    size_t nfollows;
+} struct_t;
+
+typedef struct
+{
+    struct_t *structs;
+    size_t count;
+} schema_t;
+
+typedef struct
+{
+    vm_address_t addr;
+    uint32_t type;
+    uint32_t depth;
+} node_t;
+
+typedef struct
+{
+    node_t *nodes;
+    size_t count;
+    size_t cap;
+} frontier_t;
+
+typedef struct
+{
+    size_t count;
+    size_t cap;                 // Power of two
+    vm_address_t *slots;        // 0 is empty
+} addr_set_t;
+
+static void print_usage(const char *self)
+{
+    fprintf(stderr, "Usage: %s [-h] [-v [-d]] [-S] [-i] [-m depth] [-n nodes] schema struct addr\n"
+                    "Walks kernel structures breadth-first from addr, reading each level of the\n"
+                    "walk in batches, and prints one line per structure.\n"
+                    "\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
+                    "    -h  Print this help\n"
+                    "    -i  addr holds a pointer to the first structure (e.g. a global)\n"
+                    "    -m  Maximum depth (default: unlimited)\n"
+                    "    -n  Maximum number of structures (default %u)\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
+                    "    -v  Verbose (debug output)\n"
+                    "\n"
+                    "The schema is a text file with one directive per line, '#' starts a comment:\n"
+                    "\n"
+                    "    struct <name> <size>\n"
+                    "    field  <name> <offset> <size> [hex|dec|str|ptr]\n"
+                    "    follow <name> <offset> <struct> [<offset in struct>]\n"
+                    "\n"
+                    "Fields and follows belong to the struct above them. A follow is a pointer\n"
+                    "to walk to, e.g. 'next' for lists or 'left' and 'right' for trees. If it\n"
+                    "points into the middle of the target, like list entries do, give the offset\n"
+                    "it points to. Every structure is visited only once.\n"
+                    , self, DEFAULT_MAX_NODES);
+}
+
+static bool parse_num(const char *str, unsigned long *num)
+{
+    char *end;
+    errno = 0;
+    *num = strtoul(str, &end, 0);
+    return str[0] != '\0' && end[0] == '\0' && errno == 0;
+}
+
+static bool copy_name(char dst[NAME_LEN], const char *src)
+{
+    if(strlen(src) >= NAME_LEN)
+    {
+        return false;
+    }
+    strncpy(dst, src, NAME_LEN);
+    return true;
+}
+
+// Make room for one more element in an array that doubles in size
+static void* grow(void *ptr, size_t count, size_t size)
+{
+    if(count != 0 && (count & (count - 1)) != 0)
+    {
+        return ptr;
+    }
+    return realloc(ptr, (count == 0 ? 1 : count * 2) * size);
+}
+
+static size_t find_struct(const schema_t *schema, const char *name)
+{
+    for(size_t i = 0; i < schema->count; ++i)
+    {
+        if(strcmp(schema->structs[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return schema->count;
+}
+
+static void free_schema(schema_t *schema)
+{
+    for(size_t i = 0; i < schema->count; ++i)
+    {
+        free(schema->structs[i].fields);
+        free(schema->structs[i].follows);
+    }
+    free(schema->structs);
+}
+
+static bool load_schema(const char *path, schema_t *schema)
+{
+    FILE *f = fopen(path, "r");
+    if(f == NULL)
+    {
+        fprintf(stderr, "[!] Failed to open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+    bool ok = true;
+    char line[0x200];
+    for(unsigned int lineno = 1; ok && fgets(line, sizeof(line), f) != NULL; ++lineno)
+    {
+        char *hash = strchr(line, '#');
+        if(hash != NULL)
+        {
+            *hash = '\0';
+        }
+        char *save,
+             *tok[6];
+        size_t ntok = 0;
+        for(char *t = strtok_r(line, " \t\r\n", &save); t != NULL; t = strtok_r(NULL, " \t\r\n", &save))
+        {
+            if(ntok >= sizeof(tok) / sizeof(*tok))
+            {
+                goto bad;
+            }
+            tok[ntok++] = t;
+        }
+        if(ntok == 0)
+        {
+            continue;
+        }
+
+        unsigned long a, b;
+        struct_t *cur = schema->count > 0 ? &schema->structs[schema->count - 1] : NULL;
+        if(strcmp(tok[0], "struct") == 0 && ntok == 3)
+        {
+            if(!parse_num(tok[2], &a) || a == 0 || a > MAX_STRUCT_SIZE || find_struct(schema, tok[1]) != schema->count)
+            {
+                goto bad;
+            }
+            struct_t *structs = grow(schema->structs, schema->count, sizeof(*structs));
+            if(structs == NULL)
+            {
+                goto oom;
+            }
+            schema->structs = structs;
+            cur = &structs[schema->count];
+            memset(cur, 0, sizeof(*cur));
+            if(!copy_name(cur->name, tok[1]))
+            {
+                goto bad;
+            }
+            cur->size = a;
+            ++schema->count;
+        }
+        else if(strcmp(tok[0], "field") == 0 && (ntok == 4 || ntok == 5) && cur != NULL)
+        {
+            int fmt = FMT_HEX;
+            if(ntok == 5)
+            {
+                for(fmt = 0; fmt < sizeof(fmt_names) / sizeof(*fmt_names) && strcmp(tok[4], fmt_names[fmt]) != 0; ++fmt);
+                if(fmt == sizeof(fmt_names) / sizeof(*fmt_names))
+                {
+                    goto bad;
+                }
+            }
+            if(!parse_num(tok[2], &a) || !parse_num(tok[3], &b) || b == 0 || a > cur->size || b > cur->size - a ||
+               ((fmt == FMT_DEC || fmt == FMT_PTR) && b > sizeof(uint64_t)))
+            {
+                goto bad;
+            }
+            field_t *fields = grow(cur->fields, cur->nfields, sizeof(*fields));
+            if(fields == NULL)
+            {
+                goto oom;
+            }
+            cur->fields = fields;
+            field_t *fl = &fields[cur->nfields++];
+            if(!copy_name(fl->name, tok[1]))
+            {
+                goto bad;
+            }
+            fl->off = a;
+            fl->size = b;
+            fl->fmt = fmt;
+        }
+        else if(strcmp(tok[0], "follow") == 0 && (ntok == 4 || ntok == 5) && cur != NULL)
+        {
+            b = 0;
+            if(!parse_num(tok[2], &a) || a > cur->size || sizeof(vm_address_t) > cur->size - a || (ntok == 5 && !parse_num(tok[4], &b)))
+            {
+                goto bad;
+            }
+            follow_t *follows = grow(cur->follows, cur->nfollows, sizeof(*follows));
+            if(follows == NULL)
+            {
+                goto oom;
+            }
+            cur->follows = follows;
+            follow_t *fw = &follows[cur->nfollows++];
+            if(!copy_name(fw->name, tok[1]) || !copy_name(fw->target_name, tok[3]))
+            {
+                goto bad;
+            }
+            fw->off = a;
+            fw->target_off = b;
+        }
+        else
+        {
+            goto bad;
+        }
+        continue;
+
+    bad:;
+        fprintf(stderr, "[!] %s:%u: Invalid directive\n", path, lineno);
+        ok = false;
+        continue;
+    oom:;
+        fprintf(stderr, "[!] Out of memory\n");
+        ok = false;
+    }
+    fclose(f);
+
+    // Targets may be declared after the follows pointing at them
+    for(size_t i = 0; ok && i < schema->count; ++i)
+    {
+        struct_t *s = &schema->structs[i];
+        for(size_t j = 0; j < s->nfollows; ++j)
+        {
+            follow_t *fw = &s->follows[j];
+            fw->target = find_struct(schema, fw->target_name);
+            if(fw->target == schema->count)
+            {
+                fprintf(stderr, "[!] %s: Unknown struct %s in %s.%s\n", path, fw->target_name, s->name, fw->name);
+                ok = false;
+                break;
+            }
+            if(fw->target_off > schema->structs[fw->target].size)
+            {
+                fprintf(stderr, "[!] %s: Offset 0x%x of %s.%s is outside of %s\n", path, fw->target_off, s->name, fw->name, fw->target_name);
+                ok = false;
+                break;
+            }
+        }
+    }
+    if(ok && schema->count == 0)
+    {
+        fprintf(stderr, "[!] %s: No structs\n", path);
+        ok = false;
+    }
+    return ok;
+}
+
+static size_t set_slot(const addr_set_t *set, vm_address_t addr)
+{
+    size_t i = (addr * 0x9e3779b97f4a7c15ULL >> 16) & (set->cap - 1);
+    while(set->slots[i] != 0 && set->slots[i] != addr)
+    {
+        i = (i + 1) & (set->cap - 1);
+    }
+    return i;
+}
+
+// Returns 1 if addr was added, 0 if it was already there, -1 on failure
+static int set_add(addr_set_t *set, vm_address_t addr)
+{
+    if(set->count * 2 >= set->cap)
+    {
+        addr_set_t n = { .count = set->count, .cap = set->cap == 0 ? 0x400 : set->cap * 2 };
+        n.slots = calloc(n.cap, sizeof(*n.slots));
+        if(n.slots == NULL)
+        {
+            return -1;
+        }
+        for(size_t i = 0; i < set->cap; ++i)
+        {
+            if(set->slots[i] != 0)
+            {
+                n.slots[set_slot(&n, set->slots[i])] = set->slots[i];
+            }
+        }
+        free(set->slots);
+        *set = n;
+    }
+    size_t i = set_slot(set, addr);
+    if(set->slots[i] != 0)
+    {
+        return 0;
+    }
+    set->slots[i] = addr;
+    ++set->count;
+    return 1;
+}
+
+static bool push(frontier_t *f, vm_address_t addr, uint32_t type, uint32_t depth)
+{
+    if(f->count >= f->cap)
+    {
+        size_t cap = f->cap == 0 ? 0x100 : f->cap * 2;
+        node_t *nodes = realloc(f->nodes, cap * sizeof(*nodes));
+        if(nodes == NULL)
+        {
+            return false;
+        }
+        f->nodes = nodes;
+        f->cap = cap;
+    }
+    f->nodes[f->count++] = (node_t){ .addr = addr, .type = type, .depth = depth };
+    return true;
+}
+
+static uint64_t get_uint(const uint8_t *data, uint32_t size)
+{
+    uint64_t val = 0;
+    memcpy(&val, data, size);   // Little endian
+    return val;
+}
+
+static void print_node(const schema_t *schema, const node_t *node, const uint8_t *data)
+{
+    const struct_t *s = &schema->structs[node->type];
+    printf("%5u  " ADDR "  %-16s", node->depth, node->addr, s->name);
+    if(data == NULL)
+    {
+        printf("  (unreadable)\n");
+        return;
+    }
+    for(size_t i = 0; i < s->nfields; ++i)
+    {
+        const field_t *fl = &s->fields[i];
+        const uint8_t *p = &data[fl->off];
+        printf("  %s=", fl->name);
+        switch(fl->fmt)
+        {
+            case FMT_DEC:
+                printf("%llu", (unsigned long long)get_uint(p, fl->size));
+                break;
+            case FMT_PTR:
+                printf("0x%llx", (unsigned long long)get_uint(p, fl->size));
+                break;
+            case FMT_STR:
+                putchar('"');
+                for(uint32_t k = 0; k < fl->size && p[k] != '\0'; ++k)
+                {
+                    putchar(p[k] >= 0x20 && p[k] < 0x7f && p[k] != '"' ? p[k] : '.');
+                }
+                putchar('"');
+                break;
+            default:
+                if(fl->size <= sizeof(uint64_t))
+                {
+                    printf("0x%0*llx", (int)fl->size * 2, (unsigned long long)get_uint(p, fl->size));
+                }
+                else
+                {
+                    for(uint32_t k = 0; k < fl->size; ++k)
+                    {
+                        printf("%02x", p[k]);
+                    }
+                }
+                break;
+        }
+    }
+    putchar('\n');
+}
+
+int main(int argc, const char **argv)
+{
+    bool indirect = false;
+    unsigned long max_depth = (unsigned long)-1,
+                  max_nodes = DEFAULT_MAX_NODES,
+                  root;
+
+    int aoff;
+    for(aoff = 1; aoff < argc; ++aoff)
+    {
+        if(argv[aoff][0] != '-')
+        {
+            break;
+        }
+        if(strcmp(argv[aoff], "-h") == 0)
+        {
+            print_usage(argv[0]);
+            return 0;
+        }
+        if(strcmp(argv[aoff], "-d") == 0)
+        {
+            slow = true;
+        }
+        else if(strcmp(argv[aoff], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
+        else if(strcmp(argv[aoff], "-i") == 0)
+        {
+            indirect = true;
+        }
+        else if((strcmp(argv[aoff], "-m") == 0 || strcmp(argv[aoff], "-n") == 0) && aoff + 1 < argc)
+        {
+            bool depth = argv[aoff][1] == 'm';
+            if(!parse_num(argv[++aoff], depth ? &max_depth : &max_nodes))
+            {
+                fprintf(stderr, "[!] Failed to parse \"%s\"\n", argv[aoff]);
+                return -1;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    if(argc - aoff != 3)
+    {
+        fprintf(stderr, "[!] Expected a schema, a struct and an address\n\n");
+        print_usage(argv[0]);
+        return -1;
+    }
+    if(!parse_num(argv[aoff + 2], &root))
+    {
+        fprintf(stderr, "[!] Failed to parse \"%s\"\n", argv[aoff + 2]);
+        return -1;
+    }
+
+    int ret = -1;
+    schema_t schema = { 0 };
+    addr_set_t seen = { 0 };
+    frontier_t cur = { 0 },
+               next = { 0 };
+    kernel_iov_t *iov = NULL;
+    uint8_t *buf = NULL;
+
+    if(!load_schema(argv[aoff], &schema))
+    {
+        goto out;
+    }
+    size_t type = find_struct(&schema, argv[aoff + 1]);
+    if(type == schema.count)
+    {
+        fprintf(stderr, "[!] Unknown struct %s\n", argv[aoff + 1]);
+        goto out;
+    }
+    vm_address_t addr = root;
+    if(indirect && kernel_read(root, sizeof(addr), &addr) != sizeof(addr))
+    {
+        fprintf(stderr, "[!] Failed to read pointer at " ADDR "\n", (vm_address_t)root);
+        goto out;
+    }
+
+    size_t maxsize = 0;
+    for(size_t i = 0; i < schema.count; ++i)
+    {
+        if(schema.structs[i].size > maxsize)
+        {
+            maxsize = schema.structs[i].size;
+        }
+    }
+    iov = malloc(BATCH_NODES * sizeof(*iov));
+    buf = malloc(BATCH_NODES * maxsize);
+    if(iov == NULL || buf == NULL || set_add(&seen, addr) < 0 || !push(&cur, addr, type, 0))
+    {
+        fprintf(stderr, "[!] Out of memory\n");
+        goto out;
+    }
+
+    printf("%5s  %-18s  %-16s  %s\n", "depth", "address", "struct", "fields");
+    uint64_t start = timer_ns();
+    size_t visited = 0,
+           bad = 0,
+           batches = 0;
+    unsigned long depth = 0;
+    for(; cur.count > 0; ++depth)
+    {
+        next.count = 0;
+        for(size_t first = 0; first < cur.count; first += BATCH_NODES)
+        {
+            size_t n = cur.count - first < BATCH_NODES ? cur.count - first : BATCH_NODES;
+            for(size_t i = 0; i < n; ++i)
+            {
+                node_t *node = &cur.nodes[first + i];
+                iov[i] = (kernel_iov_t)
+                {
+                    .addr = node->addr,
+                    .size = schema.structs[node->type].size,
+                    .buf = &buf[i * maxsize],
+                    .result = 0,
+                };
+            }
+            kernel_read_list(iov, n);
+            ++batches;
+
+            for(size_t i = 0; i < n; ++i)
+            {
+                node_t *node = &cur.nodes[first + i];
+                const struct_t *s = &schema.structs[node->type];
+                const uint8_t *data = iov[i].result == iov[i].size ? iov[i].buf : NULL;
+                print_node(&schema, node, data);
+                ++visited;
+                if(data == NULL)
+                {
+                    ++bad;
+                    continue;
+                }
+                if(depth >= max_depth)
+                {
+                    continue;
+                }
+                for(size_t j = 0; j < s->nfollows; ++j)
+                {
+                    const follow_t *fw = &s->follows[j];
+                    vm_address_t ptr = get_uint(&data[fw->off], sizeof(ptr));
+                    if(ptr < KERNEL_SPACE || ptr - fw->target_off < KERNEL_SPACE)
+                    {
+                        continue;
+                    }
+                    ptr -= fw->target_off;
+                    if(seen.count >= max_nodes)
+                    {
+                        continue;
+                    }
+                    int r = set_add(&seen, ptr);
+                    if(r < 0 || (r > 0 && !push(&next, ptr, fw->target, node->depth + 1)))
+                    {
+                        fprintf(stderr, "[!] Out of memory\n");
+                        goto out;
+                    }
+                }
+            }
+        }
+        frontier_t tmp = cur;
+        cur = next;
+        next = tmp;
+    }
+    uint64_t elapsed = timer_ns() - start;
+    fprintf(stderr, "[*] %zu structures over %lu levels in %zu batches, %zu unreadable, %.3f ms (%.2f us per structure)\n"
+            , visited, depth, batches, bad, elapsed / 1e6, visited > 0 ? elapsed / 1e3 / visited : 0.0);
+    if(seen.count >= max_nodes)
+    {
+        fprintf(stderr, "[!] Stopped at %lu structures, use -n to raise the limit\n", max_nodes);
+    }
+    ret = 0;
+
+out:;
+    free_schema(&schema);
+    free(seen.slots);
+    free(cur.nodes);
+    free(next.nodes);
+    free(iov);
+    free(buf);
+    return ret;
+}
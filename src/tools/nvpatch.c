@@ -10,11 +10,15 @@
 #include <stdio.h>              // fprintf, stderr
 #include <stdlib.h>             // free, malloc
 #include <string.h>             // memmem, strcmp, strnlen
+#include <unistd.h>             // STDOUT_FILENO
 
 #include "arch.h"               // ADDR, MACH_*, mach_*
-#include "debug.h"              // DEBUG, slow, verbose
+#include "debug.h"              // DEBUG, debug_flush, slow, verbose
+#include "emit.h"               // emit_*
 #include "libkern.h"            // KERNEL_BASE_OR_GTFO, kernel_read
 #include "mach-o.h"             // CMD_ITERATE
+#include "stats.h"              // stats_at_exit, STATS_HUMAN
+#include "strindex.h"           // str_index_cached, str_index_free, str_index_lookup
 
 #define MAX_HEADER_SIZE 0x4000
 
@@ -92,16 +96,21 @@ static void print_usage(const char *self)
                     "The second form patches the kernel to unrestrict the given variable.\n"
                     "\n"
                     "Options:\n"
-                    "    -d  Debug mode (sleep between function calls, gives\n"
-                    "        sshd time to deliver output before kernel panic)\n"
+                    "    -d  Debug mode (sync log output at every step, so it\n"
+                    "        survives a kernel panic)\n"
                     "    -h  Print this help\n"
+                    "    -o  List as text (default), json or bin (see emit.h)\n"
+                    "    -S  Print libkutil statistics on exit (KUTIL_STATS=json for JSON)\n"
                     "    -v  Verbose (debug output)\n"
                     , self, self);
 }
 
+static emit_t out;
+
 int main(int argc, const char **argv)
 {
     const char *target = NULL;
+    emit_fmt_t fmt = EMIT_TEXT;
 
     int aoff;
     for(aoff = 1; aoff < argc; ++aoff)
@@ -123,6 +132,19 @@ int main(int argc, const char **argv)
         {
             verbose = true;
         }
+        else if(strcmp(argv[aoff], "-S") == 0)
+        {
+            stats_at_exit(STATS_HUMAN);
+        }
+        else if(strcmp(argv[aoff], "-o") == 0 && aoff + 1 < argc)
+        {
+            if(!emit_parse_fmt(argv[++aoff], &fmt))
+            {
+                fprintf(stderr, "[!] Unknown output format: %s\n\n", argv[aoff]);
+                print_usage(argv[0]);
+                return -1;
+            }
+        }
         else
         {
             fprintf(stderr, "[!] Unrecognized option: %s\n\n", argv[aoff]);
@@ -234,13 +256,34 @@ int main(int argc, const char **argv)
 
     // This is the name of the first NVRAM variable
     char first[] = "little-endian?";
-    char *str = memmem(cstring.buf, cstring.len, first, sizeof(first));
-    if(str == NULL)
+    vm_address_t str_addr = 0;
+    // Use the string index if kstrings already built it for this kernel,
+    // building it just for this would take longer than searching the section
+    str_index_t *idx = str_index_cached(kbase);
+    if(idx != NULL)
     {
-        fprintf(stderr, "[!] Failed to find string \"%s\"\n", first);
-        return -1;
+        vm_address_t addrs[8];
+        size_t n = str_index_lookup(idx, first, sizeof(first) - 1, addrs, sizeof(addrs) / sizeof(*addrs));
+        for(size_t i = 0; i < n && i < sizeof(addrs) / sizeof(*addrs); ++i)
+        {
+            if(addrs[i] >= cstring.addr && addrs[i] < cstring.addr + cstring.len)
+            {
+                str_addr = addrs[i];
+                break;
+            }
+        }
+        str_index_free(idx);
+    }
+    if(str_addr == 0)
+    {
+        char *str = memmem(cstring.buf, cstring.len, first, sizeof(first));
+        if(str == NULL)
+        {
+            fprintf(stderr, "[!] Failed to find string \"%s\"\n", first);
+            return -1;
+        }
+        str_addr = (str - cstring.buf) + cstring.addr;
     }
-    vm_address_t str_addr = (str - cstring.buf) + cstring.addr;
     DEBUG("Found string \"%s\" at " ADDR, first, str_addr);
 
     // Now let's find a reference to it
@@ -326,10 +369,28 @@ int main(int argc, const char **argv)
     {
         DEBUG("gOFVariables:");
 
+        emit_init(&out, STDOUT_FILENO, fmt);
         for(size_t i = 0; i < numvars; ++i)
         {
             char *name = &cstring.buf[gOFVars[i].name - cstring.addr];
-            printf("%-*s %-*s %-*s\n", (int)longest_name, name, MAX_TYPELEN, type_name(gOFVars[i].type), MAX_PERMLEN, perm_name(gOFVars[i].perm));
+            if(fmt != EMIT_TEXT)
+            {
+                emit_begin(&out, "nvram");
+                emit_str(&out, "name", name);
+                emit_str(&out, "var_type", type_name(gOFVars[i].type));
+                emit_str(&out, "perm", perm_name(gOFVars[i].perm));
+                emit_hex(&out, "addr", gOFAddr + i * sizeof(OFVar));
+                emit_end(&out);
+            }
+            else
+            {
+                printf("%-*s %-*s %-*s\n", (int)longest_name, name, MAX_TYPELEN, type_name(gOFVars[i].type), MAX_PERMLEN, perm_name(gOFVars[i].perm));
+            }
+        }
+        if(emit_flush(&out) != 0)
+        {
+            fprintf(stderr, "[!] Failed to write output (%s)\n", strerror(errno));
+            return -1;
         }
     }
     else // Patch target
@@ -346,6 +407,7 @@ int main(int argc, const char **argv)
                 }
                 vm_size_t off = ((char*)&gOFVars[i].perm) - data.buf;
                 uint32_t newperm = kOFVarPermRootOnly;
+                debug_flush();
                 if(kernel_write(data.addr + off, sizeof(newperm), &newperm) != sizeof(newperm))
                 {
                     fprintf(stderr, "[!] Kernel I/O error\n");